@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mir/graphics/pixel_ops.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace mg = mir::graphics;
+
+namespace
+{
+// A 1080p frame's worth of pixels, which is well out of L2
+std::size_t const width = 1920;
+std::size_t const height = 1080;
+std::size_t const pixels = width * height;
+int const repeats = 20;
+
+/// Premultiplied pixels with a mix of opaque, clear and translucent runs
+std::vector<std::uint32_t> make_pixels(std::mt19937& random)
+{
+    std::vector<std::uint32_t> result(pixels);
+    for (std::size_t i = 0; i < pixels; i += 64)
+    {
+        auto const kind = random() % 3;
+        for (auto j = i; j != std::min(i + 64, pixels); ++j)
+        {
+            std::uint32_t const alpha = kind == 0 ? 255 : kind == 1 ? 0 : random() % 256;
+            result[j] = alpha << 24 | (alpha ? random() % (alpha + 1) : 0) * 0x010101;
+        }
+    }
+    return result;
+}
+
+/// The average time of a frame's worth of an operation, in milliseconds
+double time_of(std::function<void()> const& op)
+{
+    op();   // Warm up
+
+    auto const start = std::chrono::steady_clock::now();
+    for (auto i = 0; i != repeats; ++i)
+        op();
+    std::chrono::duration<double, std::milli> const elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / repeats;
+}
+}
+
+int main()
+{
+    std::mt19937 random{1};
+    auto const src = make_pixels(random);
+    auto dst = make_pixels(random);
+    std::vector<std::uint8_t> mask(pixels);
+    for (auto& coverage : mask)
+        coverage = random() % 3 ? 0 : random() % 256;
+
+    std::cout << "Milliseconds per " << width << "x" << height << " frame" << std::endl;
+    std::cout << std::setw(16) << "";
+    auto const implementations = mg::supported_pixel_ops();
+    for (auto const ops : implementations)
+        std::cout << std::setw(10) << ops->name;
+    std::cout << std::endl;
+
+    auto const report = [&](char const* name, std::function<void(mg::PixelOps const&)> const& op)
+        {
+            std::cout << std::setw(16) << std::left << name << std::right;
+            for (auto const ops : implementations)
+                std::cout << std::setw(10) << std::fixed << std::setprecision(3) << time_of([&]{ op(*ops); });
+            std::cout << std::endl;
+        };
+
+    report("copy", [&](auto& ops) { ops.copy(dst.data(), src.data(), pixels); });
+    report("copy_opaque", [&](auto& ops) { ops.copy_opaque(dst.data(), src.data(), pixels); });
+    report("swap_red_blue", [&](auto& ops) { ops.swap_red_blue(dst.data(), src.data(), pixels); });
+    report("reverse", [&](auto& ops) { ops.reverse(dst.data(), src.data(), pixels); });
+    report("premultiply", [&](auto& ops) { ops.premultiply(dst.data(), src.data(), pixels); });
+    report("fill", [&](auto& ops) { ops.fill(dst.data(), 0xff323232, pixels); });
+    report("over", [&](auto& ops) { ops.over(dst.data(), src.data(), pixels); });
+    report("over_with_alpha", [&](auto& ops) { ops.over_with_alpha(dst.data(), src.data(), pixels, 192); });
+    report("over_with_mask", [&](auto& ops) { ops.over_with_mask(dst.data(), mask.data(), 0xffffffff, pixels); });
+    report("rotate_left",
+        [&](auto& ops) { ops.rotate_left(dst.data(), height, src.data(), width, width, height); });
+    report("rotate_right",
+        [&](auto& ops) { ops.rotate_right(dst.data(), height, src.data(), width, width, height); });
+}
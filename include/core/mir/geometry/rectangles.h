@@ -41,6 +41,8 @@ public:
     void add(Rectangle const& rect);
     /// removes at most one matching rectangle
     void remove(Rectangle const& rect);
+    /// removes the area of rect from the collection, splitting rectangles as necessary
+    void subtract(Rectangle const& rect);
     void clear();
     Rectangle bounding_rectangle() const;
     void confine(Point& point) const;
@@ -78,6 +78,47 @@ public:
      */
     virtual std::chrono::milliseconds recommended_sleep() const = 0;
 
+    /**
+     * The most recent frame presented by this group, with the time of the
+     * vblank it was presented on. A zero msc means the platform doesn't know.
+     */
+    virtual Frame last_frame() const { return {}; }
+
+    /**
+     * The time between vblanks of this group, or zero if unknown.
+     */
+    virtual std::chrono::nanoseconds frame_interval() const
+    {
+        return std::chrono::nanoseconds::zero();
+    }
+
+    /**
+     * How long the group expects to need to render and post its next
+     * frame, or zero if unknown. The compositor starts that long before the
+     * vblank it's aiming for.
+     */
+    virtual std::chrono::nanoseconds predicted_render_time() const
+    {
+        return std::chrono::nanoseconds::zero();
+    }
+
+    /**
+     * Whether the frame most recently posted is still waiting for its
+     * vblank. Until it has been presented, last_frame() describes the one
+     * before it.
+     */
+    virtual bool frame_pending() const { return false; }
+
+    /**
+     * Calls \a handler with the frame the most recent post() was presented
+     * in, once it has been. Platforms that can't tell when that is call it
+     * straight away, with last_frame().
+     */
+    virtual void on_presented(std::function<void(Frame const&)> const& handler)
+    {
+        handler(last_frame());
+    }
+
     virtual ~DisplaySyncGroup() = default;
 protected:
     DisplaySyncGroup() = default;
@@ -68,6 +68,19 @@ public:
     **/
     virtual bool overlay(RenderableList const& renderlist) = 0;
 
+    /** Scan out what the hardware can of renderlist directly, on planes
+     *  above the composited image, when the whole list can't be overlaid.
+     *  The placement takes effect with the next post().
+     *  \param [in,out] renderlist
+     *      The renderables that should appear on the screen, bottom first.
+     *      Those assigned to planes are removed, leaving the ones the caller
+     *      still has to render in their original order. By default that is
+     *      all of them.
+    **/
+    virtual void assign_planes(RenderableList& /*renderlist*/)
+    {
+    }
+
     /**
      * Returns a transformation that the renderer must apply to all rendering.
      * There is usually no transformation required (just the identity matrix)
@@ -20,7 +20,9 @@
 #define MIR_GRAPHICS_GRAPHIC_BUFFER_ALLOCATOR_H_
 
 #include "mir/graphics/buffer.h"
+#include "mir/geometry/rectangles.h"
 
+#include <experimental/optional>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -85,10 +87,23 @@ public:
         std::function<void()>&& on_consumed,
         std::function<void()>&& on_release) = 0;
 
+    /**
+     * Import a wl_shm buffer
+     *
+     * \param buffer [in]           The wl_shm buffer
+     * \param wayland_executor [in] An Executor that spawns tasks on the Wayland event loop
+     * \param on_consumed [in]      Called when the compositor has consumed the buffer
+     * \param previous [in]         The buffer this one replaces in its stream, if any. Platforms
+     *                              may reuse its GPU resources rather than allocating afresh.
+     * \param damage [in]           The area of buffer that differs from previous, in buffer
+     *                              coordinates, or nullopt if unknown
+     */
     virtual auto buffer_from_shm(
         wl_resource* buffer,
         std::shared_ptr<mir::Executor> wayland_executor,
-        std::function<void()>&& on_consumed) -> std::shared_ptr<Buffer> = 0;
+        std::function<void()>&& on_consumed,
+        std::shared_ptr<Buffer> const& previous,
+        std::experimental::optional<geometry::Rectangles> const& damage) -> std::shared_ptr<Buffer> = 0;
 
 protected:
     GraphicBufferAllocator() = default;
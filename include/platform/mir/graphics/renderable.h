@@ -21,6 +21,8 @@
 
 #include <experimental/optional>
 #include <mir/geometry/rectangle.h>
+#include <mir/geometry/rectangles.h>
+#include <mir/graphics/buffer_id.h>
 #include <glm/glm.hpp>
 #include <memory>
 #include <vector>
@@ -72,7 +74,29 @@ public:
 
     virtual bool shaped() const = 0;  // meaning the pixel format has alpha
 
+    /**
+     * The parts of screen_position() that are opaque regardless of the alpha
+     * channel of buffer(). Only interesting if shaped().
+     */
+    virtual auto opaque_region() const -> geometry::Rectangles
+    {
+        return {};
+    }
+
     virtual unsigned int swap_interval() const = 0;
+
+    /**
+     * The parts of buffer() that differ from \a previous, an earlier buffer
+     * from the same source, in buffer coordinates. If this can't be
+     * determined then nothing is returned and the whole buffer should be
+     * considered damaged.
+     */
+    virtual auto buffer_damage_since(BufferID previous) const
+        -> std::experimental::optional<geometry::Rectangles>
+    {
+        (void)previous;
+        return {};
+    }
 protected:
     Renderable() = default;
     Renderable(Renderable const&) = delete;
@@ -48,6 +48,10 @@ extern char const* const cursor_opt;
 extern char const* const fatal_except_opt;
 extern char const* const debug_opt;
 extern char const* const composite_delay_opt;
+extern char const* const texture_cache_budget_opt;
+extern char const* const gpu_timing_opt;
+extern char const* const renderer_opt;
+extern char const* const software_renderer_threads_opt;
 extern char const* const enable_key_repeat_opt;
 extern char const* const x11_display_opt;
 extern char const* const wayland_extensions_opt;
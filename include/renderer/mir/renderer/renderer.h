@@ -20,10 +20,18 @@
 #define MIR_RENDERER_RENDERER_H_
 
 #include "mir/geometry/rectangle.h"
+#include "mir/geometry/rectangles.h"
 #include "mir/graphics/renderable.h"
 #include "mir_toolkit/common.h"
 #include <glm/glm.hpp>
 
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace mir
 {
 namespace renderer
@@ -36,9 +44,64 @@ public:
 
     virtual void set_viewport(geometry::Rectangle const& rect) = 0;
     virtual void set_output_transform(glm::mat2 const&) = 0;
+
+    /**
+     * Hint which parts of the viewport (in screen coordinates) have changed
+     * since the previous frame. This applies to the next render() only;
+     * without it the whole viewport is assumed to have changed.
+     */
+    virtual void set_damage(geometry::Rectangles const& damage) = 0;
+
+    /// The visible parts of partly hidden renderables, keyed by Renderable::id()
+    typedef std::unordered_map<graphics::Renderable::ID, geometry::Rectangles> VisibleRegions;
+
+    /**
+     * Restrict drawing of partly hidden renderables to their visible parts.
+     * This applies to the next render() only; renderables not listed are
+     * drawn in full.
+     */
+    virtual void set_visible_regions(VisibleRegions const& regions) = 0;
+
     virtual void render(graphics::RenderableList const&) const = 0;
     virtual void suspend() = 0; // called when render() is skipped
 
+    /// Graphics API state changes made, and skipped as redundant, in a frame
+    struct StateChanges
+    {
+        unsigned int made = 0;
+        unsigned int skipped = 0;
+    };
+
+    /// The state changes of the most recent render()
+    virtual StateChanges state_changes() const = 0;
+
+    /// Use of the renderer's cache of renderable textures in a frame
+    struct TextureCacheUse
+    {
+        /// Textures that were ready to draw
+        unsigned int hits = 0;
+        /// Textures that had to be (re)created or reuploaded
+        unsigned int misses = 0;
+        /// Estimated memory held by the cache afterwards, in bytes
+        std::size_t bytes_resident = 0;
+    };
+
+    /// The texture cache use of the most recent render()
+    virtual TextureCacheUse texture_cache_use() const = 0;
+
+    /// How long the GPU took over a frame, known once it has finished it
+    struct GPUFrameTiming
+    {
+        std::chrono::nanoseconds render_time;
+        /// The time between the GPU finishing the previous frame and starting this, if known
+        std::optional<std::chrono::nanoseconds> idle_before;
+        /// The GPU time spent on each renderable, in frames sampled for it
+        std::vector<std::pair<graphics::Renderable::ID, std::chrono::nanoseconds>> renderables;
+    };
+
+    /// The GPU timings of frames finished since the last call, if the renderer takes them
+    virtual std::vector<GPUFrameTiming> gpu_timings() = 0;
+
 protected:
     Renderer() = default;
     Renderer(const Renderer&) = delete;
@@ -19,6 +19,8 @@
 #ifndef MIR_RENDERER_GL_RENDER_TARGET_H_
 #define MIR_RENDERER_GL_RENDER_TARGET_H_
 
+#include "mir/geometry/rectangles.h"
+
 namespace mir
 {
 namespace renderer
@@ -41,6 +43,23 @@ public:
      * free GL-related resources such as textures and buffers.
      */
     virtual void swap_buffers() = 0;
+    /**
+     * Swap buffers, hinting that only \a damage (in render target pixels,
+     * relative to the top-left corner) changed since the previous swap.
+     * Targets which can't make use of the hint just swap_buffers().
+     */
+    virtual void swap_buffers_with_damage(geometry::Rectangles const& /*damage*/)
+    {
+        swap_buffers();
+    }
+    /**
+     * The number of frames since the current back buffer was last drawn
+     * to, or zero if its contents are unknown and must be fully redrawn.
+     */
+    virtual int buffer_age() const
+    {
+        return 0;
+    }
     /** Binds any necessary resources (fbos, textures if any)
      * in preparation for drawing.
      */
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_RENDERER_SW_RENDER_TARGET_H_
+#define MIR_RENDERER_SW_RENDER_TARGET_H_
+
+#include "mir/renderer/sw/pixel_source.h"
+
+#include <memory>
+
+namespace mir
+{
+namespace renderer
+{
+namespace software
+{
+
+/**
+ * An output the software renderer draws into with the CPU, offered by a
+ * DisplayBuffer's native_display_buffer().
+ *
+ * (The names differ from renderer::gl::RenderTarget's so a display buffer
+ * can offer both.)
+ */
+class RenderTarget
+{
+public:
+    virtual ~RenderTarget() = default;
+
+    /**
+     * Map the back buffer for drawing the next frame.
+     *
+     * \note    The mapping is read as well as written, for blending, and its
+     *          content is what was last drawn into the buffer (see back_buffer_age()).
+     * \note    The mapping is destroyed before commit_back_buffer() is called.
+     */
+    virtual std::unique_ptr<Mapping<unsigned char>> map_back_buffer() = 0;
+
+    /** Make the back buffer drawn since map_back_buffer() the next to be posted. */
+    virtual void commit_back_buffer() = 0;
+
+    /**
+     * The number of frames since the back buffer map_back_buffer() will
+     * return was last drawn to, or zero if its contents are unknown and it
+     * must be fully redrawn.
+     */
+    virtual int back_buffer_age() const
+    {
+        return 0;
+    }
+
+protected:
+    RenderTarget() = default;
+    RenderTarget(RenderTarget const&) = delete;
+    RenderTarget& operator=(RenderTarget const&) = delete;
+};
+
+}
+}
+}
+
+#endif // MIR_RENDERER_SW_RENDER_TARGET_H_
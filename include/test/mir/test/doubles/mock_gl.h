@@ -51,6 +51,7 @@ public:
     MOCK_METHOD1(glCheckFramebufferStatus, GLenum(GLenum));
     MOCK_METHOD1(glClear, void(GLbitfield));
     MOCK_METHOD4(glClearColor, void(GLclampf, GLclampf, GLclampf, GLclampf));
+    MOCK_METHOD1(glClearStencil, void(GLint));
     MOCK_METHOD4(glColorMask, void(GLboolean, GLboolean, GLboolean, GLboolean));
     MOCK_METHOD1(glCompileShader, void(GLuint));
     MOCK_METHOD0(glCreateProgram, GLuint());
@@ -95,9 +96,14 @@ public:
                  void(GLenum, GLenum, GLsizei, GLsizei));
     MOCK_METHOD4(glShaderSource,
                  void(GLuint, GLsizei, const GLchar * const *, const GLint *));
+    MOCK_METHOD3(glStencilFunc, void(GLenum, GLint, GLuint));
+    MOCK_METHOD3(glStencilOp, void(GLenum, GLenum, GLenum));
     MOCK_METHOD9(glTexImage2D,
                  void(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum,
                       GLenum,const GLvoid*));
+    MOCK_METHOD9(glTexSubImage2D,
+                 void(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum,
+                      GLenum, const GLvoid*));
     MOCK_METHOD3(glTexParameteri, void(GLenum, GLenum, GLenum));
     MOCK_METHOD2(glUniform1f, void(GLint, GLfloat));
     MOCK_METHOD3(glUniform2f, void(GLint, GLfloat, GLfloat));
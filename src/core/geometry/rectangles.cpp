@@ -60,6 +60,38 @@ void geom::Rectangles::remove(Rectangle const& rect)
     if (i != rectangles.end()) rectangles.erase(i);
 }
 
+void geom::Rectangles::subtract(Rectangle const& rect)
+{
+    // Reused so that the compositor's per-frame subtractions don't allocate
+    static thread_local std::vector<Rectangle> remaining;
+    remaining.clear();
+
+    for (auto const& r : rectangles)
+    {
+        if (!r.overlaps(rect))
+        {
+            remaining.push_back(r);
+            continue;
+        }
+
+        auto const hole = r.intersection_with(rect);
+
+        // The bands above and below the hole span the full width...
+        if (hole.top() > r.top())
+            remaining.push_back(rect_from_points(r.top_left, {r.right(), hole.top()}));
+        if (hole.bottom() < r.bottom())
+            remaining.push_back(rect_from_points({r.left(), hole.bottom()}, r.bottom_right()));
+
+        // ...the pieces either side only the height of the hole
+        if (hole.left() > r.left())
+            remaining.push_back(rect_from_points({r.left(), hole.top()}, hole.bottom_left()));
+        if (hole.right() < r.right())
+            remaining.push_back(rect_from_points(hole.top_right(), {r.right(), hole.bottom()}));
+    }
+
+    rectangles.swap(remaining);
+}
+
 void geom::Rectangles::clear()
 {
     rectangles.clear();
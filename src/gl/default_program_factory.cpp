@@ -23,6 +23,18 @@
 
 namespace mgl = mir::gl;
 
+std::size_t constexpr mgl::DefaultProgramFactory::default_texture_cache_budget;
+
+mgl::DefaultProgramFactory::DefaultProgramFactory()
+    : DefaultProgramFactory(default_texture_cache_budget)
+{
+}
+
+mgl::DefaultProgramFactory::DefaultProgramFactory(std::size_t texture_cache_budget)
+    : texture_cache_budget{texture_cache_budget}
+{
+}
+
 std::unique_ptr<mgl::Program>
 mgl::DefaultProgramFactory::create_gl_program(
     std::string const& vertex_shader,
@@ -35,5 +47,5 @@ mgl::DefaultProgramFactory::create_gl_program(
 
 std::unique_ptr<mgl::TextureCache> mgl::DefaultProgramFactory::create_texture_cache() const
 {
-    return std::make_unique<RecentlyUsedCache>();
+    return std::make_unique<RecentlyUsedCache>(texture_cache_budget);
 }
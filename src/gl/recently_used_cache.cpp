@@ -21,7 +21,9 @@
 #include "mir/graphics/buffer.h"
 #include "mir/renderer/gl/texture_source.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 #include <boost/throw_exception.hpp>
 
 namespace mg = mir::graphics;
@@ -29,6 +31,11 @@ namespace mgl = mir::gl;
 namespace geom = mir::geometry;
 namespace mrgl = mir::renderer::gl;
 
+mgl::RecentlyUsedCache::RecentlyUsedCache(std::size_t budget)
+    : budget{budget}
+{
+}
+
 std::shared_ptr<mgl::Texture> mgl::RecentlyUsedCache::load(mg::Renderable const& renderable)
 {
     auto const& buffer = renderable.buffer();
@@ -45,11 +52,22 @@ std::shared_ptr<mgl::Texture> mgl::RecentlyUsedCache::load(mg::Renderable const&
         texture_source->bind();
         texture.resource = buffer;
         texture.last_bound_buffer = buffer_id;
+
+        auto const size = buffer->size();
+        auto const bytes = static_cast<std::size_t>(size.width.as_int()) * size.height.as_int() *
+                           MIR_BYTES_PER_PIXEL(buffer->pixel_format());
+        bytes_resident += bytes - texture.bytes;
+        texture.bytes = bytes;
+        ++misses;
+    }
+    else
+    {
+        ++hits;
     }
     texture_source->secure_for_render();
 
     texture.valid_binding = true;
-    texture.used = true;
+    texture.last_used = frameno;
 
     return texture.texture;
 }
@@ -62,19 +80,37 @@ void mgl::RecentlyUsedCache::invalidate()
 
 void mgl::RecentlyUsedCache::drop_unused()
 {
-    auto t = textures.begin();
-    while (t != textures.end())
+    std::vector<decltype(textures)::iterator> evictable;
+    for (auto t = textures.begin(); t != textures.end(); ++t)
     {
         auto& tex = t->second;
         tex.resource.reset();
-        if (tex.used)
-        {
-            tex.used = false;
-            ++t;
-        }
-        else
+        if (frameno - tex.last_used >= grace_frames)
+            evictable.push_back(t);
+    }
+
+    if (bytes_resident > budget)
+    {
+        std::sort(evictable.begin(), evictable.end(),
+            [](auto const& a, auto const& b) { return a->second.last_used < b->second.last_used; });
+
+        for (auto const& t : evictable)
         {
-            t = textures.erase(t);
+            if (bytes_resident <= budget)
+                break;
+
+            bytes_resident -= t->second.bytes;
+            textures.erase(t);
         }
     }
+
+    ++frameno;
+}
+
+auto mgl::RecentlyUsedCache::statistics() -> Statistics
+{
+    Statistics const result{hits, misses, bytes_resident};
+    hits = 0;
+    misses = 0;
+    return result;
 }
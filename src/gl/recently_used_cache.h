@@ -24,6 +24,8 @@
 #include "mir/gl/texture.h"
 #include "mir/graphics/buffer_id.h"
 #include "mir/graphics/renderable.h"
+
+#include <cstddef>
 #include <unordered_map>
 
 namespace mir
@@ -31,12 +33,29 @@ namespace mir
 namespace graphics { class Buffer; }
 namespace gl
 {
+/**
+ * RecentlyUsedCache keeps the textures of renderables that drop out of the
+ * frame for a while, so that a window briefly hidden (by alt-tab, a
+ * workspace switch, another window...) can be shown again without
+ * recreating and reuploading its texture.
+ *
+ * Textures unused for grace_frames frames are evicted, least recently used
+ * first, while the cache holds more than its budget. Textures used more
+ * recently than that are kept whatever the budget.
+ */
 class RecentlyUsedCache : public TextureCache
 {
 public:
+    /// Frames an unused texture is kept for regardless of the budget
+    static constexpr unsigned int grace_frames = 8;
+
+    /// \param [in] budget   Memory (in bytes) the cache may hold on to
+    explicit RecentlyUsedCache(std::size_t budget);
+
     std::shared_ptr<Texture> load(graphics::Renderable const& renderable) override;
     void invalidate() override;
     void drop_unused() override;
+    Statistics statistics() override;
 
 private:
     struct Entry
@@ -46,12 +65,18 @@ private:
         {}
         std::shared_ptr<Texture> texture;
         graphics::BufferID last_bound_buffer;
-        bool used{true};
+        unsigned long long last_used{0};
+        std::size_t bytes{0};
         bool valid_binding{false};
         std::shared_ptr<graphics::Buffer> resource;
     };
 
+    std::size_t const budget;
     std::unordered_map<graphics::Renderable::ID, Entry> textures;
+    unsigned long long frameno{0};
+    std::size_t bytes_resident{0};
+    unsigned int hits{0};
+    unsigned int misses{0};
 };
 }
 }
@@ -0,0 +1,292 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mir/gl/texture_atlas.h"
+#include "mir/gl/texture.h"
+#include "mir/graphics/buffer.h"
+#include "mir/graphics/texture_atlas_limits.h"
+#include "mir/renderer/sw/pixel_source.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mg = mir::graphics;
+namespace mgl = mir::gl;
+namespace geom = mir::geometry;
+namespace mrs = mir::renderer::software;
+
+namespace
+{
+void copy_row(MirPixelFormat format, unsigned char const* from, unsigned char* to, int width)
+{
+    if (format == mir_pixel_format_abgr_8888 || format == mir_pixel_format_xbgr_8888)
+    {
+        std::memcpy(to, from, width * 4);
+        return;
+    }
+
+    // [A|X]RGB is BGRA in memory
+    for (auto const end = from + width * 4; from != end; from += 4, to += 4)
+    {
+        to[0] = from[2];
+        to[1] = from[1];
+        to[2] = from[0];
+        to[3] = from[3];
+    }
+}
+}
+
+mgl::TextureAtlas::TextureAtlas(geom::Size const& size, geom::Size const& max_entry)
+    : requested_size{size},
+      max_entry{max_entry}
+{
+}
+
+mgl::TextureAtlas::~TextureAtlas() = default;
+
+auto mgl::TextureAtlas::load(mg::Renderable const& renderable) -> std::optional<Region>
+{
+    auto const buffer = renderable.buffer();
+    auto const pixels = buffer ? dynamic_cast<mrs::PixelSource*>(buffer->native_buffer_base()) : nullptr;
+    auto const buffer_size = buffer ? buffer->size() : geom::Size{};
+
+    auto found = entries.find(renderable.id());
+    if (!pixels || !mg::texture_atlas_holds(buffer->pixel_format()) ||
+        buffer_size.width.as_int() <= 0 || buffer_size.width > max_entry.width ||
+        buffer_size.height.as_int() <= 0 || buffer_size.height > max_entry.height)
+    {
+        if (found != entries.end())
+        {
+            release(found->second.area);
+            entries.erase(found);
+        }
+        return std::nullopt;
+    }
+
+    if (!shared_texture)
+    {
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        size = geom::Size{
+            std::min(requested_size.width.as_int(), max_size),
+            std::min(requested_size.height.as_int(), max_size)};
+
+        shared_texture = std::make_shared<Texture>();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+                     size.width.as_int(), size.height.as_int(),
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        clear();
+    }
+
+    if (found != entries.end() && found->second.area.size != buffer_size)
+    {
+        release(found->second.area);
+        entries.erase(found);
+        found = entries.end();
+    }
+
+    if (found == entries.end())
+    {
+        auto const area = allocate(buffer_size);
+        if (!area)
+            return std::nullopt;
+
+        found = entries.emplace(renderable.id(), Entry{area.value(), buffer->id()}).first;
+    }
+
+    auto& entry = found->second;
+    entry.used = true;
+
+    if (!entry.uploaded || entry.buffer != buffer->id())
+    {
+        auto const width = buffer_size.width.as_int();
+        auto const height = buffer_size.height.as_int();
+        auto const stride = pixels->stride().as_int();
+        auto const format = buffer->pixel_format();
+
+        scratch.resize(width * height * 4);
+        pixels->read(
+            [&](unsigned char const* from)
+            {
+                for (auto row = 0; row != height; ++row)
+                    copy_row(format, from + row * stride, scratch.data() + row * width * 4, width);
+            });
+
+        shared_texture->bind();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+                        entry.area.top_left.x.as_int(), entry.area.top_left.y.as_int(),
+                        width, height,
+                        GL_RGBA, GL_UNSIGNED_BYTE, scratch.data());
+
+        entry.buffer = buffer->id();
+        entry.uploaded = true;
+    }
+
+    return region_of(entry.area);
+}
+
+auto mgl::TextureAtlas::texture() const -> std::shared_ptr<Texture>
+{
+    return shared_texture;
+}
+
+void mgl::TextureAtlas::invalidate()
+{
+    for (auto& entry : entries)
+        entry.second.uploaded = false;
+}
+
+void mgl::TextureAtlas::drop_unused()
+{
+    if (fragmented)
+    {
+        // Everything still in use is loaded again by the next frame, packed tightly
+        clear();
+        return;
+    }
+
+    for (auto i = entries.begin(); i != entries.end();)
+    {
+        if (i->second.used)
+        {
+            i->second.used = false;
+            ++i;
+        }
+        else
+        {
+            release(i->second.area);
+            i = entries.erase(i);
+        }
+    }
+}
+
+auto mgl::TextureAtlas::allocate(geom::Size const& entry_size) -> std::optional<geom::Rectangle>
+{
+    auto const width = entry_size.width.as_int();
+    auto const height = entry_size.height.as_int();
+    if (width > size.width.as_int())
+        return std::nullopt;
+
+    auto const place = [&](Shelf& shelf) -> std::optional<geom::Rectangle>
+        {
+            for (auto span = shelf.free.begin(); span != shelf.free.end(); ++span)
+            {
+                if (span->second < width)
+                    continue;
+
+                geom::Rectangle const area{{span->first, shelf.top}, entry_size};
+                span->first += width;
+                span->second -= width;
+                if (span->second == 0)
+                    shelf.free.erase(span);
+
+                free_area -= width * height;
+                return area;
+            }
+            return std::nullopt;
+        };
+
+    // Prefer shelves that don't waste much height...
+    for (auto& shelf : shelves)
+    {
+        if (shelf.height >= height && shelf.height <= height + height / 2)
+        {
+            if (auto const area = place(shelf))
+                return area;
+        }
+    }
+
+    // ...then a new shelf...
+    auto const next_top = shelves.empty() ? 0 : shelves.back().top + shelves.back().height;
+    if (next_top + height <= size.height.as_int())
+    {
+        shelves.push_back({next_top, height, {{0, size.width.as_int()}}});
+        return place(shelves.back());
+    }
+
+    // ...then whatever there's room on
+    for (auto& shelf : shelves)
+    {
+        if (shelf.height >= height)
+        {
+            if (auto const area = place(shelf))
+                return area;
+        }
+    }
+
+    if (free_area >= width * height)
+        fragmented = true;
+
+    return std::nullopt;
+}
+
+void mgl::TextureAtlas::release(geom::Rectangle const& area)
+{
+    auto const left = area.top_left.x.as_int();
+    auto const width = area.size.width.as_int();
+
+    auto const shelf = std::find_if(
+        shelves.begin(), shelves.end(),
+        [top = area.top_left.y.as_int()](Shelf const& s) { return s.top == top; });
+    if (shelf == shelves.end())
+        return;
+
+    free_area += width * area.size.height.as_int();
+
+    // Return the span, merging it with its neighbours
+    auto& free = shelf->free;
+    auto const next = std::lower_bound(
+        free.begin(), free.end(), std::make_pair(left, 0));
+    auto const span = free.insert(next, {left, width});
+    if (std::next(span) != free.end() && span->first + span->second == std::next(span)->first)
+    {
+        span->second += std::next(span)->second;
+        free.erase(std::next(span));
+    }
+    if (span != free.begin() && std::prev(span)->first + std::prev(span)->second == span->first)
+    {
+        std::prev(span)->second += span->second;
+        free.erase(span);
+    }
+
+    // Empty shelves at the bottom can be replaced by shelves of other heights
+    while (!shelves.empty() &&
+           shelves.back().free.size() == 1 &&
+           shelves.back().free.front().second == size.width.as_int())
+    {
+        shelves.pop_back();
+    }
+}
+
+void mgl::TextureAtlas::clear()
+{
+    entries.clear();
+    shelves.clear();
+    free_area = size.width.as_int() * size.height.as_int();
+    fragmented = false;
+}
+
+auto mgl::TextureAtlas::region_of(geom::Rectangle const& area) const -> Region
+{
+    GLfloat const width = size.width.as_int();
+    GLfloat const height = size.height.as_int();
+    return {
+        area.top_left.x.as_int() / width,
+        area.top_left.y.as_int() / height,
+        area.size.width.as_int() / width,
+        area.size.height.as_int() / height};
+}
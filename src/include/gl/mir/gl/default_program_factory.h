@@ -20,6 +20,8 @@
 #define MIR_GL_DEFAULT_PROGRAM_FACTORY_H_
 
 #include "program_factory.h"
+
+#include <cstddef>
 #include <mutex>
 
 namespace mir
@@ -29,10 +31,18 @@ namespace gl
 class DefaultProgramFactory : public ProgramFactory
 {
 public:
+    /// Memory (in bytes) texture caches keep textures not in use in
+    static std::size_t constexpr default_texture_cache_budget = 64 * 1024 * 1024;
+
+    DefaultProgramFactory();
+    explicit DefaultProgramFactory(std::size_t texture_cache_budget);
+
     std::unique_ptr<Program> create_gl_program(std::string const&, std::string const&) const override;
     std::unique_ptr<TextureCache> create_texture_cache() const override;
 
 private:
+    std::size_t const texture_cache_budget;
+
     /*
      * We need to serialize renderer creation because some GL calls used
      * during renderer construction that create unique resource ids
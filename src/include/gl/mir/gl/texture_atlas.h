@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GL_TEXTURE_ATLAS_H_
+#define MIR_GL_TEXTURE_ATLAS_H_
+
+#include "mir/geometry/rectangle.h"
+#include "mir/graphics/buffer_id.h"
+#include "mir/graphics/renderable.h"
+
+#include <GLES2/gl2.h>
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace mir
+{
+namespace gl
+{
+class Texture;
+
+/**
+ * TextureAtlas packs the buffers of small software renderables (cursors,
+ * touchspots, tooltips, decoration buttons...) into one shared texture, so
+ * they can be drawn without binding a texture each, and together.
+ *
+ * Buffers are packed onto shelves: rows of the texture as high as the
+ * tallest buffer on them. Entries not loaded in a frame are evicted by
+ * drop_unused(), and if a buffer didn't fit because the free space was too
+ * fragmented the atlas is emptied, so that it's packed afresh as the next
+ * frame loads its buffers again.
+ */
+class TextureAtlas
+{
+public:
+    /// Where a buffer's pixels are in the texture, in texture coordinates
+    struct Region
+    {
+        GLfloat left, top, width, height;
+    };
+
+    /**
+     * \param [in] size         The size of the shared texture (reduced to what GL supports)
+     * \param [in] max_entry    The largest buffer to pack into it
+     */
+    TextureAtlas(geometry::Size const& size, geometry::Size const& max_entry);
+    ~TextureAtlas();
+
+    TextureAtlas(TextureAtlas const&) = delete;
+    TextureAtlas& operator=(TextureAtlas const&) = delete;
+
+    /**
+     * Load the renderable's buffer into the atlas, if it is a small
+     * software buffer in a format the atlas holds. Its top row is at the
+     * top of the region. Must be called with a current GL context.
+     *
+     * \returns Where the buffer is in the texture, if it's in the atlas
+     */
+    std::optional<Region> load(graphics::Renderable const& renderable);
+
+    /// The shared texture (only valid once something has been loaded)
+    std::shared_ptr<Texture> texture() const;
+
+    /// Reload every buffer when it's next loaded. Doesn't need a GL context.
+    void invalidate();
+
+    /**
+     * Evict buffers that weren't loaded since the last call, and repack
+     * if the atlas has become too fragmented. Must be called with a
+     * current GL context.
+     */
+    void drop_unused();
+
+private:
+    struct Entry
+    {
+        geometry::Rectangle area;
+        graphics::BufferID buffer;
+        bool uploaded{false};
+        bool used{true};
+    };
+
+    /// A row of the texture, and the free spans along it
+    struct Shelf
+    {
+        int top;
+        int height;
+        /// Free spans as (left, width), sorted by left
+        std::vector<std::pair<int, int>> free;
+    };
+
+    std::optional<geometry::Rectangle> allocate(geometry::Size const& size);
+    void release(geometry::Rectangle const& area);
+    void clear();
+    Region region_of(geometry::Rectangle const& area) const;
+
+    geometry::Size const requested_size;
+    geometry::Size const max_entry;
+    geometry::Size size;
+
+    std::shared_ptr<Texture> shared_texture;
+    std::unordered_map<graphics::Renderable::ID, Entry> entries;
+    std::vector<Shelf> shelves;
+    int free_area{0};
+    /// Set when a buffer didn't fit, though there was room for it in total
+    bool fragmented{false};
+    /// Pixels converted for upload, kept to avoid reallocating
+    std::vector<unsigned char> scratch;
+};
+}
+}
+
+#endif /* MIR_GL_TEXTURE_ATLAS_H_ */
@@ -20,6 +20,7 @@
 #ifndef MIR_GL_TEXTURE_CACHE_H_
 #define MIR_GL_TEXTURE_CACHE_H_
 
+#include <cstddef>
 #include <memory>
 
 namespace mir
@@ -52,11 +53,25 @@ public:
     virtual void invalidate() = 0;
 
     /**
-     * Free textures that were not used (loaded) since the last
-     * drop/invalidate. Must be called with a current GL context.
+     * Called once a frame, after the frame's textures have been loaded, to
+     * free textures the cache no longer wants to keep. Must be called with a
+     * current GL context.
      */
     virtual void drop_unused() = 0;
 
+    struct Statistics
+    {
+        /// Loads that found the texture ready to use
+        unsigned int hits = 0;
+        /// Loads that had to create or rebind (and maybe upload) the texture
+        unsigned int misses = 0;
+        /// Estimated memory held by the cached textures, in bytes
+        std::size_t bytes_resident = 0;
+    };
+
+    /// Hits and misses since the last call, and what the cache holds now
+    virtual Statistics statistics() = 0;
+
 protected:
     TextureCache() = default;
 private:
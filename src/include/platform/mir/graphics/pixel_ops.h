@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_PIXEL_OPS_H_
+#define MIR_GRAPHICS_PIXEL_OPS_H_
+
+#include "mir/geometry/size.h"
+#include "mir/geometry/dimensions.h"
+#include "mir_toolkit/common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mir
+{
+namespace graphics
+{
+
+/**
+ * Operations on rows of 32-bit pixels with alpha in the top byte. The other
+ * three channels are treated alike, so these work for any order of them as
+ * long as source and destination agree. Blending expects premultiplied
+ * pixels.
+ *
+ * Unless noted, dst may be the same row as src (but not otherwise overlap
+ * it). Every implementation gives exactly the same results, x × a / 255
+ * being rounded to nearest throughout.
+ */
+struct PixelOps
+{
+    char const* name;
+
+    /// dst = src
+    void (*copy)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n);
+    /// dst = src with its alpha made opaque (for formats without alpha)
+    void (*copy_opaque)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n);
+    /// dst = src with its first and third channels swapped (ARGB <-> ABGR)
+    void (*swap_red_blue)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n);
+    /// dst = src, last pixel first; dst and src must not overlap
+    void (*reverse)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n);
+    /// dst = src with its colour channels multiplied by its alpha
+    void (*premultiply)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n);
+    /// dst = colour
+    void (*fill)(std::uint32_t* dst, std::uint32_t colour, std::size_t n);
+    /// dst = src + dst × (1 - src alpha)
+    void (*over)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n);
+    /// dst = src × alpha + dst × (1 - src alpha × alpha)
+    void (*over_with_alpha)(std::uint32_t* dst, std::uint32_t const* src, std::size_t n, std::uint8_t alpha);
+    /// dst = colour × mask + dst × (1 - colour alpha × mask), as for drawing glyphs
+    void (*over_with_mask)(std::uint32_t* dst, std::uint8_t const* mask, std::uint32_t colour, std::size_t n);
+
+    /**
+     * Write the width × height image at src to dst turned a quarter turn
+     * anticlockwise (left) or clockwise (right), so height × width. Strides
+     * are in pixels, and the images must not overlap.
+     * @{ */
+    void (*rotate_left)(
+        std::uint32_t* dst, std::size_t dst_stride,
+        std::uint32_t const* src, std::size_t src_stride,
+        std::size_t width, std::size_t height);
+    void (*rotate_right)(
+        std::uint32_t* dst, std::size_t dst_stride,
+        std::uint32_t const* src, std::size_t src_stride,
+        std::size_t width, std::size_t height);
+    /** @} */
+};
+
+/// The fastest operations the CPU we're running on supports, chosen on first use
+PixelOps const& pixel_ops();
+
+/// Every implementation the CPU supports, the portable one first
+std::vector<PixelOps const*> supported_pixel_ops();
+
+/// Turn a 32-bit image upside down in place, swapping red and blue as well if asked
+void flip_vertically(
+    unsigned char* pixels,
+    geometry::Size const& size,
+    geometry::Stride const& stride,
+    bool swap_red_blue);
+
+/**
+ * Copy the 32-bit image at src to dst turned to an orientation; left and
+ * right swap its width and height. The images must not overlap.
+ */
+void rotate(
+    unsigned char* dst,
+    geometry::Stride const& dst_stride,
+    unsigned char const* src,
+    geometry::Size const& size,
+    geometry::Stride const& src_stride,
+    MirOrientation orientation);
+}
+}
+
+#endif /* MIR_GRAPHICS_PIXEL_OPS_H_ */
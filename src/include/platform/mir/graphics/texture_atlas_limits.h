@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_TEXTURE_ATLAS_LIMITS_H_
+#define MIR_GRAPHICS_TEXTURE_ATLAS_LIMITS_H_
+
+#include "mir/geometry/size.h"
+#include "mir_toolkit/common.h"
+
+#include <endian.h>
+
+namespace mir
+{
+namespace graphics
+{
+/*
+ * The GL renderer copies small software buffers into a texture atlas
+ * itself, so platforms needn't upload those to textures of their own.
+ * These are the limits of what it takes, shared so that both sides agree.
+ */
+
+/// The largest buffer the atlas takes
+geometry::Size constexpr texture_atlas_max_entry{256, 256};
+
+/// Whether the atlas holds pixels of \a format (it stores RGBA bytes, reordering [A|X]RGB)
+inline bool texture_atlas_holds(MirPixelFormat format)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    switch (format)
+    {
+    case mir_pixel_format_abgr_8888:
+    case mir_pixel_format_xbgr_8888:
+    case mir_pixel_format_argb_8888:
+    case mir_pixel_format_xrgb_8888:
+        return true;
+    default:
+        return false;
+    }
+#else
+    (void)format;
+    return false;
+#endif
+}
+
+/**
+ * Whether a software buffer of \a size and \a format can go in the atlas.
+ * Whether it does also depends on how it's drawn, and on there being room.
+ */
+inline bool texture_atlas_can_hold(geometry::Size const& size, MirPixelFormat format)
+{
+    return texture_atlas_holds(format) &&
+           size.width.as_int() > 0 && size.width <= texture_atlas_max_entry.width &&
+           size.height.as_int() > 0 && size.height <= texture_atlas_max_entry.height;
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_TEXTURE_ATLAS_LIMITS_H_ */
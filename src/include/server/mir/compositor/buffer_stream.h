@@ -21,10 +21,12 @@
 #define MIR_COMPOSITOR_BUFFER_STREAM_H_
 
 #include "mir/geometry/size.h"
+#include "mir/geometry/rectangles.h"
 #include "mir/frontend/buffer_stream.h"
 #include "mir_toolkit/common.h"
 #include "mir/graphics/buffer_id.h"
 
+#include <experimental/optional>
 #include <memory>
 
 namespace mir
@@ -42,6 +44,23 @@ class BufferStream : public frontend::BufferStream
 public:
     virtual ~BufferStream() = default;
 
+    using frontend::BufferStream::submit_buffer;
+    /// Submit a buffer that differs from the previously submitted one only in \a damage (in buffer coordinates)
+    virtual void submit_buffer(
+        std::shared_ptr<graphics::Buffer> const& buffer,
+        geometry::Rectangles const& damage) = 0;
+    /**
+     * The damage accumulated over the buffers submitted after \a from up to
+     * and including \a to. Nothing is returned if this isn't known (e.g.
+     * \a from is too old, or a buffer was submitted without damage).
+     */
+    virtual auto damage_between(graphics::BufferID from, graphics::BufferID to) const
+        -> std::experimental::optional<geometry::Rectangles> = 0;
+
+    /// The parts of the stream the client has declared opaque (in logical coordinates)
+    virtual void set_opaque_region(geometry::Rectangles const& region) = 0;
+    virtual auto opaque_region() const -> geometry::Rectangles = 0;
+
     virtual auto lock_compositor_buffer(void const* user_id) -> std::shared_ptr<graphics::Buffer> = 0;
     /// Logical size of the stream (may be different than buffer sizes if scaled)
     virtual auto stream_size() -> geometry::Size = 0;
@@ -21,6 +21,9 @@
 
 #include "mir/graphics/renderable.h"
 
+#include <chrono>
+#include <cstddef>
+
 namespace mir
 {
 namespace compositor
@@ -34,6 +37,18 @@ public:
     virtual void began_frame(SubCompositorId id) = 0;
     virtual void renderables_in_frame(SubCompositorId id, graphics::RenderableList const& renderables) = 0;
     virtual void rendered_frame(SubCompositorId id) = 0;
+    /// The renderer's state changes for the frame, and those it skipped as redundant
+    virtual void state_changes_in_frame(SubCompositorId id, unsigned int made, unsigned int skipped) = 0;
+    /// The renderer's texture cache hits and misses for the frame, and the memory it holds after it
+    virtual void texture_cache_in_frame(
+        SubCompositorId id, unsigned int hits, unsigned int misses, std::size_t bytes_resident) = 0;
+    /// How long the GPU took over an earlier frame, once it has finished it (if the renderer times it)
+    virtual void gpu_rendered_frame(SubCompositorId id, std::chrono::nanoseconds render_time) = 0;
+    /// How long the GPU spent between finishing an earlier frame and starting the one after
+    virtual void gpu_idle(SubCompositorId id, std::chrono::nanoseconds gap) = 0;
+    /// The GPU time spent drawing a renderable, in frames sampled for it
+    virtual void gpu_rendered_renderable(
+        SubCompositorId id, graphics::Renderable::ID renderable, std::chrono::nanoseconds render_time) = 0;
     virtual void finished_frame(SubCompositorId id) = 0;
     virtual void started() = 0;
     virtual void stopped() = 0;
@@ -21,6 +21,9 @@
 #define MIR_COMPOSITOR_DISPLAY_BUFFER_COMPOSITOR_H_
 
 #include "mir/compositor/scene.h"
+#include "mir/graphics/buffer_id.h"
+
+#include <vector>
 
 namespace mir
 {
@@ -34,6 +37,16 @@ public:
 
     virtual void composite(SceneElementSequence&& scene_sequence) = 0;
 
+    /**
+     * Adds the buffers the last composite() showed to \a composited, or to
+     * \a scanned_out for those it had the display hardware show directly.
+     */
+    virtual void buffers_shown(
+        std::vector<graphics::BufferID>& /*composited*/,
+        std::vector<graphics::BufferID>& /*scanned_out*/) const
+    {
+    }
+
 protected:
     DisplayBufferCompositor() = default;
     DisplayBufferCompositor& operator=(DisplayBufferCompositor const&) = delete;
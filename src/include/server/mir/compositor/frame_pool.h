@@ -0,0 +1,218 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_COMPOSITOR_FRAME_POOL_H_
+#define MIR_COMPOSITOR_FRAME_POOL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * Each compositor composites on a thread of its own, building much the same
+ * short-lived scene elements, renderables and lists every frame. Keeping what
+ * a frame frees on a per-thread free list, for the next frame on that thread
+ * to take, means steady-state composition doesn't touch the heap.
+ *
+ * Objects and vectors may be freed on a different thread from the one that
+ * made them; they simply join that thread's pool.
+ */
+
+namespace mir
+{
+namespace compositor
+{
+namespace detail
+{
+/// A free list of blocks of a single size, for the calling thread
+template<std::size_t block_size>
+class FreeBlocks
+{
+public:
+    static void* take()
+    {
+        if (auto const block = head)
+        {
+            head = block->next;
+            --count;
+            return block;
+        }
+        return ::operator new(block_size);
+    }
+
+    static void give(void* block) noexcept
+    {
+        static thread_local Reaper const reaper;
+        (void)reaper;
+
+        if (exiting || count == max_blocks)
+        {
+            ::operator delete(block);
+            return;
+        }
+
+        auto const node = static_cast<Node*>(block);
+        node->next = head;
+        head = node;
+        ++count;
+    }
+
+private:
+    struct Node { Node* next; };
+
+    /// Frees the cached blocks when the thread exits
+    struct Reaper
+    {
+        ~Reaper()
+        {
+            exiting = true;
+            while (auto const block = head)
+            {
+                head = block->next;
+                ::operator delete(block);
+            }
+            count = 0;
+        }
+    };
+
+    static_assert(block_size >= sizeof(Node), "blocks must be big enough to link");
+
+    // Plenty for a frame's worth of scene elements and renderables
+    static std::size_t constexpr max_blocks = 1024;
+
+    // Plain data, so they are usable until the thread's last destructor runs
+    static inline thread_local Node* head{nullptr};
+    static inline thread_local std::size_t count{0};
+    static inline thread_local bool exiting{false};
+};
+
+/// Spare (cleared) vectors of one type, for the calling thread
+template<typename Vector>
+class SpareVectors
+{
+public:
+    static Vector take()
+    {
+        if (!spares || spares->empty())
+            return {};
+
+        auto result = std::move(spares->back());
+        spares->pop_back();
+        return result;
+    }
+
+    static void give(Vector&& vector)
+    {
+        vector.clear();
+        if (exiting || vector.capacity() == 0)
+            return;
+
+        if (!spares)
+        {
+            static thread_local Reaper const reaper;
+            (void)reaper;
+            spares = new std::vector<Vector>;
+            spares->reserve(max_spares);
+        }
+
+        if (spares->size() != max_spares)
+            spares->push_back(std::move(vector));
+    }
+
+private:
+    struct Reaper
+    {
+        ~Reaper()
+        {
+            exiting = true;
+            delete spares;
+            spares = nullptr;
+        }
+    };
+
+    static std::size_t constexpr max_spares = 64;
+
+    static inline thread_local std::vector<Vector>* spares{nullptr};
+    static inline thread_local bool exiting{false};
+};
+}
+
+/// An allocator that recycles single objects through the calling thread's free lists
+template<typename T>
+class FrameAllocator
+{
+public:
+    using value_type = T;
+
+    FrameAllocator() = default;
+    template<typename U>
+    FrameAllocator(FrameAllocator<U> const&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        if (n != 1)
+            return std::allocator<T>{}.allocate(n);
+        return static_cast<T*>(Blocks::take());
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n != 1)
+            std::allocator<T>{}.deallocate(p, n);
+        else
+            Blocks::give(p);
+    }
+
+private:
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned types aren't supported");
+
+    // Rounding sizes up lets similar types share a list
+    using Blocks = detail::FreeBlocks<(std::max(sizeof(T), sizeof(void*)) + 15) / 16 * 16>;
+};
+
+template<typename T, typename U>
+bool operator==(FrameAllocator<T> const&, FrameAllocator<U> const&) { return true; }
+
+template<typename T, typename U>
+bool operator!=(FrameAllocator<T> const&, FrameAllocator<U> const&) { return false; }
+
+/// As std::make_shared(), but reusing storage freed by earlier frames
+template<typename T, typename... Args>
+std::shared_ptr<T> make_frame_shared(Args&&... args)
+{
+    return std::allocate_shared<T>(FrameAllocator<T>{}, std::forward<Args>(args)...);
+}
+
+/// An empty vector, with the storage of one passed to recycle() on this thread if there is one
+template<typename Vector>
+Vector recycled_vector()
+{
+    return detail::SpareVectors<Vector>::take();
+}
+
+/// Clear vector, keeping its storage for a later recycled_vector() on this thread
+template<typename Vector>
+void recycle(Vector& vector)
+{
+    detail::SpareVectors<Vector>::give(std::move(vector));
+}
+}
+}
+
+#endif /* MIR_COMPOSITOR_FRAME_POOL_H_ */
@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_COMPOSITOR_PRESENTATION_OBSERVER_H_
+#define MIR_COMPOSITOR_PRESENTATION_OBSERVER_H_
+
+#include "mir/graphics/buffer_id.h"
+#include "mir/graphics/frame.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace mir
+{
+namespace compositor
+{
+/// A frame that has reached the screen, and the client buffers it showed
+struct PresentedFrame
+{
+    /// When the frame was presented; an msc of zero means the platform doesn't know
+    graphics::Frame frame;
+    /// The time between vblanks of the output, or zero if unknown
+    std::chrono::nanoseconds refresh;
+    /// Buffers drawn into the frame
+    std::vector<graphics::BufferID> composited;
+    /// Buffers the display hardware scanned out directly, without a copy
+    std::vector<graphics::BufferID> scanned_out;
+};
+
+class PresentationObserver
+{
+public:
+    virtual ~PresentationObserver() = default;
+
+    virtual void frame_presented(std::shared_ptr<PresentedFrame const> const& frame) = 0;
+
+    /**
+     * Whether anything is waiting to hear about the next frame. While not,
+     * frames needn't be reported. Called from the compositor threads.
+     */
+    virtual bool awaiting_presentation() = 0;
+
+protected:
+    PresentationObserver() = default;
+    PresentationObserver(PresentationObserver const&) = delete;
+    PresentationObserver& operator=(PresentationObserver const&) = delete;
+};
+}
+}
+
+#endif /* MIR_COMPOSITOR_PRESENTATION_OBSERVER_H_ */
@@ -55,6 +55,7 @@ class Drawer;
 class DisplayBufferCompositorFactory;
 class Compositor;
 class CompositorReport;
+class PresentationObserver;
 }
 namespace frontend
 {
@@ -374,6 +375,8 @@ protected:
     std::shared_ptr<input::DefaultInputDeviceHub>  the_default_input_device_hub();
     std::shared_ptr<graphics::DisplayConfigurationObserver> the_display_configuration_observer();
     std::shared_ptr<input::SeatObserver> the_seat_observer();
+    std::shared_ptr<compositor::PresentationObserver> the_presentation_observer();
+    std::shared_ptr<ObserverRegistrar<compositor::PresentationObserver>> the_presentation_observer_registrar();
     std::shared_ptr<frontend::SessionMediatorObserver> the_session_mediator_observer();
 
     virtual std::shared_ptr<scene::MediatingDisplayChanger> the_mediating_display_changer();
@@ -473,6 +476,8 @@ private:
         display_configuration_observer_multiplexer;
     CachedPtr<ObserverMultiplexer<input::SeatObserver>>
         seat_observer_multiplexer;
+    CachedPtr<ObserverMultiplexer<compositor::PresentationObserver>>
+        presentation_observer_multiplexer;
     CachedPtr<ObserverMultiplexer<frontend::SessionMediatorObserver>>
         session_mediator_observer_multiplexer;
 
@@ -64,6 +64,16 @@ protected:
      */
     template<typename MemberFn, typename... Args>
     void for_each_observer(MemberFn f, Args&&... args);
+
+    /**
+     * Whether a member function of Observer returns true for any registered
+     * observer. Unlike for_each_observer() it is called on this thread.
+     *
+     * \tparam MemberFn Must be bool (Observer::*)()
+     * \param f         Pointer to Observer member function to invoke.
+     */
+    template<typename MemberFn>
+    bool any_observer(MemberFn f);
 private:
     Executor& default_executor;
 
@@ -212,6 +222,26 @@ void ObserverMultiplexer<Observer>::for_each_observer(MemberFn f, Args&&... args
             });
     }
 }
+
+template<class Observer>
+template<typename MemberFn>
+bool ObserverMultiplexer<Observer>::any_observer(MemberFn f)
+{
+    static_assert(
+        std::is_member_function_pointer<MemberFn>::value,
+        "f must be of type bool (Observer::*)(), a pointer to an Observer member function.");
+    auto const invokable_mem_fn = std::mem_fn(f);
+    std::shared_lock<decltype(observer_mutex)> lock{observer_mutex};
+    for (auto& observer_pair: observers)
+    {
+        if (auto observer = observer_pair.second->lock())
+        {
+            if (invokable_mem_fn(observer))
+                return true;
+        }
+    }
+    return false;
+}
 }
 
 
@@ -66,6 +66,8 @@ private:
     std::map<Surface*, std::weak_ptr<SurfaceObserver>> surface_observers;
     
     void add_surface_observer(Surface* surface);
+    /// Notify a change to everything \a surface covers
+    void notify_change_to(Surface const& surface);
 };
 
 }
@@ -0,0 +1,941 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define MIR_LOG_COMPONENT "pixel-ops"
+
+#include "mir/graphics/pixel_ops.h"
+#include "mir/log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIR_PIXEL_OPS_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define MIR_PIXEL_OPS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace mg = mir::graphics;
+namespace geom = mir::geometry;
+
+namespace
+{
+std::uint32_t const alpha_mask = 0xff000000;
+
+/// x × a / 255, rounded to nearest, for x and a in [0, 255]
+inline std::uint32_t mul(std::uint32_t x, std::uint32_t a)
+{
+    auto const t = x * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+inline std::uint32_t scale(std::uint32_t pixel, std::uint32_t a)
+{
+    return mul(pixel & 0xff, a) |
+           mul((pixel >> 8) & 0xff, a) << 8 |
+           mul((pixel >> 16) & 0xff, a) << 16 |
+           mul(pixel >> 24, a) << 24;
+}
+
+inline std::uint32_t add_saturated(std::uint32_t a, std::uint32_t b)
+{
+    std::uint32_t result = 0;
+    for (auto shift = 0; shift != 32; shift += 8)
+    {
+        auto const sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff);
+        result |= std::min(sum, 255u) << shift;
+    }
+    return result;
+}
+
+inline std::uint32_t over(std::uint32_t dst, std::uint32_t src)
+{
+    return add_saturated(src, scale(dst, 255 - (src >> 24)));
+}
+
+inline std::uint32_t swap_red_blue(std::uint32_t pixel)
+{
+    return (pixel & 0xff00ff00) | (pixel & 0xff) << 16 | ((pixel >> 16) & 0xff);
+}
+
+inline std::uint32_t premultiply(std::uint32_t pixel)
+{
+    return (scale(pixel, pixel >> 24) & ~alpha_mask) | (pixel & alpha_mask);
+}
+
+/*
+ * Rotate the part [x0, x1) × [y0, y1) of a width × height image. The
+ * vectorised rotations use these for the edges that don't fill a block.
+ */
+void rotate_left_area(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width,
+    std::size_t x0, std::size_t x1, std::size_t y0, std::size_t y1)
+{
+    for (auto y = y0; y < y1; ++y)
+        for (auto x = x0; x < x1; ++x)
+            dst[(width - 1 - x) * dst_stride + y] = src[y * src_stride + x];
+}
+
+void rotate_right_area(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t height,
+    std::size_t x0, std::size_t x1, std::size_t y0, std::size_t y1)
+{
+    for (auto y = y0; y < y1; ++y)
+        for (auto x = x0; x < x1; ++x)
+            dst[x * dst_stride + (height - 1 - y)] = src[y * src_stride + x];
+}
+
+void copy_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    if (dst != src)
+        std::memmove(dst, src, n * sizeof *dst);
+}
+
+void copy_opaque_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    for (auto i = 0u; i != n; ++i)
+        dst[i] = src[i] | alpha_mask;
+}
+
+void swap_red_blue_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    for (auto i = 0u; i != n; ++i)
+        dst[i] = swap_red_blue(src[i]);
+}
+
+void reverse_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    std::reverse_copy(src, src + n, dst);
+}
+
+void premultiply_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    for (auto i = 0u; i != n; ++i)
+        dst[i] = premultiply(src[i]);
+}
+
+void fill_scalar(std::uint32_t* dst, std::uint32_t colour, std::size_t n)
+{
+    std::fill_n(dst, n, colour);
+}
+
+void over_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    for (auto i = 0u; i != n; ++i)
+        dst[i] = over(dst[i], src[i]);
+}
+
+void over_with_alpha_scalar(std::uint32_t* dst, std::uint32_t const* src, std::size_t n, std::uint8_t alpha)
+{
+    for (auto i = 0u; i != n; ++i)
+        dst[i] = over(dst[i], scale(src[i], alpha));
+}
+
+void over_with_mask_scalar(std::uint32_t* dst, std::uint8_t const* mask, std::uint32_t colour, std::size_t n)
+{
+    for (auto i = 0u; i != n; ++i)
+    {
+        if (mask[i])
+            dst[i] = over(dst[i], scale(colour, mask[i]));
+    }
+}
+
+/// Tiles small enough that the rows read and those written both stay in cache
+std::size_t const rotate_tile = 32;
+
+void rotate_left_scalar(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height)
+{
+    for (auto y = 0u; y < height; y += rotate_tile)
+        for (auto x = 0u; x < width; x += rotate_tile)
+            rotate_left_area(
+                dst, dst_stride, src, src_stride, width,
+                x, std::min(x + rotate_tile, width), y, std::min(y + rotate_tile, height));
+}
+
+void rotate_right_scalar(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height)
+{
+    for (auto y = 0u; y < height; y += rotate_tile)
+        for (auto x = 0u; x < width; x += rotate_tile)
+            rotate_right_area(
+                dst, dst_stride, src, src_stride, height,
+                x, std::min(x + rotate_tile, width), y, std::min(y + rotate_tile, height));
+}
+
+mg::PixelOps const scalar_ops{
+    "scalar",
+    &copy_scalar,
+    &copy_opaque_scalar,
+    &swap_red_blue_scalar,
+    &reverse_scalar,
+    &premultiply_scalar,
+    &fill_scalar,
+    &over_scalar,
+    &over_with_alpha_scalar,
+    &over_with_mask_scalar,
+    &rotate_left_scalar,
+    &rotate_right_scalar};
+
+/*
+ * The vectorised rotations turn the image in 4 × 4 blocks: transpose a
+ * block's rows, then write each one out as a column (reversed, for right).
+ * `Transpose` reads the block at src and stores its i-th column, four
+ * pixels, at column(i).
+ */
+template<typename Transpose>
+void rotate_left_blocks(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height,
+    Transpose transpose)
+{
+    auto const block_width = width & ~std::size_t{3};
+    auto const block_height = height & ~std::size_t{3};
+
+    for (auto y = 0u; y < block_height; y += 4)
+        for (auto x = 0u; x < block_width; x += 4)
+            transpose(
+                src + y * src_stride + x, src_stride,
+                [&](std::size_t i) { return dst + (width - 1 - x - i) * dst_stride + y; },
+                false);
+
+    rotate_left_area(dst, dst_stride, src, src_stride, width, block_width, width, 0, height);
+    rotate_left_area(dst, dst_stride, src, src_stride, width, 0, block_width, block_height, height);
+}
+
+template<typename Transpose>
+void rotate_right_blocks(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height,
+    Transpose transpose)
+{
+    auto const block_width = width & ~std::size_t{3};
+    auto const block_height = height & ~std::size_t{3};
+
+    for (auto y = 0u; y < block_height; y += 4)
+        for (auto x = 0u; x < block_width; x += 4)
+            transpose(
+                src + y * src_stride + x, src_stride,
+                [&](std::size_t i) { return dst + (x + i) * dst_stride + (height - 4 - y); },
+                true);
+
+    rotate_right_area(dst, dst_stride, src, src_stride, height, block_width, width, 0, height);
+    rotate_right_area(dst, dst_stride, src, src_stride, height, 0, block_width, block_height, height);
+}
+
+#ifdef MIR_PIXEL_OPS_X86
+/*
+ * The SSE2 and AVX2 kernels widen channels to 16 bits for multiplying, two
+ * pixels to each 128-bit lane, with the alpha of each pixel broadcast
+ * across its channels.
+ */
+__attribute__((target("sse2")))
+inline __m128i mul_sse2(__m128i x, __m128i a)
+{
+    auto const t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("sse2")))
+inline __m128i alphas_sse2(__m128i x)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+__attribute__((target("sse2")))
+inline __m128i over_sse2(__m128i d, __m128i s)
+{
+    auto const zero = _mm_setzero_si128();
+    auto const full = _mm_set1_epi16(255);
+    auto const inv_lo = _mm_sub_epi16(full, alphas_sse2(_mm_unpacklo_epi8(s, zero)));
+    auto const inv_hi = _mm_sub_epi16(full, alphas_sse2(_mm_unpackhi_epi8(s, zero)));
+    auto const d_lo = mul_sse2(_mm_unpacklo_epi8(d, zero), inv_lo);
+    auto const d_hi = mul_sse2(_mm_unpackhi_epi8(d, zero), inv_hi);
+    return _mm_adds_epu8(s, _mm_packus_epi16(d_lo, d_hi));
+}
+
+/// Each of four mask bytes repeated across the 32 bits of its pixel
+__attribute__((target("sse2")))
+inline __m128i spread_mask_sse2(std::uint8_t const* mask)
+{
+    std::int32_t bytes;
+    std::memcpy(&bytes, mask, sizeof bytes);
+    auto const m = _mm_cvtsi32_si128(bytes);
+    auto const doubled = _mm_unpacklo_epi8(m, m);
+    return _mm_unpacklo_epi16(doubled, doubled);
+}
+
+__attribute__((target("sse2")))
+void copy_opaque_sse2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = _mm_set1_epi32(alpha_mask);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(s, mask));
+    }
+    copy_opaque_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+void swap_red_blue_sse2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const kept = _mm_set1_epi32(0xff00ff00);
+    auto const swapped = _mm_set1_epi32(0x00ff00ff);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const rb = _mm_and_si128(s, swapped);
+        auto const result = _mm_or_si128(
+            _mm_and_si128(s, kept),
+            _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+    swap_red_blue_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+void reverse_sse2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + n - i - 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi32(s, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    reverse_scalar(dst + i, src, n - i);
+}
+
+__attribute__((target("sse2")))
+void premultiply_sse2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = _mm_set1_epi32(alpha_mask);
+    auto const zero = _mm_setzero_si128();
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const lo = _mm_unpacklo_epi8(s, zero);
+        auto const hi = _mm_unpackhi_epi8(s, zero);
+        auto const scaled = _mm_packus_epi16(mul_sse2(lo, alphas_sse2(lo)), mul_sse2(hi, alphas_sse2(hi)));
+        auto const result = _mm_or_si128(_mm_andnot_si128(mask, scaled), _mm_and_si128(s, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+    premultiply_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+void fill_sse2(std::uint32_t* dst, std::uint32_t colour, std::size_t n)
+{
+    auto const c = _mm_set1_epi32(colour);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+    fill_scalar(dst + i, colour, n - i);
+}
+
+__attribute__((target("sse2")))
+void over_sse2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = _mm_set1_epi32(alpha_mask);
+    auto const zero = _mm_setzero_si128();
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const p = reinterpret_cast<__m128i*>(dst + i);
+
+        // Runs of opaque or clear pixels are common, and easy
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(s, mask), mask)) == 0xffff)
+            _mm_storeu_si128(p, s);
+        else if (_mm_movemask_epi8(_mm_cmpeq_epi8(s, zero)) != 0xffff)
+            _mm_storeu_si128(p, over_sse2(_mm_loadu_si128(p), s));
+    }
+    over_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+void over_with_alpha_sse2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n, std::uint8_t alpha)
+{
+    auto const zero = _mm_setzero_si128();
+    auto const a = _mm_set1_epi16(alpha);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const scaled = _mm_packus_epi16(
+            mul_sse2(_mm_unpacklo_epi8(s, zero), a),
+            mul_sse2(_mm_unpackhi_epi8(s, zero), a));
+        auto const p = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(p, over_sse2(_mm_loadu_si128(p), scaled));
+    }
+    over_with_alpha_scalar(dst + i, src + i, n - i, alpha);
+}
+
+__attribute__((target("sse2")))
+void over_with_mask_sse2(std::uint32_t* dst, std::uint8_t const* mask, std::uint32_t colour, std::size_t n)
+{
+    auto const zero = _mm_setzero_si128();
+    auto const c = _mm_unpacklo_epi8(_mm_set1_epi32(colour), zero);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+    {
+        auto const m = spread_mask_sse2(mask + i);
+
+        // Glyphs are mostly background
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(m, zero)) == 0xffff)
+            continue;
+
+        auto const scaled = _mm_packus_epi16(
+            mul_sse2(c, _mm_unpacklo_epi8(m, zero)),
+            mul_sse2(c, _mm_unpackhi_epi8(m, zero)));
+        auto const p = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(p, over_sse2(_mm_loadu_si128(p), scaled));
+    }
+    over_with_mask_scalar(dst + i, mask + i, colour, n - i);
+}
+
+struct TransposeSSE2
+{
+    template<typename Column>
+    __attribute__((target("sse2")))
+    void operator()(std::uint32_t const* src, std::size_t src_stride, Column column, bool reversed) const
+    {
+        auto const r0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+        auto const r1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + src_stride));
+        auto const r2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 2 * src_stride));
+        auto const r3 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 3 * src_stride));
+        auto const t0 = _mm_unpacklo_epi32(r0, r1);
+        auto const t1 = _mm_unpacklo_epi32(r2, r3);
+        auto const t2 = _mm_unpackhi_epi32(r0, r1);
+        auto const t3 = _mm_unpackhi_epi32(r2, r3);
+        __m128i const columns[] = {
+            _mm_unpacklo_epi64(t0, t1),
+            _mm_unpackhi_epi64(t0, t1),
+            _mm_unpacklo_epi64(t2, t3),
+            _mm_unpackhi_epi64(t2, t3)};
+
+        for (auto i = 0u; i != 4; ++i)
+        {
+            auto const c = reversed ? _mm_shuffle_epi32(columns[i], _MM_SHUFFLE(0, 1, 2, 3)) : columns[i];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(column(i)), c);
+        }
+    }
+};
+
+__attribute__((target("sse2")))
+void rotate_left_sse2(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height)
+{
+    rotate_left_blocks(dst, dst_stride, src, src_stride, width, height, TransposeSSE2{});
+}
+
+__attribute__((target("sse2")))
+void rotate_right_sse2(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height)
+{
+    rotate_right_blocks(dst, dst_stride, src, src_stride, width, height, TransposeSSE2{});
+}
+
+mg::PixelOps const sse2_ops{
+    "SSE2",
+    &copy_scalar,
+    &copy_opaque_sse2,
+    &swap_red_blue_sse2,
+    &reverse_sse2,
+    &premultiply_sse2,
+    &fill_sse2,
+    &over_sse2,
+    &over_with_alpha_sse2,
+    &over_with_mask_sse2,
+    &rotate_left_sse2,
+    &rotate_right_sse2};
+
+__attribute__((target("avx2")))
+inline __m256i mul_avx2(__m256i x, __m256i a)
+{
+    auto const t = _mm256_add_epi16(_mm256_mullo_epi16(x, a), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+inline __m256i alphas_avx2(__m256i x)
+{
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+__attribute__((target("avx2")))
+inline __m256i over_avx2(__m256i d, __m256i s)
+{
+    auto const zero = _mm256_setzero_si256();
+    auto const full = _mm256_set1_epi16(255);
+    auto const inv_lo = _mm256_sub_epi16(full, alphas_avx2(_mm256_unpacklo_epi8(s, zero)));
+    auto const inv_hi = _mm256_sub_epi16(full, alphas_avx2(_mm256_unpackhi_epi8(s, zero)));
+    auto const d_lo = mul_avx2(_mm256_unpacklo_epi8(d, zero), inv_lo);
+    auto const d_hi = mul_avx2(_mm256_unpackhi_epi8(d, zero), inv_hi);
+    return _mm256_adds_epu8(s, _mm256_packus_epi16(d_lo, d_hi));
+}
+
+/// Each of eight mask bytes repeated across the 32 bits of its pixel
+__attribute__((target("avx2")))
+inline __m256i spread_mask_avx2(std::uint8_t const* mask)
+{
+    auto const m = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(mask));
+    auto const doubled = _mm_unpacklo_epi8(m, m);
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_unpacklo_epi16(doubled, doubled)),
+        _mm_unpackhi_epi16(doubled, doubled),
+        1);
+}
+
+__attribute__((target("avx2")))
+void copy_opaque_avx2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = _mm256_set1_epi32(alpha_mask);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(s, mask));
+    }
+    copy_opaque_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void swap_red_blue_avx2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const kept = _mm256_set1_epi32(0xff00ff00);
+    auto const swapped = _mm256_set1_epi32(0x00ff00ff);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto const rb = _mm256_and_si256(s, swapped);
+        auto const result = _mm256_or_si256(
+            _mm256_and_si256(s, kept),
+            _mm256_or_si256(_mm256_slli_epi32(rb, 16), _mm256_srli_epi32(rb, 16)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
+    }
+    swap_red_blue_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void reverse_avx2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const reversed = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + n - i - 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permutevar8x32_epi32(s, reversed));
+    }
+    reverse_scalar(dst + i, src, n - i);
+}
+
+__attribute__((target("avx2")))
+void premultiply_avx2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = _mm256_set1_epi32(alpha_mask);
+    auto const zero = _mm256_setzero_si256();
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto const lo = _mm256_unpacklo_epi8(s, zero);
+        auto const hi = _mm256_unpackhi_epi8(s, zero);
+        auto const scaled = _mm256_packus_epi16(mul_avx2(lo, alphas_avx2(lo)), mul_avx2(hi, alphas_avx2(hi)));
+        auto const result = _mm256_or_si256(_mm256_andnot_si256(mask, scaled), _mm256_and_si256(s, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
+    }
+    premultiply_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void fill_avx2(std::uint32_t* dst, std::uint32_t colour, std::size_t n)
+{
+    auto const c = _mm256_set1_epi32(colour);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+    fill_scalar(dst + i, colour, n - i);
+}
+
+__attribute__((target("avx2")))
+void over_avx2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = _mm256_set1_epi32(alpha_mask);
+    auto const zero = _mm256_setzero_si256();
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto const p = reinterpret_cast<__m256i*>(dst + i);
+
+        // Runs of opaque or clear pixels are common, and easy
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(s, mask), mask)) == -1)
+            _mm256_storeu_si256(p, s);
+        else if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, zero)) != -1)
+            _mm256_storeu_si256(p, over_avx2(_mm256_loadu_si256(p), s));
+    }
+    over_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void over_with_alpha_avx2(std::uint32_t* dst, std::uint32_t const* src, std::size_t n, std::uint8_t alpha)
+{
+    auto const zero = _mm256_setzero_si256();
+    auto const a = _mm256_set1_epi16(alpha);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto const scaled = _mm256_packus_epi16(
+            mul_avx2(_mm256_unpacklo_epi8(s, zero), a),
+            mul_avx2(_mm256_unpackhi_epi8(s, zero), a));
+        auto const p = reinterpret_cast<__m256i*>(dst + i);
+        _mm256_storeu_si256(p, over_avx2(_mm256_loadu_si256(p), scaled));
+    }
+    over_with_alpha_scalar(dst + i, src + i, n - i, alpha);
+}
+
+__attribute__((target("avx2")))
+void over_with_mask_avx2(std::uint32_t* dst, std::uint8_t const* mask, std::uint32_t colour, std::size_t n)
+{
+    auto const zero = _mm256_setzero_si256();
+    auto const c = _mm256_unpacklo_epi8(_mm256_set1_epi32(colour), zero);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const m = spread_mask_avx2(mask + i);
+
+        // Glyphs are mostly background
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(m, zero)) == -1)
+            continue;
+
+        auto const scaled = _mm256_packus_epi16(
+            mul_avx2(c, _mm256_unpacklo_epi8(m, zero)),
+            mul_avx2(c, _mm256_unpackhi_epi8(m, zero)));
+        auto const p = reinterpret_cast<__m256i*>(dst + i);
+        _mm256_storeu_si256(p, over_avx2(_mm256_loadu_si256(p), scaled));
+    }
+    over_with_mask_scalar(dst + i, mask + i, colour, n - i);
+}
+
+// Wider registers don't help the rotations: each block is four rows either way
+mg::PixelOps const avx2_ops{
+    "AVX2",
+    &copy_scalar,
+    &copy_opaque_avx2,
+    &swap_red_blue_avx2,
+    &reverse_avx2,
+    &premultiply_avx2,
+    &fill_avx2,
+    &over_avx2,
+    &over_with_alpha_avx2,
+    &over_with_mask_avx2,
+    &rotate_left_sse2,
+    &rotate_right_sse2};
+#endif
+
+#ifdef MIR_PIXEL_OPS_NEON
+/*
+ * NEON loads eight pixels a channel to a register, alpha last, which
+ * makes blending a matter of widening multiplies.
+ */
+inline uint8x8_t mul_neon(uint8x8_t x, uint8x8_t a)
+{
+    auto const t = vaddq_u16(vmull_u8(x, a), vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+inline uint8x8x4_t over_neon(uint8x8x4_t d, uint8x8x4_t s)
+{
+    auto const inv = vmvn_u8(s.val[3]);
+    for (auto c = 0; c != 4; ++c)
+        d.val[c] = vqadd_u8(s.val[c], mul_neon(d.val[c], inv));
+    return d;
+}
+
+inline uint32x4_t reversed_neon(uint32x4_t v)
+{
+    auto const r = vrev64q_u32(v);
+    return vcombine_u32(vget_high_u32(r), vget_low_u32(r));
+}
+
+void copy_opaque_neon(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto const mask = vdupq_n_u32(alpha_mask);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+        vst1q_u32(dst + i, vorrq_u32(vld1q_u32(src + i), mask));
+    copy_opaque_scalar(dst + i, src + i, n - i);
+}
+
+void swap_red_blue_neon(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto p = vld4_u8(reinterpret_cast<std::uint8_t const*>(src + i));
+        std::swap(p.val[0], p.val[2]);
+        vst4_u8(reinterpret_cast<std::uint8_t*>(dst + i), p);
+    }
+    swap_red_blue_scalar(dst + i, src + i, n - i);
+}
+
+void reverse_neon(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+        vst1q_u32(dst + i, reversed_neon(vld1q_u32(src + n - i - 4)));
+    reverse_scalar(dst + i, src, n - i);
+}
+
+void premultiply_neon(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto p = vld4_u8(reinterpret_cast<std::uint8_t const*>(src + i));
+        for (auto c = 0; c != 3; ++c)
+            p.val[c] = mul_neon(p.val[c], p.val[3]);
+        vst4_u8(reinterpret_cast<std::uint8_t*>(dst + i), p);
+    }
+    premultiply_scalar(dst + i, src + i, n - i);
+}
+
+void fill_neon(std::uint32_t* dst, std::uint32_t colour, std::size_t n)
+{
+    auto const c = vdupq_n_u32(colour);
+    auto i = 0u;
+    for (; i + 4 <= n; i += 4)
+        vst1q_u32(dst + i, c);
+    fill_scalar(dst + i, colour, n - i);
+}
+
+void over_neon(std::uint32_t* dst, std::uint32_t const* src, std::size_t n)
+{
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const p = reinterpret_cast<std::uint8_t*>(dst + i);
+        auto const s = vld4_u8(reinterpret_cast<std::uint8_t const*>(src + i));
+        vst4_u8(p, over_neon(vld4_u8(p), s));
+    }
+    over_scalar(dst + i, src + i, n - i);
+}
+
+void over_with_alpha_neon(std::uint32_t* dst, std::uint32_t const* src, std::size_t n, std::uint8_t alpha)
+{
+    auto const a = vdup_n_u8(alpha);
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const p = reinterpret_cast<std::uint8_t*>(dst + i);
+        auto s = vld4_u8(reinterpret_cast<std::uint8_t const*>(src + i));
+        for (auto c = 0; c != 4; ++c)
+            s.val[c] = mul_neon(s.val[c], a);
+        vst4_u8(p, over_neon(vld4_u8(p), s));
+    }
+    over_with_alpha_scalar(dst + i, src + i, n - i, alpha);
+}
+
+void over_with_mask_neon(std::uint32_t* dst, std::uint8_t const* mask, std::uint32_t colour, std::size_t n)
+{
+    uint8x8_t channels[4];
+    for (auto c = 0; c != 4; ++c)
+        channels[c] = vdup_n_u8((colour >> (8 * c)) & 0xff);
+
+    auto i = 0u;
+    for (; i + 8 <= n; i += 8)
+    {
+        auto const m = vld1_u8(mask + i);
+
+        // Glyphs are mostly background
+        if (vget_lane_u64(vreinterpret_u64_u8(m), 0) == 0)
+            continue;
+
+        uint8x8x4_t s;
+        for (auto c = 0; c != 4; ++c)
+            s.val[c] = mul_neon(channels[c], m);
+        auto const p = reinterpret_cast<std::uint8_t*>(dst + i);
+        vst4_u8(p, over_neon(vld4_u8(p), s));
+    }
+    over_with_mask_scalar(dst + i, mask + i, colour, n - i);
+}
+
+struct TransposeNEON
+{
+    template<typename Column>
+    void operator()(std::uint32_t const* src, std::size_t src_stride, Column column, bool reversed) const
+    {
+        auto const r01 = vtrnq_u32(vld1q_u32(src), vld1q_u32(src + src_stride));
+        auto const r23 = vtrnq_u32(vld1q_u32(src + 2 * src_stride), vld1q_u32(src + 3 * src_stride));
+        uint32x4_t const columns[] = {
+            vcombine_u32(vget_low_u32(r01.val[0]), vget_low_u32(r23.val[0])),
+            vcombine_u32(vget_low_u32(r01.val[1]), vget_low_u32(r23.val[1])),
+            vcombine_u32(vget_high_u32(r01.val[0]), vget_high_u32(r23.val[0])),
+            vcombine_u32(vget_high_u32(r01.val[1]), vget_high_u32(r23.val[1]))};
+
+        for (auto i = 0u; i != 4; ++i)
+            vst1q_u32(column(i), reversed ? reversed_neon(columns[i]) : columns[i]);
+    }
+};
+
+void rotate_left_neon(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height)
+{
+    rotate_left_blocks(dst, dst_stride, src, src_stride, width, height, TransposeNEON{});
+}
+
+void rotate_right_neon(
+    std::uint32_t* dst, std::size_t dst_stride,
+    std::uint32_t const* src, std::size_t src_stride,
+    std::size_t width, std::size_t height)
+{
+    rotate_right_blocks(dst, dst_stride, src, src_stride, width, height, TransposeNEON{});
+}
+
+mg::PixelOps const neon_ops{
+    "NEON",
+    &copy_scalar,
+    &copy_opaque_neon,
+    &swap_red_blue_neon,
+    &reverse_neon,
+    &premultiply_neon,
+    &fill_neon,
+    &over_neon,
+    &over_with_alpha_neon,
+    &over_with_mask_neon,
+    &rotate_left_neon,
+    &rotate_right_neon};
+#endif
+}
+
+std::vector<mg::PixelOps const*> mg::supported_pixel_ops()
+{
+    std::vector<PixelOps const*> ops{&scalar_ops};
+
+#if defined(MIR_PIXEL_OPS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        ops.push_back(&sse2_ops);
+    if (__builtin_cpu_supports("avx2"))
+        ops.push_back(&avx2_ops);
+#elif defined(MIR_PIXEL_OPS_NEON)
+    ops.push_back(&neon_ops);
+#endif
+
+    return ops;
+}
+
+mg::PixelOps const& mg::pixel_ops()
+{
+    static PixelOps const& chosen =
+        []() -> PixelOps const&
+        {
+            auto const& fastest = *supported_pixel_ops().back();
+            mir::log_info("Using %s pixel operations", fastest.name);
+            return fastest;
+        }();
+
+    return chosen;
+}
+
+void mg::flip_vertically(
+    unsigned char* pixels,
+    geom::Size const& size,
+    geom::Stride const& stride,
+    bool swap_red_blue)
+{
+    auto const& ops = pixel_ops();
+    auto const copy = swap_red_blue ? ops.swap_red_blue : ops.copy;
+    auto const width = size.width.as_uint32_t();
+    auto const height = size.height.as_uint32_t();
+    auto const row = [&](std::uint32_t y)
+        { return reinterpret_cast<std::uint32_t*>(pixels + y * stride.as_uint32_t()); };
+
+    std::vector<std::uint32_t> saved(width);
+    for (auto y = 0u; y < height / 2; ++y)
+    {
+        auto const top = row(y);
+        auto const bottom = row(height - y - 1);
+        ops.copy(saved.data(), top, width);
+        copy(top, bottom, width);
+        copy(bottom, saved.data(), width);
+    }
+
+    if (height % 2 == 1)
+        copy(row(height / 2), row(height / 2), width);
+}
+
+void mg::rotate(
+    unsigned char* dst,
+    geom::Stride const& dst_stride,
+    unsigned char const* src,
+    geom::Size const& size,
+    geom::Stride const& src_stride,
+    MirOrientation orientation)
+{
+    auto const& ops = pixel_ops();
+    auto const width = size.width.as_uint32_t();
+    auto const height = size.height.as_uint32_t();
+    auto const to = reinterpret_cast<std::uint32_t*>(dst);
+    auto const from = reinterpret_cast<std::uint32_t const*>(src);
+    auto const to_stride = dst_stride.as_uint32_t() / sizeof *to;
+    auto const from_stride = src_stride.as_uint32_t() / sizeof *from;
+
+    switch (orientation)
+    {
+    case mir_orientation_normal:
+        for (auto y = 0u; y != height; ++y)
+            ops.copy(to + y * to_stride, from + y * from_stride, width);
+        break;
+
+    case mir_orientation_inverted:
+        for (auto y = 0u; y != height; ++y)
+            ops.reverse(to + y * to_stride, from + (height - y - 1) * from_stride, width);
+        break;
+
+    case mir_orientation_left:
+        ops.rotate_left(to, to_stride, from, from_stride, width, height);
+        break;
+
+    case mir_orientation_right:
+        ops.rotate_right(to, to_stride, from, from_stride, width, height);
+        break;
+    }
+}
@@ -48,6 +48,10 @@ char const* const mo::cursor_opt                  = "cursor";
 char const* const mo::fatal_except_opt            = "on-fatal-error-except";
 char const* const mo::debug_opt                   = "debug";
 char const* const mo::composite_delay_opt         = "composite-delay";
+char const* const mo::texture_cache_budget_opt    = "texture-cache-budget";
+char const* const mo::gpu_timing_opt              = "gpu-timing";
+char const* const mo::renderer_opt                = "renderer";
+char const* const mo::software_renderer_threads_opt = "software-renderer-threads";
 char const* const mo::enable_key_repeat_opt       = "enable-key-repeat";
 char const* const mo::x11_display_opt             = "enable-x11";
 char const* const mo::wayland_extensions_opt      = "wayland-extensions";
@@ -184,6 +188,20 @@ mo::DefaultConfiguration::DefaultConfiguration(
             "frames from clients before compositing). Higher values result in "
             "lower latency but risk causing frame skipping. "
             "Default: A negative value means decide automatically.")
+        (texture_cache_budget_opt, po::value<int>()->default_value(64),
+            "Memory (in MiB) the renderer may keep the textures of hidden "
+            "surfaces in, so they can be shown again without reuploading them. "
+            "Textures used in the last few frames are kept regardless.")
+        (gpu_timing_opt, po::value<std::string>()->default_value(off_opt_value),
+            "Time the GPU's compositing work, for the compositor report: "
+            "per frame, or per frame with a sample of frames timed per "
+            "surface. [{off,frames,renderables}]")
+        (renderer_opt, po::value<std::string>()->default_value("gl"),
+            "How to composite: with OpenGL, or on the CPU for outputs the "
+            "platform can map into memory. [{gl,software}]")
+        (software_renderer_threads_opt, po::value<int>()->default_value(0),
+            "Threads each output is composited with by the software "
+            "renderer. Default: 0 means one per CPU core.")
         (offscreen_opt,
             "Render to offscreen buffers instead of the real outputs.")
         (touchspots_opt,
@@ -23,6 +23,7 @@
 #include "mir/renderer/sw/pixel_source.h"
 #include "mir/executor.h"
 #include "mir/renderer/gl/context.h"
+#include "mir/graphics/texture_atlas_limits.h"
 
 #define MIR_LOG_COMPONENT "wayland-gfx-helpers"
 #include "mir/log.h"
@@ -321,6 +322,21 @@ public:
     {
     }
 
+    WlShmBuffer(
+        SharedWlBuffer buffer,
+        mgc::ShmBuffer const& previous,
+        std::experimental::optional<mir::geometry::Rectangles> const& damage,
+        mir::geometry::Size const& size,
+        mir::geometry::Stride stride,
+        MirPixelFormat format,
+        std::function<void()>&& on_consumed)
+        : ShmBuffer(size, format, previous, damage),
+          on_consumed{std::move(on_consumed)},
+          buffer{std::move(buffer)},
+          stride_{stride}
+    {
+    }
+
     std::shared_ptr<mg::NativeBuffer> native_buffer_handle() const override
     {
         BOOST_THROW_EXCEPTION((std::logic_error{"Attempt to get mirclient handle for Wayland Shm buffer"}));
@@ -330,17 +346,8 @@ public:
     {
         ShmBuffer::bind();
         std::lock_guard<std::mutex> lock{consumption_mutex};
-        if (!uploaded)
-        {
-            read_internal(
-                [this](unsigned char const* pixels)
-                {
-                    upload_to_texture(pixels, stride());
-                });
-            on_consumed();
-            on_consumed = [](){};
-            uploaded = true;
-        }
+        on_consumed();
+        on_consumed = [](){};
     }
 
     void write(unsigned char const* /*pixels*/, size_t /*size*/) override
@@ -364,6 +371,17 @@ public:
         return stride_;
     }
 
+protected:
+    void with_pixels(
+        std::function<void(unsigned char const*, mir::geometry::Stride)> const& do_with_pixels) override
+    {
+        read_internal(
+            [this, &do_with_pixels](unsigned char const* pixels)
+            {
+                do_with_pixels(pixels, stride());
+            });
+    }
+
 private:
     void read_internal(std::function<void(unsigned char const*)> const& do_with_pixels)
     {
@@ -382,7 +400,6 @@ private:
     }
 
     std::mutex consumption_mutex;
-    bool uploaded{false};
     std::function<void()> on_consumed;
     SharedWlBuffer const buffer;
     mir::geometry::Stride const stride_;
@@ -392,21 +409,59 @@ auto mg::wayland::buffer_from_wl_shm(
     wl_resource* buffer,
     std::shared_ptr<Executor> executor,
     std::shared_ptr<common::EGLContextExecutor> egl_delegate,
-    std::function<void()>&& on_consumed) -> std::shared_ptr<Buffer>
+    std::function<void()>&& on_consumed,
+    std::shared_ptr<Buffer> const& previous,
+    std::experimental::optional<geometry::Rectangles> const& damage) -> std::shared_ptr<Buffer>
 {
     auto const shm_buffer = wl_shm_buffer_get(buffer);
     if (!shm_buffer)
     {
         BOOST_THROW_EXCEPTION((std::logic_error{"Attempt to import a non-SHM buffer as a SHM buffer"}));
     }
-    return std::make_shared<WlShmBuffer>(
-        SharedWlBuffer{buffer, std::move(executor)},
-        std::move(egl_delegate),
-        mir::geometry::Size{
-            wl_shm_buffer_get_width(shm_buffer),
-            wl_shm_buffer_get_height(shm_buffer)
-        },
-        mir::geometry::Stride{wl_shm_buffer_get_stride(shm_buffer)},
-        wl_format_to_mir_format(wl_shm_buffer_get_format(shm_buffer)),
-        std::move(on_consumed));
+
+    mir::geometry::Size const size{
+        wl_shm_buffer_get_width(shm_buffer),
+        wl_shm_buffer_get_height(shm_buffer)};
+    mir::geometry::Stride const stride{wl_shm_buffer_get_stride(shm_buffer)};
+    auto const format = wl_format_to_mir_format(wl_shm_buffer_get_format(shm_buffer));
+
+    std::shared_ptr<WlShmBuffer> imported;
+
+    // Carry on drawing into the textures of the frame this replaces, if it was one of ours
+    if (auto const previous_shm = std::dynamic_pointer_cast<common::ShmBuffer>(previous))
+    {
+        imported = std::make_shared<WlShmBuffer>(
+            SharedWlBuffer{buffer, std::move(executor)},
+            *previous_shm,
+            damage,
+            size,
+            stride,
+            format,
+            std::move(on_consumed));
+    }
+    else
+    {
+        imported = std::make_shared<WlShmBuffer>(
+            SharedWlBuffer{buffer, std::move(executor)},
+            std::move(egl_delegate),
+            size,
+            stride,
+            format,
+            std::move(on_consumed));
+    }
+
+    /*
+     * Get the upload out of the way before the compositor needs it. The GL
+     * renderer copies buffers that fit its texture atlas itself, unless the
+     * atlas can't take them (they're scaled, say, or it's full); then the
+     * stream is drawn from its textures and its later buffers are uploaded
+     * here too. Until then bind() draws the last frame uploaded, if there
+     * is one, while uploading this one in the background.
+     */
+    if (!mg::texture_atlas_can_hold(size, format) || imported->drawn_from_textures())
+    {
+        common::ShmBuffer::upload_in_background(imported);
+    }
+
+    return imported;
 }
@@ -20,6 +20,9 @@
 #ifndef MIR_GRAPHICS_GL_WAYLAND_SHM_PROVIDER_H_
 #define MIR_GRAPHICS_GL_WAYLAND_SHM_PROVIDER_H_
 
+#include "mir/geometry/rectangles.h"
+
+#include <experimental/optional>
 #include <memory>
 #include <functional>
 
@@ -52,13 +55,18 @@ namespace wayland
  * \param executor      [in]    An Executor that will defer work to the Wayland event loop
  * \param egl_delegate  [in]    An EGL-context-thread delegator
  * \param on_consumed   [in]    Closure to call when the compositor has consumed this buffer
+ * \param previous      [in]    The buffer this replaces in its stream, or nullptr. If it was
+ *                              also imported from SHM its textures are reused.
+ * \param damage        [in]    The area that differs from previous, or nullopt if unknown
  * \return                      An mg::Buffer supporting being rendered from in GL and read by the CPU.
  */
 auto buffer_from_wl_shm(
     wl_resource* buffer,
     std::shared_ptr<Executor> executor,
     std::shared_ptr<common::EGLContextExecutor> egl_delegate,
-    std::function<void()>&& on_consumed) -> std::shared_ptr<Buffer>;
+    std::function<void()>&& on_consumed,
+    std::shared_ptr<Buffer> const& previous,
+    std::experimental::optional<geometry::Rectangles> const& damage) -> std::shared_ptr<Buffer>;
 }
 }
 }
@@ -53,24 +53,32 @@ void mgc::EGLContextExecutor::process_loop(mgc::EGLContextExecutor* const me)
     me->ctx->make_current();
 
     std::unique_lock<std::mutex> lock{me->mutex};
-    while (!me->shutdown_requested)
+    while (!me->shutdown_requested || !me->work_queue.empty())
     {
-        for (auto& work : me->work_queue)
+        if (me->work_queue.empty())
         {
-            work();
+            me->new_work.wait(lock);
+            continue;
         }
-        me->work_queue.clear();
 
-        me->new_work.wait(lock);
-    }
+        /*
+         * Run the work without holding the lock, so that long-running work
+         * (such as texture uploads) doesn't block spawn() and work can
+         * itself spawn more work.
+         */
+        std::vector<std::function<void()>> work_queue;
+        work_queue.swap(me->work_queue);
+        lock.unlock();
 
-    // Drain the work-queue
-    for (auto& work : me->work_queue)
-    {
-        work();
+        for (auto& work : work_queue)
+        {
+            work();
+        }
+        // …and ensure any functor cleanup happens with the EGL context current, too.
+        work_queue.clear();
+
+        lock.lock();
     }
-    // …and ensure any functor cleanup happens with the EGL context current, too.
-    me->work_queue.clear();
 
     me->ctx->release_current();
 }
@@ -31,6 +31,7 @@
 
 #include <boost/throw_exception.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 
 #include <string.h>
@@ -94,16 +95,267 @@ bool mgc::ShmBuffer::supports(MirPixelFormat mir_format)
     return mg::get_gl_pixel_format(mir_format, gl_format, gl_type);
 }
 
+namespace
+{
+/// Far enough back to catch up with a compositor that has skipped a frame or two
+size_t const max_history = 3;
+}
+
+mgc::ShmBuffer::StreamTextures::StreamTextures(std::shared_ptr<EGLContextExecutor> egl_delegate)
+    : egl_delegate{std::move(egl_delegate)},
+      textures(2)
+{
+}
+
+mgc::ShmBuffer::StreamTextures::~StreamTextures() noexcept
+{
+    for (auto const& texture : textures)
+    {
+        for (auto const& user : texture.users)
+        {
+            if (user.fence != EGL_NO_SYNC_KHR)
+            {
+                destroy_sync(display, user.fence);
+            }
+        }
+
+        if (texture.id != 0)
+        {
+            egl_delegate->spawn(
+                [id = texture.id]()
+                {
+                    glDeleteTextures(1, &id);
+                });
+        }
+    }
+}
+
+void mgc::ShmBuffer::StreamTextures::init_fences()
+{
+    if (display != EGL_NO_DISPLAY)
+    {
+        return;
+    }
+
+    display = eglGetCurrentDisplay();
+    if (display == EGL_NO_DISPLAY)
+    {
+        return;
+    }
+
+    auto const extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_KHR_fence_sync"))
+    {
+        create_sync = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(eglGetProcAddress("eglCreateSyncKHR"));
+        destroy_sync = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(eglGetProcAddress("eglDestroySyncKHR"));
+        client_wait_sync = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(eglGetProcAddress("eglClientWaitSyncKHR"));
+    }
+
+    if (!create_sync || !destroy_sync || !client_wait_sync)
+    {
+        create_sync = nullptr;
+        destroy_sync = nullptr;
+        client_wait_sync = nullptr;
+    }
+}
+
+bool mgc::ShmBuffer::StreamTextures::busy(StreamTexture& texture, EGLContext context)
+{
+    if (texture.uploading)
+    {
+        return true;
+    }
+
+    // Forget the compositors the GPU has finished drawing for
+    auto const finished = std::remove_if(
+        texture.users.begin(), texture.users.end(),
+        [this](TextureUser const& user)
+        {
+            if (user.fence == EGL_NO_SYNC_KHR ||
+                client_wait_sync(display, user.fence, 0, 0) != EGL_CONDITION_SATISFIED_KHR)
+            {
+                return false;
+            }
+            destroy_sync(display, user.fence);
+            return true;
+        });
+    texture.users.erase(finished, texture.users.end());
+
+    // Commands in a compositor's own context are ordered, so it may upload to what it draws
+    return std::any_of(
+        texture.users.begin(), texture.users.end(),
+        [context](TextureUser const& user) { return user.context != context; });
+}
+
+auto mgc::ShmBuffer::StreamTextures::upload_target(
+    ShmBuffer const& buffer,
+    EGLContext context,
+    StreamTexture const* spare) -> StreamTexture&
+{
+    StreamTexture* target{nullptr};
+    auto target_age = buffer.history.size();
+
+    for (auto& texture : textures)
+    {
+        if (&texture == spare || busy(texture, context))
+        {
+            continue;
+        }
+
+        // The more recent the frame the texture holds, the less there is to upload
+        auto age = buffer.history.size();
+        for (auto i = 0u; i != buffer.history.size(); ++i)
+        {
+            if (buffer.history[i].first == texture.contents)
+            {
+                age = i;
+                break;
+            }
+        }
+
+        if (!target || age < target_age)
+        {
+            target = &texture;
+            target_age = age;
+        }
+    }
+
+    if (!target)
+    {
+        // Every texture is being drawn or written, so make another
+        textures.emplace_back();
+        target = &textures.back();
+    }
+
+    return *target;
+}
+
+auto mgc::ShmBuffer::StreamTextures::newest_resident() -> StreamTexture*
+{
+    StreamTexture* newest_texture{nullptr};
+    for (auto& texture : textures)
+    {
+        if (texture.contents && !texture.uploading &&
+            (!newest_texture || texture.sequence > newest_texture->sequence))
+        {
+            newest_texture = &texture;
+        }
+    }
+    return newest_texture;
+}
+
+void mgc::ShmBuffer::StreamTextures::use(StreamTexture& texture, EGLContext context)
+{
+    for (auto& other : textures)
+    {
+        if (&other == &texture)
+        {
+            continue;
+        }
+
+        for (auto user = other.users.begin(); user != other.users.end();)
+        {
+            if (user->context == context && user->fence == EGL_NO_SYNC_KHR)
+            {
+                if (create_sync)
+                {
+                    // What the compositor drew from the texture precedes what it's about to draw
+                    user->fence = create_sync(display, EGL_SYNC_FENCE_KHR, nullptr);
+                }
+                else
+                {
+                    // Without fences the best we can tell is that the compositor has moved on a frame
+                    user = other.users.erase(user);
+                    continue;
+                }
+            }
+            ++user;
+        }
+    }
+
+    auto const user = std::find_if(
+        texture.users.begin(), texture.users.end(),
+        [context](TextureUser const& user) { return user.context == context; });
+
+    if (user == texture.users.end())
+    {
+        texture.users.push_back({context, EGL_NO_SYNC_KHR});
+    }
+    else if (user->fence != EGL_NO_SYNC_KHR)
+    {
+        destroy_sync(display, user->fence);
+        user->fence = EGL_NO_SYNC_KHR;
+    }
+}
+
+void mgc::ShmBuffer::StreamTextures::fence(EGLContext context)
+{
+    if (!create_sync)
+    {
+        return;
+    }
+
+    for (auto& texture : textures)
+    {
+        for (auto& user : texture.users)
+        {
+            if (user.context == context && user.fence == EGL_NO_SYNC_KHR)
+            {
+                user.fence = create_sync(display, EGL_SYNC_FENCE_KHR, nullptr);
+            }
+        }
+    }
+}
+
 mgc::ShmBuffer::ShmBuffer(
     geom::Size const& size,
     MirPixelFormat const& format,
     std::shared_ptr<EGLContextExecutor> egl_delegate)
     : size_{size},
       pixel_format_{format},
-      egl_delegate{std::move(egl_delegate)}
+      textures{std::make_shared<StreamTextures>(std::move(egl_delegate))},
+      sequence{0}
 {
 }
 
+mgc::ShmBuffer::ShmBuffer(
+    geom::Size const& size,
+    MirPixelFormat const& format,
+    ShmBuffer const& previous,
+    std::experimental::optional<geom::Rectangles> const& damage)
+    : size_{size},
+      pixel_format_{format},
+      textures{previous.textures},
+      sequence{previous.sequence + 1},
+      history{history_after(previous, damage)}
+{
+}
+
+auto mgc::ShmBuffer::history_after(
+    ShmBuffer const& previous,
+    std::experimental::optional<geom::Rectangles> const& damage) -> History
+{
+    History history;
+    history.emplace_back(previous.id(), damage);
+
+    for (auto const& entry : previous.history)
+    {
+        if (history.size() == max_history)
+            break;
+
+        std::experimental::optional<geom::Rectangles> accumulated;
+        if (damage && entry.second)
+        {
+            accumulated = damage.value();
+            for (auto const& rect : entry.second.value())
+                accumulated.value().add(rect);
+        }
+        history.emplace_back(entry.first, std::move(accumulated));
+    }
+
+    return history;
+}
+
 mgc::MemoryBackedShmBuffer::MemoryBackedShmBuffer(
     geom::Size const& size,
     MirPixelFormat const& pixel_format,
@@ -114,17 +366,7 @@ mgc::MemoryBackedShmBuffer::MemoryBackedShmBuffer(
 {
 }
 
-mgc::ShmBuffer::~ShmBuffer() noexcept
-{
-    if (tex_id != 0)
-    {
-        egl_delegate->spawn(
-            [id = tex_id]()
-            {
-                glDeleteTextures(1, &id);
-            });
-    }
-}
+mgc::ShmBuffer::~ShmBuffer() noexcept = default;
 
 geom::Size mgc::ShmBuffer::size() const
 {
@@ -141,14 +383,72 @@ MirPixelFormat mgc::ShmBuffer::pixel_format() const
     return pixel_format_;
 }
 
-void mgc::ShmBuffer::upload_to_texture(void const* pixels, geom::Stride const& stride)
+void mgc::ShmBuffer::upload(std::unique_lock<std::mutex>& lock, StreamTexture& target, bool shared)
+{
+    std::experimental::optional<geom::Rectangles> damage;
+    if (target.size == size() && target.format == pixel_format())
+    {
+        for (auto const& entry : history)
+        {
+            if (entry.first == target.contents)
+            {
+                damage = entry.second;
+                break;
+            }
+        }
+    }
+
+    target.contents = id();
+    target.sequence = sequence;
+    target.uploading = true;
+    textures->newest = std::max(textures->newest, sequence);
+
+    /*
+     * While uploading is set nobody else touches the target, so
+     * there's no need to block other users of the textures meanwhile.
+     */
+    lock.unlock();
+
+    bool const needs_initialisation = target.id == 0;
+    if (needs_initialisation)
+    {
+        glGenTextures(1, &target.id);
+    }
+    glBindTexture(GL_TEXTURE_2D, target.id);
+    if (needs_initialisation)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    with_pixels(
+        [this, &target, &damage](unsigned char const* pixels, geom::Stride stride)
+        {
+            upload_to_texture(target, damage, pixels, stride);
+        });
+
+    if (shared)
+    {
+        glFinish();
+    }
+
+    lock.lock();
+    target.uploading = false;
+}
+
+void mgc::ShmBuffer::upload_to_texture(
+    StreamTexture& target,
+    std::experimental::optional<geom::Rectangles> const& damage,
+    unsigned char const* pixels,
+    geom::Stride const& stride)
 {
     GLenum format, type;
 
     if (mg::get_gl_pixel_format(pixel_format_, format, type))
     {
-        auto const stride_in_px =
-            stride.as_int() / MIR_BYTES_PER_PIXEL(pixel_format());
+        auto const bytes_per_pixel = MIR_BYTES_PER_PIXEL(pixel_format());
+        auto const stride_in_px = stride.as_int() / bytes_per_pixel;
         /*
          * We assume (as does Weston, AFAICT) that stride is
          * a multiple of whole pixels, but it need not be.
@@ -161,15 +461,39 @@ void mgc::ShmBuffer::upload_to_texture(void const* pixels, geom::Stride const& s
         glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride_in_px);
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            format,
-            size().width.as_int(), size().height.as_int(),
-            0,
-            format,
-            type,
-            pixels);
+        if (damage)
+        {
+            // The texture holds an earlier frame of this stream; only update what's changed
+            for (auto const& rect : damage.value())
+            {
+                auto const x = rect.top_left.x.as_int();
+                auto const y = rect.top_left.y.as_int();
+
+                glTexSubImage2D(
+                    GL_TEXTURE_2D,
+                    0,
+                    x, y,
+                    rect.size.width.as_int(), rect.size.height.as_int(),
+                    format,
+                    type,
+                    pixels + y * stride.as_int() + x * bytes_per_pixel);
+            }
+        }
+        else
+        {
+            glTexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                format,
+                size().width.as_int(), size().height.as_int(),
+                0,
+                format,
+                type,
+                pixels);
+
+            target.size = size();
+            target.format = pixel_format();
+        }
 
         // Be nice to other users of the GL context by reverting our changes to shared state
         glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);     // 0 is default, meaning “use width”
@@ -201,34 +525,101 @@ mg::NativeBufferBase* mgc::ShmBuffer::native_buffer_base()
     return this;
 }
 
+void mgc::ShmBuffer::upload_in_background(std::shared_ptr<ShmBuffer> const& buffer)
+{
+    buffer->textures->egl_delegate->spawn(
+        [weak_buffer = std::weak_ptr<ShmBuffer>{buffer}]()
+        {
+            auto const buffer = weak_buffer.lock();
+            if (!buffer)
+            {
+                // Replaced before anything wanted to draw it
+                return;
+            }
+
+            auto& textures = *buffer->textures;
+            std::unique_lock<std::mutex> lock{textures.mutex};
+
+            auto const already_uploaded = std::any_of(
+                textures.textures.begin(), textures.textures.end(),
+                [&buffer](auto const& texture) { return texture.contents == buffer->id(); });
+
+            if (already_uploaded || textures.newest > buffer->sequence)
+            {
+                return;
+            }
+
+            // Leave the newest frame alone too, so the compositor has something to draw meanwhile
+            auto& target = textures.upload_target(*buffer, eglGetCurrentContext(), textures.newest_resident());
+
+            // Waits for the GPU here, rather than have the compositor do so
+            buffer->upload(lock, target, true);
+        });
+}
+
+bool mgc::ShmBuffer::drawn_from_textures() const
+{
+    std::lock_guard<std::mutex> lock{textures->mutex};
+    return textures->bound;
+}
+
 void mgc::ShmBuffer::bind()
 {
-    std::lock_guard<decltype(tex_id_mutex)> lock{tex_id_mutex};
-    bool const needs_initialisation = tex_id == 0;
-    if (needs_initialisation)
+    auto const context = eglGetCurrentContext();
+
+    std::unique_lock<std::mutex> lock{textures->mutex};
+    textures->init_fences();
+    textures->bound = true;
+
+    auto& stream_textures = textures->textures;
+    auto const holding = std::find_if(
+        stream_textures.begin(), stream_textures.end(),
+        [this](auto const& texture) { return texture.contents == id(); });
+
+    if (holding != stream_textures.end() && !holding->uploading)
     {
-        glGenTextures(1, &tex_id);
+        textures->use(*holding, context);
+        glBindTexture(GL_TEXTURE_2D, holding->id);
+        return;
     }
-    glBindTexture(GL_TEXTURE_2D, tex_id);
-    if (needs_initialisation)
+
+    /*
+     * Our pixels aren't resident yet. Rather than wait for them, draw the
+     * stream's previous frame and have them uploaded in the background.
+     */
+    auto const stand_in = textures->newest_resident();
+    if (stand_in && stand_in->sequence < sequence)
     {
-        // The ShmBuffer *should* be immutable, so we can just upload once.
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        bool on_its_way = holding != stream_textures.end() || textures->requested >= sequence;
+        if (!on_its_way)
+        {
+            if (auto const self = weak_from_this().lock())
+            {
+                textures->requested = sequence;
+                upload_in_background(self);
+                on_its_way = true;
+            }
+        }
+
+        if (on_its_way)
+        {
+            textures->use(*stand_in, context);
+            glBindTexture(GL_TEXTURE_2D, stand_in->id);
+            return;
+        }
     }
+
+    // Nothing can stand in for our pixels, so upload them here
+    auto& target = textures->upload_target(*this, context);
+    upload(lock, target, false);
+    textures->use(target, context);
+    glBindTexture(GL_TEXTURE_2D, target.id);
 }
 
-void mgc::MemoryBackedShmBuffer::bind()
+void mgc::MemoryBackedShmBuffer::with_pixels(
+    std::function<void(unsigned char const*, geom::Stride)> const& do_with_pixels)
 {
-    mgc::ShmBuffer::bind();
-    std::lock_guard<decltype(uploaded_mutex)> lock{uploaded_mutex};
-    if (!uploaded)
-    {
-        upload_to_texture(pixels.get(), stride_);
-        uploaded = true;
-    }
+    do_with_pixels(pixels.get(), stride_);
 }
 
 auto mgc::MemoryBackedShmBuffer::native_buffer_handle() const -> std::shared_ptr<mg::NativeBuffer>
@@ -256,5 +647,8 @@ auto mgc::ShmBuffer::layout() const -> Layout
 
 void mgc::ShmBuffer::add_syncpoint()
 {
+    // Until this signals nothing may upload to the texture we've drawn from
+    std::lock_guard<std::mutex> lock{textures->mutex};
+    textures->fence(eglGetCurrentContext());
 }
 
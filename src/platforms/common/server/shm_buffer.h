@@ -23,6 +23,7 @@
 #include "mir/graphics/buffer_basic.h"
 #include "mir/geometry/dimensions.h"
 #include "mir/geometry/size.h"
+#include "mir/geometry/rectangles.h"
 #include "mir_toolkit/common.h"
 #include "mir/renderer/gl/texture_target.h"
 #include "mir_toolkit/mir_native_buffer.h"
@@ -30,8 +31,16 @@
 #include "mir/graphics/texture.h"
 
 #include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
+#include <deque>
+#include <experimental/optional>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace mir
 {
@@ -46,7 +55,8 @@ class EGLContextExecutor;
 class ShmBuffer :
     public BufferBasic,
     public NativeBufferBase,
-    public graphics::gl::Texture
+    public graphics::gl::Texture,
+    public std::enable_shared_from_this<ShmBuffer>
 {
 public:
     ~ShmBuffer() noexcept override;
@@ -57,6 +67,28 @@ public:
     MirPixelFormat pixel_format() const override;
     NativeBufferBase* native_buffer_base() override;
 
+    /**
+     * Start uploading \p buffer's pixels on the EGL thread
+     *
+     * If the upload has finished by the time the buffer is bound the
+     * compositor only has to bind the result. Until then binding the buffer
+     * draws the newest of the stream's earlier frames that is resident.
+     */
+    static void upload_in_background(std::shared_ptr<ShmBuffer> const& buffer);
+
+    /**
+     * Whether the compositor has drawn the buffer's stream from its textures
+     *
+     * A stream it draws some other way (say, from a texture atlas) needn't
+     * have its buffers uploaded ahead of time, until this changes.
+     */
+    bool drawn_from_textures() const;
+
+    /**
+     * Bind the buffer's texture, or the stream's newest resident frame if
+     * its pixels aren't uploaded yet (starting that in the background).
+     * Only a buffer with nothing to stand in for it is uploaded here.
+     */
     void bind() override;
     gl::Program const& shader(gl::ProgramFactory& cache) const override;
     Layout layout() const override;
@@ -67,14 +99,130 @@ protected:
         MirPixelFormat const& format,
         std::shared_ptr<EGLContextExecutor> egl_delegate);
 
-    /// \note This must be called with a current GL context
-    void upload_to_texture(void const* pixels, geometry::Stride const& stride);
+    /**
+     * Construct a buffer that replaces \p previous in the same stream
+     *
+     * The new buffer shares \p previous's textures. If the texture it is
+     * uploaded to still holds one of the last few frames of the stream only
+     * the regions damaged since that frame are uploaded.
+     *
+     * \param damage  The area that differs from \p previous, or nullopt if unknown
+     */
+    ShmBuffer(
+        geometry::Size const& size,
+        MirPixelFormat const& format,
+        ShmBuffer const& previous,
+        std::experimental::optional<geometry::Rectangles> const& damage);
+
+    /**
+     * Call \p do_with_pixels with the buffer's pixels and stride
+     *
+     * This is used by bind() to bring the texture up to date, and may
+     * not call \p do_with_pixels if the pixels are no longer available.
+     */
+    virtual void with_pixels(
+        std::function<void(unsigned char const*, geometry::Stride)> const& do_with_pixels) = 0;
+
 private:
+    /// A compositor drawing from a texture, and once it's done so, the fence that signals when the GPU has
+    struct TextureUser
+    {
+        EGLContext context;
+        EGLSyncKHR fence;
+    };
+
+    struct StreamTexture
+    {
+        GLuint id{0};
+        geometry::Size size;
+        MirPixelFormat format{mir_pixel_format_invalid};
+        /// The buffer whose pixels the texture holds, or is having uploaded
+        std::experimental::optional<BufferID> contents;
+        /// The position of contents in the stream
+        uint64_t sequence{0};
+        /// Whether some thread is uploading to the texture
+        bool uploading{false};
+        /// Nothing may upload to the texture while another compositor is using it
+        std::vector<TextureUser> users;
+    };
+
+    /**
+     * The textures shared by the buffers of a stream
+     *
+     * There are at least two so that the next frame can be uploaded on
+     * the EGL thread while the compositor draws the current one, and more
+     * are added while every texture is in use by some compositor.
+     */
+    struct StreamTextures
+    {
+        explicit StreamTextures(std::shared_ptr<EGLContextExecutor> egl_delegate);
+        ~StreamTextures() noexcept;
+
+        /// Look up the fence entry points, if that hasn't been done yet. Needs a current context.
+        void init_fences();
+        /// Whether another thread or compositor than \p context may be using \p texture
+        bool busy(StreamTexture& texture, EGLContext context);
+        /**
+         * A texture \p context may upload \p buffer to other than \p spare, preferring
+         * one holding a recent frame, and adding one if every texture is busy
+         */
+        auto upload_target(
+            ShmBuffer const& buffer,
+            EGLContext context,
+            StreamTexture const* spare = nullptr) -> StreamTexture&;
+        /// The texture holding the newest frame that isn't being uploaded, if any
+        auto newest_resident() -> StreamTexture*;
+        /// Note that the compositor with \p context current is about to draw from \p texture
+        void use(StreamTexture& texture, EGLContext context);
+        /// Fence what \p context has drawn from the textures
+        void fence(EGLContext context);
+
+        std::shared_ptr<EGLContextExecutor> const egl_delegate;
+        std::mutex mutex;
+        /// Never shrinks, so references to its elements stay valid
+        std::deque<StreamTexture> textures;
+        /// The sequence number of the newest buffer uploaded
+        uint64_t newest{0};
+        /// The sequence number of the newest buffer bind() has asked to be uploaded in the background
+        uint64_t requested{0};
+        /// Whether bind() has been called on any of the stream's buffers
+        bool bound{false};
+
+        EGLDisplay display{EGL_NO_DISPLAY};
+        PFNEGLCREATESYNCKHRPROC create_sync{nullptr};
+        PFNEGLDESTROYSYNCKHRPROC destroy_sync{nullptr};
+        PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync{nullptr};
+    };
+
+    /// How much of each of the stream's recent buffers differs from this one
+    using History = std::vector<std::pair<BufferID, std::experimental::optional<geometry::Rectangles>>>;
+
+    static auto history_after(
+        ShmBuffer const& previous,
+        std::experimental::optional<geometry::Rectangles> const& damage) -> History;
+
+    /**
+     * Upload the pixels to \p target, releasing \p lock on textures->mutex while doing so
+     *
+     * Changes to a shared texture are only guaranteed to be visible in other
+     * contexts once they've completed, so if \p shared is set the upload is
+     * finished before \p target is marked as ready for others to bind.
+     *
+     * \note This must be called with a current GL context
+     */
+    void upload(std::unique_lock<std::mutex>& lock, StreamTexture& target, bool shared);
+    void upload_to_texture(
+        StreamTexture& target,
+        std::experimental::optional<geometry::Rectangles> const& damage,
+        unsigned char const* pixels,
+        geometry::Stride const& stride);
+
     geometry::Size const size_;
     MirPixelFormat const pixel_format_;
-    std::shared_ptr<EGLContextExecutor> const egl_delegate;
-    std::mutex tex_id_mutex;
-    GLuint tex_id{0};
+    std::shared_ptr<StreamTextures> const textures;
+    /// The position of this buffer in its stream
+    uint64_t const sequence;
+    History const history;
 };
 
 class MemoryBackedShmBuffer :
@@ -93,15 +241,14 @@ public:
 
     std::shared_ptr<NativeBuffer> native_buffer_handle() const override;
 
-    void bind() override;
-
     MemoryBackedShmBuffer(MemoryBackedShmBuffer const&) = delete;
     MemoryBackedShmBuffer& operator=(MemoryBackedShmBuffer const&) = delete;
+protected:
+    void with_pixels(
+        std::function<void(unsigned char const*, geometry::Stride)> const& do_with_pixels) override;
 private:
     geometry::Stride const stride_;
     std::unique_ptr<unsigned char[]> const pixels;
-    std::mutex uploaded_mutex;
-    bool uploaded{false};
 };
 
 }
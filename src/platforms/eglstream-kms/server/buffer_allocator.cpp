@@ -565,11 +565,15 @@ mir::graphics::eglstream::BufferAllocator::buffer_from_resource(
 auto mge::BufferAllocator::buffer_from_shm(
     wl_resource* buffer,
     std::shared_ptr<Executor> wayland_executor,
-    std::function<void()>&& on_consumed) -> std::shared_ptr<Buffer>
+    std::function<void()>&& on_consumed,
+    std::shared_ptr<Buffer> const& previous,
+    std::experimental::optional<geometry::Rectangles> const& damage) -> std::shared_ptr<Buffer>
 {
     return mg::wayland::buffer_from_wl_shm(
         buffer,
         std::move(wayland_executor),
         egl_delegate,
-        std::move(on_consumed));
+        std::move(on_consumed),
+        previous,
+        damage);
 }
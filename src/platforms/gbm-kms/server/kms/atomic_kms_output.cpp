@@ -0,0 +1,988 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "atomic_kms_output.h"
+#include "kms_framebuffer.h"
+#include "dumb_buffer.h"
+#include "page_flipper.h"
+#include "kms-utils/kms_connector.h"
+#include "mir/graphics/gamma_curves.h"
+#include "mir/log.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <drm.h>
+#include <drm_mode.h>
+#include <gbm.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+namespace mg = mir::graphics;
+namespace mgg = mg::gbm;
+namespace mgk = mg::kms;
+namespace geom = mir::geometry;
+
+class mgg::DRMPropertyBlob
+{
+public:
+    DRMPropertyBlob(int drm_fd, void const* data, size_t size)
+        : drm_fd{drm_fd}
+    {
+        if (auto const err = drmModeCreatePropertyBlob(drm_fd, data, size, &blob_id))
+        {
+            BOOST_THROW_EXCEPTION((
+                std::system_error{-err, std::system_category(), "Failed to create DRM property blob"}));
+        }
+    }
+
+    ~DRMPropertyBlob()
+    {
+        // The kernel keeps its own reference to any blob that has been committed
+        drmModeDestroyPropertyBlob(drm_fd, blob_id);
+    }
+
+    uint32_t id() const
+    {
+        return blob_id;
+    }
+
+private:
+    int const drm_fd;
+    uint32_t blob_id;
+};
+
+class mgg::AtomicRequest
+{
+public:
+    AtomicRequest()
+        : request{drmModeAtomicAlloc(), &drmModeAtomicFree}
+    {
+        if (!request)
+            BOOST_THROW_EXCEPTION(std::bad_alloc{});
+    }
+
+    void add(uint32_t object_id, kms::ObjectProperties const& properties, char const* name, uint64_t value)
+    {
+        if (drmModeAtomicAddProperty(request.get(), object_id, properties.id_for(name), value) < 0)
+        {
+            BOOST_THROW_EXCEPTION(
+                std::runtime_error{std::string{"Failed to add property "} + name + " to atomic request"});
+        }
+    }
+
+    int commit(int drm_fd, uint32_t flags, void* event_data = nullptr)
+    {
+        return drmModeAtomicCommit(drm_fd, request.get(), flags, event_data);
+    }
+
+private:
+    std::unique_ptr<drmModeAtomicReq, void(*)(drmModeAtomicReqPtr)> const request;
+};
+
+namespace
+{
+int crtc_index_of(int drm_fd, uint32_t crtc_id)
+{
+    mgk::DRMModeResources resources{drm_fd};
+
+    int index = 0;
+    for (auto& crtc : resources.crtcs())
+    {
+        if (crtc->crtc_id == crtc_id)
+            return index;
+        ++index;
+    }
+
+    BOOST_THROW_EXCEPTION(std::runtime_error{"Failed to find index of CRTC"});
+}
+
+mgk::DRMModePlaneUPtr find_plane(
+    int drm_fd,
+    int crtc_index,
+    uint64_t type,
+    std::unordered_set<uint32_t> const& exclude = {})
+{
+    mgk::PlaneResources plane_resources{drm_fd};
+
+    for (auto& plane : plane_resources.planes())
+    {
+        if ((plane->possible_crtcs & (1 << crtc_index)) && !exclude.count(plane->plane_id))
+        {
+            mgk::ObjectProperties plane_props{drm_fd, plane};
+            if (plane_props["type"] == type)
+                return std::move(plane);
+        }
+    }
+
+    return nullptr;
+}
+
+/*
+ * Some hardware lets an overlay plane be used with any of several CRTCs.
+ * Atomic commits would happily move such a plane from one output to
+ * another, so each one is claimed by a single output at a time.
+ */
+class PlaneClaims
+{
+public:
+    bool claim(int drm_fd, uint32_t plane_id, void const* owner)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto const& claimant = owners.emplace(std::make_pair(drm_fd, plane_id), owner).first->second;
+        return claimant == owner;
+    }
+
+    void release_all(void const* owner)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto i = owners.begin(); i != owners.end();)
+        {
+            if (i->second == owner)
+                i = owners.erase(i);
+            else
+                ++i;
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::pair<int, uint32_t>, void const*> owners;
+};
+
+PlaneClaims& plane_claims()
+{
+    static PlaneClaims claims;
+    return claims;
+}
+
+void add_plane_state(
+    mgg::AtomicRequest& request,
+    uint32_t plane_id,
+    mgk::ObjectProperties const& plane_props,
+    uint32_t crtc_id,
+    uint32_t fb_id,
+    geom::Rectangle const& source,
+    geom::Rectangle const& destination)
+{
+    /* Source viewport. Coordinates are 16.16 fixed point format */
+    request.add(plane_id, plane_props, "SRC_X", uint64_t(source.top_left.x.as_int()) << 16);
+    request.add(plane_id, plane_props, "SRC_Y", uint64_t(source.top_left.y.as_int()) << 16);
+    request.add(plane_id, plane_props, "SRC_W", uint64_t(source.size.width.as_uint32_t()) << 16);
+    request.add(plane_id, plane_props, "SRC_H", uint64_t(source.size.height.as_uint32_t()) << 16);
+
+    /* Destination viewport. Coordinates are *not* 16.16, and may be negative */
+    request.add(plane_id, plane_props, "CRTC_X", static_cast<uint64_t>(int64_t{destination.top_left.x.as_int()}));
+    request.add(plane_id, plane_props, "CRTC_Y", static_cast<uint64_t>(int64_t{destination.top_left.y.as_int()}));
+    request.add(plane_id, plane_props, "CRTC_W", destination.size.width.as_uint32_t());
+    request.add(plane_id, plane_props, "CRTC_H", destination.size.height.as_uint32_t());
+
+    request.add(plane_id, plane_props, "FB_ID", fb_id);
+    request.add(plane_id, plane_props, "CRTC_ID", crtc_id);
+}
+
+void add_plane_disable(
+    mgg::AtomicRequest& request,
+    uint32_t plane_id,
+    mgk::ObjectProperties const& plane_props)
+{
+    request.add(plane_id, plane_props, "FB_ID", 0);
+    request.add(plane_id, plane_props, "CRTC_ID", 0);
+}
+}
+
+mgg::AtomicKMSOutput::AtomicKMSOutput(
+    int drm_fd,
+    kms::DRMModeConnectorUPtr&& connector,
+    std::shared_ptr<PageFlipper> const& page_flipper)
+    : RealKMSOutput(drm_fd, std::move(connector), page_flipper),
+      overlay_order_known{false},
+      flip_pending{false},
+      cursor_dirty{false},
+      cursor_commit_pending{false},
+      cursor_commits{0},
+      flip_waiting{false},
+      gamma_dirty{false},
+      overlay_planes_in_use{0},
+      overlays_dirty{false}
+{
+}
+
+mgg::AtomicKMSOutput::~AtomicKMSOutput()
+{
+    // Our flip_completed() goes with us, so mustn't be called from here on
+    detach_from_pending_flips();
+    plane_claims().release_all(this);
+}
+
+bool mgg::AtomicKMSOutput::OverlayState::operator==(OverlayState const& other) const
+{
+    return fb_id == other.fb_id &&
+           buffer_size == other.buffer_size &&
+           destination == other.destination;
+}
+
+void mgg::AtomicKMSOutput::reset()
+{
+    RealKMSOutput::reset();
+    forget_planes();
+}
+
+bool mgg::AtomicKMSOutput::set_crtc(FBHandle const& fb)
+{
+    if (!ensure_planes())
+        return RealKMSOutput::set_crtc(fb);
+
+    try
+    {
+        auto const& mode = connector->modes[mode_index];
+        DRMPropertyBlob const mode_blob{drm_fd_, &mode, sizeof(mode)};
+        geom::Size const mode_size{mode.hdisplay, mode.vdisplay};
+        auto const crtc_id = current_crtc->crtc_id;
+
+        AtomicRequest request;
+        request.add(crtc_id, *crtc_props, "MODE_ID", mode_blob.id());
+        request.add(crtc_id, *crtc_props, "ACTIVE", 1);
+        request.add(connector->connector_id, *connector_props, "CRTC_ID", crtc_id);
+        add_plane_state(
+            request,
+            primary_plane->plane_id,
+            *primary_props,
+            crtc_id,
+            fb.get_drm_fb_id(),
+            {geom::Point{} + fb_offset, mode_size},
+            {{}, mode_size});
+
+        std::lock_guard<std::mutex> lock{state_mutex};
+
+        // A modeset replaces the whole CRTC state, so bring everything along
+        cursor_dirty = true;
+        add_cursor_state_to(request);
+        add_overlay_state_to(request, overlays);
+        if (gamma_lut)
+            request.add(crtc_id, *crtc_props, "GAMMA_LUT", gamma_lut->id());
+
+        if (auto const err = request.commit(drm_fd_, DRM_MODE_ATOMIC_ALLOW_MODESET))
+        {
+            BOOST_THROW_EXCEPTION((
+                std::system_error{-err, std::system_category(), "Atomic modeset failed"}));
+        }
+
+        cursor_dirty = false;
+        gamma_dirty = false;
+        overlay_planes_in_use = overlays.size();
+        overlays_dirty = false;
+    }
+    catch (std::exception const& error)
+    {
+        mir::log_warning("Falling back to legacy modesetting for output %s: %s",
+                         kms::connector_name(connector).c_str(), error.what());
+        forget_planes();
+        return RealKMSOutput::set_crtc(fb);
+    }
+
+    using_saved_crtc = false;
+    return true;
+}
+
+void mgg::AtomicKMSOutput::clear_crtc()
+{
+    if (!ensure_planes())
+    {
+        RealKMSOutput::clear_crtc();
+        return;
+    }
+
+    int result;
+    try
+    {
+        auto const crtc_id = current_crtc->crtc_id;
+
+        AtomicRequest request;
+        request.add(crtc_id, *crtc_props, "MODE_ID", 0);
+        request.add(crtc_id, *crtc_props, "ACTIVE", 0);
+        request.add(connector->connector_id, *connector_props, "CRTC_ID", 0);
+        add_plane_disable(request, primary_plane->plane_id, *primary_props);
+        if (cursor_plane)
+            add_plane_disable(request, cursor_plane->plane_id, *cursor_props);
+        for (auto const& overlay : overlay_planes)
+            add_plane_disable(request, overlay.plane->plane_id, *overlay.properties);
+
+        result = request.commit(drm_fd_, DRM_MODE_ATOMIC_ALLOW_MODESET);
+    }
+    catch (std::exception const& error)
+    {
+        mir::log_warning("Falling back to legacy modesetting to clear output %s: %s",
+                         kms::connector_name(connector).c_str(), error.what());
+        forget_planes();
+        RealKMSOutput::clear_crtc();
+        return;
+    }
+
+    if (result == -EACCES || result == -EPERM)
+    {
+        /* We don't have modesetting rights.
+         *
+         * This can happen during session switching if (eg) logind has already
+         * revoked device access before notifying us.
+         *
+         * Whatever we're switching to can handle the CRTCs; this should not be fatal.
+         */
+        mir::log_info("Couldn't clear output %s (drmModeAtomicCommit: %s (%i))",
+            kms::connector_name(connector).c_str(),
+            strerror(-result),
+            -result);
+    }
+    else if (result)
+    {
+        mir::log_warning("Falling back to legacy modesetting to clear output %s: %s",
+                         kms::connector_name(connector).c_str(), strerror(-result));
+        forget_planes();
+        RealKMSOutput::clear_crtc();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{state_mutex};
+        cursor_dirty = true;
+        overlays.clear();
+        overlay_planes_in_use = 0;
+        overlays_dirty = false;
+    }
+    forget_planes();
+    current_crtc = nullptr;
+}
+
+bool mgg::AtomicKMSOutput::schedule_page_flip(FBHandle const& fb)
+{
+    if (!primary_plane)
+        return RealKMSOutput::schedule_page_flip(fb);
+
+    std::unique_lock<std::mutex> lg(power_mutex);
+    if (power_mode != mir_power_mode_on)
+        return true;
+
+    auto const crtc_id = current_crtc->crtc_id;
+
+    AtomicRequest request;
+    request.add(primary_plane->plane_id, *primary_props, "FB_ID", fb.get_drm_fb_id());
+
+    std::unique_lock<std::mutex> lock{state_mutex};
+
+    /*
+     * A cursor-only commit still in flight would make ours fail with EBUSY,
+     * so see it through first; cursor changes since then come with us.
+     */
+    flip_waiting = true;
+    while (cursor_commit_pending)
+    {
+        auto const commit = cursor_commits;
+        lock.unlock();
+        page_flipper->wait_for_flip(crtc_id);
+        lock.lock();
+
+        // Its handler may yet run, but the commit's done
+        if (cursor_commits == commit)
+            cursor_commit_pending = false;
+    }
+    flip_waiting = false;
+
+    add_cursor_state_to(request);
+    if (overlays_dirty)
+        add_overlay_state_to(request, overlays);
+    if (gamma_dirty && gamma_lut)
+        request.add(crtc_id, *crtc_props, "GAMMA_LUT", gamma_lut->id());
+
+    auto const scheduled = page_flipper->schedule_flip(
+        crtc_id,
+        connector->connector_id,
+        [this, &request](void* event_data)
+        {
+            return request.commit(
+                drm_fd_,
+                DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT,
+                event_data);
+        });
+
+    if (scheduled)
+    {
+        flip_pending = true;
+        cursor_dirty = false;
+        gamma_dirty = false;
+        if (overlays_dirty)
+            overlay_planes_in_use = overlays.size();
+        overlays_dirty = false;
+    }
+    else
+    {
+        // The cursor needn't wait for whatever takes the frame's place
+        commit_cursor();
+    }
+
+    return scheduled;
+}
+
+void mgg::AtomicKMSOutput::wait_for_page_flip()
+{
+    RealKMSOutput::wait_for_page_flip();
+    flip_completed();
+}
+
+void mgg::AtomicKMSOutput::flip_completed()
+{
+    std::lock_guard<std::mutex> lock{state_mutex};
+    if (!flip_pending)
+        return;
+
+    flip_pending = false;
+
+    // Gamma and the cursor changed while the flip was in flight and there might not be another
+    if (gamma_dirty)
+        commit_gamma();
+    commit_cursor();
+}
+
+bool mgg::AtomicKMSOutput::set_overlays(std::vector<OverlayLayer> const& layers)
+{
+    std::vector<OverlayState> wanted;
+    wanted.reserve(layers.size());
+    for (auto const& layer : layers)
+        wanted.push_back({layer.fb->get_drm_fb_id(), layer.buffer_size, layer.destination});
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+
+    if (wanted == overlays)
+        return true;
+
+    if (!wanted.empty())
+    {
+        if (!primary_plane || wanted.size() > overlay_planes.size())
+            return false;
+
+        // Without knowing how the planes stack we can't keep layers in order
+        if (wanted.size() > 1 && !overlay_order_known)
+            return false;
+
+        try
+        {
+            AtomicRequest request;
+            add_overlay_state_to(request, wanted);
+
+            // Formats, modifiers, scaling and bandwidth limits are the driver's to judge
+            if (request.commit(drm_fd_, DRM_MODE_ATOMIC_TEST_ONLY))
+                return false;
+        }
+        catch (std::exception const&)
+        {
+            return false;
+        }
+    }
+
+    overlays = std::move(wanted);
+    overlays_dirty = true;
+    return true;
+}
+
+/*
+ * Cursor changes are committed atomically: with the pending page flip if
+ * there is one, otherwise by a cursor-only commit of their own. Those don't
+ * block, and changes made while one is in flight follow once it completes,
+ * so the cursor moves at most once per refresh. Only outputs we can't drive
+ * atomically use the legacy cursor ioctls.
+ */
+bool mgg::AtomicKMSOutput::set_cursor(gbm_bo* buffer)
+{
+    if (!ensure_planes() || !cursor_plane)
+        return RealKMSOutput::set_cursor(buffer);
+
+    auto const fb = fb_for(buffer);
+    if (!fb)
+        return false;
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+    cursor_fb = fb;
+    cursor_size = {gbm_bo_get_width(buffer), gbm_bo_get_height(buffer)};
+    cursor_dirty = true;
+    commit_cursor();
+
+    return true;
+}
+
+void mgg::AtomicKMSOutput::move_cursor(geometry::Point destination)
+{
+    if (!ensure_planes() || !cursor_plane)
+    {
+        RealKMSOutput::move_cursor(destination);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+    cursor_position = destination;
+    cursor_dirty = true;
+    commit_cursor();
+}
+
+bool mgg::AtomicKMSOutput::clear_cursor()
+{
+    if (!ensure_planes() || !cursor_plane)
+        return RealKMSOutput::clear_cursor();
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+    cursor_fb = nullptr;
+    cursor_dirty = true;
+    commit_cursor();
+
+    return true;
+}
+
+bool mgg::AtomicKMSOutput::has_cursor() const
+{
+    if (!cursor_plane)
+        return RealKMSOutput::has_cursor();
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+    return cursor_fb != nullptr;
+}
+
+/* This method should be called with state_mutex locked */
+void mgg::AtomicKMSOutput::commit_cursor()
+{
+    // Anything committed in the meantime takes the cursor changes with it
+    if (!cursor_dirty || flip_pending || cursor_commit_pending || flip_waiting)
+        return;
+
+    if (!cursor_plane || !current_crtc)
+        return;
+
+    auto const commit = cursor_commits + 1;
+    try
+    {
+        AtomicRequest request;
+        add_cursor_state_to(request);
+
+        auto const scheduled = page_flipper->schedule_flip(
+            current_crtc->crtc_id,
+            connector->connector_id,
+            [this, &request](void* event_data)
+            {
+                return request.commit(
+                    drm_fd_,
+                    DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT,
+                    event_data);
+            },
+            [target = flip_target, commit](Frame const&)
+            {
+                std::lock_guard<std::mutex> lock{target->mutex};
+                if (target->owner)
+                    static_cast<AtomicKMSOutput*>(target->owner)->cursor_committed(commit);
+            });
+
+        if (!scheduled)
+        {
+            // It stays dirty, for the next flip to take
+            mir::log_warning("Failed to update cursor on output %s",
+                             kms::connector_name(connector).c_str());
+            return;
+        }
+    }
+    catch (std::exception const& error)
+    {
+        mir::log_warning("Failed to update cursor on output %s: %s",
+                         kms::connector_name(connector).c_str(), error.what());
+        return;
+    }
+
+    cursor_commits = commit;
+    cursor_commit_pending = true;
+    cursor_dirty = false;
+}
+
+/* Called, on whichever thread sees it, when a cursor-only commit completes */
+void mgg::AtomicKMSOutput::cursor_committed(uint64_t commit)
+{
+    std::lock_guard<std::mutex> lock{state_mutex};
+    if (!cursor_commit_pending || cursor_commits != commit)
+        return;
+
+    cursor_commit_pending = false;
+
+    // Whatever changed while it was in flight
+    commit_cursor();
+}
+
+void mgg::AtomicKMSOutput::set_gamma(GammaCurves const& gamma)
+{
+    if (gamma.red.size() != gamma.green.size() ||
+        gamma.green.size() != gamma.blue.size())
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("set_gamma: mismatch gamma LUT sizes"));
+    }
+
+    if (!ensure_planes() ||
+        !crtc_props->has_property("GAMMA_LUT") ||
+        !crtc_props->has_property("GAMMA_LUT_SIZE") ||
+        (*crtc_props)["GAMMA_LUT_SIZE"] != gamma.red.size())
+    {
+        RealKMSOutput::set_gamma(gamma);
+        return;
+    }
+
+    std::vector<drm_color_lut> lut(gamma.red.size());
+    for (size_t i = 0; i != lut.size(); ++i)
+    {
+        lut[i].red = gamma.red[i];
+        lut[i].green = gamma.green[i];
+        lut[i].blue = gamma.blue[i];
+        lut[i].reserved = 0;
+    }
+
+    auto const blob = std::make_shared<DRMPropertyBlob>(drm_fd_, lut.data(), lut.size() * sizeof(lut[0]));
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+    gamma_lut = blob;
+    gamma_dirty = true;
+
+    // Otherwise it goes out with the pending flip, or once that completes
+    if (!flip_pending)
+        commit_gamma();
+}
+
+void mgg::AtomicKMSOutput::refresh_hardware_state()
+{
+    RealKMSOutput::refresh_hardware_state();
+    forget_planes();
+}
+
+bool mgg::AtomicKMSOutput::ensure_planes()
+{
+    if (current_crtc && primary_plane)
+        return true;
+
+    /* If the output is not connected there is nothing to do */
+    if (connector->connection != DRM_MODE_CONNECTED)
+        return false;
+
+    try
+    {
+        std::tie(current_crtc, primary_plane) = kms::find_crtc_with_primary_plane(drm_fd_, connector);
+
+        crtc_props = std::make_unique<kms::ObjectProperties>(drm_fd_, current_crtc);
+        connector_props = std::make_unique<kms::ObjectProperties>(drm_fd_, connector);
+        primary_props = std::make_unique<kms::ObjectProperties>(drm_fd_, primary_plane);
+
+        auto const crtc_index = crtc_index_of(drm_fd_, current_crtc->crtc_id);
+        cursor_plane = find_plane(drm_fd_, crtc_index, DRM_PLANE_TYPE_CURSOR);
+        if (cursor_plane)
+            cursor_props = std::make_unique<kms::ObjectProperties>(drm_fd_, cursor_plane);
+
+        find_overlay_planes(crtc_index);
+    }
+    catch (std::exception const& error)
+    {
+        mir::log_warning("Unable to find planes for output %s: %s",
+                         kms::connector_name(connector).c_str(), error.what());
+        forget_planes();
+        return false;
+    }
+
+    return true;
+}
+
+void mgg::AtomicKMSOutput::find_overlay_planes(int crtc_index)
+{
+    overlay_planes.clear();
+    overlay_order_known = true;
+
+    kms::PlaneResources plane_resources{drm_fd_};
+    for (auto& plane : plane_resources.planes())
+    {
+        if (!(plane->possible_crtcs & (1 << crtc_index)))
+            continue;
+
+        auto properties = std::make_unique<kms::ObjectProperties>(drm_fd_, plane);
+        if ((*properties)["type"] != DRM_PLANE_TYPE_OVERLAY ||
+            !plane_claims().claim(drm_fd_, plane->plane_id, this))
+            continue;
+
+        overlay_order_known = overlay_order_known && properties->has_property("zpos");
+        overlay_planes.push_back({std::move(plane), std::move(properties)});
+    }
+
+    if (overlay_order_known)
+    {
+        std::stable_sort(
+            overlay_planes.begin(),
+            overlay_planes.end(),
+            [](OverlayPlane const& lhs, OverlayPlane const& rhs)
+            {
+                return (*lhs.properties)["zpos"] < (*rhs.properties)["zpos"];
+            });
+
+        // Planes stacked beneath the primary plane would be hidden by the composited image
+        if (primary_props->has_property("zpos"))
+        {
+            auto const primary_zpos = (*primary_props)["zpos"];
+            overlay_planes.erase(
+                std::remove_if(
+                    overlay_planes.begin(),
+                    overlay_planes.end(),
+                    [primary_zpos](OverlayPlane const& overlay)
+                    {
+                        return (*overlay.properties)["zpos"] <= primary_zpos;
+                    }),
+                overlay_planes.end());
+        }
+    }
+}
+
+void mgg::AtomicKMSOutput::forget_planes()
+{
+    primary_plane = nullptr;
+    cursor_plane = nullptr;
+    crtc_props = nullptr;
+    connector_props = nullptr;
+    primary_props = nullptr;
+    cursor_props = nullptr;
+    overlay_planes.clear();
+    plane_claims().release_all(this);
+
+    std::lock_guard<std::mutex> lock{state_mutex};
+    overlays.clear();
+    overlay_planes_in_use = 0;
+    overlays_dirty = false;
+}
+
+void mgg::AtomicKMSOutput::add_cursor_state_to(AtomicRequest& request)
+{
+    if (!cursor_dirty || !cursor_plane)
+        return;
+
+    if (cursor_fb)
+    {
+        add_plane_state(
+            request,
+            cursor_plane->plane_id,
+            *cursor_props,
+            current_crtc->crtc_id,
+            cursor_fb->get_drm_fb_id(),
+            {{}, cursor_size},
+            {cursor_position, cursor_size});
+    }
+    else
+    {
+        add_plane_disable(request, cursor_plane->plane_id, *cursor_props);
+    }
+}
+
+void mgg::AtomicKMSOutput::add_overlay_state_to(
+    AtomicRequest& request,
+    std::vector<OverlayState> const& layers) const
+{
+    for (size_t i = 0; i != overlay_planes.size(); ++i)
+    {
+        auto const& overlay = overlay_planes[i];
+        if (i < layers.size())
+        {
+            add_plane_state(
+                request,
+                overlay.plane->plane_id,
+                *overlay.properties,
+                current_crtc->crtc_id,
+                layers[i].fb_id,
+                {{}, layers[i].buffer_size},
+                layers[i].destination);
+        }
+        else if (i < overlay_planes_in_use)
+        {
+            add_plane_disable(request, overlay.plane->plane_id, *overlay.properties);
+        }
+    }
+}
+
+bool mgg::AtomicKMSOutput::commit_gamma()
+{
+    if (!gamma_lut || !crtc_props || !current_crtc)
+        return false;
+
+    try
+    {
+        AtomicRequest request;
+        request.add(current_crtc->crtc_id, *crtc_props, "GAMMA_LUT", gamma_lut->id());
+
+        if (auto const err = request.commit(drm_fd_, 0))
+        {
+            mir::log_warning("Failed to set gamma on output %s: %s",
+                             kms::connector_name(connector).c_str(), strerror(-err));
+            return false;
+        }
+    }
+    catch (std::exception const& error)
+    {
+        mir::log_warning("Failed to set gamma on output %s: %s",
+                         kms::connector_name(connector).c_str(), error.what());
+        return false;
+    }
+
+    gamma_dirty = false;
+    return true;
+}
+
+bool mgg::test_atomic_configuration(
+    std::vector<std::pair<std::shared_ptr<KMSOutput>, std::experimental::optional<size_t>>> const& outputs)
+{
+    std::unordered_map<int, std::vector<std::pair<AtomicKMSOutput*, std::experimental::optional<size_t>>>> devices;
+    for (auto const& output : outputs)
+    {
+        if (auto const atomic = dynamic_cast<AtomicKMSOutput*>(output.first.get()))
+            devices[atomic->drm_fd()].emplace_back(atomic, output.second);
+    }
+
+    for (auto const& device : devices)
+    {
+        auto const drm_fd = device.first;
+
+        try
+        {
+            kms::DRMModeResources resources{drm_fd};
+            kms::PlaneResources plane_resources{drm_fd};
+
+            std::vector<uint32_t> crtc_ids;
+            std::unordered_set<uint32_t> claimed_crtcs;
+            std::unordered_set<uint32_t> claimed_planes;
+            for (auto& crtc : resources.crtcs())
+            {
+                crtc_ids.push_back(crtc->crtc_id);
+                if (crtc->mode_valid)
+                    claimed_crtcs.insert(crtc->crtc_id);
+            }
+
+            auto const bound_crtc = [drm_fd](AtomicKMSOutput const& output) -> uint32_t
+                {
+                    if (!output.connector->encoder_id)
+                        return 0;
+                    return kms::get_encoder(drm_fd, output.connector->encoder_id)->crtc_id;
+                };
+
+            AtomicRequest request;
+            std::vector<std::unique_ptr<DRMPropertyBlob>> mode_blobs;
+
+            /* Outputs being switched off release their CRTC, and everything on it */
+            for (auto const& entry : device.second)
+            {
+                auto const& output = *entry.first;
+                auto const crtc_id = bound_crtc(output);
+                if (entry.second || !crtc_id)
+                    continue;
+
+                kms::ObjectProperties const crtc_props{drm_fd, crtc_id, DRM_MODE_OBJECT_CRTC};
+                kms::ObjectProperties const connector_props{drm_fd, output.connector};
+                request.add(crtc_id, crtc_props, "MODE_ID", 0);
+                request.add(crtc_id, crtc_props, "ACTIVE", 0);
+                request.add(output.connector->connector_id, connector_props, "CRTC_ID", 0);
+
+                for (auto& plane : plane_resources.planes())
+                {
+                    if (plane->crtc_id == crtc_id)
+                        add_plane_disable(request, plane->plane_id, kms::ObjectProperties{drm_fd, plane});
+                }
+
+                claimed_crtcs.erase(crtc_id);
+            }
+
+            /* ...so that outputs being lit up can take any CRTC not kept by another */
+            for (auto const& entry : device.second)
+            {
+                if (!entry.second)
+                    continue;
+
+                auto& output = *entry.first;
+                auto crtc_id = bound_crtc(output);
+                for (int i = 0; !crtc_id && i < output.connector->count_encoders; ++i)
+                {
+                    auto const encoder = kms::get_encoder(drm_fd, output.connector->encoders[i]);
+                    for (size_t index = 0; index != crtc_ids.size(); ++index)
+                    {
+                        if ((encoder->possible_crtcs & (1 << index)) && !claimed_crtcs.count(crtc_ids[index]))
+                        {
+                            crtc_id = crtc_ids[index];
+                            break;
+                        }
+                    }
+                }
+
+                auto const index = std::find(crtc_ids.begin(), crtc_ids.end(), crtc_id) - crtc_ids.begin();
+                auto const plane = crtc_id ?
+                    find_plane(drm_fd, index, DRM_PLANE_TYPE_PRIMARY, claimed_planes) : nullptr;
+                if (!plane)
+                {
+                    mir::log_info("Display configuration rejected: no CRTC available for output %s",
+                                  kms::connector_name(output.connector).c_str());
+                    return false;
+                }
+                claimed_crtcs.insert(crtc_id);
+                claimed_planes.insert(plane->plane_id);
+
+                auto const& mode = output.connector->modes[entry.second.value()];
+                geom::Size const mode_size{mode.hdisplay, mode.vdisplay};
+                mode_blobs.push_back(std::make_unique<DRMPropertyBlob>(drm_fd, &mode, sizeof(mode)));
+                // Reconfiguring mostly re-tests the modes already in use, so keep their buffers
+                if (!output.probe_fb || output.probe_fb->size() != mode_size)
+                {
+                    output.probe_fb.reset();
+                    output.probe_fb = std::make_unique<DumbBuffer>(drm_fd, mode_size);
+                }
+
+                kms::ObjectProperties const crtc_props{drm_fd, crtc_id, DRM_MODE_OBJECT_CRTC};
+                kms::ObjectProperties const connector_props{drm_fd, output.connector};
+                request.add(crtc_id, crtc_props, "MODE_ID", mode_blobs.back()->id());
+                request.add(crtc_id, crtc_props, "ACTIVE", 1);
+                request.add(output.connector->connector_id, connector_props, "CRTC_ID", crtc_id);
+                add_plane_state(
+                    request,
+                    plane->plane_id,
+                    kms::ObjectProperties{drm_fd, plane},
+                    crtc_id,
+                    output.probe_fb->fb()->get_drm_fb_id(),
+                    {{}, mode_size},
+                    {{}, mode_size});
+            }
+
+            if (auto const err = request.commit(
+                    drm_fd,
+                    DRM_MODE_ATOMIC_TEST_ONLY | DRM_MODE_ATOMIC_ALLOW_MODESET))
+            {
+                mir::log_info("Display configuration rejected by the driver: %s", strerror(-err));
+                return false;
+            }
+        }
+        catch (std::exception const& error)
+        {
+            // We can't tell one way or the other; let the modeset itself find out
+            mir::log_warning("Unable to test display configuration: %s", error.what());
+        }
+    }
+
+    return true;
+}
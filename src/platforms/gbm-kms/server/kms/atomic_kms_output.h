@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_GBM_ATOMIC_KMS_OUTPUT_H_
+#define MIR_GRAPHICS_GBM_ATOMIC_KMS_OUTPUT_H_
+
+#include "real_kms_output.h"
+
+#include <experimental/optional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mir
+{
+namespace graphics
+{
+namespace gbm
+{
+
+class AtomicRequest;
+class DRMPropertyBlob;
+class DumbBuffer;
+
+/**
+ * A KMSOutput driven by atomic modesetting.
+ *
+ * Modesets, page flips, cursor and gamma changes are submitted as atomic
+ * commits; each page flip also carries any cursor changes made since the
+ * previous commit, so the cursor and the frame it is drawn over reach the
+ * screen together. Anything the driver rejects falls back to the legacy
+ * RealKMSOutput path.
+ */
+class AtomicKMSOutput : public RealKMSOutput
+{
+public:
+    AtomicKMSOutput(
+        int drm_fd,
+        kms::DRMModeConnectorUPtr&& connector,
+        std::shared_ptr<PageFlipper> const& page_flipper);
+    ~AtomicKMSOutput();
+
+    void reset() override;
+
+    bool set_crtc(FBHandle const& fb) override;
+    void clear_crtc() override;
+    bool schedule_page_flip(FBHandle const& fb) override;
+    void wait_for_page_flip() override;
+    bool set_overlays(std::vector<OverlayLayer> const& layers) override;
+
+    bool set_cursor(gbm_bo* buffer) override;
+    void move_cursor(geometry::Point destination) override;
+    bool clear_cursor() override;
+    bool has_cursor() const override;
+
+    void set_gamma(GammaCurves const& gamma) override;
+
+    void refresh_hardware_state() override;
+
+private:
+    friend bool test_atomic_configuration(
+        std::vector<std::pair<std::shared_ptr<KMSOutput>, std::experimental::optional<size_t>>> const&);
+
+    struct OverlayPlane
+    {
+        kms::DRMModePlaneUPtr plane;
+        std::unique_ptr<kms::ObjectProperties> properties;
+    };
+
+    struct OverlayState
+    {
+        uint32_t fb_id;
+        geometry::Size buffer_size;
+        geometry::Rectangle destination;
+
+        bool operator==(OverlayState const& other) const;
+    };
+
+    void flip_completed() override;
+    bool ensure_planes();
+    void find_overlay_planes(int crtc_index);
+    void forget_planes();
+    void add_cursor_state_to(AtomicRequest& request);
+    void commit_cursor();
+    void cursor_committed(uint64_t commit);
+    void add_overlay_state_to(AtomicRequest& request, std::vector<OverlayState> const& layers) const;
+    bool commit_gamma();
+
+    kms::DRMModePlaneUPtr primary_plane;
+    kms::DRMModePlaneUPtr cursor_plane;
+    std::unique_ptr<kms::ObjectProperties> crtc_props;
+    std::unique_ptr<kms::ObjectProperties> connector_props;
+    std::unique_ptr<kms::ObjectProperties> primary_props;
+    std::unique_ptr<kms::ObjectProperties> cursor_props;
+    /// Overlay planes we may use, bottom first
+    std::vector<OverlayPlane> overlay_planes;
+    /// Whether the stacking order of overlay_planes is known
+    bool overlay_order_known;
+
+    std::mutex mutable state_mutex;
+    bool flip_pending;
+    std::shared_ptr<FBHandle const> cursor_fb;
+    geometry::Size cursor_size;
+    geometry::Point cursor_position;
+    bool cursor_dirty;
+    /// A cursor-only commit is in flight, the cursor_commits'th
+    bool cursor_commit_pending;
+    uint64_t cursor_commits;
+    /// A page flip is waiting for the cursor commit in flight, and will carry any further changes
+    bool flip_waiting;
+    std::shared_ptr<DRMPropertyBlob> gamma_lut;
+    bool gamma_dirty;
+    std::vector<OverlayState> overlays;
+    size_t overlay_planes_in_use;
+    bool overlays_dirty;
+
+    /// A framebuffer the size of the last mode tested, for test_atomic_configuration() to reuse
+    std::unique_ptr<DumbBuffer> probe_fb;
+};
+
+/**
+ * Asks the kernel whether a whole display configuration would be accepted,
+ * without changing anything on screen.
+ *
+ * \param [in] outputs  Every output affected by the configuration, with the
+ *                      KMS mode index to light it with or nullopt if it is
+ *                      to be switched off.
+ * \returns     false only if an atomic-capable device rejected the
+ *              configuration. Outputs driven by the legacy API can't be
+ *              checked up front and are assumed to be fine.
+ */
+bool test_atomic_configuration(
+    std::vector<std::pair<std::shared_ptr<KMSOutput>, std::experimental::optional<size_t>>> const& outputs);
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_GBM_ATOMIC_KMS_OUTPUT_H_ */
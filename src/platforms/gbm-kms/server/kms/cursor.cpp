@@ -23,6 +23,7 @@
 #include "kms_display_configuration.h"
 #include "mir/geometry/rectangle.h"
 #include "mir/graphics/cursor_image.h"
+#include "mir/graphics/pixel_ops.h"
 
 #include <xf86drm.h>
 
@@ -208,69 +209,16 @@ void mgg::Cursor::pad_and_write_image_data_locked(
     auto const buffer_height = std::max(min_height, gbm_bo_get_height(buffer));
     size_t const padded_size = buffer_stride * buffer_height;
 
-    auto padded = std::unique_ptr<uint8_t[]>(new uint8_t[padded_size]);
-    size_t rhs_padding = buffer_stride - 4*image_width;
+    // Zero-filled, so the padding is transparent
+    auto padded = std::unique_ptr<uint8_t[]>(new uint8_t[padded_size]());
 
-    auto const filler = 0; // 0x3f; is useful to make buffer visible for debugging
-    uint8_t const* src = argb8888.data();
-    uint8_t* dest = &padded[0];
-
-    switch (orientation)
-    {
-    case mir_orientation_normal:
-        for (unsigned int y = 0; y < image_height; y++)
-        {
-            memcpy(dest, src, 4*image_width);
-            memset(dest + 4*image_width, filler, rhs_padding);
-            dest += buffer_stride;
-            src += image_stride;
-        }
-
-        memset(dest, 0, buffer_stride * (buffer_height - image_height));
-        break;
-
-    case mir_orientation_inverted:
-        for (unsigned int row = 0; row != image_height; ++row)
-        {
-            memset(dest+row*buffer_stride+4*image_width, filler, rhs_padding);
-
-            for (unsigned int col = 0; col != image_width; ++col)
-            {
-                memcpy(dest+row*buffer_stride+4*col, src + ((image_height-1)-row)*image_stride + 4*((image_width-1)-col), 4);
-            }
-        }
-
-        memset(dest+image_height*buffer_stride, filler, buffer_stride * (buffer_height - image_height));
-        break;
-
-    case mir_orientation_left:
-        for (unsigned int row = 0; row != image_width; ++row)
-        {
-            memset(dest+row*buffer_stride+4*image_height, filler, rhs_padding);
-
-            for (unsigned int col = 0; col != image_height; ++col)
-            {
-                memcpy(dest+row*buffer_stride+4*col, src + ((image_width-1)-row)*4 + image_stride*col, 4);
-            }
-        }
-
-        memset(dest+image_width*buffer_stride, filler, buffer_stride * (buffer_height - image_width));
-        break;
-
-    case mir_orientation_right:
-        for (unsigned int row = 0; row != image_width; ++row)
-        {
-            memset(dest+row*buffer_stride+4*image_height, filler, rhs_padding);
-
-            for (unsigned int col = 0; col != image_height; ++col)
-            {
-                memcpy(dest+row*buffer_stride+4*col, src + row*4 + image_stride*((image_height-1)-col), 4);
-            }
-        }
-
-        memset(dest+image_width*buffer_stride, filler, buffer_stride * (buffer_height - image_width));
-        break;
-    }
+    mg::rotate(
+        &padded[0],
+        geom::Stride{buffer_stride},
+        argb8888.data(),
+        {image_width, image_height},
+        geom::Stride{image_stride},
+        orientation);
 
     write_buffer_data_locked(lg, buffer, &padded[0], padded_size);
 }
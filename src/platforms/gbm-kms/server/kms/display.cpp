@@ -22,6 +22,7 @@
 #include "display_buffer.h"
 #include "kms_display_configuration.h"
 #include "kms_output.h"
+#include "atomic_kms_output.h"
 #include "kms_page_flipper.h"
 #include "mir/console_services.h"
 #include "mir/graphics/overlapping_output_grouping.h"
@@ -458,6 +459,32 @@ void mgg::Display::configure_locked(
         compatible(kms_conf, current_display_configuration)};
     std::vector<std::unique_ptr<DisplayBuffer>> display_buffers_new;
 
+    if (!comp && &kms_conf != &current_display_configuration)
+    {
+        /*
+         * Check the whole configuration with the hardware before touching any
+         * output, so that it either applies completely or not at all.
+         */
+        std::vector<std::pair<std::shared_ptr<KMSOutput>, std::experimental::optional<size_t>>> outputs;
+        kms_conf.for_each_output(
+            [&](DisplayConfigurationOutput const& conf_output)
+            {
+                std::experimental::optional<size_t> mode_index;
+                if (conf_output.used && conf_output.connected)
+                {
+                    mode_index = kms_conf.get_kms_mode_index(conf_output.id,
+                                                             conf_output.current_mode_index);
+                }
+                outputs.emplace_back(current_display_configuration.get_output_for(conf_output.id), mode_index);
+            });
+
+        if (!test_atomic_configuration(outputs))
+        {
+            BOOST_THROW_EXCEPTION(
+                std::runtime_error("Display configuration rejected by the hardware"));
+        }
+    }
+
     if (!comp)
     {
         /*
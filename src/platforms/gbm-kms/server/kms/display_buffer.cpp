@@ -18,6 +18,8 @@
 
 #include "display_buffer.h"
 #include "kms_output.h"
+#include "kms_framebuffer.h"
+#include "dumb_buffer.h"
 #include "mir/graphics/display_report.h"
 #include "mir/graphics/transformation.h"
 #include "bypass.h"
@@ -230,6 +232,27 @@ public:
     }
 };
 
+/// A CPU mapping of a dumb buffer, which stays mapped until the buffer's destroyed
+class DumbBufferMapping : public mir::renderer::software::Mapping<unsigned char>
+{
+public:
+    explicit DumbBufferMapping(mgg::DumbBuffer& buffer)
+        : buffer{buffer},
+          pixels{buffer.pixels()}
+    {
+    }
+
+    MirPixelFormat format() const override { return mir_pixel_format_xrgb_8888; }
+    geom::Stride stride() const override { return buffer.stride(); }
+    geom::Size size() const override { return buffer.size(); }
+    unsigned char* data() override { return pixels; }
+    size_t len() const override { return buffer.len(); }
+
+private:
+    mgg::DumbBuffer& buffer;
+    unsigned char* const pixels;
+};
+
 class EGLBufferCopier
 {
 public:
@@ -440,8 +463,12 @@ mgg::DisplayBuffer::DisplayBuffer(
       area(area),
       transform{transformation},
       needs_set_crtc{false},
-      page_flips_pending{false}
+      render_time{std::chrono::milliseconds{50}},
+      flip_state{std::make_shared<FlipState>()}
 {
+    flip_state->owner = this;
+    flip_state->flips.resize(outputs.size());
+
     listener->report_successful_setup_of_native_resources();
 
     make_current();
@@ -476,7 +503,8 @@ mgg::DisplayBuffer::DisplayBuffer(
         get_front_buffer = [](auto&& fb) { return std::move(fb); };
     }
 
-    visible_composite_frame = get_front_buffer(std::move(temporary_front));
+    auto const initial_frame = std::make_shared<ScanoutFrame>();
+    initial_frame->composite = get_front_buffer(std::move(temporary_front));
 
     /*
      * Check that our (possibly bounced) front buffer is usable on *all* the
@@ -484,14 +512,17 @@ mgg::DisplayBuffer::DisplayBuffer(
      */
     for (auto const& output : outputs)
     {
-        if (output->buffer_requires_migration(visible_composite_frame))
+        if (output->buffer_requires_migration(initial_frame->composite))
         {
             BOOST_THROW_EXCEPTION(std::invalid_argument(
                 "Attempted to create a DisplayBuffer spanning multiple GPU memory domains"));
         }
     }
 
-    set_crtc(*outputs.front()->fb_for(visible_composite_frame));
+    initial_frame->fb = outputs.front()->fb_for(initial_frame->composite);
+    set_crtc(*initial_frame->fb);
+    for (auto& flip : flip_state->flips)
+        flip.visible = initial_frame;
 
     release_current();
 
@@ -506,6 +537,15 @@ mgg::DisplayBuffer::DisplayBuffer(
 
 mgg::DisplayBuffer::~DisplayBuffer()
 {
+    // Flips still in flight mustn't be left holding our frames, which need the surface
+    std::vector<OutputFlip> flips;
+    std::vector<std::shared_ptr<ScanoutFrame>> retired;
+    {
+        std::lock_guard<std::mutex> lock{flip_state->mutex};
+        flip_state->owner = nullptr;
+        flips.swap(flip_state->flips);
+        retired.swap(flip_state->retired);
+    }
 }
 
 geom::Rectangle mgg::DisplayBuffer::view_area() const
@@ -554,6 +594,129 @@ bool mgg::DisplayBuffer::overlay(RenderableList const& renderable_list)
     return false;
 }
 
+void mgg::DisplayBuffer::assign_planes(RenderableList& renderable_list)
+{
+    glm::mat2 static const no_transformation(1);
+    glm::mat4 static const identity(1);
+
+    pending_overlays = {};
+    planes_assigned = true;
+
+    // Overlay planes belong to a single CRTC, and we don't rotate them
+    if (outputs.size() != 1 ||
+        transform != no_transformation ||
+        bypass_option != mgg::BypassOption::allowed)
+    {
+        clear_overlays();
+        return;
+    }
+
+    auto const& output = outputs.front();
+
+    struct Candidate
+    {
+        size_t index;
+        std::shared_ptr<mg::Buffer> buffer;
+        std::shared_ptr<FBHandle const> fb;
+    };
+
+    /*
+     * Walk down from the top. Everything left on the primary plane is drawn
+     * beneath every overlay, so a renderable can only be lifted out if
+     * nothing that still needs compositing lies on top of it.
+     */
+    std::vector<Candidate> candidates;
+    std::vector<geom::Rectangle> composited_above;
+    for (auto i = renderable_list.size(); i-- != 0;)
+    {
+        auto const& renderable = *renderable_list[i];
+        auto const position = renderable.screen_position();
+        auto const clip = renderable.clip_area();
+        auto const visible = clip ? position.intersection_with(clip.value()) : position;
+
+        bool const obscured = std::any_of(
+            composited_above.begin(),
+            composited_above.end(),
+            [&visible](geom::Rectangle const& above) { return above.overlaps(visible); });
+
+        if (!obscured &&
+            renderable.transformation() == identity &&
+            renderable.alpha() == 1.0f &&
+            (!clip || clip.value().contains(position)) &&
+            area.contains(position))
+        {
+            auto buffer = renderable.buffer();
+            auto const dmabuf = buffer ?
+                dynamic_cast<mg::DMABufBuffer*>(buffer->native_buffer_base()) : nullptr;
+
+            if (dmabuf)
+            {
+                if (auto fb = output->fb_for(*dmabuf))
+                {
+                    candidates.push_back({i, std::move(buffer), std::move(fb)});
+                    continue;
+                }
+            }
+        }
+
+        composited_above.push_back(visible);
+    }
+
+    // candidates runs top to bottom; the kernel wants the lowest layer first
+    std::reverse(candidates.begin(), candidates.end());
+
+    /*
+     * Only the driver knows its format, scaling and bandwidth limits, so
+     * offer it what we have and move the lowest layer back to compositing
+     * until it's happy.
+     */
+    auto first = candidates.begin();
+    for (; first != candidates.end(); ++first)
+    {
+        std::vector<OverlayLayer> layers;
+        for (auto c = first; c != candidates.end(); ++c)
+        {
+            auto const position = renderable_list[c->index]->screen_position();
+            layers.push_back({
+                c->fb,
+                c->buffer->size(),
+                {position.top_left - as_displacement(area.top_left), position.size}});
+        }
+
+        if (output->set_overlays(layers))
+            break;
+    }
+
+    if (first == candidates.end())
+    {
+        clear_overlays();
+        return;
+    }
+
+    std::vector<bool> assigned(renderable_list.size(), false);
+    for (auto c = first; c != candidates.end(); ++c)
+    {
+        assigned[c->index] = true;
+        pending_overlays.buffers.push_back(std::move(c->buffer));
+        pending_overlays.fbs.push_back(std::move(c->fb));
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i != renderable_list.size(); ++i)
+    {
+        if (!assigned[i])
+            renderable_list[kept++] = std::move(renderable_list[i]);
+    }
+    renderable_list.resize(kept);
+}
+
+void mgg::DisplayBuffer::clear_overlays()
+{
+    pending_overlays = {};
+    for (auto& output : outputs)
+        output->set_overlays({});
+}
+
 void mgg::DisplayBuffer::for_each_display_buffer(
     std::function<void(graphics::DisplayBuffer&)> const& f)
 {
@@ -562,11 +725,25 @@ void mgg::DisplayBuffer::for_each_display_buffer(
 
 void mgg::DisplayBuffer::swap_buffers()
 {
+    rendered = surface.fence_rendering();
     surface.swap_buffers();
     bypass_buf = nullptr;
     bypass_bufobj = nullptr;
 }
 
+void mgg::DisplayBuffer::swap_buffers_with_damage(geom::Rectangles const& damage)
+{
+    rendered = surface.fence_rendering();
+    surface.swap_buffers_with_damage(damage);
+    bypass_buf = nullptr;
+    bypass_bufobj = nullptr;
+}
+
+int mgg::DisplayBuffer::buffer_age() const
+{
+    return surface.buffer_age();
+}
+
 void mgg::DisplayBuffer::set_crtc(FBHandle const& forced_frame)
 {
     for (auto& output : outputs)
@@ -588,33 +765,81 @@ void mgg::DisplayBuffer::set_crtc(FBHandle const& forced_frame)
 void mgg::DisplayBuffer::post()
 {
     /*
-     * We might not have waited for the previous frame to page flip yet.
-     * This is good because it maximizes the time available to spend rendering
-     * each frame. Just remember wait_for_page_flip() must be called at some
-     * point before the next schedule_page_flip().
+     * Measure how long this frame takes to composite, from the renderer
+     * binding us until the GPU finishes, to predict how long the next
+     * one will take. The GPU is waited for in the background, so this
+     * doesn't hold us up. Without fences we keep the conservative fallback.
      */
-    wait_for_page_flip();
+    if (!bypass_buf && render_started && rendered)
+        render_time.time(render_started.value(), std::move(rendered));
+    render_started = std::experimental::nullopt;
+    rendered = nullptr;
+
+    // What the outputs have flipped away from since we last posted
+    release_retired_frames();
 
-    std::shared_ptr<mgg::FBHandle const> bufobj;
+    // Overlays left over from an earlier frame mustn't outlive their buffers
+    if (bypass_buf || !planes_assigned)
+        clear_overlays();
+    planes_assigned = false;
+
+    auto const frame = std::make_shared<ScanoutFrame>();
     if (bypass_buf)
     {
-        bufobj = bypass_bufobj;
+        frame->fb = bypass_bufobj;
+        frame->bypass = bypass_buf;
+    }
+    else if (cpu_front)
+    {
+        frame->fb = cpu_front->buffer->fb();
+        cpu_front = nullptr;
     }
     else
     {
-        scheduled_composite_frame = get_front_buffer(surface.lock_front());
-        bufobj = outputs.front()->fb_for(scheduled_composite_frame);
-        if (!bufobj)
+        frame->composite = get_front_buffer(surface.lock_front());
+        frame->fb = outputs.front()->fb_for(frame->composite);
+        if (!frame->fb)
             fatal_error("Failed to get front buffer object");
     }
+    frame->overlays = std::move(pending_overlays);
+    pending_overlays = {};
+
+    /*
+     * Each output's flip completes in the background and retires what it
+     * replaces there, so an output only holds us up here if we're posting
+     * before its last flip has completed. All of those go before any output
+     * is flipped again, so the last frame is presented before this one is.
+     */
+    for (size_t i = 0; i != outputs.size(); ++i)
+        finish_flip(i);
 
-    scheduled_fb = std::move(bufobj);
     /*
      * Try to schedule a page flip as first preference to avoid tearing.
      * [will complete in a background thread]
      */
-    if (!needs_set_crtc && !schedule_page_flip(*scheduled_fb))
-        needs_set_crtc = true;
+    for (size_t i = 0; i != outputs.size() && !needs_set_crtc; ++i)
+    {
+        if (!outputs[i]->schedule_page_flip(*frame->fb))
+        {
+            needs_set_crtc = true;
+            break;
+        }
+
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock{flip_state->mutex};
+            auto& flip = flip_state->flips[i];
+            flip.scheduled = frame;
+            flip.in_flight = true;
+            generation = flip.generation;
+        }
+
+        outputs[i]->on_page_flip_complete(
+            [state = flip_state, i, generation]()
+            {
+                flip_completed(*state, i, generation);
+            });
+    }
 
     /*
      * Fallback blitting: Not pretty, since it may tear. VirtualBox seems
@@ -622,57 +847,51 @@ void mgg::DisplayBuffer::post()
      */
     if (needs_set_crtc)
     {
-        set_crtc(*scheduled_fb);
-        // SetCrtc is immediate, so the FB is now visible and we have nothing pending
-        visible_fb = std::move(scheduled_fb);
-        scheduled_fb = nullptr;
+        for (size_t i = 0; i != outputs.size(); ++i)
+            finish_flip(i);
 
+        set_crtc(*frame->fb);
         needs_set_crtc = false;
+
+        // SetCrtc is immediate, so the frame is now visible and we have nothing pending
+        std::vector<std::function<void(Frame const&)>> presented;
+        {
+            std::lock_guard<std::mutex> lock{flip_state->mutex};
+            for (auto& flip : flip_state->flips)
+            {
+                flip_state->retired.push_back(std::move(flip.visible));
+                flip.visible = frame;
+            }
+            presented.swap(flip_state->presented_handlers);
+        }
+
+        if (!presented.empty())
+        {
+            auto const presented_frame = last_frame();
+            for (auto const& handler : presented)
+                handler(presented_frame);
+        }
     }
 
     using namespace std::chrono_literals;  // For operator""ms()
 
     // Predicted worst case render time for the next frame...
-    auto predicted_render_time = 50ms;
+    auto predicted_render_time = render_time.predicted_render_time();
 
     if (bypass_buf)
     {
         /*
-         * For composited frames we defer wait_for_page_flip till just before
-         * the next frame, but not for bypass frames. Deferring the flip of
-         * bypass frames would increase the time we held
-         * visible_bypass_frame unacceptably, resulting in client stuttering
-         * unless we allocate more buffers (which I'm trying to avoid).
-         * Also, bypass does not need the deferred page flip because it has
-         * no compositing/rendering step for which to save time for.
-         */
-        scheduled_bypass_frame = bypass_buf;
-        wait_for_page_flip();
-
-        // It's very likely the next frame will be bypassed like this one so
-        // we only need time for kernel page flip scheduling...
-        predicted_render_time = 5ms;
-    }
-    else
-    {
-        /*
-         * Not in clone mode? We can afford to wait for the page flip then,
-         * making us double-buffered (noticeably less laggy than the triple
-         * buffering that clone mode requires).
-         */
-        if (outputs.size() == 1)
-            wait_for_page_flip();
-
-        /*
-         * TODO: If you're optimistic about your GPU performance and/or
-         *       measure it carefully you may wish to set predicted_render_time
-         *       to a lower value here for lower latency.
+         * The client buffer we bypassed last time is released with the
+         * next post after this flip replaces it, so holding it doesn't make
+         * the client stutter.
          *
-         *predicted_render_time = 9ms; // e.g. about the same as Weston
+         * It's very likely the next frame will be bypassed like this one so
+         * we only need time for kernel page flip scheduling...
          */
+        predicted_render_time = 5ms;
     }
 
-    // Buffer lifetimes are managed exclusively by scheduled*/visible* now
+    // Buffer lifetimes are managed exclusively by the outputs' flips now
     bypass_buf = nullptr;
     bypass_bufobj = nullptr;
 
@@ -691,46 +910,121 @@ std::chrono::milliseconds mgg::DisplayBuffer::recommended_sleep() const
     return recommend_sleep;
 }
 
-bool mgg::DisplayBuffer::schedule_page_flip(FBHandle const& bufobj)
+mg::Frame mgg::DisplayBuffer::last_frame() const
 {
-    /*
-     * Schedule the current front buffer object for display. Note that
-     * the page flip is asynchronous and synchronized with vertical refresh.
-     */
-    for (auto& output : outputs)
-    {
-        if (output->schedule_page_flip(bufobj))
-            page_flips_pending = true;
-    }
+    // In clone mode the outputs flip together, so any one will do
+    return outputs.front()->last_frame();
+}
 
-    return page_flips_pending;
+std::chrono::nanoseconds mgg::DisplayBuffer::frame_interval() const
+{
+    auto const refresh_rate = outputs.front()->max_refresh_rate();
+    if (refresh_rate <= 0)
+        return std::chrono::nanoseconds::zero();
+
+    return std::chrono::nanoseconds{std::chrono::seconds{1}} / refresh_rate;
+}
+
+std::chrono::nanoseconds mgg::DisplayBuffer::predicted_render_time() const
+{
+    return render_time.predicted_render_time();
 }
 
 void mgg::DisplayBuffer::wait_for_page_flip()
 {
-    if (page_flips_pending)
+    for (size_t i = 0; i != outputs.size(); ++i)
+        finish_flip(i);
+
+    release_retired_frames();
+}
+
+/* Waits for the output's flip, if it has one in flight, and retires it */
+void mgg::DisplayBuffer::finish_flip(size_t output)
+{
+    uint64_t generation;
     {
-        for (auto& output : outputs)
-            output->wait_for_page_flip();
+        std::lock_guard<std::mutex> lock{flip_state->mutex};
+        auto const& flip = flip_state->flips[output];
+        if (!flip.in_flight)
+            return;
+        generation = flip.generation;
+    }
 
-        // The previously-scheduled FB has been page-flipped, and is now visible
-        visible_fb = std::move(scheduled_fb);
-        scheduled_fb = nullptr;
+    // Won't block if the flip's completion handler has already run
+    outputs[output]->wait_for_page_flip();
+    flip_completed(*flip_state, output, generation);
+}
 
-        page_flips_pending = false;
+void mgg::DisplayBuffer::release_retired_frames()
+{
+    std::vector<std::shared_ptr<ScanoutFrame>> released;
+    {
+        std::lock_guard<std::mutex> lock{flip_state->mutex};
+        released.swap(flip_state->retired);
     }
+}
 
-    if (scheduled_bypass_frame || scheduled_composite_frame)
+/*
+ * Called from whichever thread sees the output's flip complete, or waits
+ * for it, so it only moves frames about; the last output of the group to
+ * flip runs the presented handlers.
+ */
+void mgg::DisplayBuffer::flip_completed(FlipState& state, size_t output, uint64_t generation)
+{
+    std::vector<std::function<void(Frame const&)>> presented;
+    Frame frame;
     {
-        // Why are both of these grouped into a single statement?
-        // Because in either case both types of frame need releasing each time.
+        std::lock_guard<std::mutex> lock{state.mutex};
+        if (!state.owner)
+            return;
+
+        auto& flip = state.flips[output];
+        if (!flip.in_flight || flip.generation != generation)
+            return;
 
-        visible_bypass_frame = scheduled_bypass_frame;
-        scheduled_bypass_frame = nullptr;
+        ++flip.generation;
+        flip.in_flight = false;
+        state.retired.push_back(std::move(flip.visible));
+        flip.visible = std::move(flip.scheduled);
 
-        visible_composite_frame = std::move(scheduled_composite_frame);
-        scheduled_composite_frame = nullptr;
+        auto const in_flight = [](OutputFlip const& other) { return other.in_flight; };
+        if (std::none_of(state.flips.begin(), state.flips.end(), in_flight))
+        {
+            presented.swap(state.presented_handlers);
+            frame = state.owner->last_frame();
+        }
     }
+
+    // Not under the lock, as handlers may well want to know more
+    for (auto const& handler : presented)
+        handler(frame);
+}
+
+bool mgg::DisplayBuffer::frame_pending() const
+{
+    std::lock_guard<std::mutex> lock{flip_state->mutex};
+    return std::any_of(
+        flip_state->flips.begin(), flip_state->flips.end(),
+        [](OutputFlip const& flip) { return flip.in_flight; });
+}
+
+void mgg::DisplayBuffer::on_presented(std::function<void(Frame const&)> const& handler)
+{
+    {
+        std::lock_guard<std::mutex> lock{flip_state->mutex};
+        auto const in_flight = std::any_of(
+            flip_state->flips.begin(), flip_state->flips.end(),
+            [](OutputFlip const& flip) { return flip.in_flight; });
+        if (in_flight)
+        {
+            // Whatever retires the group's last flip calls it, with the flip's timestamp
+            flip_state->presented_handlers.push_back(handler);
+            return;
+        }
+    }
+
+    // The flip's already done (or there wasn't one)
+    handler(last_frame());
 }
 
 void mgg::DisplayBuffer::make_current()
@@ -740,9 +1034,63 @@ void mgg::DisplayBuffer::make_current()
 
 void mgg::DisplayBuffer::bind()
 {
+    render_started = std::chrono::steady_clock::now();
     surface.bind();
 }
 
+auto mgg::DisplayBuffer::map_back_buffer() -> std::unique_ptr<mir::renderer::software::Mapping<unsigned char>>
+{
+    return std::make_unique<DumbBufferMapping>(*cpu_back_buffer().buffer);
+}
+
+void mgg::DisplayBuffer::commit_back_buffer()
+{
+    auto& drawn = cpu_back_buffer();
+    drawn.frame = ++cpu_frames;
+    cpu_front = &drawn;
+    cpu_back = nullptr;
+    bypass_buf = nullptr;
+    bypass_bufobj = nullptr;
+}
+
+int mgg::DisplayBuffer::back_buffer_age() const
+{
+    auto const& back = cpu_back_buffer();
+    return back.frame ? cpu_frames - back.frame + 1 : 0;
+}
+
+/* Chooses the buffer the CPU draws the next frame into, if it hasn't been already */
+auto mgg::DisplayBuffer::cpu_back_buffer() const -> CPUBuffer&
+{
+    if (cpu_back)
+        return *cpu_back;
+
+    for (auto& candidate : cpu_buffers)
+    {
+        if (!candidate.buffer)
+            candidate.buffer = std::make_unique<DumbBuffer>(outputs.front()->drm_fd(), surface.size());
+    }
+
+    std::lock_guard<std::mutex> lock{flip_state->mutex};
+    for (auto& candidate : cpu_buffers)
+    {
+        // Leave the buffers on screen, or on their way there, alone
+        auto const fb = candidate.buffer->fb();
+        auto const shows = [&fb](std::shared_ptr<ScanoutFrame> const& frame) { return frame && frame->fb == fb; };
+        auto const in_use = std::any_of(
+            flip_state->flips.begin(), flip_state->flips.end(),
+            [&shows](OutputFlip const& flip) { return shows(flip.visible) || shows(flip.scheduled); });
+        if (in_use || &candidate == cpu_front)
+            continue;
+
+        // Of the others, the most recently drawn needs the least redrawing
+        if (!cpu_back || candidate.frame > cpu_back->frame)
+            cpu_back = &candidate;
+    }
+
+    return *cpu_back;
+}
+
 void mgg::DisplayBuffer::release_current()
 {
     surface.release_current();
@@ -801,11 +1149,27 @@ void mgg::GBMOutputSurface::swap_buffers()
         fatal_error("Failed to perform buffer swap");
 }
 
+void mgg::GBMOutputSurface::swap_buffers_with_damage(geom::Rectangles const& damage)
+{
+    if (!egl.swap_buffers_with_damage(damage))
+        fatal_error("Failed to perform buffer swap");
+}
+
+int mgg::GBMOutputSurface::buffer_age() const
+{
+    return egl.buffer_age();
+}
+
 void mgg::GBMOutputSurface::bind()
 {
 
 }
 
+auto mgg::GBMOutputSurface::fence_rendering() -> RenderTimer::Fence
+{
+    return egl.fence_rendering();
+}
+
 auto mgg::GBMOutputSurface::lock_front() -> FrontBuffer
 {
     return FrontBuffer{surface.get()};
@@ -22,13 +22,19 @@
 #include "mir/graphics/display_buffer.h"
 #include "mir/graphics/display.h"
 #include "mir/renderer/gl/render_target.h"
+#include "mir/renderer/sw/render_target.h"
 #include "display_helpers.h"
 #include "egl_helper.h"
 #include "platform_common.h"
+#include "render_timer.h"
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <mutex>
+#include <experimental/optional>
 
 namespace mir
 {
@@ -43,6 +49,7 @@ namespace gbm
 
 class Platform;
 class FBHandle;
+class DumbBuffer;
 class KMSOutput;
 class NativeBuffer;
 
@@ -81,8 +88,13 @@ public:
     void make_current() override;
     void release_current() override;
     void swap_buffers() override;
+    void swap_buffers_with_damage(geometry::Rectangles const& damage) override;
+    int buffer_age() const override;
     void bind() override;
 
+    /// Fence the rendering issued so far, or nothing if rendering can't be waited for
+    auto fence_rendering() -> RenderTimer::Fence;
+
     FrontBuffer lock_front();
     void report_egl_configuration(std::function<void(EGLDisplay, EGLConfig)> const& to);
     geometry::Size size() const { return {width, height}; }
@@ -96,7 +108,8 @@ private:
 class DisplayBuffer : public graphics::DisplayBuffer,
                       public graphics::DisplaySyncGroup,
                       public graphics::NativeDisplayBuffer,
-                      public renderer::gl::RenderTarget
+                      public renderer::gl::RenderTarget,
+                      public renderer::software::RenderTarget
 {
 public:
     DisplayBuffer(BypassOption bypass_options,
@@ -111,13 +124,25 @@ public:
     void make_current() override;
     void release_current() override;
     void swap_buffers() override;
+    void swap_buffers_with_damage(geometry::Rectangles const& damage) override;
+    int buffer_age() const override;
     bool overlay(RenderableList const& renderlist) override;
+    void assign_planes(RenderableList& renderlist) override;
     void bind() override;
 
+    std::unique_ptr<renderer::software::Mapping<unsigned char>> map_back_buffer() override;
+    void commit_back_buffer() override;
+    int back_buffer_age() const override;
+
     void for_each_display_buffer(
         std::function<void(graphics::DisplayBuffer&)> const& f) override;
     void post() override;
     std::chrono::milliseconds recommended_sleep() const override;
+    Frame last_frame() const override;
+    std::chrono::nanoseconds frame_interval() const override;
+    std::chrono::nanoseconds predicted_render_time() const override;
+    bool frame_pending() const override;
+    void on_presented(std::function<void(Frame const&)> const& handler) override;
 
     glm::mat2 transformation() const override;
     NativeDisplayBuffer* native_display_buffer() override;
@@ -127,12 +152,43 @@ public:
     void wait_for_page_flip();
 
 private:
-    bool schedule_page_flip(FBHandle const& bufobj);
+    /// A buffer the CPU draws frames into, and when it last did
+    struct CPUBuffer
+    {
+        std::unique_ptr<DumbBuffer> buffer;
+        /// The (one-based) number of the CPU-drawn frame it holds, or zero
+        uint64_t frame{0};
+    };
+
+    /// What must stay alive while renderables are scanned out of overlay planes
+    struct OverlayFrame
+    {
+        std::vector<std::shared_ptr<graphics::Buffer>> buffers;
+        std::vector<std::shared_ptr<FBHandle const>> fbs;
+    };
+
+    /// Everything a posted frame needs kept alive while an output scans it out
+    struct ScanoutFrame
+    {
+        std::shared_ptr<FBHandle const> fb;
+        GBMOutputSurface::FrontBuffer composite;
+        std::shared_ptr<graphics::Buffer> bypass;
+        OverlayFrame overlays;
+    };
+
+    struct FlipState;
+
+    CPUBuffer& cpu_back_buffer() const;
     void set_crtc(FBHandle const&);
+    void clear_overlays();
+    void finish_flip(size_t output);
+    void release_retired_frames();
+    static void flip_completed(FlipState& state, size_t output, uint64_t generation);
 
-    std::shared_ptr<graphics::Buffer> visible_bypass_frame, scheduled_bypass_frame;
     std::shared_ptr<Buffer> bypass_buf{nullptr};
     std::shared_ptr<FBHandle const> bypass_bufobj{nullptr};
+    OverlayFrame pending_overlays;
+    bool planes_assigned{false};
     std::shared_ptr<DisplayReport> const listener;
     BypassOption bypass_option;
 
@@ -147,17 +203,52 @@ private:
     std::function<GBMOutputSurface::FrontBuffer(GBMOutputSurface::FrontBuffer&&)> get_front_buffer;
     GBMOutputSurface surface;
 
-    GBMOutputSurface::FrontBuffer visible_composite_frame;
-    GBMOutputSurface::FrontBuffer scheduled_composite_frame;
-
-    std::shared_ptr<FBHandle const> scheduled_fb{nullptr};
-    std::shared_ptr<FBHandle const> visible_fb{nullptr};
+    /*
+     * Frames drawn by the CPU (through software::RenderTarget) are posted
+     * from these rather than the GBM surface. They're made the first time
+     * they're asked for, and there are three so one can be drawn while
+     * another is scanned out and a third waits to be flipped to.
+     */
+    std::array<CPUBuffer, 3> mutable cpu_buffers;
+    CPUBuffer mutable* cpu_back{nullptr};
+    CPUBuffer* cpu_front{nullptr};
+    uint64_t cpu_frames{0};
 
     geometry::Rectangle area;
     glm::mat2 transform;
     std::atomic<bool> needs_set_crtc;
     std::chrono::milliseconds recommend_sleep{0};
-    bool page_flips_pending;
+    std::experimental::optional<std::chrono::steady_clock::time_point> render_started;
+    RenderTimer::Fence rendered;
+    /// Waits on our fences, so must go before the surface's EGL display does
+    RenderTimer render_time;
+
+    /// Each output of a clone group flips in its own time
+    struct OutputFlip
+    {
+        bool in_flight{false};
+        /// Bumped as each flip is retired, so its handler knows when it's too late
+        uint64_t generation{0};
+        std::shared_ptr<ScanoutFrame> scheduled, visible;
+    };
+
+    /*
+     * Page flips complete on whichever thread sees their event, possibly
+     * after we've gone, so the handlers find us through this. Everything in
+     * it is guarded by its mutex. The frames a flip takes off screen are
+     * only set aside here, as the gbm_surface and client buffers they hold
+     * must be released on the thread that posts.
+     */
+    struct FlipState
+    {
+        std::mutex mutex;
+        DisplayBuffer* owner{nullptr};
+        std::vector<OutputFlip> flips;
+        std::vector<std::shared_ptr<ScanoutFrame>> retired;
+        /// Waiting for the frame in flight to be presented on every output
+        std::vector<std::function<void(Frame const&)>> presented_handlers;
+    };
+    std::shared_ptr<FlipState> const flip_state;
 };
 
 }
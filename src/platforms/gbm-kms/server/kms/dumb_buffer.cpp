@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dumb_buffer.h"
+#include "kms_framebuffer.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <system_error>
+
+#include <drm.h>
+#include <drm_mode.h>
+#include <sys/mman.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+namespace mgg = mir::graphics::gbm;
+namespace geom = mir::geometry;
+
+mgg::DumbBuffer::DumbBuffer(int drm_fd, geom::Size const& size)
+    : drm_fd{drm_fd},
+      size_{size}
+{
+    drm_mode_create_dumb params{};
+    params.bpp = 32;
+    params.width = size.width.as_uint32_t();
+    params.height = size.height.as_uint32_t();
+
+    if (drmIoctl(drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &params) != 0)
+    {
+        BOOST_THROW_EXCEPTION((
+            std::system_error{errno, std::system_category(), "Failed to create dumb buffer"}));
+    }
+    gem_handle = params.handle;
+    pitch = params.pitch;
+    len_ = params.size;
+
+    uint32_t fb_id;
+    if (auto const err = drmModeAddFB(drm_fd, params.width, params.height, 24, 32, pitch, gem_handle, &fb_id))
+    {
+        destroy_buffer();
+        BOOST_THROW_EXCEPTION((
+            std::system_error{-err, std::system_category(), "Failed to attach dumb buffer to FB"}));
+    }
+
+    // The framebuffer holds its own reference to the buffer, so can outlive us
+    fb_ = std::make_shared<FBHandle>(drm_fd, fb_id);
+}
+
+mgg::DumbBuffer::~DumbBuffer()
+{
+    if (mapping)
+        munmap(mapping, len_);
+    destroy_buffer();
+}
+
+auto mgg::DumbBuffer::fb() const -> std::shared_ptr<FBHandle const>
+{
+    return fb_;
+}
+
+auto mgg::DumbBuffer::size() const -> geom::Size
+{
+    return size_;
+}
+
+auto mgg::DumbBuffer::stride() const -> geom::Stride
+{
+    return geom::Stride{pitch};
+}
+
+auto mgg::DumbBuffer::pixels() -> unsigned char*
+{
+    if (!mapping)
+    {
+        drm_mode_map_dumb params{};
+        params.handle = gem_handle;
+        if (drmIoctl(drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &params) != 0)
+        {
+            BOOST_THROW_EXCEPTION((
+                std::system_error{errno, std::system_category(), "Failed to prepare dumb buffer for mapping"}));
+        }
+
+        auto const mapped = mmap(nullptr, len_, PROT_READ | PROT_WRITE, MAP_SHARED, drm_fd, params.offset);
+        if (mapped == MAP_FAILED)
+        {
+            BOOST_THROW_EXCEPTION((
+                std::system_error{errno, std::system_category(), "Failed to map dumb buffer"}));
+        }
+        mapping = mapped;
+    }
+
+    return static_cast<unsigned char*>(mapping);
+}
+
+auto mgg::DumbBuffer::len() const -> std::size_t
+{
+    return len_;
+}
+
+void mgg::DumbBuffer::destroy_buffer()
+{
+    drm_mode_destroy_dumb params{};
+    params.handle = gem_handle;
+    drmIoctl(drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &params);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_GBM_DUMB_BUFFER_H_
+#define MIR_GRAPHICS_GBM_DUMB_BUFFER_H_
+
+#include "mir/geometry/size.h"
+#include "mir/geometry/dimensions.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace mir
+{
+namespace graphics
+{
+namespace gbm
+{
+class FBHandle;
+
+/**
+ * A linear XRGB8888 framebuffer in memory the CPU can map, which every KMS
+ * driver can scan out without a GPU's help.
+ */
+class DumbBuffer
+{
+public:
+    DumbBuffer(int drm_fd, geometry::Size const& size);
+    ~DumbBuffer();
+
+    DumbBuffer(DumbBuffer const&) = delete;
+    DumbBuffer& operator=(DumbBuffer const&) = delete;
+
+    /// The framebuffer to scan the buffer out of
+    auto fb() const -> std::shared_ptr<FBHandle const>;
+
+    auto size() const -> geometry::Size;
+    auto stride() const -> geometry::Stride;
+
+    /// The buffer's pixels, mapped into our address space when first asked for
+    auto pixels() -> unsigned char*;
+    auto len() const -> std::size_t;
+
+private:
+    void destroy_buffer();
+
+    int const drm_fd;
+    geometry::Size const size_;
+    uint32_t gem_handle;
+    uint32_t pitch;
+    uint64_t len_;
+    std::shared_ptr<FBHandle const> fb_;
+    void* mapping{nullptr};
+};
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_GBM_DUMB_BUFFER_H_ */
@@ -21,6 +21,9 @@
 #include "mir/graphics/egl_error.h"
 #include <boost/exception/errinfo_errno.hpp>
 #include <boost/throw_exception.hpp>
+#include <memory>
+#include <string>
+#include <vector>
 
 #define MIR_LOG_COMPONENT "EGL"
 #include "mir/log.h"
@@ -34,7 +37,12 @@ mgmh::EGLHelper::EGLHelper(GLConfig const& gl_config)
       stencil_buffer_bits{gl_config.stencil_buffer_bits()},
       egl_display{EGL_NO_DISPLAY}, egl_config{0},
       egl_context{EGL_NO_CONTEXT}, egl_surface{EGL_NO_SURFACE},
-      should_terminate_egl{false}
+      should_terminate_egl{false},
+      swap_buffers_with_damage_fn{nullptr},
+      has_buffer_age{false},
+      create_sync_fn{nullptr},
+      client_wait_sync_fn{nullptr},
+      destroy_sync_fn{nullptr}
 {
 }
 
@@ -55,7 +63,12 @@ mgmh::EGLHelper::EGLHelper(EGLHelper&& from)
       egl_config{from.egl_config},
       egl_context{from.egl_context},
       egl_surface{from.egl_surface},
-      should_terminate_egl{from.should_terminate_egl}
+      should_terminate_egl{from.should_terminate_egl},
+      swap_buffers_with_damage_fn{from.swap_buffers_with_damage_fn},
+      has_buffer_age{from.has_buffer_age},
+      create_sync_fn{from.create_sync_fn},
+      client_wait_sync_fn{from.client_wait_sync_fn},
+      destroy_sync_fn{from.destroy_sync_fn}
 {
     from.should_terminate_egl = false;
     from.egl_display = EGL_NO_DISPLAY;
@@ -121,6 +134,31 @@ void mgmh::EGLHelper::setup(
     if(egl_surface == EGL_NO_SURFACE)
         BOOST_THROW_EXCEPTION(mg::egl_error("Failed to create EGL window surface"));
 
+    auto const maybe_extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    std::string const extensions{maybe_extensions ? maybe_extensions : ""};
+    has_buffer_age = extensions.find("EGL_EXT_buffer_age") != std::string::npos;
+
+    if (extensions.find("EGL_KHR_swap_buffers_with_damage") != std::string::npos)
+    {
+        swap_buffers_with_damage_fn = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+            eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    }
+    else if (extensions.find("EGL_EXT_swap_buffers_with_damage") != std::string::npos)
+    {
+        swap_buffers_with_damage_fn = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+            eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+    }
+
+    if (extensions.find("EGL_KHR_fence_sync") != std::string::npos)
+    {
+        create_sync_fn = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+            eglGetProcAddress("eglCreateSyncKHR"));
+        client_wait_sync_fn = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(
+            eglGetProcAddress("eglClientWaitSyncKHR"));
+        destroy_sync_fn = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+            eglGetProcAddress("eglDestroySyncKHR"));
+    }
+
     egl_context = eglCreateContext(egl_display, egl_config, shared_context, context_attr);
     if (egl_context == EGL_NO_CONTEXT)
         BOOST_THROW_EXCEPTION(mg::egl_error("Failed to create EGL context"));
@@ -149,6 +187,65 @@ bool mgmh::EGLHelper::swap_buffers()
     return (ret == EGL_TRUE);
 }
 
+bool mgmh::EGLHelper::swap_buffers_with_damage(geometry::Rectangles const& damage)
+{
+    EGLint height{0};
+    if (!swap_buffers_with_damage_fn ||
+        eglQuerySurface(egl_display, egl_surface, EGL_HEIGHT, &height) != EGL_TRUE)
+    {
+        return swap_buffers();
+    }
+
+    // EGL wants the rectangles as {x, y, width, height} with a bottom-left origin
+    std::vector<EGLint> rects;
+    rects.reserve(4 * damage.size());
+    for (auto const& rect : damage)
+    {
+        rects.push_back(rect.top_left.x.as_int());
+        rects.push_back(height - rect.top_left.y.as_int() - rect.size.height.as_int());
+        rects.push_back(rect.size.width.as_int());
+        rects.push_back(rect.size.height.as_int());
+    }
+
+    auto ret = swap_buffers_with_damage_fn(
+        egl_display, egl_surface, rects.data(), static_cast<EGLint>(damage.size()));
+    return (ret == EGL_TRUE);
+}
+
+int mgmh::EGLHelper::buffer_age() const
+{
+    EGLint age{0};
+    if (!has_buffer_age ||
+        eglQuerySurface(egl_display, egl_surface, EGL_BUFFER_AGE_EXT, &age) != EGL_TRUE)
+    {
+        return 0;
+    }
+    return age;
+}
+
+auto mgmh::EGLHelper::fence_rendering() const -> std::function<bool(std::chrono::nanoseconds)>
+{
+    if (!create_sync_fn || !client_wait_sync_fn || !destroy_sync_fn)
+        return {};
+
+    auto const fence = create_sync_fn(egl_display, EGL_SYNC_FENCE_KHR, nullptr);
+    if (fence == EGL_NO_SYNC_KHR)
+        return {};
+
+    std::shared_ptr<void> const sync{
+        fence,
+        [display = egl_display, destroy_sync = destroy_sync_fn](EGLSyncKHR signalled)
+        {
+            destroy_sync(display, signalled);
+        }};
+
+    // Flushing is left to the swap: EGL_SYNC_FLUSH_COMMANDS_BIT_KHR only works in our context's thread
+    return [sync, display = egl_display, client_wait_sync = client_wait_sync_fn](std::chrono::nanoseconds timeout)
+        {
+            return client_wait_sync(display, sync.get(), 0, timeout.count()) == EGL_CONDITION_SATISFIED_KHR;
+        };
+}
+
 bool mgmh::EGLHelper::make_current() const
 {
     auto ret = eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context);
@@ -21,8 +21,12 @@
 
 #include "display_helpers.h"
 #include "mir/graphics/egl_extensions.h"
+#include "mir/geometry/rectangles.h"
 #include <EGL/egl.h>
 
+#include <chrono>
+#include <functional>
+
 namespace mir
 {
 namespace graphics
@@ -52,6 +56,23 @@ public:
     void setup(GBMHelper const& gbm, gbm_surface* surface_gbm, EGLContext shared_context, bool owns_egl);
 
     bool swap_buffers();
+    /**
+     * Swap buffers, telling EGL that only \a damage (relative to the top-left
+     * of the surface) changed. Falls back to swap_buffers() without
+     * EGL_KHR_swap_buffers_with_damage or EGL_EXT_swap_buffers_with_damage.
+     */
+    bool swap_buffers_with_damage(geometry::Rectangles const& damage);
+    /// The EGL_EXT_buffer_age of the current back buffer, or 0 if unknown
+    int buffer_age() const;
+    /**
+     * Fence the rendering commands issued so far. The result waits up to a
+     * timeout for them to finish, on any thread, and returns whether they
+     * have. It is empty without EGL_KHR_fence_sync.
+     *
+     * \note The fence is only certain to signal once the commands are flushed,
+     *       as swapping buffers does.
+     */
+    auto fence_rendering() const -> std::function<bool(std::chrono::nanoseconds)>;
     bool make_current() const;
     bool release_current() const;
 
@@ -68,6 +89,11 @@ private:
     EGLContext egl_context;
     EGLSurface egl_surface;
     bool should_terminate_egl;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swap_buffers_with_damage_fn;
+    bool has_buffer_age;
+    PFNEGLCREATESYNCKHRPROC create_sync_fn;
+    PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync_fn;
+    PFNEGLDESTROYSYNCKHRPROC destroy_sync_fn;
     EGLExtensions::PlatformBaseEXT platform_base;
 };
 }
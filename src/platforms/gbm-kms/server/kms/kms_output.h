@@ -22,6 +22,7 @@
 #include "mir/geometry/size.h"
 #include "mir/geometry/point.h"
 #include "mir/geometry/displacement.h"
+#include "mir/geometry/rectangle.h"
 #include "mir/graphics/display_configuration.h"
 #include "mir/graphics/frame.h"
 #include "mir/graphics/dmabuf_buffer.h"
@@ -31,6 +32,10 @@
 
 #include <gbm.h>
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 namespace mir
 {
 namespace graphics
@@ -42,6 +47,15 @@ namespace gbm
 
 class FBHandle;
 
+/// A framebuffer to scan out on a plane of its own, above the composited image
+struct OverlayLayer
+{
+    std::shared_ptr<FBHandle const> fb;
+    geometry::Size buffer_size;
+    /// Where the whole buffer goes, relative to the output's top left
+    geometry::Rectangle destination;
+};
+
 class KMSOutput
 {
 public:
@@ -69,6 +83,23 @@ public:
     virtual void clear_crtc() = 0;
     virtual bool schedule_page_flip(FBHandle const& fb) = 0;
     virtual void wait_for_page_flip() = 0;
+    /**
+     * Have \a handler called once the scheduled page flip completes, from
+     * whichever thread sees it complete. If no flip is pending it is called
+     * straight away. Once the handler has run the next flip can be
+     * scheduled; until then, wait_for_page_flip() must be called first.
+     */
+    virtual void on_page_flip_complete(std::function<void()> const& handler) = 0;
+
+    /**
+     * Scan out layers on planes above the primary plane from the next page flip on.
+     *
+     * \param [in] layers  The layers, bottom first. An empty list removes any
+     *                      previously set.
+     * \returns     true if the hardware can show the layers; if not, nothing
+     *              changes and they need to be composited instead.
+     */
+    virtual bool set_overlays(std::vector<OverlayLayer> const& layers) = 0;
 
     virtual bool set_cursor(gbm_bo* buffer) = 0;
     virtual void move_cursor(geometry::Point destination) = 0;
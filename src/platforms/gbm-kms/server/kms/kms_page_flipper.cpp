@@ -18,8 +18,11 @@
 
 #include "kms_page_flipper.h"
 #include "mir/graphics/display_report.h"
+#include "mir/thread_name.h"
+#include "mir/log.h"
 
 #include <stdexcept>
+#include <system_error>
 #include <boost/throw_exception.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 
@@ -27,6 +30,8 @@
 #include <xf86drmMode.h>
 #include <chrono>
 #include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 namespace mg = mir::graphics;
 namespace mgg = mir::graphics::gbm;
@@ -52,18 +57,70 @@ mgg::KMSPageFlipper::KMSPageFlipper(
     drm_fd{drm_fd},
     report{report},
     pending_page_flips(),
-    worker_tid()
+    worker_tid(),
+    wakeup{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
 {
     uint64_t mono = 0;
     if (drmGetCap(drm_fd, DRM_CAP_TIMESTAMP_MONOTONIC, &mono) || !mono)
         clock_id = CLOCK_REALTIME;
     else
         clock_id = CLOCK_MONOTONIC;
+
+    if (wakeup < 0)
+    {
+        BOOST_THROW_EXCEPTION((
+            std::system_error{errno, std::system_category(), "Failed to create page-flip event thread wakeup"}));
+    }
+
+    event_thread = std::thread{[this]() { event_loop(); }};
+}
+
+mgg::KMSPageFlipper::~KMSPageFlipper()
+{
+    {
+        std::lock_guard<std::mutex> lock{pf_mutex};
+        shutdown = true;
+    }
+    pf_cv.notify_all();
+    eventfd_write(wakeup, 1);
+
+    event_thread.join();
 }
 
 bool mgg::KMSPageFlipper::schedule_flip(uint32_t crtc_id,
                                         uint32_t fb_id,
                                         uint32_t connector_id)
+{
+    /*
+     * It appears we can't tell the difference between flipping being
+     * unsupported or failing for other reasons. On VirtualBox this always
+     * fails with -22 (Invalid argument) despite the arguments being
+     * apparently valid.
+     */
+    return schedule_flip(
+        crtc_id,
+        connector_id,
+        [this, crtc_id, fb_id](void* event_data)
+        {
+            return drmModePageFlip(drm_fd, crtc_id, fb_id,
+                                   DRM_MODE_PAGE_FLIP_EVENT,
+                                   event_data);
+        });
+}
+
+bool mgg::KMSPageFlipper::schedule_flip(
+    uint32_t crtc_id,
+    uint32_t connector_id,
+    std::function<int(void* event_data)> const& commit)
+{
+    return schedule_flip(crtc_id, connector_id, commit, {});
+}
+
+bool mgg::KMSPageFlipper::schedule_flip(
+    uint32_t crtc_id,
+    uint32_t connector_id,
+    std::function<int(void* event_data)> const& commit,
+    std::function<void(Frame const&)> const& handler)
 {
     std::unique_lock<std::mutex> lock{pf_mutex};
 
@@ -72,18 +129,18 @@ bool mgg::KMSPageFlipper::schedule_flip(uint32_t crtc_id,
 
     pending_page_flips[crtc_id] = PageFlipEventData{crtc_id, connector_id, this};
 
-    /*
-     * It appears we can't tell the difference between flipping being
-     * unsupported or failing for other reasons. On VirtualBox this always
-     * fails with -22 (Invalid argument) despite the arguments being
-     * apparently valid.
-     */
-    auto ret = drmModePageFlip(drm_fd, crtc_id, fb_id,
-                               DRM_MODE_PAGE_FLIP_EVENT,
-                               &pending_page_flips[crtc_id]);
+    auto ret = commit(&pending_page_flips[crtc_id]);
 
     if (ret)
+    {
         pending_page_flips.erase(crtc_id);
+    }
+    else if (handler)
+    {
+        // Its event can't be handled before we release pf_mutex
+        completion_handlers[crtc_id] = handler;
+        pf_cv.notify_all();
+    }
 
     return (ret == 0);
 }
@@ -102,9 +159,10 @@ mg::Frame mgg::KMSPageFlipper::wait_for_flip(uint32_t crtc_id)
 
         /*
          * While another thread is the worker (it is controlling the
-         * page flip event loop) and our event has not arrived, wait.
+         * page flip event loop), or the event thread is reading events
+         * on someone's behalf, and our event has not arrived, wait.
          */
-        while (worker_tid != invalid_tid && !page_flip_is_done(crtc_id))
+        while ((worker_tid != invalid_tid || event_thread_reading) && !page_flip_is_done(crtc_id))
             pf_cv.wait(lock);
 
         /* If the page flip we are waiting for has arrived we are done. */
@@ -152,6 +210,8 @@ mg::Frame mgg::KMSPageFlipper::wait_for_flip(uint32_t crtc_id)
                 worker_tid = invalid_tid;
         }
 
+        run_completion_handlers();
+
         /*
          * Wake up other (non-worker) threads, so they can check whether
          * their page-flip events have arrived, or whether they can become
@@ -162,6 +222,105 @@ mg::Frame mgg::KMSPageFlipper::wait_for_flip(uint32_t crtc_id)
     return completed_page_flips[crtc_id];
 }
 
+void mgg::KMSPageFlipper::on_flip_complete(
+    uint32_t crtc_id,
+    std::function<void(Frame const&)> const& handler)
+{
+    Frame completed;
+    {
+        std::unique_lock<std::mutex> lock{pf_mutex};
+
+        if (!page_flip_is_done(crtc_id))
+        {
+            completion_handlers[crtc_id] = handler;
+            pf_cv.notify_all();
+            return;
+        }
+
+        completed = completed_page_flips[crtc_id];
+    }
+
+    handler(completed);
+}
+
+void mgg::KMSPageFlipper::event_loop() noexcept
+{
+    mir::set_thread_name("Mir/DRM flips");
+
+    drmEventContext evctx;
+    memset(&evctx, 0, sizeof evctx);
+    evctx.version = 2;
+    evctx.page_flip_handler = &page_flip_handler;
+
+    static std::thread::id const invalid_tid;
+
+    std::unique_lock<std::mutex> lock{pf_mutex};
+    while (!shutdown)
+    {
+        // Someone blocked in wait_for_flip() is already reading events
+        pf_cv.wait(
+            lock,
+            [this]()
+            {
+                return shutdown || (!completion_handlers.empty() && worker_tid == invalid_tid);
+            });
+        if (shutdown)
+            break;
+
+        event_thread_reading = true;
+        lock.unlock();
+
+        pollfd fds[2];
+        fds[0].fd = drm_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakeup;
+        fds[1].events = POLLIN;
+        auto const ret = poll(fds, 2, -1);
+        auto const error = errno;
+
+        lock.lock();
+        if ((ret < 0 && error != EINTR) || (ret > 0 && (fds[0].revents & (POLLERR | POLLNVAL))))
+        {
+            /*
+             * The flips themselves may well still complete; whoever next
+             * calls wait_for_flip() will find out, so just stop listening.
+             */
+            mir::log_warning("Failed to read page-flip events from DRM fd %i", drm_fd);
+            completion_handlers.clear();
+        }
+        else if (ret > 0 && (fds[0].revents & POLLIN))
+        {
+            drmHandleEvent(drm_fd, &evctx);
+        }
+
+        if (ret > 0 && (fds[1].revents & POLLIN))
+        {
+            eventfd_t ignored;
+            eventfd_read(wakeup, &ignored);
+        }
+
+        event_thread_reading = false;
+        lock.unlock();
+
+        run_completion_handlers();
+        pf_cv.notify_all();
+
+        lock.lock();
+    }
+}
+
+void mgg::KMSPageFlipper::run_completion_handlers()
+{
+    decltype(completed_handlers) handlers;
+    {
+        std::lock_guard<std::mutex> lock{pf_mutex};
+        handlers.swap(completed_handlers);
+    }
+
+    for (auto const& handler : handlers)
+        handler.first(handler.second);
+}
+
 std::thread::id mgg::KMSPageFlipper::debug_get_worker_tid()
 {
     std::unique_lock<std::mutex> lock{pf_mutex};
@@ -186,5 +345,13 @@ void mgg::KMSPageFlipper::notify_page_flip(uint32_t crtc_id, int64_t msc,
         frame.ust = {clock_id, ust};
         report->report_vsync(pending->second.connector_id, frame);
         pending_page_flips.erase(pending);
+
+        auto const handler = completion_handlers.find(crtc_id);
+        if (handler != completion_handlers.end())
+        {
+            // Run once pf_mutex is released, so the handler may use us
+            completed_handlers.emplace_back(std::move(handler->second), frame);
+            completion_handlers.erase(handler);
+        }
     }
 }
@@ -20,8 +20,10 @@
 #define MIR_GRAPHICS_GBM_KMS_PAGE_FLIPPER_H_
 
 #include "page_flipper.h"
+#include "mir/fd.h"
 
 #include <unordered_map>
+#include <vector>
 #include <chrono>
 #include <mutex>
 #include <condition_variable>
@@ -51,15 +53,28 @@ class KMSPageFlipper : public PageFlipper
 {
 public:
     KMSPageFlipper(int drm_fd, std::shared_ptr<DisplayReport> const& report);
+    ~KMSPageFlipper();
 
     bool schedule_flip(uint32_t crtc_id, uint32_t fb_id, uint32_t connector_id) override;
+    bool schedule_flip(
+        uint32_t crtc_id,
+        uint32_t connector_id,
+        std::function<int(void* event_data)> const& commit) override;
+    bool schedule_flip(
+        uint32_t crtc_id,
+        uint32_t connector_id,
+        std::function<int(void* event_data)> const& commit,
+        std::function<void(Frame const&)> const& handler) override;
     Frame wait_for_flip(uint32_t crtc_id) override;
+    void on_flip_complete(uint32_t crtc_id, std::function<void(Frame const&)> const& handler) override;
 
     std::thread::id debug_get_worker_tid();
 
     void notify_page_flip(uint32_t crtc_id, int64_t msc, std::chrono::nanoseconds ust);
 private:
     bool page_flip_is_done(uint32_t crtc_id);
+    void event_loop() noexcept;
+    void run_completion_handlers();
 
     int const drm_fd;
     std::shared_ptr<DisplayReport> const report;
@@ -69,6 +84,18 @@ private:
     std::condition_variable pf_cv;
     std::thread::id worker_tid;
     clockid_t clock_id;
+
+    /*
+     * Flips with a completion handler are seen through by event_thread, so
+     * that nobody has to block in wait_for_flip(). It only reads the DRM fd
+     * while there is no wait_for_flip() worker, so events go to one reader.
+     */
+    std::unordered_map<uint32_t, std::function<void(Frame const&)>> completion_handlers;
+    std::vector<std::pair<std::function<void(Frame const&)>, Frame>> completed_handlers;
+    bool event_thread_reading{false};
+    bool shutdown{false};
+    mir::Fd const wakeup;
+    std::thread event_thread;
 };
 
 }
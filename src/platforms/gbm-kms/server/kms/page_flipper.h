@@ -21,6 +21,7 @@
 
 #include "mir/graphics/frame.h"
 #include <cstdint>
+#include <functional>
 
 namespace mir
 {
@@ -35,7 +36,38 @@ public:
     virtual ~PageFlipper() {}
 
     virtual bool schedule_flip(uint32_t crtc_id, uint32_t fb_id, uint32_t connector_id) = 0;
+    /**
+     * Schedule a flip that is submitted by \a commit rather than a legacy page flip.
+     *
+     * \param [in] commit  Submits the flip, requesting a page-flip event that
+     *                      carries the supplied user data. Returns 0 on success
+     *                      or a negative errno, like the libdrm calls.
+     */
+    virtual bool schedule_flip(
+        uint32_t crtc_id,
+        uint32_t connector_id,
+        std::function<int(void* event_data)> const& commit) = 0;
+    /**
+     * Schedule a flip submitted by \a commit, as above, and have \a handler
+     * called once it completes, as on_flip_complete() would. The handler is
+     * registered along with the flip, so it is never called from here and
+     * can't be mistaken for the handler of a later flip.
+     */
+    virtual bool schedule_flip(
+        uint32_t crtc_id,
+        uint32_t connector_id,
+        std::function<int(void* event_data)> const& commit,
+        std::function<void(Frame const&)> const& handler) = 0;
     virtual Frame wait_for_flip(uint32_t crtc_id) = 0;
+    /**
+     * Have \a handler called once the flip scheduled on \a crtc_id completes,
+     * without anyone having to wait for it.
+     *
+     * The handler is called from whichever thread handles the flip event, or
+     * straight away if no flip is pending. It replaces any handler already
+     * registered for the CRTC.
+     */
+    virtual void on_flip_complete(uint32_t crtc_id, std::function<void(Frame const&)> const& handler) = 0;
 
 protected:
     PageFlipper() = default;
@@ -17,6 +17,7 @@
  */
 
 #include "real_kms_output.h"
+#include "kms_framebuffer.h"
 #include "mir/graphics/display_configuration.h"
 #include "page_flipper.h"
 #include "kms-utils/kms_connector.h"
@@ -34,31 +35,6 @@ namespace mgg = mg::gbm;
 namespace mgk = mg::kms;
 namespace geom = mir::geometry;
 
-class mgg::FBHandle
-{
-public:
-    FBHandle(int drm_fd, uint32_t fb_id)
-        : drm_fd{drm_fd},
-          fb_id{fb_id}
-    {
-    }
-
-    ~FBHandle()
-    {
-        // TODO: Some sort of logging on failure?
-        drmModeRmFB(drm_fd, fb_id);
-    }
-
-    auto get_drm_fb_id() const -> uint32_t
-    {
-        return fb_id;
-    }
-private:
-    int const drm_fd;
-    uint32_t const fb_id;
-};
-
-
 mgg::RealKMSOutput::RealKMSOutput(
     int drm_fd,
     kms::DRMModeConnectorUPtr&& connector,
@@ -68,10 +44,11 @@ mgg::RealKMSOutput::RealKMSOutput(
       connector{std::move(connector)},
       mode_index{0},
       current_crtc(),
-      saved_crtc(),
       using_saved_crtc{true},
-      has_cursor_{false},
-      power_mode(mir_power_mode_on)
+      power_mode(mir_power_mode_on),
+      flip_target{std::make_shared<FlipTarget>(this)},
+      saved_crtc(),
+      has_cursor_{false}
 {
     reset();
 
@@ -89,9 +66,17 @@ mgg::RealKMSOutput::RealKMSOutput(
 
 mgg::RealKMSOutput::~RealKMSOutput()
 {
+    detach_from_pending_flips();
     restore_saved_crtc();
 }
 
+void mgg::RealKMSOutput::detach_from_pending_flips()
+{
+    // Once we hold the lock no handler is running, and none will touch us after
+    std::lock_guard<std::mutex> lock{flip_target->mutex};
+    flip_target->owner = nullptr;
+}
+
 uint32_t mgg::RealKMSOutput::id() const
 {
     return connector->connector_id;
@@ -250,6 +235,37 @@ void mgg::RealKMSOutput::wait_for_page_flip()
     last_frame_.store(page_flipper->wait_for_flip(current_crtc->crtc_id));
 }
 
+void mgg::RealKMSOutput::on_page_flip_complete(std::function<void()> const& handler)
+{
+    std::unique_lock<std::mutex> lg(power_mutex);
+    if (power_mode != mir_power_mode_on || !current_crtc)
+    {
+        // Nothing was flipped, so there's nothing to wait for
+        lg.unlock();
+        handler();
+        return;
+    }
+
+    page_flipper->on_flip_complete(
+        current_crtc->crtc_id,
+        [target = flip_target, handler](Frame const& frame)
+        {
+            std::lock_guard<std::mutex> lock{target->mutex};
+            if (!target->owner)
+                return;
+
+            target->owner->last_frame_.store(frame);
+            target->owner->flip_completed();
+            handler();
+        });
+}
+
+bool mgg::RealKMSOutput::set_overlays(std::vector<OverlayLayer> const& layers)
+{
+    // The legacy API only gives us the primary and cursor planes
+    return layers.empty();
+}
+
 mg::Frame mgg::RealKMSOutput::last_frame() const
 {
     return last_frame_.load();
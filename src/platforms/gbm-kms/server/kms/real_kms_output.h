@@ -55,6 +55,8 @@ public:
     void clear_crtc() override;
     bool schedule_page_flip(FBHandle const& fb) override;
     void wait_for_page_flip() override;
+    void on_page_flip_complete(std::function<void()> const& handler) override;
+    bool set_overlays(std::vector<OverlayLayer> const& layers) override;
 
     bool set_cursor(gbm_bo* buffer) override;
     void move_cursor(geometry::Point destination) override;
@@ -75,13 +77,49 @@ public:
     bool buffer_requires_migration(gbm_bo* bo) const override;
     int drm_fd() const override;
 
-private:
+protected:
     bool ensure_crtc();
-    void restore_saved_crtc();
+
+    /// Called, on whichever thread sees it, when a flip waited for by on_page_flip_complete() completes
+    virtual void flip_completed() {}
+
+    /**
+     * Stop the handlers of flips still in flight from touching this output.
+     * A derived class's destructor must call this before tearing down
+     * anything its flip_completed() uses.
+     */
+    void detach_from_pending_flips();
 
     int const drm_fd_;
     std::shared_ptr<PageFlipper> const page_flipper;
 
+    kms::DRMModeConnectorUPtr connector;
+    size_t mode_index;
+    geometry::Displacement fb_offset;
+    kms::DRMModeCrtcUPtr current_crtc;
+    bool using_saved_crtc;
+
+    MirPowerMode power_mode;
+    std::mutex power_mutex;
+
+    AtomicFrame last_frame_;
+
+    /*
+     * Flips complete on the DRM event thread, possibly after we've gone, so
+     * their handlers find us through this and only act while owner is set.
+     */
+    struct FlipTarget
+    {
+        explicit FlipTarget(RealKMSOutput* owner) : owner{owner} {}
+
+        std::mutex mutex;
+        RealKMSOutput* owner;
+    };
+    std::shared_ptr<FlipTarget> const flip_target;
+
+private:
+    void restore_saved_crtc();
+
     /* TODO: This should really be owned by a DRM-device-level object,
      * not per-output. We don't have one of those at the moment, so here'll do.
      */
@@ -97,20 +135,9 @@ private:
     };
     FBRegistry mutable framebuffers;
 
-    kms::DRMModeConnectorUPtr connector;
-    size_t mode_index;
-    geometry::Displacement fb_offset;
-    kms::DRMModeCrtcUPtr current_crtc;
     drmModeCrtc saved_crtc;
-    bool using_saved_crtc;
     bool has_cursor_;
-
-    MirPowerMode power_mode;
     int dpms_enum_id;
-
-    std::mutex power_mutex;
-
-    AtomicFrame last_frame_;
 };
 
 }
@@ -18,11 +18,26 @@
 
 #include <algorithm>
 #include "real_kms_output_container.h"
-#include "real_kms_output.h"
+#include "atomic_kms_output.h"
 #include "kms-utils/drm_mode_resources.h"
 
+#include <xf86drm.h>
+
 namespace mgg = mir::graphics::gbm;
 
+namespace
+{
+/*
+ * Atomic modesetting needs the universal planes cap too, and a driver that
+ * refuses either gets the legacy API
+ */
+bool enable_atomic_modesetting(int drm_fd)
+{
+    return drmSetClientCap(drm_fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) == 0 &&
+           drmSetClientCap(drm_fd, DRM_CLIENT_CAP_ATOMIC, 1) == 0;
+}
+}
+
 mgg::RealKMSOutputContainer::RealKMSOutputContainer(
     std::vector<int> const& drm_fds,
     std::function<std::shared_ptr<PageFlipper>(int)> const& construct_page_flipper)
@@ -80,6 +95,13 @@ void mgg::RealKMSOutputContainer::update_from_hardware_state()
                 new_outputs.push_back(*existing_output);
                 new_outputs.back()->refresh_hardware_state();
             }
+            else if (enable_atomic_modesetting(drm_fd))
+            {
+                new_outputs.push_back(std::make_shared<AtomicKMSOutput>(
+                    drm_fd,
+                    std::move(connector),
+                    construct_page_flipper(drm_fd)));
+            }
             else
             {
                 new_outputs.push_back(std::make_shared<RealKMSOutput>(
@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "render_time_estimator.h"
+
+#include <algorithm>
+
+namespace mgg = mir::graphics::gbm;
+using namespace std::chrono_literals;
+
+namespace
+{
+// Too few samples and a single fast frame could have us cut things too fine
+std::size_t const min_samples{10};
+
+// The fraction of frames we expect to render within the predicted time
+double const percentile{0.95};
+
+// Allowance for scheduling jitter and the work done before rendering starts
+auto const safety_margin = 1ms;
+}
+
+mgg::RenderTimeEstimator::RenderTimeEstimator(std::chrono::milliseconds fallback)
+    : fallback{fallback}
+{
+}
+
+void mgg::RenderTimeEstimator::record(std::chrono::nanoseconds render_time)
+{
+    samples[next_sample] = render_time;
+    next_sample = (next_sample + 1) % max_samples;
+    sample_count = std::min(sample_count + 1, max_samples);
+}
+
+auto mgg::RenderTimeEstimator::predicted_render_time() const -> std::chrono::milliseconds
+{
+    if (sample_count < min_samples)
+        return fallback;
+
+    auto sorted = samples;
+    auto const end = sorted.begin() + sample_count;
+    auto const nth = sorted.begin() + static_cast<std::size_t>(percentile * (sample_count - 1));
+    std::nth_element(sorted.begin(), nth, end);
+
+    // Round up: we'd rather wake a little early than miss the vblank
+    auto const predicted = std::chrono::ceil<std::chrono::milliseconds>(*nth);
+
+    return predicted + safety_margin;
+}
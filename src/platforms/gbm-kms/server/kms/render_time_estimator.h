@@ -0,0 +1,59 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_GBM_RENDER_TIME_ESTIMATOR_H_
+#define MIR_GRAPHICS_GBM_RENDER_TIME_ESTIMATOR_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+namespace mir
+{
+namespace graphics
+{
+namespace gbm
+{
+
+/**
+ * Predicts how long the next frame will take to render from how long
+ * recent frames took. The prediction is a high percentile of the recent
+ * render times, so that only the occasional slow frame misses its vblank.
+ */
+class RenderTimeEstimator
+{
+public:
+    /// Until enough frames have been measured \a fallback is predicted
+    RenderTimeEstimator(std::chrono::milliseconds fallback);
+
+    void record(std::chrono::nanoseconds render_time);
+
+    auto predicted_render_time() const -> std::chrono::milliseconds;
+
+private:
+    static std::size_t constexpr max_samples = 120;
+
+    std::chrono::milliseconds const fallback;
+    std::array<std::chrono::nanoseconds, max_samples> samples;
+    std::size_t next_sample{0};
+    std::size_t sample_count{0};
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_GBM_RENDER_TIME_ESTIMATOR_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "render_timer.h"
+#include "mir/thread_name.h"
+
+#include <algorithm>
+
+namespace mgg = mir::graphics::gbm;
+using namespace std::chrono_literals;
+
+namespace
+{
+// Don't wait forever on a wedged GPU; a frame this slow has missed its vblank anyway
+auto const fence_timeout = 100ms;
+}
+
+mgg::RenderTimer::RenderTimer(std::chrono::milliseconds fallback)
+    : estimator{fallback},
+      waiter{[this]() { wait_for_fences(); }}
+{
+}
+
+mgg::RenderTimer::~RenderTimer()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    fences_pending.notify_all();
+    waiter.join();
+}
+
+void mgg::RenderTimer::time(std::chrono::steady_clock::time_point started, Fence&& fence)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending.emplace_back(started, std::move(fence));
+    }
+    fences_pending.notify_all();
+}
+
+auto mgg::RenderTimer::predicted_render_time() const -> std::chrono::milliseconds
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return estimator.predicted_render_time();
+}
+
+void mgg::RenderTimer::wait_for_fences()
+{
+    mir::set_thread_name("Mir/RenderTime");
+
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;)
+    {
+        fences_pending.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (stopping)
+            return;
+
+        auto frame = std::move(pending.front());
+        pending.pop_front();
+
+        // Frames finish in order, so by the time this one has the next may have too
+        lock.unlock();
+        auto const finished = frame.second(fence_timeout);
+        auto render_time = std::chrono::steady_clock::now() - frame.first;
+        frame.second = nullptr;
+        lock.lock();
+
+        // A frame we gave up on took at least as long as we waited, which matters for the percentile
+        if (!finished)
+            render_time = std::max<std::chrono::steady_clock::duration>(render_time, fence_timeout);
+
+        estimator.record(render_time);
+    }
+}
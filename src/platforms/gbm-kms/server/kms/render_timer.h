@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_GRAPHICS_GBM_RENDER_TIMER_H_
+#define MIR_GRAPHICS_GBM_RENDER_TIMER_H_
+
+#include "render_time_estimator.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace mir
+{
+namespace graphics
+{
+namespace gbm
+{
+
+/**
+ * Measures how long frames take to render, waiting for the GPU on a thread
+ * of its own so that the compositor needn't.
+ */
+class RenderTimer
+{
+public:
+    /**
+     * Waits up to \a timeout for rendering to finish
+     * \returns whether it finished
+     */
+    using Fence = std::function<bool(std::chrono::nanoseconds timeout)>;
+
+    /// Until enough frames have been measured \a fallback is predicted
+    RenderTimer(std::chrono::milliseconds fallback);
+    ~RenderTimer();
+
+    /// Time a frame that started rendering at \a started, and finishes at \a fence
+    void time(std::chrono::steady_clock::time_point started, Fence&& fence);
+
+    auto predicted_render_time() const -> std::chrono::milliseconds;
+
+private:
+    void wait_for_fences();
+
+    std::mutex mutable mutex;
+    std::condition_variable fences_pending;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, Fence>> pending;
+    RenderTimeEstimator estimator;
+    bool stopping{false};
+
+    std::thread waiter;
+};
+
+}
+}
+}
+
+#endif /* MIR_GRAPHICS_GBM_RENDER_TIMER_H_ */
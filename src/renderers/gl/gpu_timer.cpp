@@ -0,0 +1,329 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define MIR_LOG_COMPONENT "GLRenderer"
+
+#include "gpu_timer.h"
+#include "mir/graphics/gl_extensions_base.h"
+#include "mir/log.h"
+#include "mir/thread_name.h"
+
+namespace mg = mir::graphics;
+namespace mrg = mir::renderer::gl;
+using namespace std::chrono_literals;
+
+namespace
+{
+// How long the waiter blocks on a fence before checking whether it's stopping
+auto const fence_timeout = 100ms;
+
+bool supports(char const* extensions, char const* extension)
+{
+    return extensions && mg::GLExtensionsBase{extensions}.support(extension);
+}
+
+template<typename Function>
+Function lookup(char const* name)
+{
+    return reinterpret_cast<Function>(eglGetProcAddress(name));
+}
+
+std::chrono::nanoseconds between(GLuint64 from, GLuint64 to)
+{
+    return std::chrono::nanoseconds{to > from ? to - from : 0};
+}
+}
+
+mrg::GPUTimer::GPUTimer(Mode mode)
+    : mode{mode}
+{
+    if (mode == Mode::off)
+        return;
+
+    if (supports(reinterpret_cast<char const*>(glGetString(GL_EXTENSIONS)), "GL_EXT_disjoint_timer_query"))
+    {
+        TimerQueryFunctions const functions{
+            lookup<PFNGLGENQUERIESEXTPROC>("glGenQueriesEXT"),
+            lookup<PFNGLDELETEQUERIESEXTPROC>("glDeleteQueriesEXT"),
+            lookup<PFNGLGETQUERYIVEXTPROC>("glGetQueryivEXT"),
+            lookup<PFNGLQUERYCOUNTEREXTPROC>("glQueryCounterEXT"),
+            lookup<PFNGLGETQUERYOBJECTIVEXTPROC>("glGetQueryObjectivEXT"),
+            lookup<PFNGLGETQUERYOBJECTUI64VEXTPROC>("glGetQueryObjectui64vEXT")};
+
+        if (functions.gen && functions.remove && functions.get_query &&
+            functions.counter && functions.get_int && functions.get_uint64)
+        {
+            // Implementations may offer the extension without timestamps
+            GLint bits = 0;
+            functions.get_query(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+            if (bits > 0)
+                queries = functions;
+        }
+    }
+
+    auto const display = eglGetCurrentDisplay();
+    if (!queries && display != EGL_NO_DISPLAY &&
+        supports(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_fence_sync"))
+    {
+        FenceFunctions const functions{
+            display,
+            lookup<PFNEGLCREATESYNCKHRPROC>("eglCreateSyncKHR"),
+            lookup<PFNEGLDESTROYSYNCKHRPROC>("eglDestroySyncKHR"),
+            lookup<PFNEGLCLIENTWAITSYNCKHRPROC>("eglClientWaitSyncKHR")};
+
+        if (functions.create && functions.destroy && functions.wait)
+            fences = functions;
+    }
+
+    if (fences)
+        fence_waiter = std::make_unique<FenceWaiter>(fences.value());
+
+    if (queries)
+        mir::log_info("Timing GPU work with timer queries");
+    else if (fences)
+        mir::log_info("Timing GPU work with fences: frame times are upper bounds, and idle gaps "
+                      "and renderable costs are unavailable");
+    else
+        mir::log_info("GPU timing is unavailable: neither timer queries nor fences are supported");
+}
+
+mrg::GPUTimer::~GPUTimer()
+{
+    for (auto& frame : frames)
+    {
+        if (queries && !frame.queries.empty())
+            queries->remove(frame.queries.size(), frame.queries.data());
+    }
+}
+
+bool mrg::GPUTimer::available() const
+{
+    return queries || fences;
+}
+
+void mrg::GPUTimer::begin_frame()
+{
+    current = nullptr;
+    if (!available())
+        return;
+
+    ++frameno;
+
+    // Don't queue up more work for the GPU to tell us about
+    auto& frame = frames[next];
+    if (frame.pending || (fence_waiter && fence_waiter->in_flight() >= frames_in_flight))
+        return;
+
+    current = &frame;
+    frame.frameno = frameno;
+    frame.used = 0;
+    frame.ends.clear();
+    frame.sampled = queries && mode == Mode::renderables && frameno % sample_interval == 0;
+
+    if (queries)
+        timestamp(frame, nullptr);
+    else
+        frame.submitted = std::chrono::steady_clock::now();
+}
+
+bool mrg::GPUTimer::sampling() const
+{
+    return current && current->sampled;
+}
+
+void mrg::GPUTimer::begin_renderables()
+{
+    if (sampling())
+        timestamp(*current, nullptr);
+}
+
+void mrg::GPUTimer::end_renderable(graphics::Renderable::ID renderable)
+{
+    if (sampling())
+        timestamp(*current, renderable);
+}
+
+void mrg::GPUTimer::end_frame()
+{
+    if (!current)
+        return;
+
+    auto& frame = *current;
+    current = nullptr;
+
+    if (queries)
+    {
+        timestamp(frame, nullptr);
+    }
+    else
+    {
+        // The waiter has the frame from here, so its slot is free for the next
+        auto const fence = fences->create(fences->display, EGL_SYNC_FENCE_KHR, nullptr);
+        if (fence != EGL_NO_SYNC_KHR)
+            fence_waiter->wait_for(fence, frame.submitted);
+        return;
+    }
+
+    frame.pending = true;
+    next = (next + 1) % frames.size();
+}
+
+void mrg::GPUTimer::collect(std::vector<renderer::Renderer::GPUFrameTiming>& timings)
+{
+    if (!available())
+        return;
+
+    if (fence_waiter)
+    {
+        fence_waiter->collect(timings);
+        return;
+    }
+
+    if (queries)
+    {
+        // Something (such as a clock change) made the timestamps in flight meaningless
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint)
+        {
+            for (auto& frame : frames)
+                frame.pending = false;
+            oldest = next;
+            last_end = std::nullopt;
+            return;
+        }
+    }
+
+    while (frames[oldest].pending && collect(frames[oldest], timings))
+    {
+        frames[oldest].pending = false;
+        oldest = (oldest + 1) % frames.size();
+    }
+}
+
+void mrg::GPUTimer::timestamp(Frame& frame, graphics::Renderable::ID ending)
+{
+    if (frame.used == frame.queries.size())
+    {
+        GLuint query = 0;
+        queries->gen(1, &query);
+        frame.queries.push_back(query);
+    }
+
+    queries->counter(frame.queries[frame.used++], GL_TIMESTAMP_EXT);
+    frame.ends.push_back(ending);
+}
+
+bool mrg::GPUTimer::collect(Frame& frame, std::vector<renderer::Renderer::GPUFrameTiming>& timings)
+{
+    // Queries complete in order, so when the last is available so are the rest
+    GLint available = GL_FALSE;
+    queries->get_int(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available)
+        return false;
+
+    times.resize(frame.used);
+    for (auto i = 0u; i != frame.used; ++i)
+        queries->get_uint64(frame.queries[i], GL_QUERY_RESULT_EXT, &times[i]);
+
+    renderer::Renderer::GPUFrameTiming timing{between(times.front(), times.back()), std::nullopt, {}};
+    if (last_end && last_end_frameno + 1 == frame.frameno)
+        timing.idle_before = between(last_end.value(), times.front());
+
+    for (auto i = 1u; i != frame.used; ++i)
+    {
+        if (frame.ends[i])
+            timing.renderables.emplace_back(frame.ends[i], between(times[i - 1], times[i]));
+    }
+
+    last_end = times.back();
+    last_end_frameno = frame.frameno;
+    timings.push_back(std::move(timing));
+    return true;
+}
+
+mrg::GPUTimer::FenceWaiter::FenceWaiter(FenceFunctions const& fences)
+    : fences{fences},
+      waiter{[this]() { wait_for_fences(); }}
+{
+}
+
+mrg::GPUTimer::FenceWaiter::~FenceWaiter()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    fences_pending.notify_all();
+    waiter.join();
+
+    for (auto const& frame : pending)
+        fences.destroy(fences.display, frame.first);
+}
+
+void mrg::GPUTimer::FenceWaiter::wait_for(EGLSyncKHR fence, std::chrono::steady_clock::time_point submitted)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending.emplace_back(fence, submitted);
+    }
+    fences_pending.notify_all();
+}
+
+auto mrg::GPUTimer::FenceWaiter::in_flight() const -> std::size_t
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return pending.size();
+}
+
+void mrg::GPUTimer::FenceWaiter::collect(std::vector<renderer::Renderer::GPUFrameTiming>& timings)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    for (auto const render_time : finished)
+        timings.push_back({render_time, std::nullopt, {}});
+    finished.clear();
+}
+
+void mrg::GPUTimer::FenceWaiter::wait_for_fences()
+{
+    mir::set_thread_name("Mir/GPUTimer");
+
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;)
+    {
+        fences_pending.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (stopping)
+            return;
+
+        // The frame stays queued while it's waited for, so that it's cleaned up if we stop
+        auto const frame = pending.front();
+        lock.unlock();
+        auto const status = fences.wait(
+            fences.display, frame.first, 0,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(fence_timeout).count());
+        auto const finished_at = std::chrono::steady_clock::now();
+        lock.lock();
+
+        if (status == EGL_TIMEOUT_EXPIRED_KHR)
+            continue;
+
+        pending.pop_front();
+        fences.destroy(fences.display, frame.first);
+
+        if (status == EGL_CONDITION_SATISFIED_KHR)
+            finished.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(finished_at - frame.second));
+    }
+}
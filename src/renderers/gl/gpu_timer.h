@@ -0,0 +1,200 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_RENDERER_GL_GPU_TIMER_H_
+#define MIR_RENDERER_GL_GPU_TIMER_H_
+
+#include <mir/renderer/renderer.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mir
+{
+namespace renderer
+{
+namespace gl
+{
+
+/**
+ * GPUTimer measures how long the GPU takes over the frames the renderer
+ * submits, which the CPU side timing of the compositor can't tell.
+ *
+ * With GL_EXT_disjoint_timer_query, GPU timestamps are taken at the start
+ * and end of each frame, which also give the gaps between frames, and in
+ * sampled frames after each renderable. Without it, an EGL fence is placed
+ * at the end of each frame and waited for on a thread of its own; the
+ * frame's time is from its submission to when the fence signalled, which is
+ * only an upper bound, and gaps and renderable costs aren't known.
+ *
+ * Results come back once the GPU has finished the frame, typically a frame
+ * or two later. Frames are not timed while earlier ones are still awaited.
+ *
+ * \note Everything here, including construction and destruction, needs a
+ *       current GL context.
+ */
+class GPUTimer
+{
+public:
+    enum class Mode
+    {
+        off,
+        /// Time each frame
+        frames,
+        /// Time each frame, and each renderable in every sample_interval-th frame
+        renderables
+    };
+
+    /// How often frames are sampled for renderable costs, in Mode::renderables
+    static constexpr unsigned int sample_interval = 60;
+
+    explicit GPUTimer(Mode mode);
+    ~GPUTimer();
+
+    GPUTimer(GPUTimer const&) = delete;
+    GPUTimer& operator=(GPUTimer const&) = delete;
+
+    /// Whether this context can time anything
+    bool available() const;
+
+    /// Mark the start of a frame's GPU work
+    void begin_frame();
+
+    /// Whether the frame begun is one to time renderables in
+    bool sampling() const;
+
+    /// In a sampled frame, mark where the GPU work for the renderables starts
+    void begin_renderables();
+
+    /// In a sampled frame, mark the end of the GPU work for a renderable, since the last mark
+    void end_renderable(graphics::Renderable::ID renderable);
+
+    /// Mark the end of a frame's GPU work
+    void end_frame();
+
+    /// Add the timings of frames the GPU has finished since the last call
+    void collect(std::vector<renderer::Renderer::GPUFrameTiming>& timings);
+
+private:
+    static std::size_t constexpr frames_in_flight = 4;
+
+    struct TimerQueryFunctions
+    {
+        PFNGLGENQUERIESEXTPROC gen;
+        PFNGLDELETEQUERIESEXTPROC remove;
+        PFNGLGETQUERYIVEXTPROC get_query;
+        PFNGLQUERYCOUNTEREXTPROC counter;
+        PFNGLGETQUERYOBJECTIVEXTPROC get_int;
+        PFNGLGETQUERYOBJECTUI64VEXTPROC get_uint64;
+    };
+
+    struct FenceFunctions
+    {
+        EGLDisplay display;
+        PFNEGLCREATESYNCKHRPROC create;
+        PFNEGLDESTROYSYNCKHRPROC destroy;
+        PFNEGLCLIENTWAITSYNCKHRPROC wait;
+    };
+
+    struct Frame
+    {
+        unsigned long long frameno{0};
+
+        /// Timestamp queries, the first and last used marking the start and end of the frame
+        std::vector<GLuint> queries;
+        std::size_t used{0};
+        /// The renderable whose work ends at each query used, if any
+        std::vector<graphics::Renderable::ID> ends;
+        bool sampled{false};
+
+        std::chrono::steady_clock::time_point submitted;
+
+        bool pending{false};
+    };
+
+    /// Waits for frames' fences, so that they're timed when they signal rather than when next collected
+    class FenceWaiter
+    {
+    public:
+        explicit FenceWaiter(FenceFunctions const& fences);
+        ~FenceWaiter();
+
+        /// Time a frame submitted at \a submitted, taking ownership of its \a fence
+        void wait_for(EGLSyncKHR fence, std::chrono::steady_clock::time_point submitted);
+
+        /// The frames whose fences haven't signalled yet
+        auto in_flight() const -> std::size_t;
+
+        void collect(std::vector<renderer::Renderer::GPUFrameTiming>& timings);
+
+    private:
+        void wait_for_fences();
+
+        FenceFunctions const fences;
+
+        std::mutex mutable mutex;
+        std::condition_variable fences_pending;
+        std::deque<std::pair<EGLSyncKHR, std::chrono::steady_clock::time_point>> pending;
+        std::vector<std::chrono::nanoseconds> finished;
+        bool stopping{false};
+
+        std::thread waiter;
+    };
+
+    void timestamp(Frame& frame, graphics::Renderable::ID ending);
+    /// \returns false if the GPU hasn't finished the frame yet
+    bool collect(Frame& frame, std::vector<renderer::Renderer::GPUFrameTiming>& timings);
+
+    Mode const mode;
+    std::optional<TimerQueryFunctions> queries;
+    std::optional<FenceFunctions> fences;
+    std::unique_ptr<FenceWaiter> fence_waiter;
+
+    std::array<Frame, frames_in_flight> frames;
+    /// The frame being submitted, if it's being timed
+    Frame* current{nullptr};
+    /// The oldest frame awaiting results
+    std::size_t oldest{0};
+    std::size_t next{0};
+    unsigned long long frameno{0};
+
+    /// When the GPU finished the last frame collected (for the gap before the one after it)
+    std::optional<GLuint64> last_end;
+    unsigned long long last_end_frameno{0};
+
+    /// The timestamps of the frame being collected, kept to save allocating them each frame
+    std::vector<GLuint64> times;
+};
+
+}
+}
+}
+
+#endif // MIR_RENDERER_GL_GPU_TIMER_H_
@@ -0,0 +1,304 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define MIR_LOG_COMPONENT "GLRenderer"
+
+#include "program_binary_cache.h"
+#include "mir/graphics/gl_extensions_base.h"
+#include "mir/log.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <boost/filesystem.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
+namespace mg = mir::graphics;
+namespace mrg = mir::renderer::gl;
+
+namespace
+{
+char const file_magic[8] = {'M', 'I', 'R', 'P', 'R', 'O', 'G', '1'};
+
+struct BinaryFunctions
+{
+    PFNGLGETPROGRAMBINARYOESPROC get;
+    PFNGLPROGRAMBINARYOESPROC load;
+};
+
+/// The program binary entry points, if the current context supports them
+auto binary_functions() -> std::optional<BinaryFunctions>
+{
+    auto const extensions = reinterpret_cast<char const*>(glGetString(GL_EXTENSIONS));
+    if (!extensions || !mg::GLExtensionsBase{extensions}.support("GL_OES_get_program_binary"))
+        return std::nullopt;
+
+    // The extension may be there without any formats to use it with
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+    if (formats <= 0)
+        return std::nullopt;
+
+    BinaryFunctions const functions{
+        reinterpret_cast<PFNGLGETPROGRAMBINARYOESPROC>(eglGetProcAddress("glGetProgramBinaryOES")),
+        reinterpret_cast<PFNGLPROGRAMBINARYOESPROC>(eglGetProcAddress("glProgramBinaryOES"))};
+    if (!functions.get || !functions.load)
+        return std::nullopt;
+
+    return functions;
+}
+
+std::string gl_string(GLenum name)
+{
+    auto const value = reinterpret_cast<char const*>(glGetString(name));
+    return value ? value : "";
+}
+
+/// Identifies the program and the driver it was built by
+std::string key_for(GLchar const* vshader_src, GLchar const* fshader_src)
+{
+    std::string key;
+    for (auto const name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        (key += gl_string(name)) += '\n';
+
+    // The sources can't contain NULs, so can't be confused with each other
+    (key += vshader_src) += '\0';
+    key += fshader_src;
+    return key;
+}
+
+template<typename T>
+void write_value(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<char const*>(&value), sizeof value);
+}
+
+template<typename T>
+bool read_value(std::istream& in, T& value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof value));
+}
+}
+
+mrg::ProgramBinaryCache::ProgramBinaryCache(std::string const& cache_dir)
+    : cache_dir{cache_dir}
+{
+}
+
+std::string mrg::ProgramBinaryCache::default_cache_dir()
+{
+    std::string cache_home;
+    if (auto const xdg_cache_home = getenv("XDG_CACHE_HOME"))
+        cache_home = xdg_cache_home;
+    else if (auto const home = getenv("HOME"))
+        (cache_home = home) += "/.cache";
+
+    return cache_home.empty() ? cache_home : cache_home + "/mir/gl-programs";
+}
+
+GLuint mrg::ProgramBinaryCache::load(GLchar const* vshader_src, GLchar const* fshader_src)
+{
+    auto const functions = binary_functions();
+    if (!functions)
+        return 0;
+
+    auto const key = key_for(vshader_src, fshader_src);
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+
+    auto found = binaries.find(key);
+    if (found == binaries.end())
+    {
+        Binary binary;
+        if (!read(key, binary))
+            return 0;
+
+        found = binaries.emplace(key, std::move(binary)).first;
+    }
+
+    auto const& binary = found->second;
+    GLuint const program = glCreateProgram();
+    functions->load(program, binary.format, binary.data.data(), binary.data.size());
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        // Drivers may reject binaries for reasons the key doesn't capture
+        mir::log_debug("Discarding GL program binary rejected by the driver");
+        glDeleteProgram(program);
+        binaries.erase(found);
+        if (!cache_dir.empty())
+            std::remove(path_for(key).c_str());
+        return 0;
+    }
+
+    return program;
+}
+
+void mrg::ProgramBinaryCache::store(GLchar const* vshader_src, GLchar const* fshader_src, GLuint program)
+{
+    auto const functions = binary_functions();
+    if (!functions)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0)
+        return;
+
+    Binary binary{GL_NONE, std::vector<char>(length)};
+    GLsizei written = 0;
+    functions->get(program, length, &written, &binary.format, binary.data.data());
+    if (written <= 0)
+        return;
+    binary.data.resize(written);
+
+    auto const key = key_for(vshader_src, fshader_src);
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    if (!cache_dir.empty())
+        write(key, binary);
+    binaries[key] = std::move(binary);
+}
+
+std::string mrg::ProgramBinaryCache::path_for(std::string const& key) const
+{
+    std::ostringstream path;
+    path << cache_dir << '/'
+         << std::hex << std::setw(16) << std::setfill('0') << std::hash<std::string>{}(key)
+         << ".bin";
+    return path.str();
+}
+
+bool mrg::ProgramBinaryCache::read(std::string const& key, Binary& binary) const
+{
+    if (cache_dir.empty())
+        return false;
+
+    std::ifstream in{path_for(key), std::ios::binary};
+    if (!in)
+        return false;
+
+    // The whole key is kept, as its hash could collide
+    char magic[sizeof file_magic];
+    uint32_t key_size = 0;
+    if (!in.read(magic, sizeof magic) ||
+        !std::equal(std::begin(magic), std::end(magic), std::begin(file_magic)) ||
+        !read_value(in, key_size) ||
+        key_size != key.size())
+    {
+        return false;
+    }
+
+    std::string stored_key(key_size, '\0');
+    uint32_t format = 0;
+    uint32_t data_size = 0;
+    if (!in.read(&stored_key[0], key_size) || stored_key != key ||
+        !read_value(in, format) || !read_value(in, data_size))
+    {
+        return false;
+    }
+
+    // The size is as untrusted as the rest of the file, so check it's what remains before allocating
+    auto const data_start = in.tellg();
+    if (data_start < 0 || !in.seekg(0, std::ios::end))
+        return false;
+    auto const data_end = in.tellg();
+    if (data_end < data_start || static_cast<uint64_t>(data_end - data_start) != data_size ||
+        !in.seekg(data_start))
+    {
+        return false;
+    }
+
+    std::vector<char> data(data_size);
+    if (!in.read(data.data(), data_size))
+        return false;
+
+    binary.format = format;
+    binary.data = std::move(data);
+    return true;
+}
+
+void mrg::ProgramBinaryCache::write(std::string const& key, Binary const& binary) const
+{
+    boost::system::error_code error;
+    boost::filesystem::create_directories(cache_dir, error);
+    if (error)
+    {
+        mir::log_debug("Not caching GL program binary: can't create %s: %s",
+                       cache_dir.c_str(), error.message().c_str());
+        return;
+    }
+
+    std::ostringstream out;
+    out.write(file_magic, sizeof file_magic);
+    write_value(out, static_cast<uint32_t>(key.size()));
+    out.write(key.data(), key.size());
+    write_value(out, static_cast<uint32_t>(binary.format));
+    write_value(out, static_cast<uint32_t>(binary.data.size()));
+    out.write(binary.data.data(), binary.data.size());
+    auto const contents = out.str();
+
+    // Write elsewhere and move into place so that nothing reads a partial file. The temporary
+    // file is unique so that servers sharing the cache can't write into each other's.
+    auto const path = path_for(key);
+    auto const temp_template = path + ".XXXXXX";
+    std::vector<char> temp_path(temp_template.begin(), temp_template.end());
+    temp_path.push_back('\0');
+
+    int const fd = mkstemp(temp_path.data());
+    if (fd < 0)
+    {
+        mir::log_debug("Not caching GL program binary: can't create a file in %s: %s",
+                       cache_dir.c_str(), std::strerror(errno));
+        return;
+    }
+
+    bool written = true;
+    for (std::size_t done = 0; written && done != contents.size();)
+    {
+        auto const result = ::write(fd, contents.data() + done, contents.size() - done);
+        if (result > 0)
+            done += result;
+        else if (result < 0 && errno == EINTR)
+            continue;
+        else
+            written = false;
+    }
+
+    if (::close(fd) != 0 || !written)
+    {
+        mir::log_debug("Not caching GL program binary: failed writing %s", temp_path.data());
+        std::remove(temp_path.data());
+        return;
+    }
+
+    if (std::rename(temp_path.data(), path.c_str()) != 0)
+        std::remove(temp_path.data());
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_RENDERER_GL_PROGRAM_BINARY_CACHE_H_
+#define MIR_RENDERER_GL_PROGRAM_BINARY_CACHE_H_
+
+#include <GLES2/gl2.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mir
+{
+namespace renderer
+{
+namespace gl
+{
+
+/**
+ * ProgramBinaryCache keeps the binaries of linked GLSL programs, so that
+ * they can be recreated without compiling and linking them again.
+ *
+ * Binaries are shared by every renderer using the cache, and are also
+ * saved to disk to be reused on the next start. They are keyed by the
+ * shader sources and by the GL vendor, renderer and version strings, so a
+ * driver or GPU change just misses the cache. Contexts without
+ * GL_OES_get_program_binary never hit it.
+ *
+ * Programs themselves are not shared: their uniforms hold per-output state.
+ */
+class ProgramBinaryCache
+{
+public:
+    /// \param [in] cache_dir   Where to save binaries; if empty they are only kept in memory
+    explicit ProgramBinaryCache(std::string const& cache_dir);
+
+    ProgramBinaryCache(ProgramBinaryCache const&) = delete;
+    ProgramBinaryCache& operator=(ProgramBinaryCache const&) = delete;
+
+    /// $XDG_CACHE_HOME/mir/gl-programs (or the same under ~/.cache), if either is set
+    static std::string default_cache_dir();
+
+    /**
+     * Create a program from the binary of one linked from these shaders.
+     *
+     * \note Must be called with a current GL context
+     * \returns The program, or 0 if there's no usable binary
+     */
+    GLuint load(GLchar const* vshader_src, GLchar const* fshader_src);
+
+    /**
+     * Keep the binary of a program linked from these shaders.
+     *
+     * \note Must be called with a current GL context
+     */
+    void store(GLchar const* vshader_src, GLchar const* fshader_src, GLuint program);
+
+private:
+    struct Binary
+    {
+        GLenum format;
+        std::vector<char> data;
+    };
+
+    std::string path_for(std::string const& key) const;
+    bool read(std::string const& key, Binary& binary) const;
+    void write(std::string const& key, Binary const& binary) const;
+
+    std::string const cache_dir;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Binary> binaries;
+};
+
+}
+}
+}
+
+#endif // MIR_RENDERER_GL_PROGRAM_BINARY_CACHE_H_
@@ -17,6 +17,7 @@
  */
 
 #include "program_family.h"
+#include "program_binary_cache.h"
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <mutex>
@@ -53,6 +54,11 @@ void ProgramFamily::Shader::init(GLenum type, const GLchar* src)
     }
 }
 
+ProgramFamily::ProgramFamily(std::shared_ptr<ProgramBinaryCache> const& binaries)
+    : binaries{binaries}
+{
+}
+
 ProgramFamily::~ProgramFamily() noexcept
 {
     // shader and program lifetimes are managed manually, so that we don't
@@ -65,6 +71,12 @@ ProgramFamily::~ProgramFamily() noexcept
             glDeleteProgram(p.second.id);
     }
 
+    for (auto& p : loaded_program)
+    {
+        if (p.second.id)
+            glDeleteProgram(p.second.id);
+    }
+
     for (auto& v : vshader)
     {
         if (v.second.id)
@@ -89,6 +101,15 @@ GLuint ProgramFamily::add_program(const GLchar* const vshader_src,
     static std::mutex lp1416482_mutex;
     std::lock_guard<decltype(lp1416482_mutex)> lock{lp1416482_mutex};
 
+    if (binaries)
+    {
+        auto& loaded = loaded_program[{vshader_src, fshader_src}];
+        if (!loaded.id)
+            loaded.id = binaries->load(vshader_src, fshader_src);
+        if (loaded.id)
+            return loaded.id;
+    }
+
     auto& v = vshader[vshader_src];
     if (!v.id) v.init(GL_VERTEX_SHADER, vshader_src);
 
@@ -113,6 +134,9 @@ GLuint ProgramFamily::add_program(const GLchar* const vshader_src,
             p.id = 0;
             throw std::runtime_error(std::string("Link failed: ")+log);
         }
+
+        if (binaries)
+            binaries->store(vshader_src, fshader_src, p.id);
     }
 
     return p.id;
@@ -22,6 +22,7 @@
 #include <GLES2/gl2.h>
 #include <utility>
 #include <map>
+#include <memory>
 #include <unordered_map>
 
 namespace mir
@@ -30,6 +31,7 @@ namespace renderer
 {
 namespace gl
 {
+class ProgramBinaryCache;
 
 /**
  * ProgramFamily represents a set of GLSL programs that are closely
@@ -38,11 +40,14 @@ namespace gl
  *   A secondary intention is that this class may be extended to allow the
  * different programs within the family to share common patterns of uniform
  * usage too.
+ *   Given a ProgramBinaryCache, programs are created from cached binaries
+ * where possible, and the binaries of any that have to be linked are cached.
  */
 class ProgramFamily
 {
 public:
     ProgramFamily() = default;
+    explicit ProgramFamily(std::shared_ptr<ProgramBinaryCache> const& binaries);
     ProgramFamily(ProgramFamily const&) = delete;
     ProgramFamily& operator=(ProgramFamily const&) = delete;
     ~ProgramFamily() noexcept;
@@ -65,6 +70,11 @@ private:
         GLuint id = 0;
     };
     std::map<ShaderPair, Program> program;
+
+    std::shared_ptr<ProgramBinaryCache> const binaries;
+    typedef std::pair<const GLchar*, const GLchar*> SourcePair;
+    /// Programs created from cached binaries, which have no shaders of their own
+    std::map<SourcePair, Program> loaded_program;
 };
 
 }
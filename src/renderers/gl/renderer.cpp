@@ -19,13 +19,16 @@
 #define MIR_LOG_COMPONENT "GLRenderer"
 
 #include "renderer.h"
+#include "program_binary_cache.h"
 #include "mir/compositor/buffer_stream.h"
 #include "mir/gl/default_program_factory.h"
 #include "mir/graphics/renderable.h"
 #include "mir/graphics/buffer.h"
 #include "mir/graphics/display_buffer.h"
+#include "mir/graphics/texture_atlas_limits.h"
 #include "mir/gl/tessellation_helpers.h"
 #include "mir/gl/texture_cache.h"
+#include "mir/gl/texture_atlas.h"
 #include "mir/gl/texture.h"
 #include "mir/log.h"
 #include "mir/report_exception.h"
@@ -40,7 +43,11 @@
 #include <EGL/egl.h>
 
 #include <boost/throw_exception.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <stdexcept>
+#include <tuple>
 #include <cmath>
 #include <sstream>
 
@@ -80,6 +87,16 @@ void mrg::CurrentRenderTarget::swap_buffers()
     render_target->swap_buffers();
 }
 
+void mrg::CurrentRenderTarget::swap_buffers_with_damage(geom::Rectangles const& damage)
+{
+    render_target->swap_buffers_with_damage(damage);
+}
+
+int mrg::CurrentRenderTarget::buffer_age() const
+{
+    return render_target->buffer_age();
+}
+
 const GLchar* const mrg::Renderer::vshader =
 {
     "attribute vec3 position;\n"
@@ -125,6 +142,82 @@ const GLchar* const mrg::Renderer::default_fshader =
 
 namespace
 {
+/*
+ * Enough history to cover triple buffering (and then some). Buffers older
+ * than this are simply redrawn in full.
+ */
+std::size_t const max_damage_history{4};
+
+bool needs_repaint(mg::Renderable const& renderable, geom::Rectangle const& repaint)
+{
+    static glm::mat4 const identity(1);
+    if (renderable.transformation() != identity)
+        return true;
+
+    auto visible = renderable.screen_position();
+    if (auto const clip_area = renderable.clip_area())
+        visible = visible.intersection_with(clip_area.value());
+
+    return visible.overlaps(repaint);
+}
+
+struct OpacitySplit
+{
+    geom::Rectangles opaque;
+    geom::Rectangles translucent;
+};
+
+/*
+ * Translucent (shaped) clients commonly have a fully opaque interior with a
+ * thin translucent border or shadow. Where they tell us so we can draw that
+ * interior without blending.
+ */
+auto split_by_opacity(mg::Renderable const& renderable) -> std::optional<OpacitySplit>
+{
+    static glm::mat4 const identity(1);
+    if (renderable.alpha() < 1.0f || renderable.transformation() != identity)
+        return std::nullopt;
+
+    auto const position = renderable.screen_position();
+
+    OpacitySplit split;
+    split.translucent.add(position);
+    for (auto const& rect : renderable.opaque_region())
+    {
+        auto const opaque = rect.intersection_with(position);
+        if (opaque.size.width.as_int() > 0 && opaque.size.height.as_int() > 0)
+        {
+            split.opaque.add(opaque);
+            split.translucent.subtract(opaque);
+        }
+    }
+
+    if (split.opaque.size() == 0)
+        return std::nullopt;
+
+    return split;
+}
+
+/// Parameters of glBlendFuncSeparate() and, where used, the constant alpha
+struct BlendState
+{
+    GLenum src_rgb, dst_rgb, src_alpha, dst_alpha;
+    GLfloat constant_alpha;
+
+    bool enabled() const
+    {
+        return dst_rgb != GL_ZERO;
+    }
+
+    bool operator<(BlendState const& other) const
+    {
+        return std::tie(src_rgb, dst_rgb, src_alpha, dst_alpha, constant_alpha) <
+               std::tie(other.src_rgb, other.dst_rgb, other.src_alpha, other.dst_alpha, other.constant_alpha);
+    }
+};
+
+BlendState const no_blending{GL_ONE, GL_ZERO, GL_ZERO, GL_ONE, 1.0f};
+
 template<void (* deleter)(GLuint)>
 class GLHandle
 {
@@ -199,8 +292,8 @@ class mrg::Renderer::ProgramFactory : public mir::graphics::gl::ProgramFactory
 {
 public:
     // NOTE: This must be called with a current GL context
-    ProgramFactory()
-        : vertex_shader{compile_shader(GL_VERTEX_SHADER, vertex_shader_src)}
+    ProgramFactory(std::shared_ptr<ProgramBinaryCache> const& binaries)
+        : binaries{binaries}
     {
     }
 
@@ -260,22 +353,40 @@ public:
         // GL shader compilation is *not* threadsafe, and requires external synchronisation
         std::lock_guard<std::mutex> lock{compilation_mutex};
 
-        ShaderHandle const opaque_shader{
-            compile_shader(GL_FRAGMENT_SHADER, opaque_fragment.str().c_str())};
-        ShaderHandle const alpha_shader{
-            compile_shader(GL_FRAGMENT_SHADER, alpha_fragment.str().c_str())};
-
+        auto opaque_program = program_for(opaque_fragment.str());
+        auto alpha_program = program_for(alpha_fragment.str());
         programs.emplace_back(id, std::make_unique<::Program>(
-            link_shader(vertex_shader, opaque_shader),
-            link_shader(vertex_shader, alpha_shader)));
+            std::move(opaque_program),
+            std::move(alpha_program)));
 
         return *programs.back().second;
-
-        // We delete opaque_shader and alpha_shader here. This is fine; it only marks them
-        // for deletion. GL will only delete them once the GL Program they're linked in is destroyed.
     }
 
 private:
+    /// A program from a cached binary if there is one, or compiled and linked if not
+    ProgramHandle program_for(std::string const& fragment_src)
+    {
+        if (binaries)
+        {
+            if (auto const id = binaries->load(vertex_shader_src, fragment_src.c_str()))
+                return ProgramHandle{id};
+        }
+
+        // Only compiled when something misses the cache
+        if (!vertex_shader)
+            vertex_shader = std::make_unique<ShaderHandle>(compile_shader(GL_VERTEX_SHADER, vertex_shader_src));
+
+        // The fragment shader is deleted here. This is fine; it only marks it for
+        // deletion. GL will only delete it once the GL Program it's linked in is destroyed.
+        ShaderHandle const fragment_shader{compile_shader(GL_FRAGMENT_SHADER, fragment_src.c_str())};
+        auto program = link_shader(*vertex_shader, fragment_shader);
+
+        if (binaries)
+            binaries->store(vertex_shader_src, fragment_src.c_str(), program);
+
+        return program;
+    }
+
     static GLuint compile_shader(GLenum type, GLchar const* src)
     {
         GLuint id = glCreateShader(type);
@@ -323,12 +434,44 @@ private:
         return program;
     }
 
-    ShaderHandle const vertex_shader;
+    std::shared_ptr<ProgramBinaryCache> const binaries;
+    std::unique_ptr<ShaderHandle> vertex_shader;
     std::vector<std::pair<void*, std::unique_ptr<::Program>>> programs;
     // GL requires us to synchronise multi-threaded access to the shader APIs.
     std::mutex compilation_mutex;
 };
 
+/// A primitive of a Draw, as a range of frame_vertices
+struct DrawPrimitive
+{
+    GLenum type;
+    GLint first;
+    GLsizei count;
+};
+
+struct mrg::Renderer::Draw
+{
+    mg::Renderable const* renderable;
+    std::shared_ptr<mg::gl::Texture> texture;
+    std::shared_ptr<mgl::Texture> fallback_texture;
+    Program const* program;
+    BlendState blend;
+    std::optional<OpacitySplit> opacity_split;
+    /// The transformation for the vertex shader to apply, if not the identity
+    std::optional<glm::mat4> transform;
+    /// Where on screen the draw can touch, if we know
+    std::optional<geom::Rectangle> bounds;
+    /// Draws only need to stay in order relative to those in other layers
+    std::size_t layer;
+    /// Whether this covers everything it touches, hiding what is below
+    bool opaque;
+    /// Place in the stack of renderables, from 1 at the bottom
+    GLint rank;
+    /// Whether fallback_texture is the texture atlas
+    bool atlased;
+    std::vector<DrawPrimitive> primitives;
+};
+
 mrg::Renderer::Program::Program(GLuint program_id)
 {
     id = program_id;
@@ -350,13 +493,30 @@ mrg::Renderer::Program::Program(GLuint program_id)
 }
 
 mrg::Renderer::Renderer(graphics::DisplayBuffer& display_buffer)
+    : Renderer(
+          display_buffer,
+          nullptr,
+          mgl::DefaultProgramFactory::default_texture_cache_budget,
+          GPUTimer::Mode::off)
+{
+}
+
+mrg::Renderer::Renderer(
+    graphics::DisplayBuffer& display_buffer,
+    std::shared_ptr<ProgramBinaryCache> const& program_binaries,
+    std::size_t texture_cache_budget,
+    GPUTimer::Mode gpu_timing)
     : render_target(&display_buffer),
       clear_color{0.0f, 0.0f, 0.0f, 0.0f},
+      family{program_binaries},
       default_program(family.add_program(vshader, default_fshader)),
       alpha_program(family.add_program(vshader, alpha_fshader)),
-      program_factory{std::make_unique<ProgramFactory>()},
-      texture_cache(mgl::DefaultProgramFactory().create_texture_cache()),
-      display_transform(1)
+      program_factory{std::make_unique<ProgramFactory>(program_binaries)},
+      texture_cache(mgl::DefaultProgramFactory(texture_cache_budget).create_texture_cache()),
+      // The platforms don't upload buffers that fit this themselves, so it's shared with them
+      texture_atlas{std::make_unique<mgl::TextureAtlas>(geom::Size{1024, 1024}, mg::texture_atlas_max_entry)},
+      display_transform(1),
+      gpu_timer{gpu_timing == GPUTimer::Mode::off ? nullptr : std::make_unique<GPUTimer>(gpu_timing)}
 {
     eglBindAPI(EGL_OPENGL_ES_API);
     EGLDisplay disp = eglGetCurrentDisplay();
@@ -405,6 +565,10 @@ mrg::Renderer::Renderer(graphics::DisplayBuffer& display_buffer)
     mir::log_info("GL framebuffer bits: RGBA=%d%d%d%d, depth=%d, stencil=%d",
                   rbits, gbits, bbits, abits, dbits, sbits);
 
+    if (sbits > 0)
+        max_stencil_rank = (1 << std::min(sbits, 8)) - 1;
+
+    glGenBuffers(1, &vertex_buffer);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     set_viewport(display_buffer.view_area());
@@ -413,6 +577,24 @@ mrg::Renderer::Renderer(graphics::DisplayBuffer& display_buffer)
 mrg::Renderer::~Renderer()
 {
     render_target.ensure_current();
+    glDeleteBuffers(1, &vertex_buffer);
+}
+
+auto mrg::Renderer::state_changes() const -> StateChanges
+{
+    return gl_state.changes();
+}
+
+auto mrg::Renderer::texture_cache_use() const -> TextureCacheUse
+{
+    return last_texture_cache_use;
+}
+
+auto mrg::Renderer::gpu_timings() -> std::vector<GPUFrameTiming>
+{
+    std::vector<GPUFrameTiming> timings;
+    std::swap(timings, finished_gpu_frames);
+    return timings;
 }
 
 void mrg::Renderer::tessellate(std::vector<mgl::Primitive>& primitives,
@@ -426,227 +608,716 @@ void mrg::Renderer::render(mg::RenderableList const& renderables) const
 {
     render_target.bind();
 
+    if (gpu_timer)
+    {
+        gpu_timer->collect(finished_gpu_frames);
+        gpu_timer->begin_frame();
+    }
+
+    /*
+     * Anything else sharing the context may have changed its state since
+     * the last frame, except that we always leave scissoring disabled.
+     */
+    gl_state.forget();
+    gl_state.assume_disabled(GL_SCISSOR_TEST);
+    gl_state.reset_changes();
+    program_in_use = nullptr;
+
+    auto const frame_damage = pending_damage ? pending_damage.value() : geom::Rectangles{viewport};
+    pending_damage = std::nullopt;
+
+    auto const retained = retain_unchanging(renderables);
+
+    repaint = repaint_area(frame_damage);
+    if (repaint)
+    {
+        gl_state.enable(GL_SCISSOR_TEST);
+        scissor_to(repaint.value());
+    }
+
+    // With a single renderable (over the retained layer) there's nothing to hide
+    front_to_back = renderables.size() - retained > 1 &&
+                    renderables.size() <= static_cast<std::size_t>(max_stencil_rank);
+
     glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glClear(GL_COLOR_BUFFER_BIT);
+    if (front_to_back)
+    {
+        glClearStencil(0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+    else
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
 
     ++frameno;
-    for (auto const& r : renderables)
+    prepare_draws(renderables, retained);
+    make_draws(retained > 0);
+
+    gl_state.disable(GL_SCISSOR_TEST);
+
+    if (gpu_timer)
+        gpu_timer->end_frame();
+
+    visible_regions.clear();
+
+    if (partial_repaint_possible)
     {
-        draw(*r);
-    }
+        geom::Rectangles target_damage;
+        for (auto const& rect : frame_damage)
+            target_damage.add({as_point(rect.top_left - viewport.top_left), rect.size});
 
-    render_target.swap_buffers();
+        render_target.swap_buffers_with_damage(target_damage);
+    }
+    else
+    {
+        render_target.swap_buffers();
+    }
 
     // Deleting unused textures only requires the GL context. This clean-up
     // does not affect screen contents so can happen after swap_buffers...
     texture_cache->drop_unused();
+    texture_atlas->drop_unused();
+
+    auto const cache_stats = texture_cache->statistics();
+    last_texture_cache_use = {cache_stats.hits, cache_stats.misses, cache_stats.bytes_resident};
 
     while (auto const gl_error = glGetError())
         mir::log_debug("GL error: %d", gl_error);
 }
 
-void mrg::Renderer::draw(mg::Renderable const& renderable) const
+void mrg::Renderer::make_draws(bool over_retained_layer) const
 {
-    auto const clip_area = renderable.clip_area();
-    if (clip_area)
-    {
-        glEnable(GL_SCISSOR_TEST);
-        glScissor(
-            clip_area.value().top_left.x.as_int() -
-                viewport.top_left.x.as_int(),
-            viewport.top_left.y.as_int() +
-                viewport.size.height.as_int() -
-                clip_area.value().top_left.y.as_int() -
-                clip_area.value().size.height.as_int(),
-            clip_area.value().size.width.as_int(), 
-            clip_area.value().size.height.as_int()
-        );
-    }
-
-    auto const texture = std::dynamic_pointer_cast<mg::gl::Texture>(renderable.buffer());
-    auto const surface_tex =
-        [this, &renderable, need_fallback = !static_cast<bool>(texture)]() -> std::shared_ptr<mir::gl::Texture>
-        {
-            if (need_fallback)
-            {
-                try
-                {
-                    return texture_cache->load(renderable);
-                }
-                catch (std::exception const&)
-                {
-                    report_exception();
-                }
-            }
-            return {nullptr};
-        }();
+    GLint const layer_vertices = frame_vertices.size();
+    if (over_retained_layer)
+    {
+        /*
+         * The layer covers the viewport, with its texture the way up that
+         * GL draws it: bottom row first.
+         */
+        GLfloat const left = viewport.top_left.x.as_int();
+        GLfloat const right = left + viewport.size.width.as_int();
+        GLfloat const top = viewport.top_left.y.as_int();
+        GLfloat const bottom = top + viewport.size.height.as_int();
+        frame_vertices.push_back({{left,  top,    0.0f}, {0.0f, 1.0f}});
+        frame_vertices.push_back({{left,  bottom, 0.0f}, {0.0f, 0.0f}});
+        frame_vertices.push_back({{right, top,    0.0f}, {1.0f, 1.0f}});
+        frame_vertices.push_back({{right, bottom, 0.0f}, {1.0f, 0.0f}});
+    }
 
-    auto const* maybe_prog =
-        [this, &texture, &surface_tex](bool alpha) -> Program const*
+    if (!draws.empty() || over_retained_layer)
+    {
+        // One upload for the whole frame, rather than client-side arrays per draw
+        gl_state.bind_array_buffer(vertex_buffer);
+        glBufferData(
+            GL_ARRAY_BUFFER,
+            frame_vertices.size() * sizeof(mgl::Vertex),
+            frame_vertices.data(),
+            GL_STREAM_DRAW);
+        gl_state.active_texture(GL_TEXTURE0);
+
+        if (over_retained_layer)
+            draw_retained_layer(layer_vertices);
+
+        if (front_to_back)
+            gl_state.enable(GL_STENCIL_TEST);
+
+        auto const sampling = gpu_timer && gpu_timer->sampling();
+        if (sampling)
+            gpu_timer->begin_renderables();
+
+        for (auto const& d : draws)
         {
-            if (texture)
-            {
-                auto const& family = static_cast<::Program const&>(texture->shader(*program_factory));
-                if (alpha)
-                {
-                    return &family.alpha;
-                }
-                return &family.opaque;
-            }
-            else if(surface_tex)
-            {
-                if (alpha)
-                {
-                    return &alpha_program;
-                }
-                return &default_program;
-            }
-            return nullptr;
-        }(renderable.alpha() < 1.0f);
+            draw(d);
+            if (sampling)
+                gpu_timer->end_renderable(d.renderable->id());
+        }
+
+        if (front_to_back)
+            gl_state.disable(GL_STENCIL_TEST);
+
+        gl_state.disable_vertex_attrib_array(program_in_use->texcoord_attr);
+        gl_state.disable_vertex_attrib_array(program_in_use->position_attr);
+        gl_state.bind_array_buffer(0);
+        program_in_use = nullptr;
+    }
+
+    // Don't keep the frame's buffers (and the textures they hold) alive until the next one
+    draws.clear();
+}
+
+auto mrg::Renderer::retain_unchanging(mg::RenderableList const& renderables) const -> std::size_t
+{
+    auto const unchanging = retained_layer.update(renderables);
+
+    /*
+     * Retaining a single renderable saves nothing. The layer is drawn 1:1
+     * over the viewport, so it's also only used where the viewport maps
+     * 1:1 onto the buffer.
+     */
+    if (unchanging < 2 || !partial_repaint_possible)
+        return 0;
+
+    if (retained_layer.holds(unchanging))
+        return unchanging;
 
-    if (!maybe_prog)
+    if (!retained_layer.bind_framebuffer(viewport.size))
     {
-        mir::log_error("Buffer does not support GL rendering!");
-        return;
+        render_target.bind();
+        return 0;
     }
 
-    auto const& prog = *maybe_prog;
+    // The layer is drawn in full: what's hidden now may not be by the time it's used
+    VisibleRegions frame_regions;
+    std::swap(frame_regions, visible_regions);
+    repaint = std::nullopt;
+    front_to_back = false;
 
-    glUseProgram(prog.id);
-    if (prog.last_used_frameno != frameno)
-    {   // Avoid reloading the screen-global uniforms on every renderable
-        // TODO: We actually only need to bind these *once*, right? Not once per frame?
-        prog.last_used_frameno = frameno;
-        for (auto i = 0u; i < prog.tex_uniforms.size(); ++i)
-        {
-            if (prog.tex_uniforms[i] != -1)
-            {
-                glUniform1i(prog.tex_uniforms[i], i);
-            }
-        }
-        glUniformMatrix4fv(prog.display_transform_uniform, 1, GL_FALSE,
-                           glm::value_ptr(display_transform));
-        glUniformMatrix4fv(prog.screen_to_gl_coords_uniform, 1, GL_FALSE,
-                           glm::value_ptr(screen_to_gl_coords));
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    prepare_draws({renderables.begin(), renderables.begin() + unchanging}, 0);
+    make_draws(false);
+
+    std::swap(frame_regions, visible_regions);
+    retained_layer.filled(unchanging);
+    render_target.bind();
+
+    return unchanging;
+}
+
+void mrg::Renderer::draw_retained_layer(GLint first_vertex) const
+{
+    static glm::mat4 const identity(1);
+
+    if (repaint)
+    {
+        gl_state.enable(GL_SCISSOR_TEST);
+        scissor_to(repaint.value());
+    }
+    else
+    {
+        gl_state.disable(GL_SCISSOR_TEST);
     }
 
-    glActiveTexture(GL_TEXTURE0);
+    use_program(default_program);
+    gl_state.uniform(default_program.transform_uniform, identity);
+    gl_state.disable(GL_BLEND);
+
+    retained_layer.bind_texture();
+    glDrawArrays(GL_TRIANGLE_STRIP, first_vertex, 4);
+}
+
+auto mrg::Renderer::repaint_area(geom::Rectangles const& frame_damage) const
+    -> std::optional<geom::Rectangle>
+{
+    damage_history.push_front(frame_damage);
+    if (damage_history.size() > max_damage_history)
+        damage_history.pop_back();
+
+    if (!partial_repaint_possible)
+        return std::nullopt;
 
-    auto const& rect = renderable.screen_position();
-    GLfloat centrex = rect.top_left.x.as_int() +
-                      rect.size.width.as_int() / 2.0f;
-    GLfloat centrey = rect.top_left.y.as_int() +
-                      rect.size.height.as_int() / 2.0f;
-    glUniform2f(prog.centre_uniform, centrex, centrey);
+    /*
+     * The back buffer was last drawn "age" frames ago, so it is missing the
+     * damage of this frame and the age-1 frames before it. It is only
+     * usable if it was drawn after the history was last reset; that is, if
+     * we have the damage for every frame since.
+     */
+    auto const age = render_target.buffer_age();
+    if (age <= 0 || static_cast<std::size_t>(age) >= damage_history.size())
+        return std::nullopt;
 
-    glm::mat4 transform = renderable.transformation();
-    if (texture && (texture->layout() == mg::gl::Texture::Layout::TopRowFirst))
+    geom::Rectangles stale;
+    for (auto i = 0; i != age; ++i)
     {
-        // GL textures have (0,0) at bottom-left rather than top-left
-        // We have to invert this texture to get it the way up GL expects.
-        transform *= glm::mat4{
-            1.0, 0.0, 0.0, 0.0,
-            0.0, -1.0, 0.0, 0.0,
-            0.0, 0.0, 1.0, 0.0,
-            -1.0, 1.0, 0.0, 1.0
-        };
+        for (auto const& rect : damage_history[i])
+            stale.add(rect);
     }
 
-    glUniformMatrix4fv(prog.transform_uniform, 1, GL_FALSE,
-                       glm::value_ptr(transform));
+    return stale.bounding_rectangle().intersection_with(viewport);
+}
 
-    if (prog.alpha_uniform >= 0)
-        glUniform1f(prog.alpha_uniform, renderable.alpha());
+void mrg::Renderer::scissor_to(geom::Rectangle const& area) const
+{
+    gl_state.scissor(
+        area.top_left.x.as_int() -
+            viewport.top_left.x.as_int(),
+        viewport.top_left.y.as_int() +
+            viewport.size.height.as_int() -
+            area.top_left.y.as_int() -
+            area.size.height.as_int(),
+        area.size.width.as_int(),
+        area.size.height.as_int()
+    );
+}
 
-    glEnableVertexAttribArray(prog.position_attr);
-    glEnableVertexAttribArray(prog.texcoord_attr);
+void mrg::Renderer::reset_damage_history()
+{
+    damage_history.clear();
+}
 
-    primitives.clear();
-    tessellate(primitives, renderable);
+void mrg::Renderer::prepare_draws(mg::RenderableList const& renderables, std::size_t retained) const
+{
+    static glm::mat4 const identity(1);
 
-    // if we fail to load the texture, we need to carry on (part of lp:1629275)
-    try
+    draws.clear();
+    frame_vertices.clear();
+
+    GLint rank = 0;
+    for (auto const& r : renderables)
     {
-        typedef struct  // Represents parameters of glBlendFuncSeparate()
+        auto const& renderable = *r;
+        ++rank;
+        if (static_cast<std::size_t>(rank) <= retained)
+            continue;
+        if (repaint && !needs_repaint(renderable, repaint.value()))
+            continue;
+
+        Draw d;
+        d.renderable = &renderable;
+        d.rank = rank;
+        d.atlased = false;
+
+        // Small software buffers drawn 1:1 share the atlas texture, so can be drawn together
+        auto const buffer = renderable.buffer();
+        std::optional<mgl::TextureAtlas::Region> atlas_region;
+        if (buffer && buffer->size() == renderable.screen_position().size &&
+            renderable.transformation() == identity)
         {
-            GLenum src_rgb, dst_rgb, src_alpha, dst_alpha;
-        } BlendSeparate;
+            try
+            {
+                atlas_region = texture_atlas->load(renderable);
+            }
+            catch (std::exception const&)
+            {
+                report_exception();
+            }
+        }
 
-        BlendSeparate client_blend;
+        if (atlas_region)
+        {
+            d.fallback_texture = texture_atlas->texture();
+            d.atlased = true;
+        }
+        else
+        {
+            d.texture = std::dynamic_pointer_cast<mg::gl::Texture>(buffer);
+        }
+
+        if (!d.texture && !d.fallback_texture)
+        {
+            try
+            {
+                d.fallback_texture = texture_cache->load(renderable);
+            }
+            catch (std::exception const&)
+            {
+                report_exception();
+            }
+        }
+
+        bool const alpha = renderable.alpha() < 1.0f;
+        if (d.texture)
+        {
+            auto const& family = static_cast<::Program const&>(d.texture->shader(*program_factory));
+            d.program = alpha ? &family.alpha : &family.opaque;
+        }
+        else if (d.fallback_texture)
+        {
+            d.program = alpha ? &alpha_program : &default_program;
+        }
+        else
+        {
+            mir::log_error("Buffer does not support GL rendering!");
+            continue;
+        }
 
         // These renderable method names could be better (see LP: #1236224)
         if (renderable.shaped())  // Client is RGBA:
         {
-            client_blend = {GL_ONE, GL_ONE_MINUS_SRC_ALPHA,
-                            GL_ONE, GL_ONE_MINUS_SRC_ALPHA};
+            d.blend = {GL_ONE, GL_ONE_MINUS_SRC_ALPHA,
+                       GL_ONE, GL_ONE_MINUS_SRC_ALPHA, 1.0f};
+            d.opacity_split = split_by_opacity(renderable);
         }
-        else if (renderable.alpha() == 1.0f)  // RGBX and no window translucency:
+        else if (!alpha)  // RGBX and no window translucency:
         {
-            client_blend = {GL_ONE,  GL_ZERO,
-                            GL_ZERO, GL_ONE};  // Avoid using src_alpha!
+            d.blend = no_blending;  // Avoid using src_alpha!
         }
         else
         {   // Client is RGBX but we also have window translucency.
             // The texture alpha channel is possibly uninitialized so we must be
             // careful and avoid using SRC_ALPHA (LP: #1423462).
-            client_blend = {GL_ONE,  GL_ONE_MINUS_CONSTANT_ALPHA,
-                            GL_ZERO, GL_ONE};
-            glBlendColor(0.0f, 0.0f, 0.0f, renderable.alpha());
+            d.blend = {GL_ONE,  GL_ONE_MINUS_CONSTANT_ALPHA,
+                       GL_ZERO, GL_ONE, renderable.alpha()};
         }
 
+        glm::mat4 transform = renderable.transformation();
+        if (d.texture && (d.texture->layout() == mg::gl::Texture::Layout::TopRowFirst))
+        {
+            // GL textures have (0,0) at bottom-left rather than top-left
+            // We have to invert this texture to get it the way up GL expects.
+            transform *= glm::mat4{
+                1.0, 0.0, 0.0, 0.0,
+                0.0, -1.0, 0.0, 0.0,
+                0.0, 0.0, 1.0, 0.0,
+                -1.0, 1.0, 0.0, 1.0
+            };
+        }
+        if (transform != identity)
+        {
+            d.transform = transform;
+        }
+        else
+        {
+            auto visible = renderable.screen_position();
+            if (auto const clip_area = renderable.clip_area())
+                visible = visible.intersection_with(clip_area.value());
+            d.bounds = visible;
+        }
+
+        primitives.clear();
+        tessellate(primitives, renderable);
+        auto const first_vertex = frame_vertices.size();
         for (auto const& p : primitives)
         {
-            BlendSeparate blend;
+            d.primitives.push_back({p.type, static_cast<GLint>(frame_vertices.size()), p.nvertices});
+            frame_vertices.insert(frame_vertices.end(), p.vertices, p.vertices + p.nvertices);
+        }
 
-            blend = client_blend;
-            if (surface_tex)
+        if (atlas_region)
+        {
+            // Sample the buffer's part of the atlas
+            auto const& region = atlas_region.value();
+            for (auto v = frame_vertices.begin() + first_vertex; v != frame_vertices.end(); ++v)
             {
-                surface_tex->bind();
+                v->texcoord[0] = region.left + v->texcoord[0] * region.width;
+                v->texcoord[1] = region.top + v->texcoord[1] * region.height;
             }
-            else
+        }
+
+        d.opaque = !d.blend.enabled() && !d.opacity_split;
+
+        draws.push_back(std::move(d));
+    }
+
+    if (front_to_back)
+    {
+        /*
+         * The stencil stops opaque draws covering anything above them, so
+         * they go first, nearest first so that they hide as much as possible
+         * of what's below. The rest are drawn back to front over them.
+         */
+        auto const translucent = std::stable_partition(
+            draws.begin(), draws.end(), [](Draw const& d) { return d.opaque; });
+        std::reverse(draws.begin(), translucent);
+
+        sort_draws(draws.begin(), translucent);
+        sort_draws(translucent, draws.end());
+    }
+    else
+    {
+        sort_draws(draws.begin(), draws.end());
+
+        // With the stencil test each draw needs its own reference value, so this is only done here
+        merge_atlas_draws();
+    }
+}
+
+void mrg::Renderer::merge_atlas_draws() const
+{
+    auto const mergeable = [this](Draw const& d)
+        {
+            if (!d.atlased || d.transform || d.opacity_split || d.renderable->clip_area() ||
+                visible_regions.find(d.renderable->id()) != visible_regions.end())
             {
-                texture->bind();
+                return false;
             }
 
-            glVertexAttribPointer(prog.position_attr, 3, GL_FLOAT,
-                                  GL_FALSE, sizeof(mgl::Vertex),
-                                  &p.vertices[0].position);
-            glVertexAttribPointer(prog.texcoord_attr, 2, GL_FLOAT,
-                                  GL_FALSE, sizeof(mgl::Vertex),
-                                  &p.vertices[0].texcoord);
+            return std::all_of(
+                d.primitives.begin(), d.primitives.end(),
+                [](DrawPrimitive const& p)
+                {
+                    return p.type == GL_TRIANGLES || p.type == GL_TRIANGLE_STRIP || p.type == GL_TRIANGLE_FAN;
+                });
+        };
+
+    // Draws of the atlas can be merged if they'd set the same state
+    auto const compatible = [](Draw const& a, Draw const& b)
+        {
+            return a.program == b.program &&
+                   !(a.blend < b.blend) && !(b.blend < a.blend) &&
+                   a.renderable->alpha() == b.renderable->alpha();
+        };
 
-            if (blend.dst_rgb == GL_ZERO)
+    auto const append_triangles = [this](DrawPrimitive const& p)
+        {
+            auto const vertex = [&](GLint i) { return frame_vertices[p.first + i]; };
+            for (GLint i = 0; i < p.count; ++i)
             {
-                glDisable(GL_BLEND);
+                if (p.type == GL_TRIANGLES)
+                {
+                    frame_vertices.push_back(vertex(i));
+                }
+                else if (i + 2 < p.count)
+                {
+                    auto const a = vertex(p.type == GL_TRIANGLE_FAN ? 0 : i);
+                    auto const b = vertex(i + 1);
+                    auto const c = vertex(i + 2);
+                    frame_vertices.push_back(a);
+                    frame_vertices.push_back(b);
+                    frame_vertices.push_back(c);
+                }
             }
-            else
+        };
+
+    auto kept = draws.begin();
+    for (auto run = draws.begin(); run != draws.end();)
+    {
+        auto end = std::next(run);
+        if (mergeable(*run))
+        {
+            while (end != draws.end() && mergeable(*end) && compatible(*run, *end))
+                ++end;
+        }
+
+        if (end - run > 1)
+        {
+            // The vertices are already in screen coordinates, so the run can be one list of triangles
+            GLint const first = frame_vertices.size();
+            for (auto d = run; d != end; ++d)
             {
-                glEnable(GL_BLEND);
-                glBlendFuncSeparate(blend.src_rgb,   blend.dst_rgb,
-                                    blend.src_alpha, blend.dst_alpha);
+                for (auto const& p : d->primitives)
+                    append_triangles(p);
             }
+            run->primitives = {{GL_TRIANGLES, first, static_cast<GLsizei>(frame_vertices.size() - first)}};
+        }
+
+        if (kept != run)
+            *kept = std::move(*run);
+        ++kept;
+        run = end;
+    }
+    draws.erase(kept, draws.end());
+}
+
+void mrg::Renderer::sort_draws(std::vector<Draw>::iterator begin, std::vector<Draw>::iterator end)
+{
+    /*
+     * Anything a draw overlaps must still be drawn before it, so it goes in
+     * a later layer than all of those. Draws within a layer don't overlap
+     * and can go in whatever order is cheapest.
+     */
+    for (auto d = begin; d != end; ++d)
+    {
+        d->layer = 0;
+        for (auto earlier = begin; earlier != d; ++earlier)
+        {
+            if (!d->bounds || !earlier->bounds || d->bounds.value().overlaps(earlier->bounds.value()))
+                d->layer = std::max(d->layer, earlier->layer + 1);
+        }
+    }
+
+    std::stable_sort(
+        begin, end,
+        [](Draw const& a, Draw const& b)
+        {
+            if (a.layer != b.layer)
+                return a.layer < b.layer;
+            if (a.program != b.program)
+                return std::less<Program const*>{}(a.program, b.program);
+            if (a.blend < b.blend || b.blend < a.blend)
+                return a.blend < b.blend;
+            // Keeps draws of the texture atlas together
+            return a.atlased < b.atlased;
+        });
+}
+
+void mrg::Renderer::use_program(Program const& prog) const
+{
+    if (program_in_use == &prog)
+        return;
+
+    if (program_in_use)
+    {
+        // Programs mostly share attribute locations, leaving nothing to swap
+        for (auto const attr : {program_in_use->position_attr, program_in_use->texcoord_attr})
+        {
+            if (attr != prog.position_attr && attr != prog.texcoord_attr)
+                gl_state.disable_vertex_attrib_array(attr);
+        }
+    }
+    program_in_use = &prog;
+
+    gl_state.use_program(prog.id);
+
+    // The tracker skips these unless the display has changed since the program was last used
+    for (auto i = 0u; i < prog.tex_uniforms.size(); ++i)
+    {
+        if (prog.tex_uniforms[i] != -1)
+        {
+            gl_state.uniform(prog.tex_uniforms[i], static_cast<GLint>(i));
+        }
+    }
+    gl_state.uniform(prog.display_transform_uniform, display_transform);
+    gl_state.uniform(prog.screen_to_gl_coords_uniform, screen_to_gl_coords);
+
+    gl_state.enable_vertex_attrib_array(prog.position_attr);
+    gl_state.enable_vertex_attrib_array(prog.texcoord_attr);
+    gl_state.vertex_attrib_pointer(prog.position_attr, 3, sizeof(mgl::Vertex), offsetof(mgl::Vertex, position));
+    gl_state.vertex_attrib_pointer(prog.texcoord_attr, 2, sizeof(mgl::Vertex), offsetof(mgl::Vertex, texcoord));
+}
+
+void mrg::Renderer::draw(Draw const& d) const
+{
+    static glm::mat4 const identity(1);
+
+    auto const& renderable = *d.renderable;
+    auto const clip_area = renderable.clip_area();
+    auto const visible_region = visible_regions.find(renderable.id());
+    auto const* const visible_parts =
+        visible_region != visible_regions.end() ? &visible_region->second : nullptr;
+
+    /*
+     * Scissoring is left as the previous draw needed it, so consecutive
+     * draws that are (or aren't) scissored don't toggle it in between.
+     */
+    if (clip_area || d.opacity_split || visible_parts)
+    {
+        gl_state.enable(GL_SCISSOR_TEST);
+        if (clip_area)
+            scissor_to(repaint ? clip_area.value().intersection_with(repaint.value()) : clip_area.value());
+    }
+    else if (repaint)
+    {
+        scissor_to(repaint.value());
+    }
+    else
+    {
+        gl_state.disable(GL_SCISSOR_TEST);
+    }
+
+    if (front_to_back)
+    {
+        // Only draw where nothing opaque above has been drawn, and mark what opaque draws cover
+        gl_state.stencil_func(GL_GREATER, d.rank, 0xff);
+        gl_state.stencil_op(GL_KEEP, GL_KEEP, d.opaque ? GL_REPLACE : GL_KEEP);
+    }
+
+    auto const& prog = *d.program;
+    use_program(prog);
+
+    if (d.transform)
+    {
+        auto const& rect = renderable.screen_position();
+        GLfloat centrex = rect.top_left.x.as_int() +
+                          rect.size.width.as_int() / 2.0f;
+        GLfloat centrey = rect.top_left.y.as_int() +
+                          rect.size.height.as_int() / 2.0f;
+        gl_state.uniform(prog.centre_uniform, glm::vec2{centrex, centrey});
+        gl_state.uniform(prog.transform_uniform, d.transform.value());
+    }
+    else
+    {
+        // The vertices are already in screen coordinates, so the centre doesn't matter
+        gl_state.uniform(prog.transform_uniform, identity);
+    }
+
+    if (prog.alpha_uniform >= 0)
+        gl_state.uniform(prog.alpha_uniform, static_cast<GLfloat>(renderable.alpha()));
+
+    // if we fail to load the texture, we need to carry on (part of lp:1629275)
+    try
+    {
+        auto const apply_blend = [this](BlendState const& blend)
+            {
+                if (!blend.enabled())
+                {
+                    gl_state.disable(GL_BLEND);
+                    return;
+                }
 
-            glDrawArrays(p.type, 0, p.nvertices);
+                gl_state.enable(GL_BLEND);
+                if (blend.dst_rgb == GL_ONE_MINUS_CONSTANT_ALPHA)
+                    gl_state.blend_color(0.0f, 0.0f, 0.0f, blend.constant_alpha);
+                gl_state.blend_func(blend.src_rgb,   blend.dst_rgb,
+                                    blend.src_alpha, blend.dst_alpha);
+            };
+
+        auto const draw_clipped = [&](DrawPrimitive const& p, geom::Rectangle area)
+            {
+                if (clip_area)
+                    area = area.intersection_with(clip_area.value());
+                if (repaint)
+                    area = area.intersection_with(repaint.value());
+
+                if (area.size.width.as_int() > 0 && area.size.height.as_int() > 0)
+                {
+                    scissor_to(area);
+                    glDrawArrays(p.type, p.first, p.count);
+                }
+            };
+
+        // Draw the primitive once for each (visible) part of the renderable, scissored to that part
+        auto const draw_scissored = [&](DrawPrimitive const& p, geom::Rectangles const& parts)
+            {
+                for (auto const& part : parts)
+                {
+                    if (visible_parts)
+                    {
+                        for (auto const& visible : *visible_parts)
+                            draw_clipped(p, part.intersection_with(visible));
+                    }
+                    else
+                    {
+                        draw_clipped(p, part);
+                    }
+                }
+            };
+
+        if (d.fallback_texture)
+        {
+            d.fallback_texture->bind();
+        }
+        else
+        {
+            d.texture->bind();
+        }
+
+        for (auto const& p : d.primitives)
+        {
+            if (d.opacity_split)
+            {
+                apply_blend(no_blending);
+                draw_scissored(p, d.opacity_split->opaque);
 
-            if (texture)
+                apply_blend(d.blend);
+                draw_scissored(p, d.opacity_split->translucent);
+            }
+            else if (visible_parts)
+            {
+                apply_blend(d.blend);
+                draw_scissored(p, *visible_parts);
+            }
+            else
             {
-                // We're done with the texture for now
-                texture->add_syncpoint();
+                apply_blend(d.blend);
+                glDrawArrays(p.type, p.first, p.count);
             }
         }
+
+        if (d.texture)
+        {
+            // We're done with the texture for now
+            d.texture->add_syncpoint();
+        }
     }
     catch (std::exception const& ex)
     {
         report_exception();
     }
-
-    glDisableVertexAttribArray(prog.texcoord_attr);
-    glDisableVertexAttribArray(prog.position_attr);
-    if (renderable.clip_area())
-    {
-        glDisable(GL_SCISSOR_TEST);
-    }
 }
 
 void mrg::Renderer::set_viewport(geometry::Rectangle const& rect)
@@ -690,6 +1361,7 @@ void mrg::Renderer::set_viewport(geometry::Rectangle const& rect)
 
     viewport = rect;
     update_gl_viewport();
+    reset_damage_history();
 }
 
 void mrg::Renderer::update_gl_viewport()
@@ -710,6 +1382,8 @@ void mrg::Renderer::update_gl_viewport()
     auto surf = eglGetCurrentSurface(EGL_DRAW);
     EGLint buf_width = 0, buf_height = 0;
 
+    partial_repaint_possible = false;
+
     if (viewport_width > 0.0f && viewport_height > 0.0f &&
         eglQuerySurface(dpy, surf, EGL_WIDTH, &buf_width) && buf_width > 0 &&
         eglQuerySurface(dpy, surf, EGL_HEIGHT, &buf_height) && buf_height > 0)
@@ -725,6 +1399,17 @@ void mrg::Renderer::update_gl_viewport()
         GLint offset_y = (buf_height - reduced_height) / 2;
 
         glViewport(offset_x, offset_y, reduced_width, reduced_height);
+
+        /*
+         * Partial repaints (and damage hints) are expressed in screen
+         * coordinates so we only attempt them when those map 1:1 onto the
+         * buffer. Rotated, scaled and letterboxed outputs get full repaints.
+         */
+        partial_repaint_possible =
+            display_transform == glm::mat4(1) &&
+            offset_x == 0 && offset_y == 0 &&
+            reduced_width == viewport.size.width.as_int() &&
+            reduced_height == viewport.size.height.as_int();
     }
 }
 
@@ -735,11 +1420,26 @@ void mrg::Renderer::set_output_transform(glm::mat2 const& t)
     {
         display_transform = new_display_transform;
         update_gl_viewport();
+        reset_damage_history();
     }
 }
 
+void mrg::Renderer::set_damage(geom::Rectangles const& damage)
+{
+    pending_damage = damage;
+}
+
+void mrg::Renderer::set_visible_regions(VisibleRegions const& regions)
+{
+    visible_regions = regions;
+}
+
 void mrg::Renderer::suspend()
 {
     texture_cache->invalidate();
+    texture_atlas->invalidate();
+
+    // Whatever was on screen meanwhile didn't come from our buffers
+    reset_damage_history();
 }
 
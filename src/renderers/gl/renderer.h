@@ -19,28 +19,35 @@
 #ifndef MIR_RENDERER_GL_RENDERER_H_
 #define MIR_RENDERER_GL_RENDERER_H_
 
+#include "gpu_timer.h"
 #include "program_family.h"
+#include "retained_layer.h"
+#include "state_tracker.h"
 
 #include <mir/renderer/renderer.h>
 #include <mir/geometry/rectangle.h>
+#include <mir/geometry/rectangles.h>
 #include <mir/graphics/buffer_id.h>
 #include <mir/graphics/renderable.h>
 #include <mir/gl/primitive.h>
 #include "mir/renderer/gl/render_target.h"
 
 #include <GLES2/gl2.h>
+#include <deque>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 namespace mir
 {
-namespace gl { class TextureCache; }
+namespace gl { class TextureCache; class TextureAtlas; }
 namespace graphics { class DisplayBuffer; }
 namespace renderer
 {
 namespace gl
 {
+class ProgramBinaryCache;
 
 class CurrentRenderTarget
 {
@@ -51,6 +58,8 @@ public:
     void ensure_current();
     void bind();
     void swap_buffers();
+    void swap_buffers_with_damage(geometry::Rectangles const& damage);
+    int buffer_age() const;
 
 private:
     renderer::gl::RenderTarget* const render_target;
@@ -60,12 +69,27 @@ class Renderer : public renderer::Renderer
 {
 public:
     Renderer(graphics::DisplayBuffer& display_buffer);
+    /**
+     * Programs are created from (and their binaries kept in) program_binaries,
+     * textures of renderables not in the frame are kept within
+     * texture_cache_budget bytes, and the GPU's work is timed as gpu_timing says
+     */
+    Renderer(
+        graphics::DisplayBuffer& display_buffer,
+        std::shared_ptr<ProgramBinaryCache> const& program_binaries,
+        std::size_t texture_cache_budget,
+        GPUTimer::Mode gpu_timing);
     virtual ~Renderer();
 
     // These are called with a valid GL context:
     void set_viewport(geometry::Rectangle const& rect) override;
     void set_output_transform(glm::mat2 const&) override;
+    void set_damage(geometry::Rectangles const& damage) override;
+    void set_visible_regions(VisibleRegions const& regions) override;
     void render(graphics::RenderableList const&) const override;
+    StateChanges state_changes() const override;
+    TextureCacheUse texture_cache_use() const override;
+    std::vector<GPUFrameTiming> gpu_timings() override;
 
     // This is called _without_ a GL context:
     void suspend() override;
@@ -85,7 +109,6 @@ public:
         GLint transform_uniform = -1;
         GLint screen_to_gl_coords_uniform = -1;
         GLint alpha_uniform = -1;
-        mutable long long last_used_frameno = 0;
 
         Program(GLuint program_id);
     };
@@ -123,18 +146,81 @@ protected:
     static const GLchar* const default_fshader;
     static const GLchar* const alpha_fshader;
 
-    virtual void draw(graphics::Renderable const& renderable) const;
-
 private:
+    struct Draw;
+
+    /**
+     * Work out what needs drawing this frame, with the vertices of everything
+     * in frame_vertices, and sort it into as few state changes as possible
+     */
+    void prepare_draws(graphics::RenderableList const& renderables, std::size_t retained) const;
+    /// Turn runs of draws from the texture atlas that only differ in position into one draw each
+    void merge_atlas_draws() const;
+    /// Upload frame_vertices and make the prepared draws, over the retained layer if wanted
+    void make_draws(bool over_retained_layer) const;
+    /**
+     * Bring the retained layer up to date with any run of unchanging
+     * renderables at the bottom of the stack.
+     * \returns How many renderables the layer draws in place of
+     */
+    std::size_t retain_unchanging(graphics::RenderableList const& renderables) const;
+    void draw_retained_layer(GLint first_vertex) const;
+    /// Order draws so that each comes after anything it overlaps that comes before it
+    static void sort_draws(std::vector<Draw>::iterator begin, std::vector<Draw>::iterator end);
+    void draw(Draw const& draw) const;
+    void use_program(Program const& prog) const;
+
     void update_gl_viewport();
+    void reset_damage_history();
+    std::optional<geometry::Rectangle> repaint_area(geometry::Rectangles const& frame_damage) const;
+    void scissor_to(geometry::Rectangle const& area) const;
 
     class ProgramFactory;
     std::unique_ptr<ProgramFactory> const program_factory;
     std::unique_ptr<mir::gl::TextureCache> const texture_cache;
+    TextureCacheUse mutable last_texture_cache_use;
+    /// Shared texture for small software buffers
+    std::unique_ptr<mir::gl::TextureAtlas> const texture_atlas;
     geometry::Rectangle viewport;
     glm::mat4 screen_to_gl_coords;
     glm::mat4 display_transform;
     std::vector<mir::gl::Primitive> mutable primitives;
+
+    /// This frame's draws, in the order they'll be made
+    std::vector<Draw> mutable draws;
+    /// The vertices of every primitive drawn this frame, streamed to vertex_buffer
+    std::vector<mir::gl::Vertex> mutable frame_vertices;
+    GLuint vertex_buffer{0};
+
+    /*
+     * With a stencil buffer, opaque draws can be made nearest first with
+     * the stencil test rejecting whatever they hide, and the rest drawn
+     * after them from the back. Each draw's stencil reference is its place
+     * in the stack, so there is a limit to how many renderables this copes with.
+     */
+    GLint max_stencil_rank{0};
+    bool mutable front_to_back{false};
+
+    /// Renderer-owned GL state; changes made through it are counted per frame
+    StateTracker mutable gl_state;
+
+    /// Times the GPU's work, when asked to
+    std::unique_ptr<GPUTimer> const gpu_timer;
+    std::vector<GPUFrameTiming> mutable finished_gpu_frames;
+
+    /// The bottom of the stack, composited once it stops changing
+    RetainedLayer mutable retained_layer;
+    mutable Program const* program_in_use{nullptr};
+
+    /*
+     * Damage for the most recent frames, newest first. Together with the
+     * buffer age this tells us how much of the back buffer is stale.
+     */
+    std::optional<geometry::Rectangles> mutable pending_damage;
+    VisibleRegions mutable visible_regions;
+    std::deque<geometry::Rectangles> mutable damage_history;
+    bool partial_repaint_possible{false};
+    std::optional<geometry::Rectangle> mutable repaint;
 };
 
 }
@@ -18,13 +18,29 @@
 
 #include "renderer_factory.h"
 #include "renderer.h"
+#include "program_binary_cache.h"
+#include "mir/gl/default_program_factory.h"
 #include "mir/graphics/display_buffer.h"
 
 namespace mrg = mir::renderer::gl;
 
+mrg::RendererFactory::RendererFactory()
+    : RendererFactory(mir::gl::DefaultProgramFactory::default_texture_cache_budget, GPUTimer::Mode::off)
+{
+}
+
+mrg::RendererFactory::RendererFactory(std::size_t texture_cache_budget, GPUTimer::Mode gpu_timing)
+    : program_binaries{std::make_shared<ProgramBinaryCache>(ProgramBinaryCache::default_cache_dir())},
+      texture_cache_budget{texture_cache_budget},
+      gpu_timing{gpu_timing}
+{
+}
+
+mrg::RendererFactory::~RendererFactory() = default;
+
 std::unique_ptr<mir::renderer::Renderer>
 mrg::RendererFactory::create_renderer_for(
     graphics::DisplayBuffer& display_buffer)
 {
-    return std::make_unique<Renderer>(display_buffer);
+    return std::make_unique<Renderer>(display_buffer, program_binaries, texture_cache_budget, gpu_timing);
 }
@@ -19,8 +19,12 @@
 #ifndef MIR_RENDERER_GL_RENDERER_FACTORY_H_
 #define MIR_RENDERER_GL_RENDERER_FACTORY_H_
 
+#include "gpu_timer.h"
 #include "mir/renderer/renderer_factory.h"
 
+#include <cstddef>
+#include <memory>
+
 namespace mir
 {
 namespace renderer
@@ -28,11 +32,27 @@ namespace renderer
 namespace gl
 {
 
+class ProgramBinaryCache;
+
 class RendererFactory : public renderer::RendererFactory
 {
 public:
+    RendererFactory();
+    /**
+     * Renderers keep textures of renderables not in the frame within
+     * texture_cache_budget bytes, and time the GPU's work as gpu_timing says
+     */
+    RendererFactory(std::size_t texture_cache_budget, GPUTimer::Mode gpu_timing);
+    ~RendererFactory();
+
     std::unique_ptr<renderer::Renderer> create_renderer_for(
         graphics::DisplayBuffer& display_buffer) override;
+
+private:
+    /// Shared by every renderer, so that each program is only linked once
+    std::shared_ptr<ProgramBinaryCache> const program_binaries;
+    std::size_t const texture_cache_budget;
+    GPUTimer::Mode const gpu_timing;
 };
 
 }
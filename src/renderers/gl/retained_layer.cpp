@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define MIR_LOG_COMPONENT "GLRenderer"
+
+#include "retained_layer.h"
+#include "mir/graphics/buffer.h"
+#include "mir/log.h"
+
+#include <algorithm>
+
+namespace mg = mir::graphics;
+namespace geom = mir::geometry;
+namespace mrg = mir::renderer::gl;
+
+bool mrg::RetainedLayer::State::operator==(State const& other) const
+{
+    return id == other.id && buffer == other.buffer &&
+           position == other.position && clip_area == other.clip_area &&
+           alpha == other.alpha && transformation == other.transformation &&
+           shaped == other.shaped;
+}
+
+mrg::RetainedLayer::~RetainedLayer()
+{
+    if (framebuffer)
+        glDeleteFramebuffers(1, &framebuffer);
+    if (texture)
+        glDeleteTextures(1, &texture);
+}
+
+auto mrg::RetainedLayer::state_of(mg::Renderable const& renderable) -> State
+{
+    auto const buffer = renderable.buffer();
+    std::optional<geom::Rectangle> clip_area;
+    if (auto const clip = renderable.clip_area())
+        clip_area = clip.value();
+
+    return {
+        renderable.id(),
+        buffer ? buffer->id() : mg::BufferID{},
+        renderable.screen_position(),
+        clip_area,
+        renderable.alpha(),
+        renderable.transformation(),
+        renderable.shaped()};
+}
+
+std::size_t mrg::RetainedLayer::update(mg::RenderableList const& renderables)
+{
+    ++frameno;
+    current.clear();
+
+    std::size_t retainable = 0;
+    bool run_unbroken = true;
+    for (auto const& renderable : renderables)
+    {
+        current.push_back(state_of(*renderable));
+        auto const& state = current.back();
+
+        auto const inserted = tracked.emplace(state.id, Tracked{state, 0, frameno});
+        auto& t = inserted.first->second;
+        if (!inserted.second)
+        {
+            if (t.state == state)
+            {
+                ++t.unchanged_frames;
+            }
+            else
+            {
+                t.state = state;
+                t.unchanged_frames = 0;
+            }
+            t.last_seen = frameno;
+        }
+
+        run_unbroken = run_unbroken && t.unchanged_frames >= frames_to_retain;
+        if (run_unbroken)
+            ++retainable;
+    }
+
+    // Forget whatever has left the stack
+    for (auto i = tracked.begin(); i != tracked.end();)
+    {
+        if (i->second.last_seen != frameno)
+            i = tracked.erase(i);
+        else
+            ++i;
+    }
+
+    return retainable;
+}
+
+bool mrg::RetainedLayer::holds(std::size_t count) const
+{
+    return count <= current.size() && held.size() == count &&
+           std::equal(held.begin(), held.end(), current.begin());
+}
+
+bool mrg::RetainedLayer::bind_framebuffer(geom::Size const& size)
+{
+    if (unusable)
+        return false;
+
+    if (!framebuffer)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &texture);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    if (size != texture_size)
+    {
+        held.clear();
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+                     size.width.as_int(), size.height.as_int(),
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        texture_size = size;
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            mir::log_info("Can't draw into textures; not retaining unchanging renderables");
+            unusable = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void mrg::RetainedLayer::filled(std::size_t count)
+{
+    held.assign(current.begin(), current.begin() + std::min(count, current.size()));
+}
+
+void mrg::RetainedLayer::bind_texture() const
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
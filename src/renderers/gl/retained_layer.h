@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_RENDERER_GL_RETAINED_LAYER_H_
+#define MIR_RENDERER_GL_RETAINED_LAYER_H_
+
+#include <mir/geometry/rectangle.h>
+#include <mir/graphics/buffer_id.h>
+#include <mir/graphics/renderable.h>
+
+#include <GLES2/gl2.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace mir
+{
+namespace renderer
+{
+namespace gl
+{
+
+/**
+ * RetainedLayer keeps the bottom of the stack of renderables (wallpaper,
+ * panels and the like) composited into a texture once it has stopped
+ * changing, so that frames can draw that one texture in place of all of it.
+ *
+ * A renderable has changed if it has a new buffer (which is how clients
+ * submit new content) or has been moved, resized, clipped, transformed or
+ * made more or less translucent.
+ *
+ * \note bind_framebuffer(), bind_texture() and destruction need a current GL context
+ */
+class RetainedLayer
+{
+public:
+    /// Frames a renderable must be unchanged for before it is retained
+    static constexpr unsigned int frames_to_retain = 4;
+
+    RetainedLayer() = default;
+    ~RetainedLayer();
+
+    RetainedLayer(RetainedLayer const&) = delete;
+    RetainedLayer& operator=(RetainedLayer const&) = delete;
+
+    /**
+     * Note which renderables have changed since the last frame
+     *
+     * \returns How many renderables, from the bottom of the stack, have been
+     *          unchanged for long enough to retain
+     */
+    std::size_t update(graphics::RenderableList const& renderables);
+
+    /// Whether the texture holds the bottom count renderables as they are now
+    bool holds(std::size_t count) const;
+
+    /**
+     * Bind a framebuffer that draws into the texture, reallocating it if
+     * it isn't the given size.
+     *
+     * \returns false if the framebuffer can't be used
+     */
+    bool bind_framebuffer(geometry::Size const& size);
+
+    /// Record that the texture now holds the bottom count renderables
+    void filled(std::size_t count);
+
+    /// Bind the texture to the active texture unit
+    void bind_texture() const;
+
+private:
+    /// What a renderable looks like, as far as drawing it is concerned
+    struct State
+    {
+        graphics::Renderable::ID id;
+        graphics::BufferID buffer;
+        geometry::Rectangle position;
+        std::optional<geometry::Rectangle> clip_area;
+        float alpha;
+        glm::mat4 transformation;
+        bool shaped;
+
+        bool operator==(State const& other) const;
+    };
+
+    struct Tracked
+    {
+        State state;
+        unsigned int unchanged_frames;
+        unsigned long long last_seen;
+    };
+
+    static State state_of(graphics::Renderable const& renderable);
+
+    /// The renderables in this frame's stack, bottom first
+    std::vector<State> current;
+    std::unordered_map<graphics::Renderable::ID, Tracked> tracked;
+    unsigned long long frameno{0};
+
+    /// The renderables the texture holds, bottom first
+    std::vector<State> held;
+    GLuint framebuffer{0};
+    GLuint texture{0};
+    geometry::Size texture_size;
+    /// Set once we know this context can't draw into textures
+    bool unusable{false};
+};
+
+}
+}
+}
+
+#endif // MIR_RENDERER_GL_RETAINED_LAYER_H_
@@ -0,0 +1,289 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "state_tracker.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+
+namespace mrg = mir::renderer::gl;
+
+bool mrg::StateTracker::AttribPointer::operator==(AttribPointer const& other) const
+{
+    return buffer == other.buffer && size == other.size &&
+           stride == other.stride && offset == other.offset;
+}
+
+void mrg::StateTracker::forget()
+{
+    blend_enabled = std::nullopt;
+    scissor_enabled = std::nullopt;
+    stencil_enabled = std::nullopt;
+    program = std::nullopt;
+    texture_unit = std::nullopt;
+    array_buffer = std::nullopt;
+    vertex_attribs = {};
+    blend_function = std::nullopt;
+    blend_colour = std::nullopt;
+    scissor_box = std::nullopt;
+    stencil_function = std::nullopt;
+    stencil_operation = std::nullopt;
+}
+
+void mrg::StateTracker::assume_disabled(GLenum cap)
+{
+    if (auto const state = capability(cap))
+        *state = false;
+}
+
+void mrg::StateTracker::enable(GLenum cap)
+{
+    auto const state = capability(cap);
+    if (!state)
+    {
+        changing(true);
+        glEnable(cap);
+    }
+    else if (changing(*state != true))
+    {
+        glEnable(cap);
+        *state = true;
+    }
+}
+
+void mrg::StateTracker::disable(GLenum cap)
+{
+    auto const state = capability(cap);
+    if (!state)
+    {
+        changing(true);
+        glDisable(cap);
+    }
+    else if (changing(*state != false))
+    {
+        glDisable(cap);
+        *state = false;
+    }
+}
+
+void mrg::StateTracker::use_program(GLuint id)
+{
+    if (changing(program != id))
+    {
+        glUseProgram(id);
+        program = id;
+    }
+}
+
+void mrg::StateTracker::active_texture(GLenum unit)
+{
+    if (changing(texture_unit != unit))
+    {
+        glActiveTexture(unit);
+        texture_unit = unit;
+    }
+}
+
+void mrg::StateTracker::bind_array_buffer(GLuint buffer)
+{
+    if (changing(array_buffer != buffer))
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        array_buffer = buffer;
+    }
+}
+
+void mrg::StateTracker::enable_vertex_attrib_array(GLuint index)
+{
+    if (index >= vertex_attribs.size())
+    {
+        changing(true);
+        glEnableVertexAttribArray(index);
+    }
+    else if (changing(vertex_attribs[index].enabled != true))
+    {
+        glEnableVertexAttribArray(index);
+        vertex_attribs[index].enabled = true;
+    }
+}
+
+void mrg::StateTracker::disable_vertex_attrib_array(GLuint index)
+{
+    if (index >= vertex_attribs.size())
+    {
+        changing(true);
+        glDisableVertexAttribArray(index);
+    }
+    else if (changing(vertex_attribs[index].enabled != false))
+    {
+        glDisableVertexAttribArray(index);
+        vertex_attribs[index].enabled = false;
+    }
+}
+
+void mrg::StateTracker::vertex_attrib_pointer(GLuint index, GLint size, GLsizei stride, std::size_t offset)
+{
+    auto const set_pointer = [&]
+        {
+            glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, stride,
+                                  reinterpret_cast<void const*>(offset));
+        };
+
+    // The pointer refers to whatever buffer is bound, so we can only skip it if we know which
+    if (index >= vertex_attribs.size() || !array_buffer)
+    {
+        changing(true);
+        set_pointer();
+        return;
+    }
+
+    AttribPointer const pointer{array_buffer.value(), size, stride, offset};
+    auto& current = vertex_attribs[index].pointer;
+    if (changing(!current || !(current.value() == pointer)))
+    {
+        set_pointer();
+        current = pointer;
+    }
+}
+
+void mrg::StateTracker::blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+{
+    std::array<GLenum, 4> const function{{src_rgb, dst_rgb, src_alpha, dst_alpha}};
+    if (changing(blend_function != function))
+    {
+        glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+        blend_function = function;
+    }
+}
+
+void mrg::StateTracker::blend_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+    std::array<GLfloat, 4> const colour{{red, green, blue, alpha}};
+    if (changing(blend_colour != colour))
+    {
+        glBlendColor(red, green, blue, alpha);
+        blend_colour = colour;
+    }
+}
+
+void mrg::StateTracker::scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    std::array<GLint, 4> const box{{x, y, width, height}};
+    if (changing(scissor_box != box))
+    {
+        glScissor(x, y, width, height);
+        scissor_box = box;
+    }
+}
+
+void mrg::StateTracker::stencil_func(GLenum func, GLint ref, GLuint mask)
+{
+    auto const function = std::make_tuple(func, ref, mask);
+    if (changing(stencil_function != function))
+    {
+        glStencilFunc(func, ref, mask);
+        stencil_function = function;
+    }
+}
+
+void mrg::StateTracker::stencil_op(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass)
+{
+    std::array<GLenum, 3> const operation{{stencil_fail, depth_fail, depth_pass}};
+    if (changing(stencil_operation != operation))
+    {
+        glStencilOp(stencil_fail, depth_fail, depth_pass);
+        stencil_operation = operation;
+    }
+}
+
+void mrg::StateTracker::uniform(GLint location, GLint value)
+{
+    if (uniform_changing(location, &value, sizeof value))
+        glUniform1i(location, value);
+}
+
+void mrg::StateTracker::uniform(GLint location, GLfloat value)
+{
+    if (uniform_changing(location, &value, sizeof value))
+        glUniform1f(location, value);
+}
+
+void mrg::StateTracker::uniform(GLint location, glm::vec2 const& value)
+{
+    if (uniform_changing(location, glm::value_ptr(value), sizeof(GLfloat) * 2))
+        glUniform2f(location, value.x, value.y);
+}
+
+void mrg::StateTracker::uniform(GLint location, glm::mat4 const& value)
+{
+    if (uniform_changing(location, glm::value_ptr(value), sizeof(GLfloat) * 16))
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+auto mrg::StateTracker::changes() const -> Renderer::StateChanges
+{
+    return counts;
+}
+
+void mrg::StateTracker::reset_changes()
+{
+    counts = {};
+}
+
+bool mrg::StateTracker::changing(bool changed)
+{
+    if (changed)
+        ++counts.made;
+    else
+        ++counts.skipped;
+
+    return changed;
+}
+
+bool mrg::StateTracker::uniform_changing(GLint location, void const* value, std::size_t size)
+{
+    // Setting a missing uniform does nothing, so there's nothing to remember
+    if (location < 0)
+        return changing(true);
+
+    if (!program)
+        return changing(true);
+
+    auto const bytes = static_cast<unsigned char const*>(value);
+    auto& current = uniforms[{program.value(), location}];
+    if (!changing(current.size() != size || std::memcmp(current.data(), bytes, size) != 0))
+        return false;
+
+    current.assign(bytes, bytes + size);
+    return true;
+}
+
+std::optional<bool>* mrg::StateTracker::capability(GLenum cap)
+{
+    switch (cap)
+    {
+    case GL_BLEND:
+        return &blend_enabled;
+    case GL_SCISSOR_TEST:
+        return &scissor_enabled;
+    case GL_STENCIL_TEST:
+        return &stencil_enabled;
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_RENDERER_GL_STATE_TRACKER_H_
+#define MIR_RENDERER_GL_STATE_TRACKER_H_
+
+#include <mir/renderer/renderer.h>
+
+#include <GLES2/gl2.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mir
+{
+namespace renderer
+{
+namespace gl
+{
+
+/**
+ * StateTracker remembers the GL state the renderer has set and drops calls
+ * that wouldn't change it. Drivers validate state on every call whether or
+ * not it changes anything, which is costly when repeated for each renderable.
+ *
+ * Anything not yet set (or since forgotten) is unknown, and setting it is
+ * always passed on to GL. Uniform values are kept per program, and so are
+ * remembered across forget().
+ */
+class StateTracker
+{
+public:
+    StateTracker() = default;
+    StateTracker(StateTracker const&) = delete;
+    StateTracker& operator=(StateTracker const&) = delete;
+
+    /// Forget the context state; other code may have changed it since
+    void forget();
+    /// Record a capability as disabled without calling GL
+    void assume_disabled(GLenum cap);
+
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void use_program(GLuint program);
+    void active_texture(GLenum unit);
+    void bind_array_buffer(GLuint buffer);
+    void enable_vertex_attrib_array(GLuint index);
+    void disable_vertex_attrib_array(GLuint index);
+    /// glVertexAttribPointer() for a float attribute in the bound array buffer
+    void vertex_attrib_pointer(GLuint index, GLint size, GLsizei stride, std::size_t offset);
+    void blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+    void blend_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+    void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+    void stencil_func(GLenum func, GLint ref, GLuint mask);
+    void stencil_op(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass);
+
+    // Uniforms of the program in use
+    void uniform(GLint location, GLint value);
+    void uniform(GLint location, GLfloat value);
+    void uniform(GLint location, glm::vec2 const& value);
+    void uniform(GLint location, glm::mat4 const& value);
+
+    /// State changes made and skipped since the last reset_changes()
+    Renderer::StateChanges changes() const;
+    void reset_changes();
+
+private:
+    struct AttribPointer
+    {
+        GLuint buffer;
+        GLint size;
+        GLsizei stride;
+        std::size_t offset;
+
+        bool operator==(AttribPointer const& other) const;
+    };
+
+    struct VertexAttrib
+    {
+        std::optional<bool> enabled;
+        std::optional<AttribPointer> pointer;
+    };
+
+    /// Count a change, returning whether it needs making
+    bool changing(bool changed);
+    /// Whether a uniform of the program in use needs setting to value
+    bool uniform_changing(GLint location, void const* value, std::size_t size);
+    std::optional<bool>* capability(GLenum cap);
+
+    std::optional<bool> blend_enabled;
+    std::optional<bool> scissor_enabled;
+    std::optional<bool> stencil_enabled;
+    std::optional<GLuint> program;
+    std::optional<GLenum> texture_unit;
+    std::optional<GLuint> array_buffer;
+    /// Indexed by attribute; GL guarantees at least 8 of them
+    std::array<VertexAttrib, 8> vertex_attribs;
+    std::optional<std::array<GLenum, 4>> blend_function;
+    std::optional<std::array<GLfloat, 4>> blend_colour;
+    std::optional<std::array<GLint, 4>> scissor_box;
+    std::optional<std::tuple<GLenum, GLint, GLuint>> stencil_function;
+    std::optional<std::array<GLenum, 3>> stencil_operation;
+
+    /// Raw uniform values, by program and location
+    std::map<std::pair<GLuint, GLint>, std::vector<unsigned char>> uniforms;
+
+    Renderer::StateChanges counts;
+};
+
+}
+}
+}
+
+#endif // MIR_RENDERER_GL_STATE_TRACKER_H_
@@ -0,0 +1,567 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "renderer.h"
+#include "mir/graphics/buffer.h"
+#include "mir/graphics/display_buffer.h"
+#include "mir/graphics/pixel_ops.h"
+#include "mir/renderer/sw/pixel_source.h"
+#include "mir/renderer/sw/render_target.h"
+#include "mir/thread/basic_thread_pool.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+namespace mg = mir::graphics;
+namespace mrs = mir::renderer::software;
+namespace geom = mir::geometry;
+
+namespace
+{
+std::size_t const max_damage_history{4};
+
+std::uint32_t const clear_colour{0xff000000};
+std::uint32_t const opaque_alpha{0xff000000};
+
+/// 16.16 fixed point
+std::int64_t const one{1 << 16};
+
+std::int64_t fixed(double value)
+{
+    return std::llround(value * one);
+}
+
+bool supported(MirPixelFormat format)
+{
+    switch (format)
+    {
+    case mir_pixel_format_argb_8888:
+    case mir_pixel_format_xrgb_8888:
+    case mir_pixel_format_abgr_8888:
+    case mir_pixel_format_xbgr_8888:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool red_first(MirPixelFormat format)
+{
+    return format == mir_pixel_format_abgr_8888 || format == mir_pixel_format_xbgr_8888;
+}
+
+bool opaque(MirPixelFormat format)
+{
+    return format == mir_pixel_format_xrgb_8888 || format == mir_pixel_format_xbgr_8888;
+}
+
+bool empty(geom::Rectangle const& rect)
+{
+    return rect.size.width.as_int() <= 0 || rect.size.height.as_int() <= 0;
+}
+
+/// The pixels covering the area between two corners, allowing for rounding errors
+geom::Rectangle covering(glm::dvec2 const& from, glm::dvec2 const& to)
+{
+    double const slack = 1e-6;
+    auto const left = static_cast<int>(std::floor(std::min(from.x, to.x) + slack));
+    auto const top = static_cast<int>(std::floor(std::min(from.y, to.y) + slack));
+    auto const right = static_cast<int>(std::ceil(std::max(from.x, to.x) - slack));
+    auto const bottom = static_cast<int>(std::ceil(std::max(from.y, to.y) - slack));
+    return {{left, top}, {std::max(right - left, 0), std::max(bottom - top, 0)}};
+}
+}
+
+struct mrs::Renderer::Layer
+{
+    /// The buffer drawn from, and however its pixels are read
+    std::shared_ptr<mg::Buffer> buffer;
+    PixelSource* pixel_source{nullptr};
+    std::unique_ptr<Mapping<unsigned char const>> mapping;
+    std::uint32_t const* pixels{nullptr};
+    int stride{0};
+    int width{0};
+    int height{0};
+
+    bool swap_red_blue{false};
+    std::uint32_t opaque_bits{0};
+    bool blend{false};
+    std::uint8_t alpha{255};
+
+    /*
+     * Output pixel (x, y) shows buffer pixel origin + x × across + y × down,
+     * in 16.16 fixed point. When across and down are unit steps the buffer's
+     * rows are read as they are.
+     */
+    std::int64_t origin_x{0}, origin_y{0};
+    std::int64_t across_x{0}, across_y{0};
+    std::int64_t down_x{0}, down_y{0};
+    bool direct{false};
+    /// Whether the buffer's edges are aligned with the output's
+    bool orthogonal{false};
+
+    /// The output pixels to draw (in this frame's repaint area)
+    std::vector<geom::Rectangle> areas;
+};
+
+mrs::Renderer::Renderer(mg::DisplayBuffer& display_buffer, unsigned int threads)
+    : render_target{dynamic_cast<RenderTarget*>(display_buffer.native_display_buffer())},
+      kernels{mg::pixel_ops()},
+      helper_threads{threads > 1 ? threads - 1 : 0},
+      pool{helper_threads ? std::make_unique<thread::BasicThreadPool>(helper_threads) : nullptr},
+      scratch(helper_threads + 1)
+{
+    if (!render_target)
+        BOOST_THROW_EXCEPTION(std::logic_error("DisplayBuffer does not support software rendering"));
+
+    set_viewport(display_buffer.view_area());
+}
+
+mrs::Renderer::~Renderer() = default;
+
+void mrs::Renderer::set_viewport(geom::Rectangle const& rect)
+{
+    if (rect == viewport)
+        return;
+
+    viewport = rect;
+    update_output_size();
+}
+
+void mrs::Renderer::set_output_transform(glm::mat2 const& t)
+{
+    glm::dmat2 const transform{t};
+    if (transform == output_transform)
+        return;
+
+    output_transform = transform;
+    inverse_output_transform = glm::inverse(transform);
+    update_output_size();
+}
+
+void mrs::Renderer::update_output_size()
+{
+    auto const transformed = output_transform *
+        glm::dvec2{viewport.size.width.as_int(), viewport.size.height.as_int()};
+
+    output_size = geom::Size{
+        static_cast<int>(std::lround(std::abs(transformed.x))),
+        static_cast<int>(std::lround(std::abs(transformed.y)))};
+
+    for (auto& row : scratch)
+        row.resize(output_size.width.as_int());
+
+    damage_history.clear();
+}
+
+void mrs::Renderer::set_damage(geom::Rectangles const& damage)
+{
+    pending_damage = damage;
+}
+
+void mrs::Renderer::set_visible_regions(VisibleRegions const& regions)
+{
+    visible_regions = regions;
+}
+
+void mrs::Renderer::suspend()
+{
+    // Whatever was on screen meanwhile didn't come from our buffers
+    damage_history.clear();
+}
+
+auto mrs::Renderer::state_changes() const -> StateChanges
+{
+    return {};
+}
+
+auto mrs::Renderer::texture_cache_use() const -> TextureCacheUse
+{
+    return {};
+}
+
+auto mrs::Renderer::gpu_timings() -> std::vector<GPUFrameTiming>
+{
+    return {};
+}
+
+/*
+ * The output transform is applied as the GL renderer applies it: about the
+ * centre of the viewport, in coordinates normalised to [-1, 1] with y up.
+ */
+glm::dvec2 mrs::Renderer::to_output(glm::dvec2 screen) const
+{
+    glm::dvec2 const origin{viewport.top_left.x.as_int(), viewport.top_left.y.as_int()};
+    glm::dvec2 const extent{viewport.size.width.as_int(), viewport.size.height.as_int()};
+    glm::dvec2 const output_extent{output_size.width.as_int(), output_size.height.as_int()};
+
+    auto const centred = (screen - origin) / extent * 2.0 - 1.0;
+    auto const turned = output_transform * glm::dvec2{centred.x, -centred.y};
+    return glm::dvec2{turned.x + 1.0, 1.0 - turned.y} / 2.0 * output_extent;
+}
+
+glm::dvec2 mrs::Renderer::to_screen(glm::dvec2 output) const
+{
+    glm::dvec2 const origin{viewport.top_left.x.as_int(), viewport.top_left.y.as_int()};
+    glm::dvec2 const extent{viewport.size.width.as_int(), viewport.size.height.as_int()};
+    glm::dvec2 const output_extent{output_size.width.as_int(), output_size.height.as_int()};
+
+    auto const normalised = output / output_extent * 2.0;
+    auto const centred = inverse_output_transform * glm::dvec2{normalised.x - 1.0, 1.0 - normalised.y};
+    return (glm::dvec2{centred.x, -centred.y} + 1.0) / 2.0 * extent + origin;
+}
+
+geom::Rectangle mrs::Renderer::to_output(geom::Rectangle const& screen) const
+{
+    auto const from = to_output(glm::dvec2{screen.left().as_int(), screen.top().as_int()});
+    auto const to = to_output(glm::dvec2{screen.right().as_int(), screen.bottom().as_int()});
+    return covering(from, to).intersection_with({{0, 0}, output_size});
+}
+
+auto mrs::Renderer::repaint_area(geom::Rectangles const& frame_damage) const
+    -> std::optional<geom::Rectangle>
+{
+    damage_history.push_front(frame_damage);
+    if (damage_history.size() > max_damage_history)
+        damage_history.pop_back();
+
+    // As for the GL renderer: the back buffer is missing the last "age" frames' damage
+    auto const age = render_target->back_buffer_age();
+    if (age <= 0 || static_cast<std::size_t>(age) >= damage_history.size())
+        return std::nullopt;
+
+    geom::Rectangles stale;
+    for (auto i = 0; i != age; ++i)
+    {
+        for (auto const& rect : damage_history[i])
+            stale.add(rect);
+    }
+
+    return stale.bounding_rectangle().intersection_with(viewport);
+}
+
+void mrs::Renderer::render(mg::RenderableList const& renderables) const
+{
+    auto const frame_damage = pending_damage ? pending_damage.value() : geom::Rectangles{viewport};
+    pending_damage = std::nullopt;
+
+    auto const stale = repaint_area(frame_damage);
+
+    auto mapping = render_target->map_back_buffer();
+    if (!supported(mapping->format()))
+        BOOST_THROW_EXCEPTION(std::runtime_error("Software rendering needs a 32-bit RGB output"));
+    output_red_first = red_first(mapping->format());
+
+    geom::Rectangle const output{
+        {0, 0},
+        {std::min(output_size.width.as_int(), mapping->size().width.as_int()),
+         std::min(output_size.height.as_int(), mapping->size().height.as_int())}};
+    auto const repaint = stale ? to_output(stale.value()).intersection_with(output) : output;
+
+    layers.clear();
+    if (!empty(repaint))
+    {
+        for (auto const& renderable : renderables)
+        {
+            layers.emplace_back();
+            if (!prepare(*renderable, repaint, layers.back()))
+                layers.pop_back();
+        }
+
+        auto const pixels = reinterpret_cast<std::uint32_t*>(mapping->data());
+        auto const stride = mapping->stride().as_int() / static_cast<int>(sizeof *pixels);
+        draw_with_pixels(0, [&]() { draw_tiles(pixels, stride, repaint); });
+    }
+
+    // Let go of the clients' buffers before the output's
+    layers.clear();
+    visible_regions.clear();
+
+    mapping.reset();
+    render_target->commit_back_buffer();
+}
+
+bool mrs::Renderer::prepare(mg::Renderable const& renderable, geom::Rectangle const& repaint, Layer& layer) const
+{
+    auto const buffer = renderable.buffer();
+    if (!buffer || !supported(buffer->pixel_format()))
+        return false;
+
+    auto const native = buffer->native_buffer_base();
+    layer.pixel_source = dynamic_cast<PixelSource*>(native);
+    if (!layer.pixel_source &&
+        !dynamic_cast<ReadMappableBuffer*>(native) &&
+        !dynamic_cast<ReadTransferableBuffer*>(native))
+    {
+        return false;
+    }
+
+    auto const alpha = std::lround(std::clamp(renderable.alpha(), 0.0f, 1.0f) * 255);
+    auto const position = renderable.screen_position();
+    layer.width = buffer->size().width.as_int();
+    layer.height = buffer->size().height.as_int();
+    if (alpha == 0 || empty(position) || layer.width <= 0 || layer.height <= 0)
+        return false;
+
+    glm::dmat2 const transform{glm::mat2{renderable.transformation()}};
+    if (std::abs(glm::determinant(transform)) < 1e-6)
+        return false;
+    auto const inverse = glm::inverse(transform);
+
+    // Work back from the output to the buffer, through the transform about the renderable's centre
+    glm::dvec2 const top_left{position.top_left.x.as_int(), position.top_left.y.as_int()};
+    glm::dvec2 const extent{position.size.width.as_int(), position.size.height.as_int()};
+    auto const centre = top_left + extent / 2.0;
+    glm::dvec2 const buffer_scale{layer.width / extent.x, layer.height / extent.y};
+
+    auto const buffer_point = [&](glm::dvec2 output)
+        {
+            return (inverse * (to_screen(output) - centre) + centre - top_left) * buffer_scale;
+        };
+
+    auto const origin = buffer_point({0.5, 0.5});
+    auto const across = buffer_point({1.5, 0.5}) - origin;
+    auto const down = buffer_point({0.5, 1.5}) - origin;
+    layer.origin_x = fixed(origin.x);
+    layer.origin_y = fixed(origin.y);
+    layer.across_x = fixed(across.x);
+    layer.across_y = fixed(across.y);
+    layer.down_x = fixed(down.x);
+    layer.down_y = fixed(down.y);
+    layer.direct = layer.across_x == one && layer.across_y == 0 && layer.down_x == 0 && layer.down_y == one;
+    layer.orthogonal = (layer.across_y == 0 && layer.down_x == 0) || (layer.across_x == 0 && layer.down_y == 0);
+
+    // Where it's drawn: the output pixels covering the transformed screen position
+    auto const corner = [&](double x, double y)
+        {
+            return to_output(transform * (top_left + glm::dvec2{x, y} - centre) + centre);
+        };
+    glm::dvec2 low{corner(0, 0)};
+    glm::dvec2 high{low};
+    for (auto const& point : {corner(extent.x, 0), corner(0, extent.y), corner(extent.x, extent.y)})
+    {
+        low = glm::min(low, point);
+        high = glm::max(high, point);
+    }
+
+    auto drawn = covering(low, high).intersection_with(repaint);
+    if (layer.direct)
+    {
+        // Don't let rounding take us off the edge of the buffer
+        drawn = drawn.intersection_with({
+            {-static_cast<int>(layer.origin_x >> 16), -static_cast<int>(layer.origin_y >> 16)},
+            {layer.width, layer.height}});
+    }
+    if (auto const clip = renderable.clip_area())
+        drawn = drawn.intersection_with(to_output(clip.value()));
+
+    layer.areas.clear();
+    auto const visible = visible_regions.find(renderable.id());
+    if (visible != visible_regions.end())
+    {
+        for (auto const& rect : visible->second)
+        {
+            auto const area = to_output(rect).intersection_with(drawn);
+            if (!empty(area))
+                layer.areas.push_back(area);
+        }
+    }
+    else if (!empty(drawn))
+    {
+        layer.areas.push_back(drawn);
+    }
+
+    if (layer.areas.empty())
+        return false;
+
+    auto const format = buffer->pixel_format();
+    layer.swap_red_blue = red_first(format) != output_red_first;
+    layer.opaque_bits = opaque(format) ? opaque_alpha : 0;
+    layer.alpha = static_cast<std::uint8_t>(alpha);
+    // Sampling off the edge of a rotated buffer leaves clear pixels to blend
+    layer.blend = alpha < 255 || (renderable.shaped() && !opaque(format)) || !layer.orthogonal;
+
+    layer.buffer = buffer;
+    if (layer.pixel_source)
+    {
+        layer.stride = layer.pixel_source->stride().as_int() / static_cast<int>(sizeof *layer.pixels);
+    }
+    else
+    {
+        layer.mapping = as_read_mappable_buffer(buffer)->map_readable();
+        layer.pixels = reinterpret_cast<std::uint32_t const*>(layer.mapping->data());
+        layer.stride = layer.mapping->stride().as_int() / static_cast<int>(sizeof *layer.pixels);
+    }
+
+    return true;
+}
+
+void mrs::Renderer::draw_with_pixels(std::size_t first, std::function<void()> const& draw) const
+{
+    // A PixelSource's pixels are only to be read within read(), so draw within them all
+    for (auto i = first; i != layers.size(); ++i)
+    {
+        if (layers[i].pixel_source)
+        {
+            layers[i].pixel_source->read(
+                [&, i](unsigned char const* pixels)
+                {
+                    layers[i].pixels = reinterpret_cast<std::uint32_t const*>(pixels);
+                    draw_with_pixels(i + 1, draw);
+                    layers[i].pixels = nullptr;
+                });
+            return;
+        }
+    }
+
+    draw();
+}
+
+void mrs::Renderer::draw_tiles(std::uint32_t* pixels, int stride, geom::Rectangle const& repaint) const
+{
+    auto const top = repaint.top().as_int();
+    auto const bottom = repaint.bottom().as_int();
+    int const tiles = (bottom - top + tile_height - 1) / tile_height;
+
+    std::atomic<int> next_tile{0};
+    auto const work = [&](std::vector<std::uint32_t>& scratch)
+        {
+            for (auto tile = next_tile++; tile < tiles; tile = next_tile++)
+            {
+                auto const tile_top = top + tile * tile_height;
+                draw_tile(pixels, stride, tile_top, std::min(tile_top + tile_height, bottom), repaint, scratch);
+            }
+        };
+
+    for (auto i = 0u; i != helper_threads && static_cast<int>(i) + 1 < tiles; ++i)
+        helpers.push_back(pool->run([&work, this, i]() { work(scratch[i + 1]); }));
+
+    // The helpers use what's on our stack, so they must finish even if we don't
+    std::exception_ptr error;
+    try
+    {
+        work(scratch.front());
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    for (auto& helper : helpers)
+    {
+        try
+        {
+            helper.get();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    helpers.clear();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void mrs::Renderer::draw_tile(
+    std::uint32_t* pixels, int stride,
+    int top, int bottom,
+    geom::Rectangle const& repaint,
+    std::vector<std::uint32_t>& scratch) const
+{
+    auto const left = repaint.left().as_int();
+    auto const width = repaint.size.width.as_int();
+    for (auto y = top; y != bottom; ++y)
+        kernels.fill(pixels + y * stride + left, clear_colour, width);
+
+    for (auto const& layer : layers)
+    {
+        for (auto const& area : layer.areas)
+        {
+            auto const from = std::max(top, area.top().as_int());
+            auto const to = std::min(bottom, area.bottom().as_int());
+            auto const x = area.left().as_int();
+            for (auto y = from; y < to; ++y)
+                draw_span(layer, pixels + y * stride + x, x, y, area.size.width.as_int(), scratch);
+        }
+    }
+}
+
+void mrs::Renderer::draw_span(
+    Layer const& layer,
+    std::uint32_t* dst,
+    int x, int y, int n,
+    std::vector<std::uint32_t>& scratch) const
+{
+    // Unblended pixels are converted in place
+    auto const converted = layer.blend ? scratch.data() : dst;
+    std::uint32_t const* row;
+
+    if (layer.direct)
+    {
+        row = layer.pixels +
+              (y + (layer.origin_y >> 16)) * layer.stride +
+              x + (layer.origin_x >> 16);
+
+        if (layer.opaque_bits)
+        {
+            kernels.copy_opaque(converted, row, n);
+            row = converted;
+        }
+    }
+    else
+    {
+        auto u = layer.origin_x + x * layer.across_x + y * layer.down_x;
+        auto v = layer.origin_y + x * layer.across_y + y * layer.down_y;
+        for (auto i = 0; i != n; ++i, u += layer.across_x, v += layer.across_y)
+        {
+            auto column = static_cast<int>(u >> 16);
+            auto line = static_cast<int>(v >> 16);
+            if (layer.orthogonal)
+            {
+                column = std::clamp(column, 0, layer.width - 1);
+                line = std::clamp(line, 0, layer.height - 1);
+            }
+            else if (column < 0 || column >= layer.width || line < 0 || line >= layer.height)
+            {
+                converted[i] = 0;
+                continue;
+            }
+
+            converted[i] = layer.pixels[line * layer.stride + column] | layer.opaque_bits;
+        }
+        row = converted;
+    }
+
+    if (layer.swap_red_blue)
+    {
+        kernels.swap_red_blue(converted, row, n);
+        row = converted;
+    }
+
+    if (!layer.blend)
+        kernels.copy(dst, row, n);
+    else if (layer.alpha == 255)
+        kernels.over(dst, row, n);
+    else
+        kernels.over_with_alpha(dst, row, n, layer.alpha);
+}
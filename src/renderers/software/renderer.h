@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_RENDERER_SOFTWARE_RENDERER_H_
+#define MIR_RENDERER_SOFTWARE_RENDERER_H_
+
+#include <mir/renderer/renderer.h>
+#include <mir/geometry/rectangle.h>
+#include <mir/geometry/rectangles.h>
+#include <mir/graphics/renderable.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace mir
+{
+namespace graphics { class DisplayBuffer; struct PixelOps; }
+namespace thread { class BasicThreadPool; }
+namespace renderer
+{
+namespace software
+{
+class RenderTarget;
+
+/**
+ * Renderer composites renderables whose buffers the CPU can read straight
+ * into a mapping of the output, for hosts without a (usable) GPU.
+ *
+ * Buffers are drawn 1:1 where they can be, with the pixel operations the
+ * CPU best supports; scaled and transformed buffers are sampled to the
+ * nearest pixel first. The output is drawn in tiles of rows, spread across
+ * a pool of threads.
+ *
+ * Only 32-bit RGB formats are handled, for buffers and output alike;
+ * renderables with other buffers (or none the CPU can read) are skipped.
+ */
+class Renderer : public renderer::Renderer
+{
+public:
+    /// Rows of output in each tile
+    static int constexpr tile_height = 32;
+
+    /// Draws using up to \a threads threads, including the caller's
+    Renderer(graphics::DisplayBuffer& display_buffer, unsigned int threads);
+    ~Renderer();
+
+    void set_viewport(geometry::Rectangle const& rect) override;
+    void set_output_transform(glm::mat2 const&) override;
+    void set_damage(geometry::Rectangles const& damage) override;
+    void set_visible_regions(VisibleRegions const& regions) override;
+    void render(graphics::RenderableList const&) const override;
+    void suspend() override;
+
+    /// There's no graphics API, so nothing to report for these
+    StateChanges state_changes() const override;
+    TextureCacheUse texture_cache_use() const override;
+    std::vector<GPUFrameTiming> gpu_timings() override;
+
+private:
+    struct Layer;
+
+    /// The output point a point on the screen is drawn at, and the reverse
+    glm::dvec2 to_output(glm::dvec2 screen) const;
+    glm::dvec2 to_screen(glm::dvec2 output) const;
+    /// The output pixels covering an area of the screen
+    geometry::Rectangle to_output(geometry::Rectangle const& screen) const;
+
+    void update_output_size();
+    std::optional<geometry::Rectangle> repaint_area(geometry::Rectangles const& frame_damage) const;
+
+    /// Work out what of a renderable to draw where, or false if nothing
+    bool prepare(graphics::Renderable const& renderable, geometry::Rectangle const& repaint, Layer& layer) const;
+    /// Make the pixels of layers[first] onwards readable, then draw
+    void draw_with_pixels(std::size_t first, std::function<void()> const& draw) const;
+    void draw_tiles(std::uint32_t* pixels, int stride, geometry::Rectangle const& repaint) const;
+    void draw_tile(
+        std::uint32_t* pixels, int stride,
+        int top, int bottom,
+        geometry::Rectangle const& repaint,
+        std::vector<std::uint32_t>& scratch) const;
+    void draw_span(
+        Layer const& layer,
+        std::uint32_t* dst,
+        int x, int y, int n,
+        std::vector<std::uint32_t>& scratch) const;
+
+    RenderTarget* const render_target;
+    graphics::PixelOps const& kernels;
+
+    geometry::Rectangle viewport;
+    glm::dmat2 output_transform{1};
+    glm::dmat2 inverse_output_transform{1};
+    geometry::Size output_size;
+
+    /// Helpers for the caller, which draws tiles too
+    unsigned int const helper_threads;
+    std::unique_ptr<thread::BasicThreadPool> const pool;
+    /// A row of converted pixels for each thread drawing
+    std::vector<std::vector<std::uint32_t>> mutable scratch;
+    std::vector<std::future<void>> mutable helpers;
+
+    /// This frame's renderables to draw, bottom first
+    std::vector<Layer> mutable layers;
+    /// Whether the output's channels are in ABGR order (rather than ARGB)
+    bool mutable output_red_first{false};
+
+    std::optional<geometry::Rectangles> mutable pending_damage;
+    VisibleRegions mutable visible_regions;
+    std::deque<geometry::Rectangles> mutable damage_history;
+};
+
+}
+}
+}
+
+#endif // MIR_RENDERER_SOFTWARE_RENDERER_H_
@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "damage_tracker.h"
+#include "mir/graphics/buffer.h"
+#include "mir/geometry/displacement.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mc = mir::compositor;
+namespace mg = mir::graphics;
+namespace geom = mir::geometry;
+
+namespace
+{
+template<typename Snapshot>
+geom::Rectangle visible_area_of(Snapshot const& snapshot)
+{
+    if (snapshot.clip_area)
+        return snapshot.position.intersection_with(snapshot.clip_area.value());
+    return snapshot.position;
+}
+
+/// Maps damage in buffer coordinates to the area of the screen it covers
+geom::Rectangle to_screen(
+    geom::Rectangle const& damage,
+    geom::Size const& buffer_size,
+    geom::Rectangle const& position)
+{
+    auto const x_scale = float(position.size.width.as_int()) / buffer_size.width.as_int();
+    auto const y_scale = float(position.size.height.as_int()) / buffer_size.height.as_int();
+
+    // Round outwards so that scaled damage still covers every affected pixel
+    auto const left = int(std::floor(damage.top_left.x.as_int() * x_scale));
+    auto const top = int(std::floor(damage.top_left.y.as_int() * y_scale));
+    auto const right = int(std::ceil(damage.right().as_int() * x_scale));
+    auto const bottom = int(std::ceil(damage.bottom().as_int() * y_scale));
+
+    return {position.top_left + geom::Displacement{left, top}, {right - left, bottom - top}};
+}
+}
+
+geom::Rectangles const& mc::DamageTracker::damage_for(
+    mg::RenderableList const& renderables,
+    geom::Rectangle const& view_area)
+{
+    static glm::mat4 const identity(1);
+
+    current.clear();
+
+    bool any_transformed = false;
+    for (auto const& renderable : renderables)
+    {
+        auto const buffer = renderable->buffer();
+        bool const transformed = renderable->transformation() != identity;
+        any_transformed |= transformed;
+
+        current.push_back(Snapshot{
+            renderable->id(),
+            buffer ? buffer->id() : mg::BufferID{},
+            renderable->screen_position(),
+            renderable->clip_area(),
+            renderable->alpha(),
+            renderable->shaped(),
+            transformed});
+    }
+
+    for (auto const& snapshot : previous)
+        any_transformed |= snapshot.transformed;
+
+    damage.clear();
+    auto const add_damage = [this, &view_area](geom::Rectangle const& area)
+        {
+            auto const clipped = area.intersection_with(view_area);
+            if (clipped.size.width.as_int() > 0 && clipped.size.height.as_int() > 0)
+                damage.add(clipped);
+        };
+
+    if (!previous_view_area || previous_view_area.value() != view_area || any_transformed)
+    {
+        /*
+         * We can't reason about what was on screen before (or, for weirdly
+         * transformed renderables, where it was) so everything is damaged.
+         */
+        add_damage(view_area);
+    }
+    else
+    {
+        // A sorted vector, as it needs no allocation once it's big enough
+        previous_index.clear();
+        for (size_t i = 0; i != previous.size(); ++i)
+            previous_index.emplace_back(previous[i].id, i);
+        std::sort(previous_index.begin(), previous_index.end());
+
+        still_present.assign(previous.size(), false);
+        size_t highest_previous_index = 0;
+
+        for (size_t i = 0; i != current.size(); ++i)
+        {
+            auto const& snapshot = current[i];
+            auto const found = std::lower_bound(
+                previous_index.begin(), previous_index.end(), std::make_pair(snapshot.id, size_t{0}));
+            if (found == previous_index.end() || found->first != snapshot.id)
+            {
+                add_damage(visible_area_of(snapshot));
+                continue;
+            }
+
+            auto const index = found->second;
+            auto const& old = previous[index];
+            still_present[index] = true;
+
+            /*
+             * Renderables that survived from the last frame should appear in
+             * the same relative order. Any that don't have been restacked
+             * relative to something below them.
+             */
+            bool const restacked = index < highest_previous_index;
+            highest_previous_index = std::max(highest_previous_index, index);
+
+            if (restacked ||
+                old.position != snapshot.position ||
+                old.clip_area != snapshot.clip_area ||
+                old.alpha != snapshot.alpha ||
+                old.shaped != snapshot.shaped)
+            {
+                add_damage(visible_area_of(old));
+                add_damage(visible_area_of(snapshot));
+            }
+            else if (old.buffer_id != snapshot.buffer_id)
+            {
+                auto const& renderable = *renderables[i];
+                auto const buffer = renderable.buffer();
+                auto const buffer_size = buffer ? buffer->size() : geom::Size{};
+                auto const buffer_damage = renderable.buffer_damage_since(old.buffer_id);
+
+                if (buffer_damage && buffer_size.width.as_int() > 0 && buffer_size.height.as_int() > 0)
+                {
+                    auto const visible = visible_area_of(snapshot);
+                    for (auto const& rect : buffer_damage.value())
+                        add_damage(to_screen(rect, buffer_size, snapshot.position).intersection_with(visible));
+                }
+                else
+                {
+                    add_damage(visible_area_of(snapshot));
+                }
+            }
+        }
+
+        for (size_t i = 0; i != previous.size(); ++i)
+        {
+            if (!still_present[i])
+                add_damage(visible_area_of(previous[i]));
+        }
+    }
+
+    previous.swap(current);
+    previous_view_area = view_area;
+
+    return damage;
+}
+
+void mc::DamageTracker::reset()
+{
+    previous.clear();
+    previous_view_area = std::experimental::nullopt;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_COMPOSITOR_DAMAGE_TRACKER_H_
+#define MIR_COMPOSITOR_DAMAGE_TRACKER_H_
+
+#include "mir/geometry/rectangle.h"
+#include "mir/geometry/rectangles.h"
+#include "mir/graphics/buffer_id.h"
+#include "mir/graphics/renderable.h"
+
+#include <experimental/optional>
+#include <utility>
+#include <vector>
+
+namespace mir
+{
+namespace compositor
+{
+
+/**
+ * DamageTracker works out which parts of an output have changed between
+ * consecutive frames by comparing what was rendered last time against what
+ * is about to be rendered. Surface moves, newly submitted buffers, stacking
+ * changes and surfaces appearing or disappearing all show up as damage.
+ */
+class DamageTracker
+{
+public:
+    DamageTracker() = default;
+
+    /**
+     * Record the renderables of a new frame and return the damage relative
+     * to the previous one, clipped to the area of the output. The result is
+     * valid until the next call.
+     */
+    geometry::Rectangles const& damage_for(
+        graphics::RenderableList const& renderables,
+        geometry::Rectangle const& view_area);
+
+    /// Forget the previous frame so the next one is fully damaged
+    void reset();
+
+private:
+    struct Snapshot
+    {
+        graphics::Renderable::ID id;
+        graphics::BufferID buffer_id;
+        geometry::Rectangle position;
+        std::experimental::optional<geometry::Rectangle> clip_area;
+        float alpha;
+        bool shaped;
+        bool transformed;
+    };
+
+    std::vector<Snapshot> previous;
+    std::experimental::optional<geometry::Rectangle> previous_view_area;
+
+    // Kept between frames so that their storage is reused
+    std::vector<Snapshot> current;
+    std::vector<std::pair<graphics::Renderable::ID, size_t>> previous_index;
+    std::vector<bool> still_present;
+    geometry::Rectangles damage;
+};
+
+}
+}
+
+#endif // MIR_COMPOSITOR_DAMAGE_TRACKER_H_
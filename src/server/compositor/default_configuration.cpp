@@ -22,13 +22,18 @@
 #include "buffer_stream_factory.h"
 #include "default_display_buffer_compositor_factory.h"
 #include "multi_threaded_compositor.h"
+#include "presentation_observer_multiplexer.h"
 #include "gl/renderer_factory.h"
+#include "software/renderer_factory.h"
 #include "mir/main_loop.h"
 
+#include "mir/abnormal_exit.h"
 #include "mir/options/configuration.h"
 
 #include <boost/throw_exception.hpp>
 
+#include <algorithm>
+
 namespace mc = mir::compositor;
 namespace ms = mir::scene;
 namespace mf = mir::frontend;
@@ -76,16 +81,66 @@ mir::DefaultServerConfiguration::the_compositor()
                 the_display_buffer_compositor_factory(),
                 the_shell(),
                 the_compositor_report(),
+                the_presentation_observer(),
                 composite_delay,
                 true);
         });
 }
 
+std::shared_ptr<mc::PresentationObserver>
+mir::DefaultServerConfiguration::the_presentation_observer()
+{
+    return presentation_observer_multiplexer(
+        [default_executor = the_main_loop()]()
+        {
+            return std::make_shared<mc::PresentationObserverMultiplexer>(default_executor);
+        });
+}
+
+std::shared_ptr<mir::ObserverRegistrar<mc::PresentationObserver>>
+mir::DefaultServerConfiguration::the_presentation_observer_registrar()
+{
+    return presentation_observer_multiplexer(
+        [default_executor = the_main_loop()]()
+        {
+            return std::make_shared<mc::PresentationObserverMultiplexer>(default_executor);
+        });
+}
+
 std::shared_ptr<mir::renderer::RendererFactory> mir::DefaultServerConfiguration::the_renderer_factory()
 {
     return renderer_factory(
-        []()
+        [this]() -> std::shared_ptr<mir::renderer::RendererFactory>
         {
-            return std::make_shared<mir::renderer::gl::RendererFactory>();
+            using GPUTimer = mir::renderer::gl::GPUTimer;
+
+            auto const renderer_opt = the_options()->get<std::string>(options::renderer_opt);
+            if (renderer_opt == "software")
+            {
+                auto const threads = the_options()->get<int>(options::software_renderer_threads_opt);
+                return std::make_shared<mir::renderer::software::RendererFactory>(
+                    static_cast<unsigned int>(std::max(threads, 0)));
+            }
+            else if (renderer_opt != "gl")
+            {
+                throw AbnormalExit(std::string("Invalid ") + options::renderer_opt + " option: " +
+                                   renderer_opt + " (valid options are: \"gl\" and \"software\")");
+            }
+
+            auto const budget_mib = the_options()->get<int>(options::texture_cache_budget_opt);
+            auto const gpu_timing_opt = the_options()->get<std::string>(options::gpu_timing_opt);
+
+            auto gpu_timing = GPUTimer::Mode::off;
+            if (gpu_timing_opt == "frames")
+                gpu_timing = GPUTimer::Mode::frames;
+            else if (gpu_timing_opt == "renderables")
+                gpu_timing = GPUTimer::Mode::renderables;
+            else if (gpu_timing_opt != options::off_opt_value)
+                throw AbnormalExit(std::string("Invalid ") + options::gpu_timing_opt + " option: " +
+                                   gpu_timing_opt + " (valid options are: \"off\", \"frames\" and \"renderables\")");
+
+            return std::make_shared<mir::renderer::gl::RendererFactory>(
+                static_cast<std::size_t>(std::max(budget_mib, 0)) * 1024 * 1024,
+                gpu_timing);
         });
 }
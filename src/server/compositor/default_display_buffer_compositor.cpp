@@ -21,6 +21,7 @@
 
 #include "mir/compositor/scene.h"
 #include "mir/compositor/scene_element.h"
+#include "mir/compositor/frame_pool.h"
 #include "mir/graphics/renderable.h"
 #include "mir/graphics/display_buffer.h"
 #include "mir/graphics/buffer.h"
@@ -47,15 +48,16 @@ mc::DefaultDisplayBufferCompositor::DefaultDisplayBufferCompositor(
 void mc::DefaultDisplayBufferCompositor::composite(mc::SceneElementSequence&& scene_elements)
 {
     report->began_frame(this);
+    composited_buffers.clear();
+    scanned_out_buffers.clear();
 
     auto const& view_area = display_buffer.view_area();
-    auto const& occlusions = mc::filter_occlusions_from(scene_elements, view_area);
+    auto occlusions = mc::filter_occlusions_from(scene_elements, view_area, visible_regions);
 
     for (auto const& element : occlusions)
         element->occluded();
+    mc::recycle(occlusions);
 
-    mg::RenderableList renderable_list;
-    renderable_list.reserve(scene_elements.size());
     for (auto const& element : scene_elements)
     {
         element->rendered();
@@ -66,24 +68,67 @@ void mc::DefaultDisplayBufferCompositor::composite(mc::SceneElementSequence&& sc
      * Note: Buffer lifetimes are ensured by the two objects holding
      *       references to them; scene_elements and renderable_list.
      *       So no buffer is going to be released back to the client till
-     *       both of those containers get destroyed (end of the function).
+     *       both of those containers are cleared (end of the function).
      *       Actually, there's a third reference held by the texture cache
      *       in GLRenderer, but that gets released earlier in render().
      */
-    scene_elements.clear();  // Those in use are still in renderable_list
+    mc::recycle(scene_elements);  // Those in use are still in renderable_list
 
     if (display_buffer.overlay(renderable_list))
     {
+        // Nothing is drawn into our buffers, so there's nothing to track
+        damage_tracker.reset();
+
+        for (auto const& renderable : renderable_list)
+        {
+            if (auto const buffer = renderable->buffer())
+                scanned_out_buffers.push_back(buffer->id());
+        }
+
         report->renderables_in_frame(this, renderable_list);
         renderer->suspend();
+        renderable_list.clear();
     }
     else
     {
+        // Anything scanned out on a plane of its own is left out of the framebuffer
+        composited.assign(renderable_list.begin(), renderable_list.end());
+        display_buffer.assign_planes(composited);
+        auto const& damage = damage_tracker.damage_for(composited, view_area);
+
         renderer->set_output_transform(display_buffer.transformation());
         renderer->set_viewport(view_area);
-        renderer->render(renderable_list);
+        renderer->set_damage(damage);
+        renderer->set_visible_regions(visible_regions);
+        renderer->render(composited);
+
+        // assign_planes() keeps the order, so what's missing went to a plane
+        auto drawn = composited.begin();
+        for (auto const& renderable : renderable_list)
+        {
+            bool const is_drawn = drawn != composited.end() && *drawn == renderable;
+            if (is_drawn)
+                ++drawn;
+
+            if (auto const buffer = renderable->buffer())
+                (is_drawn ? composited_buffers : scanned_out_buffers).push_back(buffer->id());
+        }
+
+        auto const state_changes = renderer->state_changes();
+        auto const texture_cache_use = renderer->texture_cache_use();
 
         report->renderables_in_frame(this, renderable_list);
+        report->state_changes_in_frame(this, state_changes.made, state_changes.skipped);
+        report->texture_cache_in_frame(
+            this, texture_cache_use.hits, texture_cache_use.misses, texture_cache_use.bytes_resident);
+        for (auto const& timing : renderer->gpu_timings())
+        {
+            report->gpu_rendered_frame(this, timing.render_time);
+            if (timing.idle_before)
+                report->gpu_idle(this, timing.idle_before.value());
+            for (auto const& renderable : timing.renderables)
+                report->gpu_rendered_renderable(this, renderable.first, renderable.second);
+        }
         report->rendered_frame(this);
 
         /*
@@ -97,8 +142,17 @@ void mc::DefaultDisplayBufferCompositor::composite(mc::SceneElementSequence&& sc
          *        problematic IPC (LP: #1395421) will instead occur in buffer
          *        acquisition calls when we composite the next frame.
          */
+        composited.clear();
         renderable_list.clear();
     }
 
     report->finished_frame(this);
 }
+
+void mc::DefaultDisplayBufferCompositor::buffers_shown(
+    std::vector<mg::BufferID>& composited,
+    std::vector<mg::BufferID>& scanned_out) const
+{
+    composited.insert(composited.end(), composited_buffers.begin(), composited_buffers.end());
+    scanned_out.insert(scanned_out.end(), scanned_out_buffers.begin(), scanned_out_buffers.end());
+}
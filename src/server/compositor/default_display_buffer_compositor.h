@@ -21,6 +21,9 @@
 
 #include "mir/compositor/display_buffer_compositor.h"
 #include "mir/compositor/compositor_report.h"
+#include "damage_tracker.h"
+#include "occlusion.h"
+#include "mir/graphics/renderable.h"
 #include <memory>
 
 namespace mir
@@ -47,11 +50,24 @@ public:
         std::shared_ptr<CompositorReport> const& report);
 
     void composite(SceneElementSequence&& scene_sequence) override;
+    void buffers_shown(
+        std::vector<graphics::BufferID>& composited,
+        std::vector<graphics::BufferID>& scanned_out) const override;
 
 private:
     graphics::DisplayBuffer& display_buffer;
     std::shared_ptr<renderer::Renderer> const renderer;
     std::shared_ptr<CompositorReport> const report;
+    DamageTracker damage_tracker;
+
+    // Per-frame working space, kept so that steady-state frames don't allocate
+    VisibleRegions visible_regions;
+    graphics::RenderableList renderable_list;
+    graphics::RenderableList composited;
+
+    // What the last frame showed
+    std::vector<graphics::BufferID> composited_buffers;
+    std::vector<graphics::BufferID> scanned_out_buffers;
 };
 
 }
@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+namespace mc = mir::compositor;
+namespace mg = mir::graphics;
+
+void mc::FrameScheduler::presented(mg::Frame const& frame, std::chrono::nanoseconds interval)
+{
+    if (frame.msc == 0 || interval <= std::chrono::nanoseconds::zero())
+        return;
+
+    last_presented = frame;
+    this->interval = interval;
+}
+
+void mc::FrameScheduler::frame_in_flight(bool in_flight)
+{
+    this->in_flight = in_flight;
+}
+
+bool mc::FrameScheduler::has_timing() const
+{
+    return last_presented.msc != 0;
+}
+
+std::chrono::nanoseconds mc::FrameScheduler::delay_before_compositing(
+    time::PosixTimestamp const& now,
+    std::chrono::nanoseconds render_time) const
+{
+    if (!has_timing() || now.clock_id != last_presented.ust.clock_id)
+        return std::chrono::nanoseconds::zero();
+
+    render_time = std::max(render_time, std::chrono::nanoseconds::zero());
+
+    /*
+     * Aim for the first vblank we can both render in time for and that
+     * hasn't already been presented to. Only one frame can be presented
+     * per vblank, so that's never the one we last presented on, nor the
+     * one after it if a frame is already waiting to be flipped there.
+     */
+    auto const earliest_ready = now + render_time;
+    auto vblanks = std::max<long long>(
+        in_flight ? 2 : 1,
+        (earliest_ready - last_presented.ust + interval - std::chrono::nanoseconds{1}) / interval);
+    auto const target_vblank = last_presented.ust + vblanks * interval;
+
+    auto const start = target_vblank - render_time;
+    return start > now ? start - now : std::chrono::nanoseconds::zero();
+}
+
+clockid_t mc::FrameScheduler::clock_id() const
+{
+    return last_presented.ust.clock_id;
+}
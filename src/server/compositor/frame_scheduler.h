@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_COMPOSITOR_FRAME_SCHEDULER_H_
+#define MIR_COMPOSITOR_FRAME_SCHEDULER_H_
+
+#include "mir/graphics/frame.h"
+
+#include <chrono>
+
+namespace mir
+{
+namespace compositor
+{
+
+/**
+ * FrameScheduler decides when to start compositing a frame so that it is
+ * ready just before the next vblank, from the timing of the frames already
+ * presented. Starting as late as possible means the frame shows the
+ * freshest scene, and everything that changes before then is coalesced
+ * into it.
+ */
+class FrameScheduler
+{
+public:
+    FrameScheduler() = default;
+
+    /// Record the frame most recently presented and the refresh interval
+    void presented(graphics::Frame const& frame, std::chrono::nanoseconds interval);
+
+    /**
+     * Record whether a frame posted since the last presented one is still
+     * waiting for its vblank, which the next frame can't share.
+     */
+    void frame_in_flight(bool in_flight);
+
+    /// Whether any vblank timing is known yet
+    bool has_timing() const;
+
+    /**
+     * How long to wait from \a now before compositing a frame that will
+     * take \a render_time to be ready. Zero if the timing is unknown.
+     */
+    std::chrono::nanoseconds delay_before_compositing(
+        time::PosixTimestamp const& now,
+        std::chrono::nanoseconds render_time) const;
+
+    /// The clock vblank times are reported against
+    clockid_t clock_id() const;
+
+private:
+    graphics::Frame last_presented;
+    std::chrono::nanoseconds interval{0};
+    bool in_flight{false};
+};
+
+}
+}
+
+#endif // MIR_COMPOSITOR_FRAME_SCHEDULER_H_
@@ -17,6 +17,7 @@
  */
 
 #include "multi_threaded_compositor.h"
+#include "frame_scheduler.h"
 #include "mir/graphics/display.h"
 #include "mir/graphics/display_buffer.h"
 #include "mir/compositor/display_buffer_compositor.h"
@@ -24,6 +25,7 @@
 #include "mir/compositor/display_listener.h"
 #include "mir/compositor/scene.h"
 #include "mir/compositor/compositor_report.h"
+#include "mir/compositor/presentation_observer.h"
 #include "mir/scene/legacy_scene_change_notification.h"
 #include "mir/scene/surface_observer.h"
 #include "mir/scene/surface.h"
@@ -32,9 +34,11 @@
 #include "mir/unwind_helpers.h"
 #include "mir/thread_name.h"
 
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <condition_variable>
+#include <algorithm>
 #include <boost/throw_exception.hpp>
 
 using namespace std::literals::chrono_literals;
@@ -57,7 +61,8 @@ public:
         std::shared_ptr<mc::Scene> const& scene,
         std::shared_ptr<DisplayListener> const& display_listener,
         std::chrono::milliseconds fixed_composite_delay,
-        std::shared_ptr<CompositorReport> const& report) :
+        std::shared_ptr<CompositorReport> const& report,
+        std::shared_ptr<PresentationObserver> const& presentation_observer) :
         compositor_factory{db_compositor_factory},
         group(group),
         scene(scene),
@@ -66,8 +71,17 @@ public:
         force_sleep{fixed_composite_delay},
         display_listener{display_listener},
         report{report},
+        presentation_observer{presentation_observer},
+        flip_waker{std::make_shared<FlipWaker>()},
         started_future{started.get_future()}
     {
+        flip_waker->owner = this;
+    }
+
+    ~CompositingFunctor()
+    {
+        std::lock_guard<std::mutex> lock{flip_waker->mutex};
+        flip_waker->owner = nullptr;
     }
 
     void operator()() noexcept  // noexcept is important! (LP: #1237332)
@@ -75,7 +89,7 @@ public:
     {
         mir::set_thread_name("Mir/Comp");
 
-        std::vector<std::tuple<mg::DisplayBuffer*, std::unique_ptr<mc::DisplayBufferCompositor>>> compositors;
+        Compositors compositors;
         group.for_each_display_buffer(
         [this, &compositors](mg::DisplayBuffer& buffer)
         {
@@ -118,6 +132,32 @@ public:
                 /* Wait until compositing has been scheduled or we are stopped */
                 run_cv.wait(lock, [&]{ return (frames_scheduled > 0) || !running; });
 
+                /*
+                 * Posting while the last frame is still waiting for its flip
+                 * would block until it completes, so wait for the flip here,
+                 * where it wakes us. Should the flip's event go missing the
+                 * watchdog gives up and lets post() wait on the outputs.
+                 */
+                run_cv.wait_for(lock, flip_watchdog, [&]{ return !running || !group.frame_pending(); });
+
+                /*
+                 * When we know when the next vblank is we can hold off
+                 * sampling the scene until just in time to render for it.
+                 * Anything else that changes in the meantime gets coalesced
+                 * into the same frame rather than triggering another.
+                 */
+                if (running && force_sleep < std::chrono::milliseconds::zero())
+                {
+                    // The last frame's flip may have completed since we posted it
+                    frame_scheduler.presented(group.last_frame(), group.frame_interval());
+                    frame_scheduler.frame_in_flight(group.frame_pending());
+
+                    auto const delay = frame_scheduler.delay_before_compositing(
+                        time::PosixTimestamp::now(frame_scheduler.clock_id()),
+                        predicted_render_time());
+                    run_cv.wait_for(lock, delay, [&]{ return !running; });
+                }
+
                 /*
                  * Check if we are running before compositing, since we may have
                  * been stopped while waiting for the run_cv above.
@@ -141,6 +181,10 @@ public:
                         compositor->composite(scene->scene_elements_for(compositor.get()));
                     }
                     group.post();
+                    notify_when_presented(compositors);
+                    wake_when_flipped();
+                    frame_scheduler.presented(group.last_frame(), group.frame_interval());
+                    frame_scheduler.frame_in_flight(group.frame_pending());
 
                     /*
                      * "Predictive bypass" optimization: If the last frame was
@@ -148,10 +192,14 @@ public:
                      * beneficial to sleep for most of the next frame. This reduces
                      * the latency between snapshotting the scene and post()
                      * completing by almost a whole frame.
+                     *
+                     * With vblank timing the frame scheduler does this instead,
+                     * and only when there is another frame to composite.
                      */
-                    auto delay = force_sleep >= std::chrono::milliseconds::zero() ?
-                                 force_sleep : group.recommended_sleep();
-                    std::this_thread::sleep_for(delay);
+                    if (force_sleep >= std::chrono::milliseconds::zero())
+                        std::this_thread::sleep_for(force_sleep);
+                    else if (!frame_scheduler.has_timing())
+                        std::this_thread::sleep_for(group.recommended_sleep());
 
                     lock.lock();
 
@@ -231,16 +279,98 @@ public:
     }
 
 private:
+    using Compositors = std::vector<std::tuple<mg::DisplayBuffer*, std::unique_ptr<mc::DisplayBufferCompositor>>>;
+
+    /// Tells the presentation observer about the frame just posted, once it's on screen
+    void notify_when_presented(Compositors const& compositors)
+    {
+        if (!presentation_observer->awaiting_presentation())
+            return;
+
+        // Refill the last frame's, unless it's still queued for (or with) the observer
+        if (!presented || presented.use_count() > 1)
+        {
+            presented = std::make_shared<PresentedFrame>();
+        }
+        else
+        {
+            // Make sure the observer's reads of it happened before we write to it
+            std::atomic_thread_fence(std::memory_order_acquire);
+            presented->composited.clear();
+            presented->scanned_out.clear();
+        }
+
+        for (auto const& compositor : compositors)
+            std::get<1>(compositor)->buffers_shown(presented->composited, presented->scanned_out);
+
+        if (presented->composited.empty() && presented->scanned_out.empty())
+            return;
+
+        presented->refresh = group.frame_interval();
+        group.on_presented(
+            [presented = presented, observer = presentation_observer](mg::Frame const& frame)
+            {
+                presented->frame = frame;
+                observer->frame_presented(presented);
+            });
+    }
+
+    /// Has the frame just posted wake us once it's flipped, if it hasn't been already
+    void wake_when_flipped()
+    {
+        if (!group.frame_pending())
+            return;
+
+        group.on_presented(
+            [waker = flip_waker](mg::Frame const&)
+            {
+                std::lock_guard<std::mutex> lock{waker->mutex};
+                if (waker->owner)
+                    waker->owner->flipped();
+            });
+    }
+
+    void flipped()
+    {
+        std::lock_guard<std::mutex> lock{run_mutex};
+        run_cv.notify_one();
+    }
+
+    /*
+     * Without the group's prediction we allow a whole frame interval to
+     * render, which means starting as soon as there's a vblank to aim for.
+     */
+    std::chrono::nanoseconds predicted_render_time() const
+    {
+        auto const predicted = group.predicted_render_time();
+        return predicted > std::chrono::nanoseconds::zero() ? predicted : group.frame_interval();
+    }
+
     std::shared_ptr<mc::DisplayBufferCompositorFactory> const compositor_factory;
     mg::DisplaySyncGroup& group;
     std::shared_ptr<mc::Scene> const scene;
     bool running;
     int frames_scheduled;
     std::chrono::milliseconds force_sleep{-1};
+    FrameScheduler frame_scheduler;
     std::mutex run_mutex;
     std::condition_variable run_cv;
     std::shared_ptr<DisplayListener> const display_listener;
     std::shared_ptr<CompositorReport> const report;
+    std::shared_ptr<PresentationObserver> const presentation_observer;
+    std::shared_ptr<PresentedFrame> presented;
+
+    /*
+     * Flips complete on whichever thread sees them, possibly after we've
+     * gone, so their handlers find us through this.
+     */
+    struct FlipWaker
+    {
+        std::mutex mutex;
+        CompositingFunctor* owner{nullptr};
+    };
+    std::shared_ptr<FlipWaker> const flip_waker;
+    std::chrono::milliseconds const flip_watchdog{100};
     std::promise<void> started;
     std::future<void> started_future;
     bool not_posted_yet = true;
@@ -249,12 +379,42 @@ private:
 }
 }
 
+namespace
+{
+struct NullPresentationObserver : mc::PresentationObserver
+{
+    void frame_presented(std::shared_ptr<mc::PresentedFrame const> const&) override {}
+    bool awaiting_presentation() override { return false; }
+};
+}
+
+mc::MultiThreadedCompositor::MultiThreadedCompositor(
+    std::shared_ptr<mg::Display> const& display,
+    std::shared_ptr<mc::Scene> const& scene,
+    std::shared_ptr<DisplayBufferCompositorFactory> const& db_compositor_factory,
+    std::shared_ptr<DisplayListener> const& display_listener,
+    std::shared_ptr<CompositorReport> const& compositor_report,
+    std::chrono::milliseconds fixed_composite_delay,
+    bool compose_on_start)
+    : MultiThreadedCompositor{
+          display,
+          scene,
+          db_compositor_factory,
+          display_listener,
+          compositor_report,
+          std::make_shared<NullPresentationObserver>(),
+          fixed_composite_delay,
+          compose_on_start}
+{
+}
+
 mc::MultiThreadedCompositor::MultiThreadedCompositor(
     std::shared_ptr<mg::Display> const& display,
     std::shared_ptr<mc::Scene> const& scene,
     std::shared_ptr<DisplayBufferCompositorFactory> const& db_compositor_factory,
     std::shared_ptr<DisplayListener> const& display_listener,
     std::shared_ptr<CompositorReport> const& compositor_report,
+    std::shared_ptr<PresentationObserver> const& presentation_observer,
     std::chrono::milliseconds fixed_composite_delay,
     bool compose_on_start)
     : display{display},
@@ -262,6 +422,7 @@ mc::MultiThreadedCompositor::MultiThreadedCompositor(
       display_buffer_compositor_factory{db_compositor_factory},
       display_listener{display_listener},
       report{compositor_report},
+      presentation_observer{presentation_observer},
       state{CompositorState::stopped},
       fixed_composite_delay{fixed_composite_delay},
       compose_on_start{compose_on_start},
@@ -368,7 +529,7 @@ void mc::MultiThreadedCompositor::create_compositing_threads()
     {
         auto thread_functor = std::make_unique<mc::CompositingFunctor>(
             display_buffer_compositor_factory, group, scene, display_listener,
-            fixed_composite_delay, report);
+            fixed_composite_delay, report, presentation_observer);
 
         futures.push_back(thread_pool.run(std::ref(*thread_functor), &group));
         thread_functors.push_back(std::move(thread_functor));
@@ -49,6 +49,7 @@ class DisplayListener;
 class CompositingFunctor;
 class Scene;
 class CompositorReport;
+class PresentationObserver;
 
 enum class CompositorState
 {
@@ -69,6 +70,15 @@ public:
         std::shared_ptr<CompositorReport> const& compositor_report,
         std::chrono::milliseconds fixed_composite_delay,  // -1 = automatic
         bool compose_on_start);
+    MultiThreadedCompositor(
+        std::shared_ptr<graphics::Display> const& display,
+        std::shared_ptr<Scene> const& scene,
+        std::shared_ptr<DisplayBufferCompositorFactory> const& db_compositor_factory,
+        std::shared_ptr<DisplayListener> const& display_listener,
+        std::shared_ptr<CompositorReport> const& compositor_report,
+        std::shared_ptr<PresentationObserver> const& presentation_observer,
+        std::chrono::milliseconds fixed_composite_delay,  // -1 = automatic
+        bool compose_on_start);
     ~MultiThreadedCompositor();
 
     void start();
@@ -83,6 +93,7 @@ private:
     std::shared_ptr<DisplayBufferCompositorFactory> const display_buffer_compositor_factory;
     std::shared_ptr<DisplayListener> const display_listener;
     std::shared_ptr<CompositorReport> const report;
+    std::shared_ptr<PresentationObserver> const presentation_observer;
 
     std::vector<std::unique_ptr<CompositingFunctor>> thread_functors;
     std::vector<std::future<void>> futures;
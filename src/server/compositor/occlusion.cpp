@@ -17,10 +17,13 @@
  */
 
 #include "mir/geometry/rectangle.h"
+#include "mir/geometry/rectangles.h"
 #include "mir/compositor/scene_element.h"
+#include "mir/compositor/frame_pool.h"
 #include "mir/graphics/renderable.h"
 #include "occlusion.h"
 
+#include <algorithm>
 #include <vector>
 
 using namespace mir::geometry;
@@ -32,7 +35,9 @@ namespace
 bool renderable_is_occluded(
     Renderable const& renderable, 
     Rectangle const& area,
-    std::vector<Rectangle>& coverage)
+    Rectangles& coverage,
+    Rectangles& exposed,
+    VisibleRegions* visible)
 {
     static glm::mat4 const identity(1);
     static Rectangle const empty{};
@@ -46,37 +51,69 @@ bool renderable_is_occluded(
     if (clipped_window == empty)
         return true;  // Not in the area; definitely occluded.
 
-    bool occluded = false;
+    // Whatever isn't covered by the (combined) renderables above is exposed
+    exposed.clear();
+    exposed.add(clipped_window);
+    bool partly_covered = false;
     for (auto const& r : coverage)
     {
-        if (r.contains(clipped_window))
+        if (r.overlaps(clipped_window))
         {
-            occluded = true;
-            break;
+            partly_covered = true;
+            exposed.subtract(r);
+            if (exposed.size() == 0)
+                break;
         }
     }
 
-    if (!occluded && renderable.alpha() == 1.0f && !renderable.shaped())
-        coverage.push_back(clipped_window);
+    bool const occluded = exposed.size() == 0;
+
+    if (!occluded && partly_covered && visible)
+        (*visible)[renderable.id()] = exposed;
+
+    if (!occluded && renderable.alpha() == 1.0f)
+    {
+        if (!renderable.shaped())
+        {
+            coverage.add(clipped_window);
+        }
+        else
+        {
+            // Translucent clients may still have opaque parts that hide what's below
+            for (auto const& opaque : renderable.opaque_region())
+                coverage.add(opaque.intersection_with(area));
+        }
+    }
 
     return occluded;
 }
-}
 
-SceneElementSequence mir::compositor::filter_occlusions_from(
+SceneElementSequence filter_occlusions(
     SceneElementSequence& elements,
-    Rectangle const& area)
+    Rectangle const& area,
+    VisibleRegions* visible)
 {
-    SceneElementSequence occluded;
-    std::vector<Rectangle> coverage;
+    // Scratch space kept from frame to frame (each compositor has a thread of its own)
+    static thread_local Rectangles coverage;
+    static thread_local Rectangles exposed;
+    coverage.clear();
+
+    // Keep the entries (and their storage) for renderables that are likely to be partly hidden again
+    if (visible)
+    {
+        for (auto& region : *visible)
+            region.second.clear();
+    }
+
+    auto occluded = recycled_vector<SceneElementSequence>();
 
     auto it = elements.rbegin();
     while (it != elements.rend())
     {
         auto const renderable = (*it)->renderable();
-        if (renderable_is_occluded(*renderable, area, coverage))
+        if (renderable_is_occluded(*renderable, area, coverage, exposed, visible))
         {
-            occluded.insert(occluded.begin(), *it);
+            occluded.push_back(std::move(*it));
             it = SceneElementSequence::reverse_iterator(elements.erase(std::prev(it.base())));
         }
         else
@@ -85,5 +122,35 @@ SceneElementSequence mir::compositor::filter_occlusions_from(
         }
     }
 
+    // We found them top first
+    std::reverse(occluded.begin(), occluded.end());
+
+    if (visible)
+    {
+        for (auto region = visible->begin(); region != visible->end();)
+        {
+            if (region->second.size() == 0)
+                region = visible->erase(region);
+            else
+                ++region;
+        }
+    }
+
     return occluded;
 }
+}
+
+SceneElementSequence mir::compositor::filter_occlusions_from(
+    SceneElementSequence& elements,
+    Rectangle const& area)
+{
+    return filter_occlusions(elements, area, nullptr);
+}
+
+SceneElementSequence mir::compositor::filter_occlusions_from(
+    SceneElementSequence& elements,
+    Rectangle const& area,
+    VisibleRegions& visible)
+{
+    return filter_occlusions(elements, area, &visible);
+}
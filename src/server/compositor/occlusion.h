@@ -20,14 +20,31 @@
 #define MIR_COMPOSITOR_OCCLUSION_H_
 
 #include "mir/compositor/scene.h"
+#include "mir/geometry/rectangles.h"
+#include "mir/graphics/renderable.h"
+
+#include <unordered_map>
 
 namespace mir
 {
 namespace compositor
 {
 
+/// The visible parts of renderables partly hidden by those above them, keyed by Renderable::id()
+typedef std::unordered_map<graphics::Renderable::ID, geometry::Rectangles> VisibleRegions;
+
 SceneElementSequence filter_occlusions_from(SceneElementSequence& list, geometry::Rectangle const& area);
 
+/**
+ * As above, also recording the visible parts of any partly hidden renderables
+ * that remain in list. visible is updated in place, so reusing it from frame
+ * to frame saves reallocating its entries.
+ */
+SceneElementSequence filter_occlusions_from(
+    SceneElementSequence& list,
+    geometry::Rectangle const& area,
+    VisibleRegions& visible);
+
 } // namespace compositor
 } // namespace mir
 
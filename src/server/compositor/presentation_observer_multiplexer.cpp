@@ -0,0 +1,36 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "presentation_observer_multiplexer.h"
+
+namespace mc = mir::compositor;
+
+void mc::PresentationObserverMultiplexer::frame_presented(std::shared_ptr<PresentedFrame const> const& frame)
+{
+    for_each_observer(&mc::PresentationObserver::frame_presented, frame);
+}
+
+bool mc::PresentationObserverMultiplexer::awaiting_presentation()
+{
+    return any_observer(&mc::PresentationObserver::awaiting_presentation);
+}
+
+mc::PresentationObserverMultiplexer::PresentationObserverMultiplexer(
+    std::shared_ptr<mir::Executor> const& default_executor)
+    : ObserverMultiplexer(*default_executor),
+      executor{default_executor}
+{
+}
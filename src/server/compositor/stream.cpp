@@ -22,6 +22,7 @@
 #include "dropping_schedule.h"
 #include "mir/graphics/buffer.h"
 #include <boost/throw_exception.hpp>
+#include <algorithm>
 
 namespace mc = mir::compositor;
 namespace geom = mir::geometry;
@@ -46,18 +47,45 @@ mc::Stream::Stream(
 {
 }
 
+namespace
+{
+/*
+ * Enough submissions to cover the buffers a (possibly slow) compositor might
+ * have skipped over since it last looked at the stream
+ */
+std::size_t const max_submissions{8};
+}
+
 mc::Stream::~Stream() = default;
 
 void mc::Stream::submit_buffer(std::shared_ptr<mg::Buffer> const& buffer)
+{
+    submit(buffer, std::experimental::nullopt);
+}
+
+void mc::Stream::submit_buffer(std::shared_ptr<mg::Buffer> const& buffer, geom::Rectangles const& damage)
+{
+    submit(buffer, damage);
+}
+
+void mc::Stream::submit(
+    std::shared_ptr<mg::Buffer> const& buffer,
+    std::experimental::optional<geom::Rectangles> const& damage)
 {
     if (!buffer)
         BOOST_THROW_EXCEPTION(std::invalid_argument("cannot submit null buffer"));
 
     {
         std::lock_guard<decltype(mutex)> lk(mutex);
+        bool const resized = first_frame_posted && latest_buffer_size != buffer->size();
         first_frame_posted = true;
         pf = buffer->pixel_format();
         latest_buffer_size = buffer->size();
+
+        submissions.push_back({buffer->id(), resized ? std::experimental::nullopt : damage});
+        if (submissions.size() > max_submissions)
+            submissions.pop_front();
+
         schedule->schedule(buffer);
     }
     {
@@ -66,6 +94,32 @@ void mc::Stream::submit_buffer(std::shared_ptr<mg::Buffer> const& buffer)
     }
 }
 
+auto mc::Stream::damage_between(mg::BufferID from, mg::BufferID to) const
+    -> std::experimental::optional<geom::Rectangles>
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+
+    auto const later = std::find_if(
+        submissions.rbegin(), submissions.rend(), [to](auto const& s) { return s.id == to; });
+    auto const earlier = std::find_if(
+        later, submissions.rend(), [from](auto const& s) { return s.id == from; });
+
+    if (earlier == submissions.rend())
+        return std::experimental::nullopt;
+
+    geom::Rectangles damage;
+    for (auto s = later; s != earlier; ++s)
+    {
+        if (!s->damage)
+            return std::experimental::nullopt;
+
+        for (auto const& rect : s->damage.value())
+            damage.add(rect);
+    }
+
+    return damage;
+}
+
 void mc::Stream::with_most_recent_buffer_do(std::function<void(mg::Buffer&)> const& fn)
 {
     std::lock_guard<decltype(mutex)> lk(mutex);
@@ -165,3 +219,15 @@ void mc::Stream::set_scale(float scale)
     std::lock_guard<decltype(mutex)> lk(mutex);
     scale_ = scale;
 }
+
+void mc::Stream::set_opaque_region(geom::Rectangles const& region)
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    opaque_region_ = region;
+}
+
+auto mc::Stream::opaque_region() const -> geom::Rectangles
+{
+    std::lock_guard<decltype(mutex)> lk(mutex);
+    return opaque_region_;
+}
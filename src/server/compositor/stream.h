@@ -26,6 +26,7 @@
 #include "mir/lockable_callback.h"
 #include "mir/geometry/size.h"
 #include "multi_monitor_arbiter.h"
+#include <deque>
 #include <mutex>
 #include <memory>
 #include <set>
@@ -43,6 +44,13 @@ public:
     ~Stream();
 
     void submit_buffer(std::shared_ptr<graphics::Buffer> const& buffer) override;
+    void submit_buffer(
+        std::shared_ptr<graphics::Buffer> const& buffer,
+        geometry::Rectangles const& damage) override;
+    auto damage_between(graphics::BufferID from, graphics::BufferID to) const
+        -> std::experimental::optional<geometry::Rectangles> override;
+    void set_opaque_region(geometry::Rectangles const& region) override;
+    auto opaque_region() const -> geometry::Rectangles override;
     void with_most_recent_buffer_do(std::function<void(graphics::Buffer&)> const& exec) override;
     MirPixelFormat pixel_format() const override;
     void set_frame_posted_callback(
@@ -60,6 +68,15 @@ public:
 private:
     enum class ScheduleMode;
     void transition_schedule(std::shared_ptr<Schedule>&& new_schedule, std::lock_guard<std::mutex> const&);
+    void submit(
+        std::shared_ptr<graphics::Buffer> const& buffer,
+        std::experimental::optional<geometry::Rectangles> const& damage);
+
+    struct Submission
+    {
+        graphics::BufferID id;
+        std::experimental::optional<geometry::Rectangles> damage; ///< relative to the previous submission
+    };
 
     std::mutex mutable mutex;
     ScheduleMode schedule_mode;
@@ -69,6 +86,8 @@ private:
     float scale_{1.0f};
     MirPixelFormat pf;
     bool first_frame_posted;
+    std::deque<Submission> submissions;
+    geometry::Rectangles opaque_region_;
 
     std::mutex callback_mutex;
     std::function<void(geometry::Size const&)> frame_callback;
@@ -0,0 +1,254 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "presentation_time.h"
+
+#include "wl_surface.h"
+#include "deleted_for_resource.h"
+
+#include "mir/compositor/presentation_observer.h"
+#include "mir/observer_registrar.h"
+#include "mir/time/posix_timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace mf = mir::frontend;
+namespace mc = mir::compositor;
+namespace mg = mir::graphics;
+namespace mw = mir::wayland;
+
+namespace
+{
+/// The clock clients are told presentation times are in, which is also the one KMS uses
+clockid_t const presentation_clock = CLOCK_MONOTONIC;
+}
+
+namespace mir
+{
+namespace frontend
+{
+/**
+ * Matches the buffers shown in each presented frame to the content updates
+ * that are waiting for feedback. Only used on the Wayland thread.
+ */
+class PresentationTracker : public compositor::PresentationObserver
+{
+public:
+    void await(mg::BufferID buffer, std::shared_ptr<WpPresentationFeedback> const& feedback);
+
+    void frame_presented(std::shared_ptr<mc::PresentedFrame const> const& frame) override;
+
+    bool awaiting_presentation() override
+    {
+        return anything_awaiting;
+    }
+
+private:
+    struct Update
+    {
+        mg::BufferID buffer;
+        std::shared_ptr<bool> surface_destroyed;
+        std::shared_ptr<WpPresentationFeedback> feedback;
+    };
+
+    /// In the order they were committed; at most two per surface
+    std::vector<Update> awaiting;
+    /// Whether awaiting is non-empty, for the compositor threads to check
+    std::atomic<bool> anything_awaiting{false};
+};
+}
+}
+
+void mf::PresentationTracker::await(mg::BufferID buffer, std::shared_ptr<WpPresentationFeedback> const& feedback)
+{
+    auto const surface = feedback->surface;
+
+    /*
+     * Of the surface's earlier updates only the latest may yet be shown, as it
+     * may be in a frame on its way to the screen. The rest are superseded now,
+     * rather than waiting for a frame to show the surface, which for a hidden
+     * surface may never come.
+     */
+    auto const latest = std::find_if(
+        awaiting.rbegin(), awaiting.rend(),
+        [surface](Update const& update) { return update.feedback->surface == surface; });
+
+    if (latest != awaiting.rend())
+    {
+        auto const keep = latest->feedback;
+        awaiting.erase(
+            std::remove_if(
+                awaiting.begin(), awaiting.end(),
+                [surface, &keep](Update const& update)
+                {
+                    if (update.feedback->surface != surface || update.feedback == keep)
+                        return false;
+
+                    update.feedback->discarded();
+                    return true;
+                }),
+            awaiting.end());
+    }
+
+    awaiting.push_back({buffer, deleted_flag_for_resource(surface), feedback});
+    anything_awaiting = true;
+}
+
+void mf::PresentationTracker::frame_presented(std::shared_ptr<mc::PresentedFrame const> const& frame)
+{
+    auto const shows = [](std::vector<mg::BufferID> const& buffers, mg::BufferID buffer)
+        {
+            return std::find(buffers.begin(), buffers.end(), buffer) != buffers.end();
+        };
+
+    // Working back from the newest, an update older than one that's been shown never will be
+    std::vector<wl_resource*> shown_surfaces;
+    std::vector<Update> still_awaiting;
+    for (auto update = awaiting.rbegin(); update != awaiting.rend(); ++update)
+    {
+        auto const surface = update->feedback->surface;
+        bool const zero_copy = shows(frame->scanned_out, update->buffer);
+
+        if (zero_copy || shows(frame->composited, update->buffer))
+        {
+            update->feedback->presented(*frame, zero_copy);
+            shown_surfaces.push_back(surface);
+        }
+        else if (*update->surface_destroyed ||
+                 std::find(shown_surfaces.begin(), shown_surfaces.end(), surface) != shown_surfaces.end())
+        {
+            update->feedback->discarded();
+        }
+        else
+        {
+            still_awaiting.push_back(std::move(*update));
+        }
+    }
+
+    std::reverse(still_awaiting.begin(), still_awaiting.end());
+    awaiting = std::move(still_awaiting);
+    anything_awaiting = !awaiting.empty();
+}
+
+class mf::WpPresentation::Instance : public wayland::Presentation
+{
+public:
+    Instance(wl_resource* new_resource, std::weak_ptr<PresentationTracker> const& tracker)
+        : Presentation{new_resource, Version<1>()},
+          tracker{tracker}
+    {
+        send_clock_id_event(presentation_clock);
+    }
+
+private:
+    void destroy() override
+    {
+        destroy_wayland_object();
+    }
+
+    void feedback(wl_resource* surface, wl_resource* callback) override
+    {
+        WlSurface::from(surface)->add_presentation_feedback(
+            std::make_shared<WpPresentationFeedback>(callback, surface, tracker));
+    }
+
+    std::weak_ptr<PresentationTracker> const tracker;
+};
+
+mf::WpPresentation::WpPresentation(
+    wl_display* display,
+    std::shared_ptr<Executor> const& wayland_executor,
+    std::shared_ptr<ObserverRegistrar<mc::PresentationObserver>> const& registrar)
+    : Global{display, Version<1>()},
+      wayland_executor{wayland_executor},
+      registrar{registrar},
+      tracker{std::make_shared<PresentationTracker>()}
+{
+    registrar->register_interest(tracker, *wayland_executor);
+}
+
+mf::WpPresentation::~WpPresentation()
+{
+    registrar->unregister_interest(*tracker);
+}
+
+void mf::WpPresentation::bind(wl_resource* new_resource)
+{
+    new Instance{new_resource, tracker};
+}
+
+mf::WpPresentationFeedback::WpPresentationFeedback(
+    wl_resource* new_resource,
+    wl_resource* surface,
+    std::weak_ptr<PresentationTracker> const& tracker)
+    : PresentationFeedback{new_resource, Version<1>()},
+      surface{surface},
+      destroyed{deleted_flag_for_resource(resource)},
+      tracker{tracker}
+{
+}
+
+void mf::WpPresentationFeedback::committed(mg::BufferID buffer)
+{
+    if (auto const presentations = tracker.lock())
+        presentations->await(buffer, shared_from_this());
+    else
+        discarded();
+}
+
+void mf::WpPresentationFeedback::discarded()
+{
+    if (!*destroyed)
+    {
+        send_discarded_event();
+        destroy_wayland_object();
+    }
+}
+
+void mf::WpPresentationFeedback::presented(mc::PresentedFrame const& frame, bool zero_copy)
+{
+    if (*destroyed)
+        return;
+
+    auto timestamp = frame.frame.ust;
+    uint64_t msc = 0;
+    uint32_t flags = zero_copy ? Kind::zero_copy : 0;
+
+    if (frame.frame.msc && timestamp.clock_id == presentation_clock)
+    {
+        // The platform has the time and count of the vblank it flipped on, from the display hardware
+        msc = frame.frame.msc;
+        flags |= Kind::vsync | Kind::hw_clock | Kind::hw_completion;
+    }
+    else
+    {
+        // All we know is that it's on screen by now
+        timestamp = time::PosixTimestamp::now(presentation_clock);
+    }
+
+    auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(timestamp.nanoseconds);
+    uint64_t const tv_sec = seconds.count();
+    uint32_t const tv_nsec = (timestamp.nanoseconds - seconds).count();
+
+    send_presented_event(
+        tv_sec >> 32, tv_sec & 0xffffffff, tv_nsec,
+        frame.refresh.count(),
+        msc >> 32, msc & 0xffffffff,
+        flags);
+    destroy_wayland_object();
+}
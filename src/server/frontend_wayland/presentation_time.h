@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_FRONTEND_PRESENTATION_TIME_H
+#define MIR_FRONTEND_PRESENTATION_TIME_H
+
+#include "presentation-time_wrapper.h"
+
+#include "mir/graphics/buffer_id.h"
+
+#include <memory>
+
+namespace mir
+{
+class Executor;
+template<class Observer>
+class ObserverRegistrar;
+namespace compositor
+{
+class PresentationObserver;
+struct PresentedFrame;
+}
+namespace frontend
+{
+class PresentationTracker;
+
+class WpPresentation : public wayland::Presentation::Global
+{
+public:
+    WpPresentation(
+        wl_display* display,
+        std::shared_ptr<Executor> const& wayland_executor,
+        std::shared_ptr<ObserverRegistrar<compositor::PresentationObserver>> const& registrar);
+    ~WpPresentation();
+
+private:
+    class Instance;
+
+    void bind(wl_resource* new_resource) override;
+
+    // Presentations are delivered through this, so it must outlive the registration
+    std::shared_ptr<Executor> const wayland_executor;
+    std::shared_ptr<ObserverRegistrar<compositor::PresentationObserver>> const registrar;
+    std::shared_ptr<PresentationTracker> const tracker;
+};
+
+/// Feedback on a single content update of a wl_surface
+class WpPresentationFeedback
+    : public wayland::PresentationFeedback,
+      public std::enable_shared_from_this<WpPresentationFeedback>
+{
+public:
+    WpPresentationFeedback(
+        wl_resource* new_resource,
+        wl_resource* surface,
+        std::weak_ptr<PresentationTracker> const& tracker);
+
+    /// The update has been committed, and will be on screen when \a buffer is
+    void committed(graphics::BufferID buffer);
+
+    /// The update will never be on screen
+    void discarded();
+
+    /// The update is on screen in \a frame
+    void presented(compositor::PresentedFrame const& frame, bool zero_copy);
+
+    wl_resource* const surface;
+
+private:
+    std::shared_ptr<bool> const destroyed;
+    std::weak_ptr<PresentationTracker> const tracker;
+};
+}
+}
+
+#endif // MIR_FRONTEND_PRESENTATION_TIME_H
@@ -614,6 +614,7 @@ mf::WaylandConnector::WaylandConnector(
     std::shared_ptr<mg::GraphicBufferAllocator> const& allocator,
     std::shared_ptr<mf::SessionAuthorizer> const& session_authorizer,
     std::shared_ptr<SurfaceStack> const& surface_stack,
+    std::shared_ptr<ObserverRegistrar<mc::PresentationObserver>> const& presentation_observer_registrar,
     bool arw_socket,
     std::unique_ptr<WaylandExtensions> extensions_,
     WaylandProtocolExtensionFilter const& extension_filter)
@@ -672,14 +673,14 @@ mf::WaylandConnector::WaylandConnector(
         executor);
 
     data_device_manager_global = mf::create_data_device_manager(display.get());
-
     extensions->init(WaylandExtensions::Context{
         display.get(),
         executor,
         shell,
         seat_global.get(),
         output_manager.get(),
-        surface_stack});
+        surface_stack,
+        presentation_observer_registrar});
 
     wl_display_init_shm(display.get());
 
@@ -32,6 +32,8 @@
 namespace mir
 {
 class Executor;
+template<class Observer>
+class ObserverRegistrar;
 
 namespace input
 {
@@ -54,6 +56,10 @@ namespace scene
 {
 class Surface;
 }
+namespace compositor
+{
+class PresentationObserver;
+}
 namespace frontend
 {
 class WlCompositor;
@@ -79,6 +85,7 @@ public:
         WlSeat* seat;
         OutputManager* output_manager;
         std::shared_ptr<SurfaceStack> surface_stack;
+        std::shared_ptr<ObserverRegistrar<compositor::PresentationObserver>> presentation_observer_registrar;
     };
 
     WaylandExtensions() = default;
@@ -114,6 +121,7 @@ public:
         std::shared_ptr<graphics::GraphicBufferAllocator> const& allocator,
         std::shared_ptr<SessionAuthorizer> const& session_authorizer,
         std::shared_ptr<SurfaceStack> const& surface_stack,
+        std::shared_ptr<ObserverRegistrar<compositor::PresentationObserver>> const& presentation_observer_registrar,
         bool arw_socket,
         std::unique_ptr<WaylandExtensions> extensions,
         WaylandProtocolExtensionFilter const& extension_filter);
@@ -30,6 +30,7 @@
 #include "xdg-output-unstable-v1_wrapper.h"
 #include "foreign_toplevel_manager_v1.h"
 #include "wlr-foreign-toplevel-management-unstable-v1_wrapper.h"
+#include "presentation_time.h"
 
 #include "mir/graphics/platform.h"
 #include "mir/options/default_configuration.h"
@@ -83,6 +84,15 @@ std::vector<ExtensionBuilder> const internal_extension_builders = {
                     ctx.surface_stack);
             }
     },
+    {
+        mw::Presentation::interface_name, [](auto const& ctx) -> std::shared_ptr<void>
+            {
+                return std::make_shared<mf::WpPresentation>(
+                    ctx.display,
+                    ctx.wayland_executor,
+                    ctx.presentation_observer_registrar);
+            }
+    },
 };
 
 ExtensionBuilder const xwayland_builder {
@@ -169,7 +179,8 @@ auto mf::get_standard_extensions() -> std::vector<std::string>
     return std::vector<std::string>{
         mw::Shell::interface_name,
         mw::XdgWmBase::interface_name,
-        mw::XdgShellV6::interface_name};
+        mw::XdgShellV6::interface_name,
+        mw::Presentation::interface_name};
 }
 
 auto mf::get_supported_extensions() -> std::vector<std::string>
@@ -207,6 +218,7 @@ std::shared_ptr<mf::Connector>
                 the_buffer_allocator(),
                 the_session_authorizer(),
                 the_frontend_surface_stack(),
+                the_presentation_observer_registrar(),
                 arw_socket,
                 configure_wayland_extensions(
                     wayland_extensions,
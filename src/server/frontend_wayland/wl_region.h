@@ -23,6 +23,7 @@
 #include "wayland_wrapper.h"
 
 #include "mir/geometry/rectangle.h"
+#include "mir/geometry/rectangles.h"
 
 #include <vector>
 
@@ -46,7 +47,7 @@ private:
     void add(int32_t x, int32_t y, int32_t width, int32_t height) override;
     void subtract(int32_t x, int32_t y, int32_t width, int32_t height) override;
 
-    std::vector<geometry::Rectangle> rects;
+    geometry::Rectangles rects;
 };
 
 }
@@ -23,6 +23,7 @@
 #include "wl_subcompositor.h"
 #include "wl_region.h"
 #include "deleted_for_resource.h"
+#include "presentation_time.h"
 
 #include "wayland_wrapper.h"
 
@@ -36,6 +37,7 @@
 #include "mir/graphics/graphic_buffer_allocator.h"
 #include "mir/shell/surface_specification.h"
 #include "mir/log.h"
+#include "mir/time/posix_timestamp.h"
 
 #include <algorithm>
 #include <boost/throw_exception.hpp>
@@ -66,10 +68,20 @@ void mf::WlSurfaceState::update_from(WlSurfaceState const& source)
     if (source.input_shape)
         input_shape = source.input_shape;
 
+    if (source.opaque_region)
+        opaque_region = source.opaque_region;
+
     frame_callbacks.insert(end(frame_callbacks),
                            begin(source.frame_callbacks),
                            end(source.frame_callbacks));
 
+    presentation_feedbacks.insert(end(presentation_feedbacks),
+                                  begin(source.presentation_feedbacks),
+                                  end(source.presentation_feedbacks));
+
+    surface_damage.insert(end(surface_damage), begin(source.surface_damage), end(source.surface_damage));
+    buffer_damage.insert(end(buffer_damage), begin(source.buffer_damage), end(source.buffer_damage));
+
     if (source.surface_data_invalidated)
         surface_data_invalidated = true;
 }
@@ -109,6 +121,10 @@ mf::WlSurface::~WlSurface()
 
     role->destroy();
     session->destroy_buffer_stream(stream);
+
+    // Updates that were never committed won't be shown
+    for (auto const& feedback : pending.presentation_feedbacks)
+        feedback->discarded();
 }
 
 bool mf::WlSurface::synchronized() const
@@ -240,14 +256,22 @@ mf::WlSurface* mf::WlSurface::from(wl_resource* resource)
     return static_cast<WlSurface*>(static_cast<wayland::Surface*>(raw_surface));
 }
 
+void mf::WlSurface::add_presentation_feedback(std::shared_ptr<WpPresentationFeedback> const& feedback)
+{
+    pending.presentation_feedbacks.push_back(feedback);
+}
+
 void mf::WlSurface::send_frame_callbacks()
 {
+    // wl_callback.done has a timestamp in milliseconds, with an undefined base
+    auto const now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        time::PosixTimestamp::now(CLOCK_MONOTONIC).nanoseconds);
+
     for (auto const& frame : frame_callbacks)
     {
         if (!*frame->destroyed)
         {
-            // TODO: argument should be a timestamp
-            frame->send_done_event(0);
+            frame->send_done_event(now.count());
             frame->destroy_wayland_object();
         }
     }
@@ -271,20 +295,12 @@ void mf::WlSurface::attach(std::experimental::optional<wl_resource*> const& buff
 
 void mf::WlSurface::damage(int32_t x, int32_t y, int32_t width, int32_t height)
 {
-    (void)x;
-    (void)y;
-    (void)width;
-    (void)height;
-    // This isn't essential, but could enable optimizations
+    pending.surface_damage.push_back({{x, y}, {width, height}});
 }
 
 void mf::WlSurface::damage_buffer(int32_t x, int32_t y, int32_t width, int32_t height)
 {
-    (void)x;
-    (void)y;
-    (void)width;
-    (void)height;
-    // This isn't essential, but could enable optimizations
+    pending.buffer_damage.push_back({{x, y}, {width, height}});
 }
 
 void mf::WlSurface::frame(wl_resource* new_callback)
@@ -294,8 +310,14 @@ void mf::WlSurface::frame(wl_resource* new_callback)
 
 void mf::WlSurface::set_opaque_region(std::experimental::optional<wl_resource*> const& region)
 {
-    (void)region;
-    // This isn't essential, but could enable optimizations
+    if (region)
+    {
+        pending.opaque_region = WlRegion::from(region.value())->rectangle_vector();
+    }
+    else
+    {
+        pending.opaque_region = std::vector<geom::Rectangle>{};
+    }
 }
 
 void mf::WlSurface::set_input_region(std::experimental::optional<wl_resource*> const& region)
@@ -341,6 +363,55 @@ MirPixelFormat wl_format_to_mir_format(uint32_t format)
             return mir_pixel_format_invalid;
     }
 }
+
+/*
+ * Clients commonly send "everything" damage as (0, 0, INT32_MAX, INT32_MAX),
+ * so do the arithmetic in 64 bits and clip to the buffer before narrowing.
+ */
+void add_clipped_damage(
+    geom::Rectangles& damage,
+    int64_t x, int64_t y, int64_t width, int64_t height,
+    int64_t scale,
+    geom::Size const& buffer_size)
+{
+    auto const left = std::max<int64_t>(x * scale, 0);
+    auto const top = std::max<int64_t>(y * scale, 0);
+    auto const right = std::min<int64_t>((x + width) * scale, buffer_size.width.as_int());
+    auto const bottom = std::min<int64_t>((y + height) * scale, buffer_size.height.as_int());
+
+    if (left < right && top < bottom)
+    {
+        damage.add({
+            {static_cast<int>(left), static_cast<int>(top)},
+            {static_cast<int>(right - left), static_cast<int>(bottom - top)}});
+    }
+}
+
+auto buffer_damage_for(mf::WlSurfaceState const& state, int scale, geom::Size const& buffer_size)
+    -> geom::Rectangles
+{
+    geom::Rectangles damage;
+
+    for (auto const& rect : state.buffer_damage)
+    {
+        add_clipped_damage(
+            damage,
+            rect.top_left.x.as_int(), rect.top_left.y.as_int(),
+            rect.size.width.as_int(), rect.size.height.as_int(),
+            1, buffer_size);
+    }
+
+    for (auto const& rect : state.surface_damage)
+    {
+        add_clipped_damage(
+            damage,
+            rect.top_left.x.as_int(), rect.top_left.y.as_int(),
+            rect.size.width.as_int(), rect.size.height.as_int(),
+            scale, buffer_size);
+    }
+
+    return damage;
+}
 }
 
 void mf::WlSurface::commit(WlSurfaceState const& state)
@@ -357,7 +428,18 @@ void mf::WlSurface::commit(WlSurfaceState const& state)
         input_shape = state.input_shape.value();
 
     if (state.scale)
-        stream->set_scale(state.scale.value());
+    {
+        buffer_scale = state.scale.value();
+        stream->set_scale(buffer_scale);
+    }
+
+    if (state.opaque_region)
+    {
+        geom::Rectangles opaque_region;
+        for (auto const& rect : state.opaque_region.value())
+            opaque_region.add(rect);
+        stream->set_opaque_region(opaque_region);
+    }
 
     if (state.buffer)
     {
@@ -368,6 +450,8 @@ void mf::WlSurface::commit(WlSurfaceState const& state)
             // TODO: unmap surface, and unmap all subsurfaces
             buffer_size_ = std::experimental::nullopt;
             send_frame_callbacks();
+            for (auto const& feedback : state.presentation_feedbacks)
+                feedback->discarded();
         }
         else
         {
@@ -400,10 +484,13 @@ void mf::WlSurface::commit(WlSurfaceState const& state)
                     BOOST_THROW_EXCEPTION((
                                               std::runtime_error{"Buffer has invalid stride"}));
                 }
+                geom::Size const size{width, wl_shm_buffer_get_height(shm_buffer)};
                 mir_buffer = allocator->buffer_from_shm(
                     buffer,
                     executor,
-                    std::move(executor_send_frame_callbacks));
+                    std::move(executor_send_frame_callbacks),
+                    previous_buffer.lock(),
+                    buffer_damage_for(state, buffer_scale, size));
                 tracepoint(
                     mir_server_wayland,
                     sw_buffer_committed,
@@ -432,7 +519,11 @@ void mf::WlSurface::commit(WlSurfaceState const& state)
                     mir_buffer->id().as_value());
             }
 
-            stream->submit_buffer(mir_buffer);
+            // Before the compositor can see the buffer, so it knows to report the frame showing it
+            for (auto const& feedback : state.presentation_feedbacks)
+                feedback->committed(mir_buffer->id());
+            stream->submit_buffer(mir_buffer, buffer_damage_for(state, buffer_scale, mir_buffer->size()));
+            previous_buffer = mir_buffer;
             auto const new_buffer_size = stream->stream_size();
 
             if (!input_shape && std::experimental::make_optional(new_buffer_size) != buffer_size_)
@@ -446,6 +537,10 @@ void mf::WlSurface::commit(WlSurfaceState const& state)
     else
     {
         send_frame_callbacks();
+
+        // Without a new buffer there's nothing new to be presented
+        for (auto const& feedback : state.presentation_feedbacks)
+            feedback->discarded();
     }
 
     for (WlSubsurface* child: children)
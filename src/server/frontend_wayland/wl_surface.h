@@ -26,6 +26,7 @@
 #include "mir/geometry/displacement.h"
 #include "mir/geometry/size.h"
 #include "mir/geometry/point.h"
+#include "mir/geometry/rectangle.h"
 
 #include <vector>
 #include <map>
@@ -36,6 +37,7 @@ class Executor;
 
 namespace graphics
 {
+class Buffer;
 class GraphicBufferAllocator;
 }
 namespace scene
@@ -46,10 +48,6 @@ namespace shell
 {
 struct StreamSpecification;
 }
-namespace geometry
-{
-class Rectangle;
-}
 namespace compositor
 {
 class BufferStream;
@@ -58,6 +56,7 @@ namespace frontend
 {
 class WlSurface;
 class WlSubsurface;
+class WpPresentationFeedback;
 
 struct WlSurfaceState
 {
@@ -84,6 +83,11 @@ struct WlSurfaceState
     std::experimental::optional<geometry::Displacement> offset;
     std::experimental::optional<std::experimental::optional<std::vector<geometry::Rectangle>>> input_shape;
     std::vector<std::shared_ptr<Callback>> frame_callbacks;
+    std::vector<std::shared_ptr<WpPresentationFeedback>> presentation_feedbacks;
+    std::vector<geometry::Rectangle> surface_damage;  ///< from wl_surface.damage, in surface coordinates
+    std::vector<geometry::Rectangle> buffer_damage;   ///< from wl_surface.damage_buffer, in buffer coordinates
+    // an empty vector means the opaque region has been unset
+    std::experimental::optional<std::vector<geometry::Rectangle>> opaque_region;
 
 private:
     // only set to true if invalidate_surface_data() is called
@@ -130,6 +134,7 @@ public:
     void remove_subsurface(WlSubsurface* child);
     void refresh_surface_data_now();
     void pending_invalidate_surface_data() { pending.invalidate_surface_data(); }
+    void add_presentation_feedback(std::shared_ptr<WpPresentationFeedback> const& feedback);
     void populate_surface_data(std::vector<shell::StreamSpecification>& buffer_streams,
                                std::vector<mir::geometry::Rectangle>& input_shape_accumulator,
                                geometry::Displacement const& parent_offset) const;
@@ -153,6 +158,9 @@ private:
     WlSurfaceState pending;
     geometry::Displacement offset_;
     std::experimental::optional<geometry::Size> buffer_size_;
+    /// The last buffer submitted, which SHM buffers may take over the texture of
+    std::weak_ptr<graphics::Buffer> previous_buffer;
+    int buffer_scale{1};
     std::vector<std::shared_ptr<WlSurfaceState::Callback>> frame_callbacks;
     std::experimental::optional<std::vector<mir::geometry::Rectangle>> input_shape;
     std::map<void const*, std::function<void()>> destroy_listeners;
@@ -223,12 +223,17 @@ mir::DefaultServerConfiguration::the_gl_config()
     return gl_config(
         []
         {
-            struct NoGLConfig : public mg::GLConfig
+            /*
+             * The GL renderer draws opaque renderables front to back behind
+             * a stencil test (one rank per renderable, so 8 bits is plenty),
+             * and only does so when there's a stencil buffer to use.
+             */
+            struct DefaultGLConfig : public mg::GLConfig
             {
                 int depth_buffer_bits() const override { return 0; }
-                int stencil_buffer_bits() const override { return 0; }
+                int stencil_buffer_bits() const override { return 8; }
             };
-            return std::make_shared<NoGLConfig>();
+            return std::make_shared<DefaultGLConfig>();
         });
 }
 
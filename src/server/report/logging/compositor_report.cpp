@@ -74,6 +74,44 @@ void mrl::CompositorReport::rendered_frame(SubCompositorId id)
     inst.bypassed = false;
 }
 
+void mrl::CompositorReport::state_changes_in_frame(SubCompositorId id, unsigned int made, unsigned int skipped)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& inst = instance[id];
+    inst.state_changes_made += made;
+    inst.state_changes_skipped += skipped;
+}
+
+void mrl::CompositorReport::texture_cache_in_frame(
+    SubCompositorId id, unsigned int hits, unsigned int misses, std::size_t bytes_resident)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& inst = instance[id];
+    inst.texture_cache_hits += hits;
+    inst.texture_cache_misses += misses;
+    inst.texture_cache_bytes = bytes_resident;
+}
+
+void mrl::CompositorReport::gpu_rendered_frame(SubCompositorId id, std::chrono::nanoseconds render_time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& inst = instance[id];
+    ++inst.gpu_frames;
+    inst.gpu_render_time_sum += render_time;
+}
+
+void mrl::CompositorReport::gpu_idle(SubCompositorId id, std::chrono::nanoseconds gap)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    instance[id].gpu_idle_sum += gap;
+}
+
+void mrl::CompositorReport::gpu_rendered_renderable(
+    SubCompositorId, graphics::Renderable::ID, std::chrono::nanoseconds)
+{
+    // Too much detail to log; the LTTng report has it
+}
+
 void mrl::CompositorReport::Instance::log(ml::Logger& logger, SubCompositorId id)
 {
     // The first report is a valid sample, but don't log anything because
@@ -95,6 +133,11 @@ void mrl::CompositorReport::Instance::log(ml::Logger& logger, SubCompositorId id
             ).count();
 
         long bypass_percent = dn ? (nbypassed - last_reported_bypassed) * 100L / dn : 0;
+        long rendered = dn - (nbypassed - last_reported_bypassed);
+        long long state_changes = rendered ?
+            (state_changes_made - last_reported_state_changes_made) / rendered : 0;
+        long long skipped_state_changes = rendered ?
+            (state_changes_skipped - last_reported_state_changes_skipped) / rendered : 0;
 
         // Keep everything premultiplied by 1000 to guarantee accuracy
         // and avoid floating point.
@@ -103,12 +146,14 @@ void mrl::CompositorReport::Instance::log(ml::Logger& logger, SubCompositorId id
         long avg_latency_usec = dn ? dl / dn : 0;
         long dt_msec = dt / 1000L;
 
-        char msg[128];
-        snprintf(msg, sizeof msg, "Display %p averaged %ld.%03ld FPS, "
+        char msg[320];
+        auto length = snprintf(msg, sizeof msg, "Display %p averaged %ld.%03ld FPS, "
                  "%ld.%03ld ms/frame, "
                  "latency %ld.%03ld ms, "
                  "%ld frames over %ld.%03ld sec, "
-                 "%ld%% bypassed",
+                 "%ld%% bypassed, "
+                 "%lld state changes/frame (%lld skipped), "
+                 "texture cache %lld hits, %lld misses, %zu KiB",
                  id,
                  frames_per_1000sec / 1000,
                  frames_per_1000sec % 1000,
@@ -119,9 +164,33 @@ void mrl::CompositorReport::Instance::log(ml::Logger& logger, SubCompositorId id
                  dn,
                  dt_msec / 1000,
                  dt_msec % 1000,
-                 bypass_percent
+                 bypass_percent,
+                 state_changes,
+                 skipped_state_changes,
+                 texture_cache_hits - last_reported_texture_cache_hits,
+                 texture_cache_misses - last_reported_texture_cache_misses,
+                 texture_cache_bytes / 1024
                  );
 
+        // Only when the renderer times its GPU work
+        if (auto const gpu_dn = gpu_frames - last_reported_gpu_frames)
+        {
+            long const gpu_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                gpu_render_time_sum - last_reported_gpu_render_time_sum).count() / gpu_dn;
+            long const idle_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                gpu_idle_sum - last_reported_gpu_idle_sum).count() / gpu_dn;
+
+            if (length > 0 && static_cast<std::size_t>(length) < sizeof msg)
+            {
+                snprintf(msg + length, sizeof msg - length,
+                         ", GPU %ld.%03ld ms/frame, GPU idle %ld.%03ld ms/frame",
+                         gpu_usec / 1000,
+                         gpu_usec % 1000,
+                         idle_usec / 1000,
+                         idle_usec % 1000);
+            }
+        }
+
         logger.log(ml::Severity::informational, msg, component);
     }
 
@@ -130,6 +199,13 @@ void mrl::CompositorReport::Instance::log(ml::Logger& logger, SubCompositorId id
     last_reported_latency_sum = latency_sum;
     last_reported_nframes = nframes;
     last_reported_bypassed = nbypassed;
+    last_reported_state_changes_made = state_changes_made;
+    last_reported_state_changes_skipped = state_changes_skipped;
+    last_reported_texture_cache_hits = texture_cache_hits;
+    last_reported_texture_cache_misses = texture_cache_misses;
+    last_reported_gpu_frames = gpu_frames;
+    last_reported_gpu_render_time_sum = gpu_render_time_sum;
+    last_reported_gpu_idle_sum = gpu_idle_sum;
 }
 
 void mrl::CompositorReport::finished_frame(SubCompositorId id)
@@ -46,6 +46,13 @@ public:
     void began_frame(SubCompositorId id) override;
     void renderables_in_frame(SubCompositorId id, graphics::RenderableList const& renderables) override;
     void rendered_frame(SubCompositorId id) override;
+    void state_changes_in_frame(SubCompositorId id, unsigned int made, unsigned int skipped) override;
+    void texture_cache_in_frame(
+        SubCompositorId id, unsigned int hits, unsigned int misses, std::size_t bytes_resident) override;
+    void gpu_rendered_frame(SubCompositorId id, std::chrono::nanoseconds render_time) override;
+    void gpu_idle(SubCompositorId id, std::chrono::nanoseconds gap) override;
+    void gpu_rendered_renderable(
+        SubCompositorId id, graphics::Renderable::ID renderable, std::chrono::nanoseconds render_time) override;
     void finished_frame(SubCompositorId id) override;
     void started() override;
     void stopped() override;
@@ -67,6 +74,14 @@ private:
         TimePoint latency_sum;
         long nframes = 0;
         long nbypassed = 0;
+        long long state_changes_made = 0;
+        long long state_changes_skipped = 0;
+        long long texture_cache_hits = 0;
+        long long texture_cache_misses = 0;
+        std::size_t texture_cache_bytes = 0;
+        long gpu_frames = 0;
+        std::chrono::nanoseconds gpu_render_time_sum{0};
+        std::chrono::nanoseconds gpu_idle_sum{0};
         bool bypassed = true;
         bool prev_bypassed = false;
 
@@ -75,6 +90,13 @@ private:
         TimePoint last_reported_latency_sum;
         long last_reported_nframes = 0;
         long last_reported_bypassed = 0;
+        long long last_reported_state_changes_made = 0;
+        long long last_reported_state_changes_skipped = 0;
+        long long last_reported_texture_cache_hits = 0;
+        long long last_reported_texture_cache_misses = 0;
+        long last_reported_gpu_frames = 0;
+        std::chrono::nanoseconds last_reported_gpu_render_time_sum{0};
+        std::chrono::nanoseconds last_reported_gpu_idle_sum{0};
 
         void log(mir::logging::Logger& logger, SubCompositorId id);
     };
@@ -58,6 +58,35 @@ void mir::report::lttng::CompositorReport::rendered_frame(SubCompositorId id)
     mir_tracepoint(mir_server_compositor, rendered_frame, id);
 }
 
+void mir::report::lttng::CompositorReport::state_changes_in_frame(
+    SubCompositorId id, unsigned int made, unsigned int skipped)
+{
+    mir_tracepoint(mir_server_compositor, state_changes_in_frame, id, made, skipped);
+}
+
+void mir::report::lttng::CompositorReport::texture_cache_in_frame(
+    SubCompositorId id, unsigned int hits, unsigned int misses, std::size_t bytes_resident)
+{
+    mir_tracepoint(mir_server_compositor, texture_cache_in_frame, id, hits, misses, bytes_resident);
+}
+
+void mir::report::lttng::CompositorReport::gpu_rendered_frame(
+    SubCompositorId id, std::chrono::nanoseconds render_time)
+{
+    mir_tracepoint(mir_server_compositor, gpu_rendered_frame, id, render_time.count());
+}
+
+void mir::report::lttng::CompositorReport::gpu_idle(SubCompositorId id, std::chrono::nanoseconds gap)
+{
+    mir_tracepoint(mir_server_compositor, gpu_idle, id, gap.count());
+}
+
+void mir::report::lttng::CompositorReport::gpu_rendered_renderable(
+    SubCompositorId id, graphics::Renderable::ID renderable, std::chrono::nanoseconds render_time)
+{
+    mir_tracepoint(mir_server_compositor, gpu_rendered_renderable, id, renderable, render_time.count());
+}
+
 void mir::report::lttng::CompositorReport::finished_frame(SubCompositorId id)
 {
     mir_tracepoint(mir_server_compositor, finished_frame, id);
@@ -80,6 +80,60 @@ TRACEPOINT_EVENT_INSTANCE(
     TP_ARGS(void const*, id)
 )
 
+TRACEPOINT_EVENT(
+    mir_server_compositor,
+    state_changes_in_frame,
+    TP_ARGS(void const*, id, unsigned int, made, unsigned int, skipped),
+    TP_FIELDS(
+        ctf_integer_hex(uintptr_t, id, (uintptr_t)(id))
+        ctf_integer(unsigned int, made, made)
+        ctf_integer(unsigned int, skipped, skipped)
+    )
+)
+
+TRACEPOINT_EVENT(
+    mir_server_compositor,
+    texture_cache_in_frame,
+    TP_ARGS(void const*, id, unsigned int, hits, unsigned int, misses, size_t, bytes_resident),
+    TP_FIELDS(
+        ctf_integer_hex(uintptr_t, id, (uintptr_t)(id))
+        ctf_integer(unsigned int, hits, hits)
+        ctf_integer(unsigned int, misses, misses)
+        ctf_integer(size_t, bytes_resident, bytes_resident)
+    )
+)
+
+TRACEPOINT_EVENT(
+    mir_server_compositor,
+    gpu_rendered_frame,
+    TP_ARGS(void const*, id, int64_t, render_time_ns),
+    TP_FIELDS(
+        ctf_integer_hex(uintptr_t, id, (uintptr_t)(id))
+        ctf_integer(int64_t, render_time_ns, render_time_ns)
+    )
+)
+
+TRACEPOINT_EVENT(
+    mir_server_compositor,
+    gpu_idle,
+    TP_ARGS(void const*, id, int64_t, gap_ns),
+    TP_FIELDS(
+        ctf_integer_hex(uintptr_t, id, (uintptr_t)(id))
+        ctf_integer(int64_t, gap_ns, gap_ns)
+    )
+)
+
+TRACEPOINT_EVENT(
+    mir_server_compositor,
+    gpu_rendered_renderable,
+    TP_ARGS(void const*, id, void const*, renderable, int64_t, render_time_ns),
+    TP_FIELDS(
+        ctf_integer_hex(uintptr_t, id, (uintptr_t)(id))
+        ctf_integer_hex(uintptr_t, renderable, (uintptr_t)(renderable))
+        ctf_integer(int64_t, render_time_ns, render_time_ns)
+    )
+)
+
 TRACEPOINT_EVENT(
     mir_server_compositor,
     buffers_in_frame,
@@ -36,6 +36,26 @@ void mrn::CompositorReport::rendered_frame(SubCompositorId)
 {
 }
 
+void mrn::CompositorReport::state_changes_in_frame(SubCompositorId, unsigned int, unsigned int)
+{
+}
+
+void mrn::CompositorReport::texture_cache_in_frame(SubCompositorId, unsigned int, unsigned int, std::size_t)
+{
+}
+
+void mrn::CompositorReport::gpu_rendered_frame(SubCompositorId, std::chrono::nanoseconds)
+{
+}
+
+void mrn::CompositorReport::gpu_idle(SubCompositorId, std::chrono::nanoseconds)
+{
+}
+
+void mrn::CompositorReport::gpu_rendered_renderable(SubCompositorId, graphics::Renderable::ID, std::chrono::nanoseconds)
+{
+}
+
 void mrn::CompositorReport::finished_frame(SubCompositorId)
 {
 }
@@ -35,6 +35,13 @@ public:
     void began_frame(SubCompositorId id) override;
     void renderables_in_frame(SubCompositorId id, graphics::RenderableList const& renderables) override;
     void rendered_frame(SubCompositorId id) override;
+    void state_changes_in_frame(SubCompositorId id, unsigned int made, unsigned int skipped) override;
+    void texture_cache_in_frame(
+        SubCompositorId id, unsigned int hits, unsigned int misses, std::size_t bytes_resident) override;
+    void gpu_rendered_frame(SubCompositorId id, std::chrono::nanoseconds render_time) override;
+    void gpu_idle(SubCompositorId id, std::chrono::nanoseconds gap) override;
+    void gpu_rendered_renderable(
+        SubCompositorId id, graphics::Renderable::ID renderable, std::chrono::nanoseconds render_time) override;
     void finished_frame(SubCompositorId id) override;
     void started() override;
     void stopped() override;
@@ -20,6 +20,7 @@
 
 #include "basic_surface.h"
 #include "mir/compositor/buffer_stream.h"
+#include "mir/compositor/frame_pool.h"
 #include "mir/frontend/event_sink.h"
 #include "mir/shell/input_targeter.h"
 #include "mir/graphics/buffer.h"
@@ -293,6 +294,11 @@ ms::BasicSurface::BasicSurface(
     {
         layer.stream->set_frame_posted_callback(callback);
     }
+
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        publish_presentation(lock);
+    }
     report->surface_created(this, surface_name);
 }
 
@@ -327,6 +333,7 @@ void ms::BasicSurface::move_to(geometry::Point const& top_left)
     {
         std::lock_guard<std::mutex> lock(guard);
         surface_rect.top_left = top_left;
+        publish_presentation(lock);
     }
     observers->moved_to(this, top_left);
 }
@@ -336,6 +343,7 @@ void ms::BasicSurface::set_hidden(bool hide)
     {
         std::lock_guard<std::mutex> lock(guard);
         hidden = hide;
+        publish_presentation(lock);
     }
     observers->hidden_set_to(this, hide);
 }
@@ -368,6 +376,7 @@ void ms::BasicSurface::set_input_region(std::vector<geom::Rectangle> const& inpu
 {
     std::lock_guard<std::mutex> lock(guard);
     custom_input_rectangles = input_rectangles;
+    publish_presentation(lock);
 }
 
 void ms::BasicSurface::resize(geom::Size const& desired_size)
@@ -380,6 +389,7 @@ void ms::BasicSurface::resize(geom::Size const& desired_size)
     if (new_size != surface_rect.size)
     {
         surface_rect.size = new_size;
+        publish_presentation(lock);
         auto const content_size_ = content_size(lock);
 
         lock.unlock();
@@ -403,27 +413,27 @@ geom::Rectangle ms::BasicSurface::input_bounds() const
 // TODO: Does not account for transformation().
 bool ms::BasicSurface::input_area_contains(geom::Point const& point) const
 {
-    std::lock_guard<std::mutex> lock(guard);
+    auto const current = presentation();
 
-    if (!visible(lock))
+    if (!visible(*current))
         return false;
 
-    if (clip_area_) 
+    if (current->clip_area)
     {
-        if (!clip_area_.value().contains(point))
+        if (!current->clip_area.value().contains(point))
             return false;
     }
 
-    if (custom_input_rectangles.empty())
+    if (current->input_rectangles.empty())
     {
         // no custom input, restrict to bounding rectangle
-        auto const input_rect = geom::Rectangle{content_top_left(lock), content_size(lock)};
+        auto const input_rect = geom::Rectangle{current->content_top_left, current->content_size};
         return input_rect.contains(point);
     }
     else
     {
-        auto local_point = as_point(point - content_top_left(lock));
-        for (auto const& rectangle : custom_input_rectangles)
+        auto local_point = as_point(point - current->content_top_left);
+        for (auto const& rectangle : current->input_rectangles)
         {
             if (rectangle.contains(local_point))
                 return true;
@@ -437,6 +447,7 @@ void ms::BasicSurface::set_alpha(float alpha)
     {
         std::lock_guard<std::mutex> lock(guard);
         surface_alpha = alpha;
+        publish_presentation(lock);
     }
     observers->alpha_set_to(this, alpha);
 }
@@ -451,22 +462,42 @@ void ms::BasicSurface::set_transformation(glm::mat4 const& t)
     {
         std::lock_guard<std::mutex> lock(guard);
         transformation_matrix = t;
+        publish_presentation(lock);
     }
     observers->transformation_set_to(this, t);
 }
 
 bool ms::BasicSurface::visible() const
 {
-    std::lock_guard<std::mutex> lock(guard);
-    return visible(lock);
+    return visible(*presentation());
 }
 
-bool ms::BasicSurface::visible(ProofOfMutexLock const&) const
+bool ms::BasicSurface::visible(Presentation const& presentation)
 {
     bool visible{false};
-    for (auto const& info : layers)
+    for (auto const& info : presentation.layers)
         visible |= info.stream->has_submitted_buffer();
-    return !hidden && visible;
+    return !presentation.hidden && visible;
+}
+
+void ms::BasicSurface::publish_presentation(ProofOfMutexLock const& lock)
+{
+    std::atomic_store(&presentation_, std::shared_ptr<Presentation const>{std::make_shared<Presentation>(
+        Presentation{
+            surface_rect,
+            content_top_left(lock),
+            content_size(lock),
+            transformation_matrix,
+            surface_alpha,
+            hidden,
+            clip_area_,
+            custom_input_rectangles,
+            {layers.begin(), layers.end()}})});
+}
+
+auto ms::BasicSurface::presentation() const -> std::shared_ptr<Presentation const>
+{
+    return std::atomic_load(&presentation_);
 }
 
 mi::InputReceptionMode ms::BasicSurface::reception_mode() const
@@ -817,6 +848,14 @@ public:
       transformation_(transform),
       id_(id)
     {
+        for (auto const& rect : stream->opaque_region())
+        {
+            auto const opaque = geom::Rectangle{rect.top_left + as_displacement(position.top_left), rect.size}
+                .intersection_with(position);
+
+            if (opaque.size.width.as_int() > 0 && opaque.size.height.as_int() > 0)
+                opaque_region_.add(opaque);
+        }
     }
 
     ~SurfaceSnapshot()
@@ -850,8 +889,15 @@ public:
     bool shaped() const override
     { return mg::contains_alpha(underlying_buffer_stream->pixel_format()); }
 
+    auto opaque_region() const -> geom::Rectangles override
+    { return opaque_region_; }
+
     mg::Renderable::ID id() const override
     { return id_; }
+
+    auto buffer_damage_since(mg::BufferID previous) const
+        -> std::experimental::optional<geom::Rectangles> override
+    { return underlying_buffer_stream->damage_between(previous, buffer()->id()); }
 private:
     std::shared_ptr<mc::BufferStream> const underlying_buffer_stream;
     std::shared_ptr<mg::Buffer> mutable compositor_buffer;
@@ -861,14 +907,15 @@ private:
     std::experimental::optional<geom::Rectangle> const clip_area_;
     glm::mat4 const transformation_;
     mg::Renderable::ID const id_;
+    geom::Rectangles opaque_region_;
 };
 }
 
 int ms::BasicSurface::buffers_ready_for_compositor(void const* id) const
 {
-    std::lock_guard<std::mutex> lock(guard);
+    auto const current = presentation();
     auto max_buf = 0;
-    for (auto const& info : layers)
+    for (auto const& info : current->layers)
         max_buf = std::max(max_buf, info.stream->buffers_ready_for_compositor(id));
     return max_buf;
 }
@@ -913,6 +960,7 @@ void ms::BasicSurface::set_streams(std::list<scene::StreamInfo> const& s)
                     if (auto const o = observers.lock())
                         o->frame_posted(this, 1, size);
                 });
+        publish_presentation(lock);
         surface_top_left = surface_rect.top_left;
     }
     observers->moved_to(this, surface_top_left);
@@ -920,18 +968,16 @@ void ms::BasicSurface::set_streams(std::list<scene::StreamInfo> const& s)
 
 mg::RenderableList ms::BasicSurface::generate_renderables(mc::CompositorID id) const
 {
-    std::lock_guard<std::mutex> lock(guard);
-    mg::RenderableList list;
-    
-    if (clip_area_)
+    auto const current = presentation();
+    auto list = mc::recycled_vector<mg::RenderableList>();
+
+    if (current->clip_area)
     {
-        if (!surface_rect.overlaps(clip_area_.value()))
+        if (!current->surface_rect.overlaps(current->clip_area.value()))
             return list;
     }
 
-    auto const content_top_left_ = content_top_left(lock);
-
-    for (auto const& info : layers)
+    for (auto const& info : current->layers)
     {
         if (info.stream->has_submitted_buffer())
         {
@@ -941,11 +987,11 @@ mg::RenderableList ms::BasicSurface::generate_renderables(mc::CompositorID id) c
             else
                 size = info.stream->stream_size();
 
-            list.emplace_back(std::make_shared<SurfaceSnapshot>(
+            list.emplace_back(mc::make_frame_shared<SurfaceSnapshot>(
                 info.stream, id,
-                geom::Rectangle{content_top_left_ + info.displacement, std::move(size)},
-                clip_area_,
-                transformation_matrix, surface_alpha, info.stream.get()));
+                geom::Rectangle{current->content_top_left + info.displacement, std::move(size)},
+                current->clip_area,
+                current->transformation, current->alpha, info.stream.get()));
         }
     }
     return list;
@@ -998,6 +1044,7 @@ void mir::scene::BasicSurface::set_clip_area(std::experimental::optional<geom::R
 {
     std::lock_guard<std::mutex> lock(guard);
     clip_area_ = area;
+    publish_presentation(lock);
 }
 
 auto mir::scene::BasicSurface::focus_state() const -> MirWindowFocusState
@@ -1069,6 +1116,7 @@ void mir::scene::BasicSurface::set_window_margins(
         margins.left   = left;
         margins.bottom = bottom;
         margins.right  = right;
+        publish_presentation(lock);
 
         auto const size = content_size(lock);
         lock.unlock();
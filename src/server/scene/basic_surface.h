@@ -176,7 +176,28 @@ private:
         ProofOfMutexLock operator=(ProofOfMutexLock const&) = delete;
     };
 
-    bool visible(ProofOfMutexLock const&) const;
+    /**
+     * What compositing and input hit-testing need of the surface. A fresh one
+     * is published, under guard, whenever any of it changes, so they can read
+     * it without taking guard.
+     */
+    struct Presentation
+    {
+        geometry::Rectangle surface_rect;
+        geometry::Point content_top_left;
+        geometry::Size content_size;
+        glm::mat4 transformation;
+        float alpha;
+        bool hidden;
+        std::experimental::optional<geometry::Rectangle> clip_area;
+        std::vector<geometry::Rectangle> input_rectangles;
+        std::vector<StreamInfo> layers;
+    };
+
+    static bool visible(Presentation const& presentation);
+    void publish_presentation(ProofOfMutexLock const&);
+    auto presentation() const -> std::shared_ptr<Presentation const>;
+
     MirWindowType set_type(MirWindowType t);  // Use configure() to make public changes
     MirWindowState set_state(MirWindowState s);
     int set_dpi(int);
@@ -226,6 +247,9 @@ private:
         geometry::DeltaY bottom;
         geometry::DeltaX right;
     } margins;
+
+    /// Only accessed through std::atomic_load() and std::atomic_store()
+    std::shared_ptr<Presentation const> presentation_;
 };
 
 }
@@ -21,9 +21,19 @@
 #include "mir/scene/legacy_scene_change_notification.h"
 #include "mir/scene/surface.h"
 
+#include "mir/scene/null_surface_observer.h"
+#include "mir/geometry/rectangles.h"
+#include "mir/graphics/renderable.h"
+
 #include <boost/throw_exception.hpp>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <experimental/optional>
+#include <limits>
 
 namespace ms = mir::scene;
+namespace geom = mir::geometry;
 
 ms::LegacySceneChangeNotification::LegacySceneChangeNotification(
     std::function<void()> const& scene_notify_change,
@@ -49,56 +59,212 @@ ms::LegacySceneChangeNotification::~LegacySceneChangeNotification()
 
 namespace
 {
-class NonLegacySurfaceChangeNotification : public ms::LegacySurfaceChangeNotification
+/// The bounds of \a rect once \a transform is applied about its centre, as the renderer does
+std::experimental::optional<geom::Rectangle> transformed_bounds(
+    geom::Rectangle const& rect,
+    glm::mat4 const& transform)
+{
+    static glm::mat4 const identity(1);
+    if (transform == identity)
+        return rect;
+
+    // A projective transformation could put the surface just about anywhere
+    if (transform[0][3] != 0.0f || transform[1][3] != 0.0f ||
+        transform[2][3] != 0.0f || transform[3][3] != 1.0f)
+    {
+        return std::experimental::nullopt;
+    }
+
+    glm::vec2 const centre{
+        rect.top_left.x.as_int() + rect.size.width.as_int() / 2.0f,
+        rect.top_left.y.as_int() + rect.size.height.as_int() / 2.0f};
+
+    glm::vec2 const corners[] = {
+        {rect.left().as_int(), rect.top().as_int()},
+        {rect.right().as_int(), rect.top().as_int()},
+        {rect.left().as_int(), rect.bottom().as_int()},
+        {rect.right().as_int(), rect.bottom().as_int()}};
+
+    glm::vec2 min{std::numeric_limits<float>::max()};
+    glm::vec2 max{std::numeric_limits<float>::lowest()};
+    for (auto const& corner : corners)
+    {
+        auto const transformed = glm::vec2{transform * glm::vec4{corner - centre, 0.0f, 1.0f}} + centre;
+        min = glm::min(min, transformed);
+        max = glm::max(max, transformed);
+    }
+
+    auto const left = int(std::floor(min.x));
+    auto const top = int(std::floor(min.y));
+    return geom::Rectangle{{left, top}, {int(std::ceil(max.x)) - left, int(std::ceil(max.y)) - top}};
+}
+
+/// The area of the screen \a surface could be drawn on, if it is known
+std::experimental::optional<geom::Rectangle> area_of(ms::Surface const& surface)
+{
+    geom::Rectangles area;
+    area.add({surface.top_left(), surface.window_size()});
+
+    // Buffers aren't acquired until asked for, so this doesn't disturb any compositor
+    for (auto const& renderable : surface.generate_renderables(nullptr))
+    {
+        auto const bounds = transformed_bounds(renderable->screen_position(), renderable->transformation());
+        if (!bounds)
+            return std::experimental::nullopt;
+        area.add(bounds.value());
+    }
+
+    return area.bounding_rectangle();
+}
+
+/*
+ * Reports each change to a surface as damage to the area it covered before
+ * and after the change, so that only the outputs it's on need to redraw.
+ */
+class NonLegacySurfaceChangeNotification : public ms::NullSurfaceObserver
 {
 public:
     NonLegacySurfaceChangeNotification(
         std::function<void()> const& notify_scene_change,
-        std::function<void(int frames, mir::geometry::Rectangle const& damage)> const& damage_notify_change,
+        std::function<void(int frames, geom::Rectangle const& damage)> const& damage_notify_change,
         ms::Surface* surface);
 
-    void moved_to(ms::Surface const* surf, const mir::geometry::Point&) override;
-    void frame_posted(ms::Surface const* surf, int frames_available, const mir::geometry::Size& size) override;
+    void content_resized_to(ms::Surface const* surf, geom::Size const&) override;
+    void moved_to(ms::Surface const* surf, geom::Point const& top_left) override;
+    void hidden_set_to(ms::Surface const* surf, bool) override;
+    void frame_posted(ms::Surface const* surf, int frames_available, geom::Size const& size) override;
+    void alpha_set_to(ms::Surface const* surf, float) override;
+    void transformation_set_to(ms::Surface const* surf, glm::mat4 const&) override;
+    void reception_mode_set_to(ms::Surface const* surf, mir::input::InputReceptionMode) override;
+    void renamed(ms::Surface const* surf, char const*) override;
 
 private:
-    mir::geometry::Point top_left;
-    std::function<void(int frames, mir::geometry::Rectangle const& damage)> const damage_notify_change;
+    void surface_changed(ms::Surface const* surf);
+
+    std::function<void()> const notify_scene_change;
+    std::function<void(int frames, geom::Rectangle const& damage)> const damage_notify_change;
+
+    std::mutex mutex;
+    geom::Point top_left;
+    std::experimental::optional<geom::Rectangle> area;
+    /// The size of the buffer last posted, which the area depends on
+    std::experimental::optional<geom::Size> posted_size;
+    bool was_visible;
 };
 
 NonLegacySurfaceChangeNotification::NonLegacySurfaceChangeNotification(
     std::function<void()> const& notify_scene_change,
-    std::function<void(int frames, mir::geometry::Rectangle const& damage)> const& damage_notify_change,
+    std::function<void(int frames, geom::Rectangle const& damage)> const& damage_notify_change,
     ms::Surface* surface) :
-    ms::LegacySurfaceChangeNotification(notify_scene_change, {}),
-    damage_notify_change(damage_notify_change)
+    notify_scene_change(notify_scene_change),
+    damage_notify_change(damage_notify_change),
+    top_left{surface->top_left()},
+    area{area_of(*surface)},
+    was_visible{false}
+{
+}
+
+void NonLegacySurfaceChangeNotification::content_resized_to(ms::Surface const* surf, geom::Size const&)
 {
-    top_left = surface->top_left();
+    surface_changed(surf);
+}
+
+void NonLegacySurfaceChangeNotification::moved_to(ms::Surface const* surf, geom::Point const& top_left)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        this->top_left = top_left;
+    }
+    surface_changed(surf);
 }
 
-void NonLegacySurfaceChangeNotification::moved_to(ms::Surface const* surf, const mir::geometry::Point& top_left)
+void NonLegacySurfaceChangeNotification::hidden_set_to(ms::Surface const* surf, bool)
 {
-    this->top_left = top_left;
-    ms::LegacySurfaceChangeNotification::moved_to(surf, top_left);
+    surface_changed(surf);
 }
 
-void NonLegacySurfaceChangeNotification::frame_posted(ms::Surface const*, int frames_available, const mir::geometry::Size& size)
+void NonLegacySurfaceChangeNotification::frame_posted(ms::Surface const* surf, int frames_available, geom::Size const& size)
 {
-    mir::geometry::Rectangle const update_region{top_left, size};
+    geom::Rectangle update_region;
+    bool resized;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        update_region = {top_left, size};
+        resized = !posted_size || posted_size.value() != size;
+        posted_size = size;
+    }
+
+    if (resized)
+    {
+        // The area the surface covers has changed with its buffer, so find it again
+        surface_changed(surf);
+    }
+
     damage_notify_change(frames_available, update_region);
 }
+
+void NonLegacySurfaceChangeNotification::alpha_set_to(ms::Surface const* surf, float)
+{
+    surface_changed(surf);
 }
 
-void ms::LegacySceneChangeNotification::add_surface_observer(ms::Surface* surface)
+void NonLegacySurfaceChangeNotification::transformation_set_to(ms::Surface const* surf, glm::mat4 const&)
 {
-    auto notifier = [surface, this, was_visible = false] () mutable
-        {
-            if (surface->visible() || was_visible)
-                scene_notify_change();
-            was_visible = surface->visible();
-        };
+    surface_changed(surf);
+}
 
+void NonLegacySurfaceChangeNotification::reception_mode_set_to(
+    ms::Surface const* surf, mir::input::InputReceptionMode)
+{
+    surface_changed(surf);
+}
+
+void NonLegacySurfaceChangeNotification::renamed(ms::Surface const* surf, char const*)
+{
+    surface_changed(surf);
+}
+
+void NonLegacySurfaceChangeNotification::surface_changed(ms::Surface const* surf)
+{
+    auto const visible = surf->visible();
+    auto const new_area = area_of(*surf);
+
+    std::experimental::optional<geom::Rectangle> old_area;
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        notify = visible || was_visible;
+        old_area = area;
+        area = new_area;
+        was_visible = visible;
+    }
+
+    if (!notify)
+        return;
+
+    if (old_area && new_area)
+    {
+        damage_notify_change(1, old_area.value());
+        damage_notify_change(1, new_area.value());
+    }
+    else
+    {
+        notify_scene_change();
+    }
+}
+}
+
+void ms::LegacySceneChangeNotification::add_surface_observer(ms::Surface* surface)
+{
     if (buffer_notify_change)
     {
+        auto notifier = [surface, this, was_visible = false] () mutable
+            {
+                if (surface->visible() || was_visible)
+                    scene_notify_change();
+                was_visible = surface->visible();
+            };
+
         auto observer = std::make_shared<LegacySurfaceChangeNotification>(notifier, buffer_notify_change);
         surface->add_observer(observer);
 
@@ -107,7 +273,8 @@ void ms::LegacySceneChangeNotification::add_surface_observer(ms::Surface* surfac
     }
     else
     {
-        auto observer = std::make_shared<NonLegacySurfaceChangeNotification>(notifier, damage_notify_change, surface);
+        auto observer = std::make_shared<NonLegacySurfaceChangeNotification>(
+            scene_notify_change, damage_notify_change, surface);
         surface->add_observer(observer);
 
         std::unique_lock<decltype(surface_observers_guard)> lg(surface_observers_guard);
@@ -121,7 +288,7 @@ void ms::LegacySceneChangeNotification::surface_added(std::shared_ptr<ms::Surfac
 
     // If the surface already has content we need to (re)composite
     if (!buffer_notify_change && surface->visible())
-        scene_notify_change();
+        notify_change_to(*surface);
 }
 
 void ms::LegacySceneChangeNotification::surface_exists(std::shared_ptr<ms::Surface> const& surface)
@@ -142,12 +309,25 @@ void ms::LegacySceneChangeNotification::surface_removed(std::shared_ptr<ms::Surf
     }
 
     if (surface->visible())
-        scene_notify_change();
+        notify_change_to(*surface);
 }
 
-void ms::LegacySceneChangeNotification::surfaces_reordered(SurfaceSet const&)
+void ms::LegacySceneChangeNotification::surfaces_reordered(SurfaceSet const& affected_surfaces)
 {
-    scene_notify_change();
+    if (buffer_notify_change || affected_surfaces.empty())
+    {
+        scene_notify_change();
+        return;
+    }
+
+    for (auto const& weak_surface : affected_surfaces)
+    {
+        if (auto const surface = weak_surface.lock())
+        {
+            if (surface->visible())
+                notify_change_to(*surface);
+        }
+    }
 }
 
 void ms::LegacySceneChangeNotification::scene_changed()
@@ -155,6 +335,20 @@ void ms::LegacySceneChangeNotification::scene_changed()
     scene_notify_change();
 }
 
+void ms::LegacySceneChangeNotification::notify_change_to(Surface const& surface)
+{
+    if (buffer_notify_change)
+    {
+        scene_notify_change();
+        return;
+    }
+
+    if (auto const area = area_of(surface))
+        damage_notify_change(1, area.value());
+    else
+        scene_notify_change();
+}
+
 void ms::LegacySceneChangeNotification::end_observation()
 {
     std::unique_lock<decltype(surface_observers_guard)> lg(surface_observers_guard);
@@ -24,6 +24,7 @@
 #include "mir/scene/null_surface_observer.h"
 #include "mir/scene/scene_report.h"
 #include "mir/compositor/scene_element.h"
+#include "mir/compositor/frame_pool.h"
 #include "mir/graphics/renderable.h"
 #include "mir/depth_layer.h"
 
@@ -48,14 +49,12 @@ class SurfaceSceneElement : public mc::SceneElement
 {
 public:
     SurfaceSceneElement(
-        std::string name,
-        std::shared_ptr<mg::Renderable> const& renderable,
+        std::shared_ptr<mg::Renderable> renderable,
         std::shared_ptr<ms::RenderingTracker> const& tracker,
         mc::CompositorID id)
-        : renderable_{renderable},
+        : renderable_{std::move(renderable)},
           tracker{tracker},
-          cid{id},
-          surface_name(name)
+          cid{id}
     {
     }
 
@@ -78,7 +77,6 @@ private:
     std::shared_ptr<mg::Renderable> const renderable_;
     std::shared_ptr<ms::RenderingTracker> const tracker;
     mc::CompositorID cid;
-    std::string const surface_name;
 };
 
 //note: something different than a 2D/HWC overlay
@@ -87,7 +85,7 @@ class OverlaySceneElement : public mc::SceneElement
 public:
     OverlaySceneElement(
         std::shared_ptr<mg::Renderable> renderable)
-        : renderable_{renderable}
+        : renderable_{std::move(renderable)}
     {
     }
 
@@ -136,6 +134,7 @@ ms::SurfaceStack::SurfaceStack(
     scene_changed{false},
     surface_observer{std::make_shared<SurfaceDepthLayerObserver>(this)}
 {
+    publish_snapshot();
 }
 
 ms::SurfaceStack::~SurfaceStack() noexcept(true)
@@ -152,57 +151,45 @@ ms::SurfaceStack::~SurfaceStack() noexcept(true)
 
 mc::SceneElementSequence ms::SurfaceStack::scene_elements_for(mc::CompositorID id)
 {
-    RecursiveReadLock lg(guard);
-
     scene_changed = false;
-    mc::SceneElementSequence elements;
-    for (auto const& layer : surface_layers)
+    auto const scene = snapshot();
+
+    auto elements = mc::recycled_vector<mc::SceneElementSequence>();
+    for (auto const& entry : scene->surfaces)
     {
-        for (auto const& surface : layer)
+        if (entry.surface->visible())
         {
-            if (surface->visible())
+            auto renderables = entry.surface->generate_renderables(id);
+            for (auto& renderable : renderables)
             {
-                for (auto& renderable : surface->generate_renderables(id))
-                {
-                    elements.emplace_back(
-                        std::make_shared<SurfaceSceneElement>(
-                            surface->name(),
-                            renderable,
-                            rendering_trackers[surface.get()],
-                            id));
-                }
+                elements.emplace_back(
+                    mc::make_frame_shared<SurfaceSceneElement>(std::move(renderable), entry.tracker, id));
             }
+            mc::recycle(renderables);
         }
     }
-    for (auto const& renderable : overlays)
+    for (auto const& renderable : scene->overlays)
     {
-        elements.emplace_back(std::make_shared<OverlaySceneElement>(renderable));
+        elements.emplace_back(mc::make_frame_shared<OverlaySceneElement>(renderable));
     }
     return elements;
 }
 
 int ms::SurfaceStack::frames_pending(mc::CompositorID id) const
 {
-    RecursiveReadLock lg(guard);
-
     int result = scene_changed ? 1 : 0;
-    for (auto const& layer : surface_layers)
+    auto const scene = snapshot();
+
+    for (auto const& entry : scene->surfaces)
     {
-        for (auto const& surface : layer)
+        if (entry.surface->visible() && entry.tracker->is_exposed_in(id))
         {
-            if (surface->visible())
-            {
-                auto const tracker = rendering_trackers.find(surface.get());
-                if (tracker != rendering_trackers.end() && tracker->second->is_exposed_in(id))
-                {
-                    // Note that we ask the surface and not a Renderable.
-                    // This is because we don't want to waste time and resources
-                    // on a snapshot till we're sure we need it...
-                    int ready = surface->buffers_ready_for_compositor(id);
-                    if (ready > result)
-                        result = ready;
-                }
-            }
+            // Note that we ask the surface and not a Renderable.
+            // This is because we don't want to waste time and resources
+            // on a snapshot till we're sure we need it...
+            int ready = entry.surface->buffers_ready_for_compositor(id);
+            if (ready > result)
+                result = ready;
         }
     }
     return result;
@@ -232,6 +219,7 @@ void ms::SurfaceStack::add_input_visualization(
     {
         RecursiveWriteLock lg(guard);
         overlays.push_back(overlay);
+        publish_snapshot();
     }
     emit_scene_changed();
 }
@@ -248,6 +236,7 @@ void ms::SurfaceStack::remove_input_visualization(
             BOOST_THROW_EXCEPTION(std::runtime_error("Attempt to remove an overlay which was never added or which has been previously removed"));
         }
         overlays.erase(p);
+        publish_snapshot();
     }
     
     emit_scene_changed();
@@ -271,6 +260,7 @@ void ms::SurfaceStack::add_surface(
         insert_surface_at_top_of_depth_layer(surface);
         create_rendering_tracker_for(surface);
         surface->add_observer(surface_observer);
+        publish_snapshot();
     }
     surface->set_reception_mode(input_mode);
     observers.surface_added(surface);
@@ -296,6 +286,7 @@ void ms::SurfaceStack::remove_surface(std::weak_ptr<Surface> const& surface)
                 rendering_trackers.erase(keep_alive.get());
                 keep_alive->remove_observer(surface_observer);
                 found_surface = true;
+                publish_snapshot();
                 break;
             }
         }
@@ -325,18 +316,15 @@ InReverse<Container> in_reverse(Container& container) { return InReverse<Contain
 auto ms::SurfaceStack::surface_at(geometry::Point cursor) const
 -> std::shared_ptr<Surface>
 {
-    RecursiveReadLock lg(guard);
-    for (auto const& layer : in_reverse(surface_layers))
+    auto const scene = snapshot();
+    for (auto const& entry : in_reverse(scene->surfaces))
     {
-        for (auto const& surface : in_reverse(layer))
-        {
-            // TODO There's a lack of clarity about how the input area will
-            // TODO be maintained and whether this test will detect clicks on
-            // TODO decorations (it should) as these may be outside the area
-            // TODO known to the client.  But it works for now.
-            if (surface->input_area_contains(cursor))
-                    return surface;
-        }
+        // TODO There's a lack of clarity about how the input area will
+        // TODO be maintained and whether this test will detect clicks on
+        // TODO decorations (it should) as these may be outside the area
+        // TODO known to the client.  But it works for now.
+        if (entry.surface->input_area_contains(cursor))
+            return entry.surface;
     }
 
     return {};
@@ -344,13 +332,10 @@ auto ms::SurfaceStack::surface_at(geometry::Point cursor) const
 
 void ms::SurfaceStack::for_each(std::function<void(std::shared_ptr<mi::Surface> const&)> const& callback)
 {
-    RecursiveReadLock lg(guard);
-    for (auto const& layer : surface_layers)
+    auto const scene = snapshot();
+    for (auto const& entry : scene->surfaces)
     {
-        for (auto const& surface : layer)
-        {
-            callback(surface);
-        }
+        callback(entry.surface);
     }
 }
 
@@ -376,6 +361,7 @@ void ms::SurfaceStack::raise(Surface const* surface)
                 layer.erase(p);
                 insert_surface_at_top_of_depth_layer(surface_shared);
                 affected_surfaces.insert(surface_shared);
+                publish_snapshot();
                 break;
             }
         }
@@ -426,6 +412,9 @@ void ms::SurfaceStack::raise(SurfaceSet const& ss)
             if (old_layer != layer)
                 surfaces_reordered = true;
         }
+
+        if (surfaces_reordered)
+            publish_snapshot();
     }
 
     if (surfaces_reordered)
@@ -459,6 +448,27 @@ void ms::SurfaceStack::insert_surface_at_top_of_depth_layer(std::shared_ptr<Surf
     surface_layers[depth_index].push_back(surface);
 }
 
+void ms::SurfaceStack::publish_snapshot()
+{
+    RecursiveWriteLock lg(guard);
+
+    auto const scene = std::make_shared<Snapshot>();
+    scene->version = ++snapshot_version;
+    for (auto const& layer : surface_layers)
+    {
+        for (auto const& surface : layer)
+            scene->surfaces.push_back({surface, rendering_trackers[surface.get()]});
+    }
+    scene->overlays = overlays;
+
+    std::atomic_store(&snapshot_, std::shared_ptr<Snapshot const>{scene});
+}
+
+auto ms::SurfaceStack::snapshot() const -> std::shared_ptr<Snapshot const>
+{
+    return std::atomic_load(&snapshot_);
+}
+
 void ms::SurfaceStack::add_observer(std::shared_ptr<ms::Observer> const& observer)
 {
     observers.add(observer);
@@ -489,15 +499,12 @@ auto ms::SurfaceStack::stacking_order_of(SurfaceSet const& surfaces) const -> Su
 {
     SurfaceList result;
 
-    RecursiveReadLock lk(guard);
-    for (auto const& layer : surface_layers)
+    auto const scene = snapshot();
+    for (auto const& entry : scene->surfaces)
     {
-        for (auto const& surface : layer)
+        if (surfaces.find(entry.surface) != surfaces.end())
         {
-            if (surfaces.find(surface) != surfaces.end())
-            {
-                result.push_back(surface);
-            }
+            result.push_back(entry.surface);
         }
     }
     return result;
@@ -31,6 +31,7 @@
 #include "mir/scene/surface_observer.h"
 
 #include <atomic>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -109,12 +110,35 @@ public:
 
     void emit_scene_changed() override;
 
+    /**
+     * An immutable picture of the stack. A new one, with a higher version,
+     * is published whenever surfaces are added, removed or restacked or the
+     * overlays change. Compositors and input read the latest one without
+     * taking the stack's lock, and a snapshot stays valid for as long as it
+     * is held.
+     */
+    struct Snapshot
+    {
+        struct Entry
+        {
+            std::shared_ptr<Surface> surface;
+            std::shared_ptr<RenderingTracker> tracker;
+        };
+
+        std::uint64_t version;
+        std::vector<Entry> surfaces;    ///< Bottom to top, across all depth layers
+        std::vector<std::shared_ptr<graphics::Renderable>> overlays;
+    };
+
+    auto snapshot() const -> std::shared_ptr<Snapshot const>;
+
 private:
     SurfaceStack(const SurfaceStack&) = delete;
     SurfaceStack& operator=(const SurfaceStack&) = delete;
     void create_rendering_tracker_for(std::shared_ptr<Surface> const&);
     void update_rendering_tracker_compositors();
     void insert_surface_at_top_of_depth_layer(std::shared_ptr<Surface> const& surface);
+    void publish_snapshot();
 
     RecursiveReadWriteMutex mutable guard;
 
@@ -136,6 +160,10 @@ private:
     Observers observers;
     std::atomic<bool> scene_changed;
     std::shared_ptr<SurfaceObserver> surface_observer;
+
+    /// Written under guard, through std::atomic_store(); read with std::atomic_load()
+    std::shared_ptr<Snapshot const> snapshot_;
+    std::uint64_t snapshot_version{0};
 };
 
 }
@@ -22,6 +22,7 @@
 #include "input.h"
 
 #include "mir/graphics/graphic_buffer_allocator.h"
+#include "mir/graphics/pixel_ops.h"
 #include "mir/renderer/sw/pixel_source.h"
 #include "mir/geometry/displacement.h"
 #include "mir/log.h"
@@ -106,10 +107,10 @@ inline void render_row(
         return;
     geom::X const right = std::min(left.x + as_delta(length), as_x(buf_size.width));
     left.x = std::max(left.x, geom::X{});
+    if (right <= left.x)
+        return;
     uint32_t* const start = data + (left.y.as_int() * buf_size.width.as_int()) + left.x.as_int();
-    uint32_t* const end = start + right.as_int() - left.x.as_int();
-    for (uint32_t* i = start; i < end; i++)
-        *i = color;
+    mg::pixel_ops().fill(start, color, right.as_int() - left.x.as_int());
 }
 
 inline void render_close_icon(
@@ -359,30 +360,28 @@ void msd::Renderer::Text::Impl::render_glyph(
     geom::Y const buffer_top = std::max(top_left.y, geom::Y{});
     geom::Y const buffer_bottom = std::min(top_left.y + geom::DeltaY{glyph->rows}, as_y(buf_size.height));
 
+    if (buffer_right <= buffer_left)
+        return;
+
     geom::Displacement const glyph_offset = as_displacement(top_left);
+    auto const& ops = mg::pixel_ops();
 
-    unsigned char* const color_pixels = (unsigned char *)&color;
-    unsigned char const color_alpha = color_pixels[3];
+    // The glyph's coverage is blended in as the alpha of the (premultiplied) color
+    Pixel premultiplied;
+    ops.premultiply(&premultiplied, &color, 1);
 
     for (geom::Y buffer_y = buffer_top; buffer_y < buffer_bottom; buffer_y += geom::DeltaY{1})
     {
         geom::Y const glyph_y = buffer_y - glyph_offset.dy;
         unsigned char* const glyph_row = glyph->buffer + glyph_y.as_int() * glyph->pitch;
         Pixel* const buffer_row = buf + buffer_y.as_int() * buf_size.width.as_int();
+        geom::X const glyph_left = buffer_left - glyph_offset.dx;
 
-        for (geom::X buffer_x = buffer_left; buffer_x < buffer_right; buffer_x += geom::DeltaX{1})
-        {
-            geom::X const glyph_x = buffer_x - glyph_offset.dx;
-            unsigned char const glyph_alpha = ((int)glyph_row[glyph_x.as_int()] * color_alpha) / 255;
-            unsigned char* const buffer_pixels = (unsigned char *)(buffer_row + buffer_x.as_int());
-            for (int i = 0; i < 3; i++)
-            {
-                // Blend color with the previous buffer color based on the glyph's alpha
-                buffer_pixels[i] =
-                    ((int)buffer_pixels[i] * (255 - glyph_alpha)) / 255 +
-                    ((int)color_pixels[i] * glyph_alpha) / 255;
-            }
-        }
+        ops.over_with_mask(
+            buffer_row + buffer_left.as_int(),
+            glyph_row + glyph_left.as_int(),
+            premultiplied,
+            buffer_right.as_int() - buffer_left.as_int());
     }
 }
 
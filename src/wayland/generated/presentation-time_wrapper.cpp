@@ -0,0 +1,283 @@
+/*
+ * AUTOGENERATED - DO NOT EDIT
+ *
+ * This file is generated from presentation-time.xml
+ * To regenerate, run the “refresh-wayland-wrapper” target.
+ */
+
+#include "presentation-time_wrapper.h"
+
+#include <boost/throw_exception.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+
+#include <wayland-server-core.h>
+
+#include "mir/log.h"
+
+namespace mir
+{
+namespace wayland
+{
+extern struct wl_interface const wl_output_interface_data;
+extern struct wl_interface const wl_surface_interface_data;
+extern struct wl_interface const wp_presentation_interface_data;
+extern struct wl_interface const wp_presentation_feedback_interface_data;
+}
+}
+
+namespace mw = mir::wayland;
+
+namespace
+{
+struct wl_interface const* all_null_types [] {
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr};
+}
+
+// Presentation
+
+struct mw::Presentation::Thunks
+{
+    static int const supported_version;
+
+    static void destroy_thunk(struct wl_client* client, struct wl_resource* resource)
+    {
+        auto me = static_cast<Presentation*>(wl_resource_get_user_data(resource));
+        try
+        {
+            me->destroy();
+        }
+        catch(ProtocolError const& err)
+        {
+            wl_resource_post_error(err.resource(), err.code(), "%s", err.message());
+        }
+        catch(...)
+        {
+            internal_error_processing_request(client, "Presentation::destroy()");
+        }
+    }
+
+    static void feedback_thunk(struct wl_client* client, struct wl_resource* resource, struct wl_resource* surface, uint32_t callback)
+    {
+        auto me = static_cast<Presentation*>(wl_resource_get_user_data(resource));
+        wl_resource* callback_resolved{
+            wl_resource_create(client, &wp_presentation_feedback_interface_data, wl_resource_get_version(resource), callback)};
+        if (callback_resolved == nullptr)
+        {
+            wl_client_post_no_memory(client);
+            BOOST_THROW_EXCEPTION((std::bad_alloc{}));
+        }
+        try
+        {
+            me->feedback(surface, callback_resolved);
+        }
+        catch(ProtocolError const& err)
+        {
+            wl_resource_post_error(err.resource(), err.code(), "%s", err.message());
+        }
+        catch(...)
+        {
+            internal_error_processing_request(client, "Presentation::feedback()");
+        }
+    }
+
+    static void resource_destroyed_thunk(wl_resource* resource)
+    {
+        delete static_cast<Presentation*>(wl_resource_get_user_data(resource));
+    }
+
+    static void bind_thunk(struct wl_client* client, void* data, uint32_t version, uint32_t id)
+    {
+        auto me = static_cast<Presentation::Global*>(data);
+        auto resource = wl_resource_create(
+            client,
+            &wp_presentation_interface_data,
+            std::min((int)version, Thunks::supported_version),
+            id);
+        if (resource == nullptr)
+        {
+            wl_client_post_no_memory(client);
+            BOOST_THROW_EXCEPTION((std::bad_alloc{}));
+        }
+        try
+        {
+            me->bind(resource);
+        }
+        catch(...)
+        {
+            internal_error_processing_request(client, "Presentation global bind");
+        }
+    }
+
+    static struct wl_interface const* feedback_types[];
+    static struct wl_message const request_messages[];
+    static struct wl_message const event_messages[];
+    static void const* request_vtable[];
+};
+
+int const mw::Presentation::Thunks::supported_version = 1;
+
+mw::Presentation::Presentation(struct wl_resource* resource, Version<1>)
+    : client{wl_resource_get_client(resource)},
+      resource{resource}
+{
+    if (resource == nullptr)
+    {
+        BOOST_THROW_EXCEPTION((std::bad_alloc{}));
+    }
+    wl_resource_set_implementation(resource, Thunks::request_vtable, this, &Thunks::resource_destroyed_thunk);
+}
+
+mw::Presentation::~Presentation()
+{
+    wl_resource_set_implementation(resource, nullptr, nullptr, nullptr);
+}
+
+void mw::Presentation::send_clock_id_event(uint32_t clk_id) const
+{
+    wl_resource_post_event(resource, Opcode::clock_id, clk_id);
+}
+
+bool mw::Presentation::is_instance(wl_resource* resource)
+{
+    return wl_resource_instance_of(resource, &wp_presentation_interface_data, Thunks::request_vtable);
+}
+
+void mw::Presentation::destroy_wayland_object() const
+{
+    wl_resource_destroy(resource);
+}
+
+mw::Presentation::Global::Global(wl_display* display, Version<1>)
+    : wayland::Global{
+          wl_global_create(
+              display,
+              &wp_presentation_interface_data,
+              Thunks::supported_version,
+              this,
+              &Thunks::bind_thunk)}
+{
+}
+
+auto mw::Presentation::Global::interface_name() const -> char const*
+{
+    return Presentation::interface_name;
+}
+
+struct wl_interface const* mw::Presentation::Thunks::feedback_types[] {
+    &wl_surface_interface_data,
+    &wp_presentation_feedback_interface_data};
+
+struct wl_message const mw::Presentation::Thunks::request_messages[] {
+    {"destroy", "", all_null_types},
+    {"feedback", "on", feedback_types}};
+
+struct wl_message const mw::Presentation::Thunks::event_messages[] {
+    {"clock_id", "u", all_null_types}};
+
+void const* mw::Presentation::Thunks::request_vtable[] {
+    (void*)Thunks::destroy_thunk,
+    (void*)Thunks::feedback_thunk};
+
+mw::Presentation* mw::Presentation::from(struct wl_resource* resource)
+{
+    if (wl_resource_instance_of(resource, &wp_presentation_interface_data, Presentation::Thunks::request_vtable))
+    {
+        return static_cast<Presentation*>(wl_resource_get_user_data(resource));
+    }
+    return nullptr;
+}
+
+// PresentationFeedback
+
+struct mw::PresentationFeedback::Thunks
+{
+    static int const supported_version;
+
+    static struct wl_interface const* sync_output_types[];
+    static struct wl_interface const* presented_types[];
+    static struct wl_message const event_messages[];
+};
+
+int const mw::PresentationFeedback::Thunks::supported_version = 1;
+
+mw::PresentationFeedback::PresentationFeedback(struct wl_resource* resource, Version<1>)
+    : client{wl_resource_get_client(resource)},
+      resource{resource}
+{
+    if (resource == nullptr)
+    {
+        BOOST_THROW_EXCEPTION((std::bad_alloc{}));
+    }
+}
+
+mw::PresentationFeedback::~PresentationFeedback()
+{
+}
+
+void mw::PresentationFeedback::send_sync_output_event(struct wl_resource* output) const
+{
+    wl_resource_post_event(resource, Opcode::sync_output, output);
+}
+
+void mw::PresentationFeedback::send_presented_event(uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) const
+{
+    wl_resource_post_event(resource, Opcode::presented, tv_sec_hi, tv_sec_lo, tv_nsec, refresh, seq_hi, seq_lo, flags);
+}
+
+void mw::PresentationFeedback::send_discarded_event() const
+{
+    wl_resource_post_event(resource, Opcode::discarded);
+}
+
+void mw::PresentationFeedback::destroy_wayland_object() const
+{
+    wl_resource_destroy(resource);
+}
+
+struct wl_interface const* mw::PresentationFeedback::Thunks::sync_output_types[] {
+    &wl_output_interface_data};
+
+struct wl_interface const* mw::PresentationFeedback::Thunks::presented_types[] {
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr};
+
+struct wl_message const mw::PresentationFeedback::Thunks::event_messages[] {
+    {"sync_output", "o", sync_output_types},
+    {"presented", "uuuuuuu", presented_types},
+    {"discarded", "", all_null_types}};
+
+mw::PresentationFeedback* mw::PresentationFeedback::from(struct wl_resource* resource)
+{
+    // WARNING: This is potentially unsafe; there is no guarantee that resource is a PresentationFeedback
+    return static_cast<PresentationFeedback*>(wl_resource_get_user_data(resource));
+}
+
+namespace mir
+{
+namespace wayland
+{
+
+struct wl_interface const wp_presentation_interface_data {
+    mw::Presentation::interface_name,
+    mw::Presentation::Thunks::supported_version,
+    2, mw::Presentation::Thunks::request_messages,
+    1, mw::Presentation::Thunks::event_messages};
+
+struct wl_interface const wp_presentation_feedback_interface_data {
+    mw::PresentationFeedback::interface_name,
+    mw::PresentationFeedback::Thunks::supported_version,
+    0, nullptr,
+    3, mw::PresentationFeedback::Thunks::event_messages};
+
+}
+}
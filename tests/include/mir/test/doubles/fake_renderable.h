@@ -80,11 +80,27 @@ public:
         return !rectangular;
     }
 
+    void set_opaque_region(geometry::Rectangles const& region)
+    {
+        opaque = region;
+    }
+
+    auto opaque_region() const -> geometry::Rectangles override
+    {
+        return opaque;
+    }
+
     void set_buffer(std::shared_ptr<graphics::Buffer> b)
     {
         buf = b;
     }
 
+    void set_buffer(std::shared_ptr<graphics::Buffer> b, geometry::Rectangles const& damage)
+    {
+        buf = b;
+        buffer_damage = damage;
+    }
+
     std::shared_ptr<graphics::Buffer> buffer() const override
     {
         return buf;
@@ -105,8 +121,16 @@ public:
         return 1u;
     }
 
+    auto buffer_damage_since(graphics::BufferID) const
+        -> std::experimental::optional<geometry::Rectangles> override
+    {
+        return buffer_damage;
+    }
+
 private:
     std::shared_ptr<graphics::Buffer> buf;
+    std::experimental::optional<geometry::Rectangles> buffer_damage;
+    geometry::Rectangles opaque;
     mir::geometry::Rectangle rect;
     float opacity;
     bool rectangular;
@@ -72,6 +72,11 @@ struct MockBufferStream : public compositor::BufferStream
     MOCK_METHOD0(drop_client_requests, void());
 
     MOCK_METHOD1(submit_buffer, void(std::shared_ptr<graphics::Buffer> const&));
+    MOCK_METHOD2(submit_buffer, void(std::shared_ptr<graphics::Buffer> const&, geometry::Rectangles const&));
+    MOCK_CONST_METHOD2(damage_between,
+                       std::experimental::optional<geometry::Rectangles>(graphics::BufferID, graphics::BufferID));
+    MOCK_METHOD1(set_opaque_region, void(geometry::Rectangles const&));
+    MOCK_CONST_METHOD0(opaque_region, geometry::Rectangles());
     MOCK_METHOD1(with_most_recent_buffer_do, void(std::function<void(graphics::Buffer&)> const&));
     MOCK_CONST_METHOD0(pixel_format, MirPixelFormat());
     MOCK_CONST_METHOD0(has_submitted_buffer, bool());
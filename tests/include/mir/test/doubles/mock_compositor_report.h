@@ -41,6 +41,16 @@ public:
                  void(compositor::CompositorReport::SubCompositorId, graphics::RenderableList const&));
     MOCK_METHOD1(rendered_frame,
                  void(compositor::CompositorReport::SubCompositorId));
+    MOCK_METHOD3(state_changes_in_frame,
+                 void(compositor::CompositorReport::SubCompositorId, unsigned int, unsigned int));
+    MOCK_METHOD4(texture_cache_in_frame,
+                 void(compositor::CompositorReport::SubCompositorId, unsigned int, unsigned int, std::size_t));
+    MOCK_METHOD2(gpu_rendered_frame,
+                 void(compositor::CompositorReport::SubCompositorId, std::chrono::nanoseconds));
+    MOCK_METHOD2(gpu_idle,
+                 void(compositor::CompositorReport::SubCompositorId, std::chrono::nanoseconds));
+    MOCK_METHOD3(gpu_rendered_renderable,
+                 void(compositor::CompositorReport::SubCompositorId, graphics::Renderable::ID, std::chrono::nanoseconds));
     MOCK_METHOD1(finished_frame,
                  void(compositor::CompositorReport::SubCompositorId));
     MOCK_METHOD0(started, void());
@@ -55,6 +55,7 @@ struct MockRenderable : public graphics::Renderable
     MOCK_CONST_METHOD0(transformation, glm::mat4());
     MOCK_CONST_METHOD0(visible, bool());
     MOCK_CONST_METHOD0(shaped, bool());
+    MOCK_CONST_METHOD0(opaque_region, geometry::Rectangles());
     MOCK_CONST_METHOD0(swap_interval, unsigned int());
 };
 }
@@ -33,8 +33,13 @@ struct MockRenderer : public renderer::Renderer
 {
     MOCK_METHOD1(set_viewport, void(geometry::Rectangle const&));
     MOCK_METHOD1(set_output_transform, void(glm::mat2 const&));
+    MOCK_METHOD1(set_damage, void(geometry::Rectangles const&));
+    MOCK_METHOD1(set_visible_regions, void(VisibleRegions const&));
     MOCK_CONST_METHOD1(render, void(graphics::RenderableList const&));
     MOCK_METHOD0(suspend, void());
+    MOCK_CONST_METHOD0(state_changes, StateChanges());
+    MOCK_CONST_METHOD0(texture_cache_use, TextureCacheUse());
+    MOCK_METHOD0(gpu_timings, std::vector<GPUFrameTiming>());
 
     ~MockRenderer() noexcept {}
 };
@@ -82,7 +82,9 @@ struct StubBufferAllocator : public graphics::GraphicBufferAllocator
     auto buffer_from_shm(
         wl_resource* resource,
         std::shared_ptr<mir::Executor> executor,
-        std::function<void()>&& on_consumed) -> std::shared_ptr<graphics::Buffer> override
+        std::function<void()>&& on_consumed,
+        std::shared_ptr<graphics::Buffer> const& previous,
+        std::experimental::optional<geometry::Rectangles> const& damage) -> std::shared_ptr<graphics::Buffer> override
     {
         // Temporary(?!) hack to actually use the buffer, for WLCS test
         // Transitioning the StubGraphicsPlatform to use the MESA surfaceless GL platform would
@@ -93,7 +95,9 @@ struct StubBufferAllocator : public graphics::GraphicBufferAllocator
             resource,
             std::move(executor),
             std::make_shared<graphics::common::EGLContextExecutor>(std::make_unique<test::doubles::NullGLContext>()),
-            std::move(on_consumed));
+            std::move(on_consumed),
+            previous,
+            damage);
     }
 };
 
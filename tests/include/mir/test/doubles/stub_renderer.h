@@ -35,7 +35,12 @@ class StubRenderer : public renderer::Renderer
 public:
     void set_viewport(geometry::Rectangle const&) override {}
     void set_output_transform(glm::mat2 const&) override {}
+    void set_damage(geometry::Rectangles const&) override {}
+    void set_visible_regions(VisibleRegions const&) override {}
     void suspend() override {}
+    StateChanges state_changes() const override { return {}; }
+    TextureCacheUse texture_cache_use() const override { return {}; }
+    std::vector<GPUFrameTiming> gpu_timings() override { return {}; }
 
     void render(graphics::RenderableList const& renderables) const override
     {
@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIR_TEST_DOUBLES_STUB_SOFTWARE_DISPLAY_BUFFER_H_
+#define MIR_TEST_DOUBLES_STUB_SOFTWARE_DISPLAY_BUFFER_H_
+
+#include "mir/test/doubles/stub_display_buffer.h"
+#include "mir/renderer/sw/render_target.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace mir
+{
+namespace test
+{
+namespace doubles
+{
+
+/// A display buffer the software renderer can draw in, held in memory
+class StubSoftwareDisplayBuffer : public StubDisplayBuffer,
+                                  public renderer::software::RenderTarget
+{
+public:
+    StubSoftwareDisplayBuffer(
+        geometry::Rectangle const& view_area,
+        MirPixelFormat format = mir_pixel_format_argb_8888)
+        : StubDisplayBuffer{view_area},
+          format{format},
+          size{view_area.size},
+          pixels(size.width.as_int() * size.height.as_int())
+    {
+    }
+
+    std::unique_ptr<renderer::software::Mapping<unsigned char>> map_back_buffer() override
+    {
+        return std::make_unique<PixelMapping>(*this);
+    }
+
+    void commit_back_buffer() override
+    {
+        ++swaps;
+    }
+
+    int back_buffer_age() const override
+    {
+        return age;
+    }
+
+    std::uint32_t pixel(int x, int y) const
+    {
+        return pixels[y * size.width.as_int() + x];
+    }
+
+    MirPixelFormat const format;
+    geometry::Size const size;
+    std::vector<std::uint32_t> pixels;
+    int age{0};
+    int swaps{0};
+
+private:
+    class PixelMapping : public renderer::software::Mapping<unsigned char>
+    {
+    public:
+        PixelMapping(StubSoftwareDisplayBuffer& buffer)
+            : buffer{buffer}
+        {
+        }
+
+        MirPixelFormat format() const override { return buffer.format; }
+        geometry::Stride stride() const override { return geometry::Stride{buffer.size.width.as_int() * 4}; }
+        geometry::Size size() const override { return buffer.size; }
+        unsigned char* data() override { return reinterpret_cast<unsigned char*>(buffer.pixels.data()); }
+        size_t len() const override { return buffer.pixels.size() * 4; }
+
+    private:
+        StubSoftwareDisplayBuffer& buffer;
+    };
+};
+
+}
+}
+}
+
+#endif /* MIR_TEST_DOUBLES_STUB_SOFTWARE_DISPLAY_BUFFER_H_ */
@@ -359,6 +359,12 @@ mtd::MockDRM::MockDRM()
         .WillByDefault(Return(0));
     ON_CALL(*this, drmCheckModesettingSupported(IsNull()))
         .WillByDefault(Return(-EINVAL));
+
+    // The fake DRM only implements the legacy modesetting API
+    ON_CALL(*this, drmSetClientCap(_, _, _))
+        .WillByDefault(Return(0));
+    ON_CALL(*this, drmSetClientCap(_, DRM_CLIENT_CAP_ATOMIC, _))
+        .WillByDefault(Return(-EINVAL));
 }
 
 mtd::MockDRM::~MockDRM() noexcept
@@ -114,6 +114,12 @@ void glClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
     global_mock_gl->glClearColor(red, green, blue, alpha);
 }
 
+void glClearStencil(GLint s)
+{
+    CHECK_GLOBAL_VOID_MOCK();
+    global_mock_gl->glClearStencil(s);
+}
+
 void glColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a)
 {
     CHECK_GLOBAL_VOID_MOCK();
@@ -361,6 +367,26 @@ void glTexImage2D(GLenum target, GLint level, GLint internalformat,
     global_mock_gl->glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
 }
 
+void glStencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+    CHECK_GLOBAL_VOID_MOCK();
+    global_mock_gl->glStencilFunc(func, ref, mask);
+}
+
+void glStencilOp(GLenum sfail, GLenum dpfail, GLenum dppass)
+{
+    CHECK_GLOBAL_VOID_MOCK();
+    global_mock_gl->glStencilOp(sfail, dpfail, dppass);
+}
+
+void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                     GLsizei width, GLsizei height,
+                     GLenum format, GLenum type, const GLvoid* pixels)
+{
+    CHECK_GLOBAL_VOID_MOCK();
+    global_mock_gl->glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
 void glGenFramebuffers(GLsizei n, GLuint *framebuffers)
 {
     CHECK_GLOBAL_VOID_MOCK();
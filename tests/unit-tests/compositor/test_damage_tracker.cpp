@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/server/compositor/damage_tracker.h"
+#include "mir/test/doubles/fake_renderable.h"
+#include "mir/test/doubles/stub_buffer.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace testing;
+using namespace mir::geometry;
+namespace mc = mir::compositor;
+namespace mg = mir::graphics;
+namespace mtd = mir::test::doubles;
+
+namespace
+{
+struct DamageTracker : Test
+{
+    Rectangle const view_area{{0, 0}, {1920, 1080}};
+
+    std::shared_ptr<mtd::FakeRenderable> const bottom{std::make_shared<mtd::FakeRenderable>(10, 10, 100, 100)};
+    std::shared_ptr<mtd::FakeRenderable> const top{std::make_shared<mtd::FakeRenderable>(50, 50, 100, 100)};
+
+    mc::DamageTracker tracker;
+};
+}
+
+TEST_F(DamageTracker, first_frame_is_fully_damaged)
+{
+    EXPECT_THAT(tracker.damage_for({bottom, top}, view_area), Eq(Rectangles{view_area}));
+}
+
+TEST_F(DamageTracker, unchanged_frame_has_no_damage)
+{
+    tracker.damage_for({bottom, top}, view_area);
+
+    EXPECT_THAT(tracker.damage_for({bottom, top}, view_area), Eq(Rectangles{}));
+}
+
+TEST_F(DamageTracker, new_buffer_damages_only_its_renderable)
+{
+    tracker.damage_for({bottom, top}, view_area);
+
+    top->set_buffer(std::make_shared<mtd::StubBuffer>());
+
+    EXPECT_THAT(tracker.damage_for({bottom, top}, view_area), Eq(Rectangles{top->screen_position()}));
+}
+
+TEST_F(DamageTracker, buffer_damage_is_mapped_to_the_screen)
+{
+    auto const scaled = std::make_shared<mtd::FakeRenderable>(200, 100, 100, 100);
+    tracker.damage_for({scaled}, view_area);
+
+    // A 200x200 buffer shown at half size...
+    scaled->set_buffer(
+        std::make_shared<mtd::StubBuffer>(Size{200, 200}),
+        Rectangles{{{10, 20}, {30, 41}}});
+
+    // ...has its damage halved (rounding outwards)
+    EXPECT_THAT(tracker.damage_for({scaled}, view_area), Eq(Rectangles{{{205, 110}, {15, 21}}}));
+}
+
+TEST_F(DamageTracker, added_and_removed_renderables_are_damaged)
+{
+    tracker.damage_for({bottom}, view_area);
+
+    EXPECT_THAT(tracker.damage_for({bottom, top}, view_area), Eq(Rectangles{top->screen_position()}));
+    EXPECT_THAT(tracker.damage_for({top}, view_area), Eq(Rectangles{bottom->screen_position()}));
+}
+
+TEST_F(DamageTracker, restacking_damages_the_restacked_renderable)
+{
+    tracker.damage_for({bottom, top}, view_area);
+
+    EXPECT_THAT(tracker.damage_for({top, bottom}, view_area),
+        Eq(Rectangles{bottom->screen_position(), bottom->screen_position()}));
+}
+
+TEST_F(DamageTracker, damage_is_clipped_to_view_area)
+{
+    auto const straddling = std::make_shared<mtd::FakeRenderable>(1900, 1000, 100, 100);
+    tracker.damage_for({}, view_area);
+
+    EXPECT_THAT(tracker.damage_for({straddling}, view_area),
+        Eq(Rectangles{{{1900, 1000}, {20, 80}}}));
+}
+
+TEST_F(DamageTracker, changing_view_area_or_resetting_damages_everything)
+{
+    Rectangle const moved_view_area{{1920, 0}, {1920, 1080}};
+    tracker.damage_for({bottom, top}, view_area);
+
+    EXPECT_THAT(tracker.damage_for({bottom, top}, moved_view_area), Eq(Rectangles{moved_view_area}));
+
+    tracker.reset();
+
+    EXPECT_THAT(tracker.damage_for({bottom, top}, moved_view_area), Eq(Rectangles{moved_view_area}));
+}
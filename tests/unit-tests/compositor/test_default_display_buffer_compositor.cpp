@@ -169,6 +169,10 @@ TEST_F(DefaultDisplayBufferCompositor, rendering_reports_everything)
         .WillOnce(Return(false));
     EXPECT_CALL(*report, renderables_in_frame(_,_))
         .InSequence(seq);
+    EXPECT_CALL(*report, state_changes_in_frame(_,_,_))
+        .InSequence(seq);
+    EXPECT_CALL(*report, texture_cache_in_frame(_,_,_,_))
+        .InSequence(seq);
     EXPECT_CALL(*report, rendered_frame(_))
         .InSequence(seq);
     EXPECT_CALL(*report, finished_frame(_))
@@ -184,6 +188,69 @@ TEST_F(DefaultDisplayBufferCompositor, rendering_reports_everything)
     compositor.composite(make_scene_elements({}));
 }
 
+TEST_F(DefaultDisplayBufferCompositor, reports_renderer_state_changes)
+{
+    using namespace testing;
+    auto report = std::make_shared<NiceMock<mtd::MockCompositorReport>>();
+
+    EXPECT_CALL(display_buffer, overlay(_))
+        .WillOnce(Return(false));
+    EXPECT_CALL(mock_renderer, state_changes())
+        .WillOnce(Return(mir::renderer::Renderer::StateChanges{12, 34}));
+    EXPECT_CALL(*report, state_changes_in_frame(_, 12u, 34u));
+
+    mc::DefaultDisplayBufferCompositor compositor(
+        display_buffer,
+        mt::fake_shared(mock_renderer),
+        report);
+    compositor.composite(make_scene_elements({}));
+}
+
+TEST_F(DefaultDisplayBufferCompositor, reports_renderer_texture_cache_use)
+{
+    using namespace testing;
+    auto report = std::make_shared<NiceMock<mtd::MockCompositorReport>>();
+
+    EXPECT_CALL(display_buffer, overlay(_))
+        .WillOnce(Return(false));
+    EXPECT_CALL(mock_renderer, texture_cache_use())
+        .WillOnce(Return(mir::renderer::Renderer::TextureCacheUse{5, 2, 4096}));
+    EXPECT_CALL(*report, texture_cache_in_frame(_, 5u, 2u, 4096u));
+
+    mc::DefaultDisplayBufferCompositor compositor(
+        display_buffer,
+        mt::fake_shared(mock_renderer),
+        report);
+    compositor.composite(make_scene_elements({}));
+}
+
+TEST_F(DefaultDisplayBufferCompositor, reports_renderer_gpu_timings)
+{
+    using namespace testing;
+    using namespace std::chrono_literals;
+    auto report = std::make_shared<NiceMock<mtd::MockCompositorReport>>();
+    int const renderable{0};
+
+    std::vector<mir::renderer::Renderer::GPUFrameTiming> timings{
+        {3ms, std::nullopt, {}},
+        {2ms, 1ms, {{&renderable, 500us}}}};
+
+    EXPECT_CALL(display_buffer, overlay(_))
+        .WillOnce(Return(false));
+    EXPECT_CALL(mock_renderer, gpu_timings())
+        .WillOnce(Return(timings));
+    EXPECT_CALL(*report, gpu_rendered_frame(_, std::chrono::nanoseconds{3ms}));
+    EXPECT_CALL(*report, gpu_rendered_frame(_, std::chrono::nanoseconds{2ms}));
+    EXPECT_CALL(*report, gpu_idle(_, std::chrono::nanoseconds{1ms}));
+    EXPECT_CALL(*report, gpu_rendered_renderable(_, &renderable, std::chrono::nanoseconds{500us}));
+
+    mc::DefaultDisplayBufferCompositor compositor(
+        display_buffer,
+        mt::fake_shared(mock_renderer),
+        report);
+    compositor.composite(make_scene_elements({}));
+}
+
 TEST_F(DefaultDisplayBufferCompositor, calls_renderer_in_sequence)
 {
     using namespace testing;
@@ -210,6 +277,43 @@ TEST_F(DefaultDisplayBufferCompositor, calls_renderer_in_sequence)
     }));
 }
 
+TEST_F(DefaultDisplayBufferCompositor, renders_only_what_is_not_assigned_to_planes)
+{
+    using namespace testing;
+
+    EXPECT_CALL(display_buffer, assign_planes(ContainerEq(mg::RenderableList{big, small})))
+        .WillOnce(SetArgReferee<0>(mg::RenderableList{big}));
+    EXPECT_CALL(mock_renderer, render(ContainerEq(mg::RenderableList{big})))
+        .Times(1);
+
+    mc::DefaultDisplayBufferCompositor compositor(
+        display_buffer,
+        mt::fake_shared(mock_renderer),
+        mr::null_compositor_report());
+
+    compositor.composite(make_scene_elements({
+        big,
+        small
+    }));
+}
+
+TEST_F(DefaultDisplayBufferCompositor, does_not_assign_planes_when_overlaying_everything)
+{
+    using namespace testing;
+
+    EXPECT_CALL(display_buffer, overlay(_))
+        .WillOnce(Return(true));
+    EXPECT_CALL(display_buffer, assign_planes(_))
+        .Times(0);
+
+    mc::DefaultDisplayBufferCompositor compositor(
+        display_buffer,
+        mt::fake_shared(mock_renderer),
+        mr::null_compositor_report());
+
+    compositor.composite(make_scene_elements({fullscreen}));
+}
+
 TEST_F(DefaultDisplayBufferCompositor, rotates_viewport)
 {   // Regression test for LP: #1643488
     using namespace testing;
@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/server/compositor/default_display_buffer_compositor.h"
+#include "src/server/scene/surface_stack.h"
+#include "src/server/scene/basic_surface.h"
+#include "src/server/report/null_report_factory.h"
+#include "mir/compositor/scene_element.h"
+#include "mir/input/input_reception_mode.h"
+#include "mir/test/fake_shared.h"
+#include "mir/test/doubles/stub_buffer_stream.h"
+#include "mir/test/doubles/stub_display_buffer.h"
+#include "mir/test/doubles/stub_renderer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace mc = mir::compositor;
+namespace ms = mir::scene;
+namespace mi = mir::input;
+namespace mr = mir::report;
+namespace geom = mir::geometry;
+namespace mt = mir::test;
+namespace mtd = mir::test::doubles;
+
+/*
+ * These tests count the allocations of DefaultDisplayBufferCompositor and the
+ * scene it draws, with StubRenderer and StubDisplayBuffer standing in for a
+ * real renderer and output. They say nothing about the allocations of the GL
+ * or software renderers, or of the platforms' display buffers.
+ *
+ * Replacing operator new affects the whole binary, so they are built into
+ * mir_allocation_unit_tests rather than mir_unit_tests.
+ */
+
+namespace
+{
+// Only the test's own thread is counted, and only while it asks to be
+thread_local bool counting{false};
+thread_local unsigned allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    if (counting)
+        ++allocations;
+
+    if (auto const block = std::malloc(size ? size : 1))
+        return block;
+
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+namespace
+{
+struct FrameAllocations : testing::Test
+{
+    FrameAllocations()
+    {
+        // Overlapping surfaces, with one wholly off screen to be occluded
+        for (auto const& position : {
+            geom::Rectangle{{0, 0}, {800, 600}},
+            geom::Rectangle{{100, 100}, {400, 300}},
+            geom::Rectangle{{300, 200}, {400, 300}},
+            geom::Rectangle{{2000, 2000}, {100, 100}}})
+        {
+            auto const surface = std::make_shared<ms::BasicSurface>(
+                nullptr /* session */,
+                std::string("surface"),
+                position,
+                mir_pointer_unconfined,
+                std::list<ms::StreamInfo>{{std::make_shared<mtd::StubBufferStream>(), {}, position.size}},
+                nullptr /* cursor */,
+                mr::null_scene_report());
+
+            stack.add_surface(surface, mi::InputReceptionMode::normal);
+        }
+
+        stack.register_compositor(this);
+    }
+
+    /// The number of heap allocations made by compositing a frame
+    unsigned allocations_in_frame()
+    {
+        allocations = 0;
+        counting = true;
+        compositor.composite(stack.scene_elements_for(this));
+        counting = false;
+        return allocations;
+    }
+
+    ms::SurfaceStack stack{mr::null_scene_report()};
+    mtd::StubDisplayBuffer display_buffer{{{0, 0}, {1024, 768}}};
+    mtd::StubRenderer renderer;
+    mc::DefaultDisplayBufferCompositor compositor{
+        display_buffer,
+        mt::fake_shared(renderer),
+        mr::null_compositor_report()};
+};
+}
+
+TEST_F(FrameAllocations, are_counted)
+{
+    allocations = 0;
+    counting = true;
+    auto const block = std::make_unique<int>(0);
+    counting = false;
+
+    EXPECT_THAT(allocations, testing::Gt(0u));
+}
+
+TEST_F(FrameAllocations, stop_once_the_scene_is_steady)
+{
+    // The first frames set up what's reused (and the surfaces' visibility)
+    for (auto i = 0; i != 3; ++i)
+        allocations_in_frame();
+
+    for (auto i = 0; i != 10; ++i)
+        EXPECT_THAT(allocations_in_frame(), testing::Eq(0u)) << "frame " << i;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/server/compositor/frame_scheduler.h"
+
+#include <gtest/gtest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+namespace mc = mir::compositor;
+namespace mg = mir::graphics;
+namespace mt = mir::time;
+
+namespace
+{
+struct FrameScheduler : Test
+{
+    std::chrono::nanoseconds const interval{16ms};
+    mt::PosixTimestamp const vblank{CLOCK_MONOTONIC, 1000ms};
+
+    mg::Frame frame_at(mt::PosixTimestamp const& ust, int64_t msc = 1)
+    {
+        mg::Frame frame;
+        frame.msc = msc;
+        frame.ust = ust;
+        return frame;
+    }
+
+    mc::FrameScheduler scheduler;
+};
+}
+
+TEST_F(FrameScheduler, composites_immediately_without_timing)
+{
+    EXPECT_FALSE(scheduler.has_timing());
+    EXPECT_EQ(0ns, scheduler.delay_before_compositing(vblank, 5ms));
+}
+
+TEST_F(FrameScheduler, ignores_frames_the_platform_knows_nothing_about)
+{
+    scheduler.presented(mg::Frame{}, interval);
+    EXPECT_FALSE(scheduler.has_timing());
+
+    scheduler.presented(frame_at(vblank), 0ns);
+    EXPECT_FALSE(scheduler.has_timing());
+}
+
+TEST_F(FrameScheduler, starts_compositing_render_time_before_next_vblank)
+{
+    scheduler.presented(frame_at(vblank), interval);
+
+    EXPECT_TRUE(scheduler.has_timing());
+    EXPECT_EQ(11ms, scheduler.delay_before_compositing(vblank, 5ms));
+    EXPECT_EQ(9ms, scheduler.delay_before_compositing(vblank + 2ms, 5ms));
+}
+
+TEST_F(FrameScheduler, composites_immediately_when_just_in_time)
+{
+    scheduler.presented(frame_at(vblank), interval);
+
+    EXPECT_EQ(0ns, scheduler.delay_before_compositing(vblank + 11ms, 5ms));
+}
+
+TEST_F(FrameScheduler, aims_for_a_later_vblank_when_too_late_for_the_next)
+{
+    scheduler.presented(frame_at(vblank), interval);
+
+    // Too late to render 5ms in time for vblank + 16ms, so aim for vblank + 32ms
+    EXPECT_EQ(15ms, scheduler.delay_before_compositing(vblank + 12ms, 5ms));
+}
+
+TEST_F(FrameScheduler, stays_in_phase_after_idling)
+{
+    scheduler.presented(frame_at(vblank), interval);
+
+    auto const much_later = vblank + 100 * interval + 3ms;
+    EXPECT_EQ(8ms, scheduler.delay_before_compositing(much_later, 5ms));
+}
+
+TEST_F(FrameScheduler, never_targets_the_vblank_already_presented_on)
+{
+    scheduler.presented(frame_at(vblank), interval);
+
+    EXPECT_EQ(0ns, scheduler.delay_before_compositing(vblank, interval));
+    EXPECT_EQ(16ms, scheduler.delay_before_compositing(vblank, 0ns));
+}
+
+TEST_F(FrameScheduler, composites_immediately_when_clocks_differ)
+{
+    scheduler.presented(frame_at(vblank), interval);
+
+    EXPECT_EQ(0ns, scheduler.delay_before_compositing(mt::PosixTimestamp{CLOCK_REALTIME, 1000ms}, 5ms));
+}
+
+TEST_F(FrameScheduler, follows_the_latest_presented_frame)
+{
+    scheduler.presented(frame_at(vblank), interval);
+    scheduler.presented(frame_at(vblank + 20ms, 2), interval);
+
+    EXPECT_EQ(CLOCK_MONOTONIC, scheduler.clock_id());
+    EXPECT_EQ(11ms, scheduler.delay_before_compositing(vblank + 20ms, 5ms));
+}
+
+TEST_F(FrameScheduler, skips_the_vblank_a_posted_frame_is_waiting_for)
+{
+    scheduler.presented(frame_at(vblank), interval);
+    scheduler.frame_in_flight(true);
+
+    EXPECT_EQ(27ms, scheduler.delay_before_compositing(vblank, 5ms));
+
+    scheduler.frame_in_flight(false);
+    EXPECT_EQ(11ms, scheduler.delay_before_compositing(vblank, 5ms));
+}
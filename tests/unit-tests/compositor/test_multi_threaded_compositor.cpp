@@ -23,6 +23,7 @@
 #include "mir/compositor/display_buffer_compositor.h"
 #include "mir/compositor/scene.h"
 #include "mir/compositor/display_buffer_compositor_factory.h"
+#include "mir/compositor/presentation_observer.h"
 #include "mir/scene/observer.h"
 #include "mir/raii.h"
 
@@ -38,10 +39,12 @@
 
 #include <boost/throw_exception.hpp>
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 
 #include <gmock/gmock.h>
@@ -948,3 +951,122 @@ TEST(MultiThreadedCompositor, can_schedule_from_display_observer_when_removing_d
         display, stub_scene, db_compositor_factory, mock_display_listener, mock_report, default_delay, true};
     compositor.start();
 }
+
+namespace
+{
+struct ShowingDisplayBufferCompositor : mc::DisplayBufferCompositor
+{
+    explicit ShowingDisplayBufferCompositor(std::atomic<int>& composites)
+        : composites{composites}
+    {
+    }
+
+    void composite(mc::SceneElementSequence&&) override
+    {
+        ++composites;
+    }
+
+    void buffers_shown(
+        std::vector<mg::BufferID>& composited,
+        std::vector<mg::BufferID>& scanned_out) const override
+    {
+        composited.push_back(mg::BufferID{7});
+        scanned_out.push_back(mg::BufferID{11});
+    }
+
+    std::atomic<int>& composites;
+};
+
+struct ShowingDisplayBufferCompositorFactory : mc::DisplayBufferCompositorFactory
+{
+    std::unique_ptr<mc::DisplayBufferCompositor> create_compositor_for(mg::DisplayBuffer&) override
+    {
+        return std::make_unique<ShowingDisplayBufferCompositor>(composites);
+    }
+
+    std::atomic<int> composites{0};
+};
+
+struct RecordingPresentationObserver : mc::PresentationObserver
+{
+    void frame_presented(std::shared_ptr<mc::PresentedFrame const> const& frame) override
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        frames.push_back(frame);
+        cv.notify_all();
+    }
+
+    bool awaiting_presentation() override
+    {
+        return awaiting;
+    }
+
+    std::shared_ptr<mc::PresentedFrame const> wait_for_frame()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        cv.wait_for(lock, 5s, [this] { return !frames.empty(); });
+        return frames.empty() ? nullptr : frames.front();
+    }
+
+    std::atomic<bool> awaiting{true};
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::shared_ptr<mc::PresentedFrame const>> frames;
+};
+}
+
+TEST(MultiThreadedCompositor, reports_the_buffers_each_frame_presented)
+{
+    using namespace testing;
+
+    auto const observer = std::make_shared<RecordingPresentationObserver>();
+
+    mc::MultiThreadedCompositor compositor{
+        std::make_shared<mtd::StubDisplay>(1),
+        std::make_shared<StubScene>(),
+        std::make_shared<ShowingDisplayBufferCompositorFactory>(),
+        null_display_listener,
+        null_report,
+        observer,
+        default_delay,
+        true};
+
+    compositor.start();
+    auto const frame = observer->wait_for_frame();
+    compositor.stop();
+
+    ASSERT_THAT(frame, NotNull());
+    EXPECT_THAT(frame->composited, ElementsAre(mg::BufferID{7}));
+    EXPECT_THAT(frame->scanned_out, ElementsAre(mg::BufferID{11}));
+}
+
+TEST(MultiThreadedCompositor, reports_no_frames_while_nothing_awaits_presentation)
+{
+    using namespace testing;
+
+    auto const observer = std::make_shared<RecordingPresentationObserver>();
+    observer->awaiting = false;
+    auto const factory = std::make_shared<ShowingDisplayBufferCompositorFactory>();
+
+    mc::MultiThreadedCompositor compositor{
+        std::make_shared<mtd::StubDisplay>(1),
+        std::make_shared<StubScene>(),
+        factory,
+        null_display_listener,
+        null_report,
+        observer,
+        default_delay,
+        true};
+
+    compositor.start();
+    for (auto const timeout = std::chrono::steady_clock::now() + 5s;
+         factory->composites == 0 && std::chrono::steady_clock::now() < timeout;)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    compositor.stop();
+
+    ASSERT_THAT(factory->composites.load(), Gt(0));
+    std::lock_guard<std::mutex> lock{observer->mutex};
+    EXPECT_THAT(observer->frames, IsEmpty());
+}
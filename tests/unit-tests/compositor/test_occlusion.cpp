@@ -125,6 +125,20 @@ TEST_F(OcclusionFilterTest, shaped_window_occludes_nothing)
     EXPECT_THAT(renderables_from(elements), ElementsAre(bottom, top));
 }
 
+TEST_F(OcclusionFilterTest, opaque_region_of_shaped_window_occludes)
+{
+    auto top = std::make_shared<mtd::FakeRenderable>(Rectangle{{0, 0}, {30, 30}}, 1.0f, false);
+    top->set_opaque_region({{{5, 5}, {20, 20}}});
+    auto hidden = std::make_shared<mtd::FakeRenderable>(10, 10, 10, 10);
+    auto under_shadow = std::make_shared<mtd::FakeRenderable>(0, 0, 10, 10);
+    auto elements = scene_elements_from({under_shadow, hidden, top});
+
+    auto const& occlusions = filter_occlusions_from(elements, monitor_rect);
+
+    EXPECT_THAT(renderables_from(occlusions), ElementsAre(hidden));
+    EXPECT_THAT(renderables_from(elements), ElementsAre(under_shadow, top));
+}
+
 TEST_F(OcclusionFilterTest, identical_window_occluded)
 {
     auto top = std::make_shared<mtd::FakeRenderable>(10, 10, 10, 10);
@@ -202,3 +216,30 @@ TEST_F(OcclusionFilterTest,
     EXPECT_THAT(renderables_from(occlusions), ElementsAre(partially_onscreen));
     EXPECT_THAT(renderables_from(elements), ElementsAre(covering));
 }
+
+TEST_F(OcclusionFilterTest, window_covered_by_several_windows_is_occluded)
+{
+    auto const hidden = std::make_shared<mtd::FakeRenderable>(50, 50, 100, 100);
+    auto const left = std::make_shared<mtd::FakeRenderable>(0, 0, 100, 200);
+    auto const right = std::make_shared<mtd::FakeRenderable>(100, 0, 100, 200);
+    auto elements = scene_elements_from({hidden, left, right});
+
+    auto const& occlusions = filter_occlusions_from(elements, monitor_rect);
+
+    EXPECT_THAT(renderables_from(occlusions), ElementsAre(hidden));
+    EXPECT_THAT(renderables_from(elements), ElementsAre(left, right));
+}
+
+TEST_F(OcclusionFilterTest, records_visible_region_of_partly_hidden_windows)
+{
+    auto const partly_hidden = std::make_shared<mtd::FakeRenderable>(50, 50, 100, 100);
+    auto const unobstructed = std::make_shared<mtd::FakeRenderable>(500, 500, 100, 100);
+    auto const top = std::make_shared<mtd::FakeRenderable>(0, 0, 100, 200);
+    auto elements = scene_elements_from({partly_hidden, unobstructed, top});
+
+    VisibleRegions visible;
+    filter_occlusions_from(elements, monitor_rect, visible);
+
+    EXPECT_THAT(visible.size(), Eq(1u));
+    EXPECT_THAT(visible[partly_hidden->id()], Eq(Rectangles{{{100, 50}, {50, 100}}}));
+}
@@ -241,3 +241,33 @@ TEST_F(Stream, stream_remembers_scale_when_buffer_added)
     stream.submit_buffer(buffers[0]);
     ASSERT_THAT(stream.stream_size(), Eq(initial_size / 2));
 }
+
+TEST_F(Stream, accumulates_damage_between_submitted_buffers)
+{
+    geom::Rectangle const first_damage{{0, 0}, {4, 1}};
+    geom::Rectangle const second_damage{{10, 1}, {2, 1}};
+
+    stream.submit_buffer(buffers[0]);
+    stream.submit_buffer(buffers[1], geom::Rectangles{first_damage});
+    stream.submit_buffer(buffers[2], geom::Rectangles{second_damage});
+
+    EXPECT_THAT(stream.damage_between(buffers[1]->id(), buffers[2]->id()),
+        Eq(std::experimental::make_optional(geom::Rectangles{second_damage})));
+    EXPECT_THAT(stream.damage_between(buffers[0]->id(), buffers[2]->id()),
+        Eq(std::experimental::make_optional(geom::Rectangles{second_damage, first_damage})));
+    EXPECT_THAT(stream.damage_between(buffers[2]->id(), buffers[2]->id()),
+        Eq(std::experimental::make_optional(geom::Rectangles{})));
+}
+
+TEST_F(Stream, damage_is_unknown_for_buffers_submitted_without_damage_or_resized)
+{
+    auto const resized = std::make_shared<mtd::StubBuffer>(initial_size * 2);
+
+    stream.submit_buffer(buffers[0]);
+    stream.submit_buffer(buffers[1]);
+    stream.submit_buffer(resized, geom::Rectangles{{{0, 0}, {1, 1}}});
+
+    EXPECT_FALSE(stream.damage_between(buffers[0]->id(), buffers[1]->id()));
+    EXPECT_FALSE(stream.damage_between(buffers[1]->id(), resized->id()));
+    EXPECT_FALSE(stream.damage_between(buffers[2]->id(), resized->id()));
+}
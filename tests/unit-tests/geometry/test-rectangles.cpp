@@ -285,3 +285,41 @@ TEST_F(TestRectangles, remove_only_removes_one_instance)
         EXPECT_THAT(rectangles.size(), Eq(i));
     }
 }
+
+TEST_F(TestRectangles, subtract_leaves_the_uncovered_area)
+{
+    Rectangle const whole{{0, 0}, {100, 100}};
+    Rectangle const hole{{25, 25}, {50, 50}};
+
+    rectangles.add(whole);
+    rectangles.subtract(hole);
+
+    EXPECT_THAT(contents_of(rectangles), UnorderedElementsAre(
+        Rectangle{{0, 0}, {100, 25}},
+        Rectangle{{0, 75}, {100, 25}},
+        Rectangle{{0, 25}, {25, 50}},
+        Rectangle{{75, 25}, {25, 50}}));
+}
+
+TEST_F(TestRectangles, subtract_ignores_rectangles_not_overlapping)
+{
+    Rectangle const left{{0, 0}, {100, 100}};
+    Rectangle const right{{100, 0}, {100, 100}};
+
+    rectangles.add(left);
+    rectangles.add(right);
+    rectangles.subtract({{0, 50}, {100, 100}});
+
+    EXPECT_THAT(contents_of(rectangles), UnorderedElementsAre(Rectangle{{0, 0}, {100, 50}}, right));
+}
+
+TEST_F(TestRectangles, subtracting_everything_leaves_nothing)
+{
+    rectangles.add({{0, 0}, {100, 100}});
+    rectangles.add({{50, 50}, {100, 100}});
+
+    rectangles.subtract({{0, 0}, {50, 150}});
+    rectangles.subtract({{50, 0}, {100, 150}});
+
+    EXPECT_THAT(rectangles.size(), Eq(0u));
+}
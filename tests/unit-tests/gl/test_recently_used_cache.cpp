@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mir/gl/default_program_factory.h"
+#include "src/gl/recently_used_cache.h"
+#include <mir/test/doubles/mock_gl.h>
+#include <mir/test/doubles/mock_gl_buffer.h>
+#include <mir/test/doubles/mock_renderable.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+using testing::Eq;
+using testing::Return;
+
+namespace mg = mir::graphics;
+namespace mgl = mir::gl;
+namespace geom = mir::geometry;
+namespace mtd = mir::test::doubles;
+
+namespace
+{
+struct Loadable
+{
+    Loadable(int id)
+        : buffer{std::make_shared<testing::NiceMock<mtd::MockGLBuffer>>(
+              geom::Size{16, 16}, geom::Stride{64}, mir_pixel_format_abgr_8888)}
+    {
+        ON_CALL(*buffer, id()).WillByDefault(Return(mg::BufferID{static_cast<uint32_t>(id)}));
+        ON_CALL(renderable, id()).WillByDefault(Return(&renderable));
+        ON_CALL(renderable, buffer()).WillByDefault(Return(buffer));
+    }
+
+    std::shared_ptr<testing::NiceMock<mtd::MockGLBuffer>> const buffer;
+    testing::NiceMock<mtd::MockRenderable> renderable;
+};
+
+std::size_t const bytes_per_buffer = 16 * 16 * 4;
+
+struct RecentlyUsedCache : testing::Test
+{
+    std::unique_ptr<mgl::TextureCache> cache_with_budget(std::size_t budget)
+    {
+        return mgl::DefaultProgramFactory{budget}.create_texture_cache();
+    }
+
+    static void skip_frames(mgl::TextureCache& cache, unsigned int frames)
+    {
+        for (auto i = 0u; i != frames; ++i)
+            cache.drop_unused();
+    }
+
+    testing::NiceMock<mtd::MockGL> mock_gl;
+};
+}
+
+TEST_F(RecentlyUsedCache, keeps_textures_missing_from_a_few_frames)
+{
+    auto const cache = cache_with_budget(0);
+    Loadable a{1};
+
+    EXPECT_CALL(*a.buffer, bind()).Times(1);
+
+    cache->load(a.renderable);
+    cache->drop_unused();
+    skip_frames(*cache, mgl::RecentlyUsedCache::grace_frames - 1);
+    cache->load(a.renderable);
+}
+
+TEST_F(RecentlyUsedCache, evicts_textures_missing_for_longer_when_over_budget)
+{
+    auto const cache = cache_with_budget(0);
+    Loadable a{1};
+
+    EXPECT_CALL(*a.buffer, bind()).Times(2);
+
+    cache->load(a.renderable);
+    cache->drop_unused();
+    skip_frames(*cache, mgl::RecentlyUsedCache::grace_frames);
+    cache->load(a.renderable);
+}
+
+TEST_F(RecentlyUsedCache, keeps_textures_missing_for_longer_within_budget)
+{
+    auto const cache = cache_with_budget(bytes_per_buffer);
+    Loadable a{1};
+
+    EXPECT_CALL(*a.buffer, bind()).Times(1);
+
+    cache->load(a.renderable);
+    cache->drop_unused();
+    skip_frames(*cache, 10 * mgl::RecentlyUsedCache::grace_frames);
+    cache->load(a.renderable);
+}
+
+TEST_F(RecentlyUsedCache, evicts_least_recently_used_textures_first)
+{
+    auto const cache = cache_with_budget(bytes_per_buffer);
+    Loadable older{1};
+    Loadable newer{2};
+
+    EXPECT_CALL(*older.buffer, bind()).Times(2);
+    EXPECT_CALL(*newer.buffer, bind()).Times(1);
+
+    cache->load(older.renderable);
+    cache->drop_unused();
+    cache->load(newer.renderable);
+    cache->drop_unused();
+    skip_frames(*cache, mgl::RecentlyUsedCache::grace_frames);
+
+    cache->load(newer.renderable);
+    cache->load(older.renderable);
+}
+
+TEST_F(RecentlyUsedCache, rebinds_invalidated_textures)
+{
+    auto const cache = cache_with_budget(bytes_per_buffer);
+    Loadable a{1};
+
+    EXPECT_CALL(*a.buffer, bind()).Times(2);
+
+    cache->load(a.renderable);
+    cache->drop_unused();
+    cache->invalidate();
+    cache->load(a.renderable);
+}
+
+TEST_F(RecentlyUsedCache, counts_hits_misses_and_bytes_resident)
+{
+    auto const cache = cache_with_budget(2 * bytes_per_buffer);
+    Loadable a{1};
+    Loadable b{2};
+
+    cache->load(a.renderable);
+    cache->load(b.renderable);
+    cache->drop_unused();
+
+    auto stats = cache->statistics();
+    EXPECT_THAT(stats.hits, Eq(0u));
+    EXPECT_THAT(stats.misses, Eq(2u));
+    EXPECT_THAT(stats.bytes_resident, Eq(2 * bytes_per_buffer));
+
+    cache->load(a.renderable);
+    cache->drop_unused();
+
+    stats = cache->statistics();
+    EXPECT_THAT(stats.hits, Eq(1u));
+    EXPECT_THAT(stats.misses, Eq(0u));
+    EXPECT_THAT(stats.bytes_resident, Eq(2 * bytes_per_buffer));
+}
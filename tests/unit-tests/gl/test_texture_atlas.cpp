@@ -0,0 +1,188 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mir/gl/texture_atlas.h"
+#include "mir/graphics/buffer_properties.h"
+#include <mir/test/doubles/mock_gl.h>
+#include <mir/test/doubles/mock_renderable.h>
+#include <mir/test/doubles/stub_buffer.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <vector>
+
+using testing::_;
+using testing::Eq;
+using testing::Invoke;
+using testing::Return;
+using testing::SetArgPointee;
+
+namespace mg = mir::graphics;
+namespace mgl = mir::gl;
+namespace geom = mir::geometry;
+namespace mtd = mir::test::doubles;
+
+namespace
+{
+struct TextureAtlas : testing::Test
+{
+    TextureAtlas()
+    {
+        ON_CALL(mock_gl, glGetIntegerv(GL_MAX_TEXTURE_SIZE, _))
+            .WillByDefault(SetArgPointee<1>(4096));
+    }
+
+    auto renderable_with(geom::Size const& size, MirPixelFormat format = mir_pixel_format_abgr_8888)
+    {
+        auto const r = std::make_shared<testing::NiceMock<mtd::MockRenderable>>();
+        ON_CALL(*r, id()).WillByDefault(Return(r.get()));
+        give_buffer(*r, size, format);
+        return r;
+    }
+
+    void give_buffer(mtd::MockRenderable& r, geom::Size const& size, MirPixelFormat format = mir_pixel_format_abgr_8888)
+    {
+        auto const buffer = std::make_shared<mtd::StubBuffer>(
+            mg::BufferProperties{size, format, mg::BufferUsage::software});
+        ON_CALL(r, buffer()).WillByDefault(Return(buffer));
+    }
+
+    static bool overlap(mgl::TextureAtlas::Region const& a, mgl::TextureAtlas::Region const& b)
+    {
+        return a.left < b.left + b.width && b.left < a.left + a.width &&
+               a.top < b.top + b.height && b.top < a.top + a.height;
+    }
+
+    testing::NiceMock<mtd::MockGL> mock_gl;
+    mgl::TextureAtlas atlas{{64, 64}, {64, 64}};
+};
+}
+
+TEST_F(TextureAtlas, packs_small_buffers_into_one_texture)
+{
+    auto const a = renderable_with({16, 16});
+    auto const b = renderable_with({16, 16});
+
+    EXPECT_CALL(mock_gl, glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 64, 0, GL_RGBA, GL_UNSIGNED_BYTE, _)).Times(1);
+    EXPECT_CALL(mock_gl, glTexSubImage2D(GL_TEXTURE_2D, 0, _, _, 16, 16, GL_RGBA, GL_UNSIGNED_BYTE, _)).Times(2);
+
+    auto const region_a = atlas.load(*a);
+    auto const region_b = atlas.load(*b);
+
+    ASSERT_TRUE(region_a);
+    ASSERT_TRUE(region_b);
+    EXPECT_THAT(region_a->width, Eq(0.25f));
+    EXPECT_THAT(region_a->height, Eq(0.25f));
+    EXPECT_FALSE(overlap(region_a.value(), region_b.value()));
+}
+
+TEST_F(TextureAtlas, does_not_hold_large_buffers)
+{
+    mgl::TextureAtlas atlas{{64, 64}, {32, 32}};
+
+    EXPECT_FALSE(atlas.load(*renderable_with({33, 16})));
+    EXPECT_FALSE(atlas.load(*renderable_with({16, 33})));
+}
+
+TEST_F(TextureAtlas, does_not_hold_formats_it_cant_convert)
+{
+    EXPECT_FALSE(atlas.load(*renderable_with({16, 16}, mir_pixel_format_rgb_565)));
+}
+
+TEST_F(TextureAtlas, uploads_only_new_buffers)
+{
+    auto const r = renderable_with({16, 16});
+
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(1);
+    atlas.load(*r);
+    atlas.load(*r);
+    testing::Mock::VerifyAndClearExpectations(&mock_gl);
+
+    give_buffer(*r, {16, 16});
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(1);
+    atlas.load(*r);
+}
+
+TEST_F(TextureAtlas, reorders_argb_pixels_as_rgba)
+{
+    auto const r = std::make_shared<testing::NiceMock<mtd::MockRenderable>>();
+    auto const buffer = std::make_shared<mtd::StubBuffer>(
+        mg::BufferProperties{{1, 1}, mir_pixel_format_argb_8888, mg::BufferUsage::software});
+    unsigned char const bgra[] = {1, 2, 3, 4};
+    buffer->write(bgra, sizeof bgra);
+    ON_CALL(*r, id()).WillByDefault(Return(r.get()));
+    ON_CALL(*r, buffer()).WillByDefault(Return(buffer));
+
+    std::vector<unsigned char> uploaded;
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, _))
+        .WillOnce(Invoke(
+            [&](GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, GLvoid const* pixels)
+            {
+                auto const bytes = static_cast<unsigned char const*>(pixels);
+                uploaded.assign(bytes, bytes + 4);
+            }));
+
+    atlas.load(*r);
+
+    EXPECT_THAT(uploaded, Eq(std::vector<unsigned char>{3, 2, 1, 4}));
+}
+
+TEST_F(TextureAtlas, evicts_buffers_that_are_no_longer_loaded)
+{
+    std::vector<std::shared_ptr<testing::NiceMock<mtd::MockRenderable>>> renderables;
+    for (auto i = 0; i != 4; ++i)
+    {
+        renderables.push_back(renderable_with({32, 32}));
+        ASSERT_TRUE(atlas.load(*renderables.back()));
+    }
+    auto const another = renderable_with({32, 32});
+    EXPECT_FALSE(atlas.load(*another));
+    atlas.drop_unused();
+
+    atlas.load(*renderables[0]);
+    atlas.drop_unused();
+
+    EXPECT_TRUE(atlas.load(*another));
+}
+
+TEST_F(TextureAtlas, repacks_when_too_fragmented)
+{
+    std::vector<std::shared_ptr<testing::NiceMock<mtd::MockRenderable>>> renderables;
+    for (auto i = 0; i != 4; ++i)
+        renderables.push_back(renderable_with({32, 32}));
+    for (auto const& r : renderables)
+        atlas.load(*r);
+    atlas.drop_unused();
+
+    // Free two quarters that aren't next to each other
+    atlas.load(*renderables[0]);
+    atlas.load(*renderables[3]);
+    atlas.drop_unused();
+
+    auto const wide = renderable_with({64, 32});
+    EXPECT_FALSE(atlas.load(*wide));
+    atlas.drop_unused();
+
+    auto const region_0 = atlas.load(*renderables[0]);
+    auto const region_3 = atlas.load(*renderables[3]);
+    auto const region_wide = atlas.load(*wide);
+    ASSERT_TRUE(region_0);
+    ASSERT_TRUE(region_3);
+    ASSERT_TRUE(region_wide);
+    EXPECT_FALSE(overlap(region_0.value(), region_wide.value()));
+    EXPECT_FALSE(overlap(region_3.value(), region_wide.value()));
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mir/graphics/pixel_ops.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using testing::ElementsAre;
+using testing::Eq;
+
+namespace mg = mir::graphics;
+namespace geom = mir::geometry;
+
+namespace
+{
+struct PixelOps : testing::TestWithParam<mg::PixelOps const*>
+{
+    mg::PixelOps const& ops{*GetParam()};
+    mg::PixelOps const& scalar{*mg::supported_pixel_ops().front()};
+
+    /// Premultiplied pixels, with plenty of opaque and clear runs; odd lengths exercise the tails
+    std::vector<std::uint32_t> random_pixels(std::size_t n)
+    {
+        std::vector<std::uint32_t> pixels(n);
+        for (auto& pixel : pixels)
+        {
+            auto const kind = random() % 4;
+            std::uint32_t const alpha = kind == 0 ? 255 : kind == 1 ? 0 : random() % 256;
+            auto const channel = [&]() { return alpha ? random() % (alpha + 1) : 0; };
+            pixel = alpha << 24 | channel() << 16 | channel() << 8 | channel();
+        }
+        return pixels;
+    }
+
+    /// A glyph-like mask: mostly empty, with some solid and some edge coverage
+    std::vector<std::uint8_t> random_mask(std::size_t n)
+    {
+        std::vector<std::uint8_t> mask(n);
+        for (auto& coverage : mask)
+        {
+            auto const kind = random() % 4;
+            coverage = kind < 2 ? 0 : kind == 2 ? 255 : random() % 256;
+        }
+        return mask;
+    }
+
+    std::mt19937 random{42};
+};
+
+std::string name_of(testing::TestParamInfo<mg::PixelOps const*> const& info)
+{
+    return info.param->name;
+}
+
+/// A 3 × 2 image, laid out as its rows
+std::vector<std::uint32_t> const image{
+    1, 2, 3,
+    4, 5, 6};
+}
+
+TEST_P(PixelOps, over_blends_premultiplied_source_over_destination)
+{
+    std::uint32_t dst[] = {0xffff0000, 0xffff0000, 0xffff0000};
+    std::uint32_t const src[] = {0x80000080, 0x00000000, 0xff00ff00};
+
+    ops.over(dst, src, 3);
+
+    EXPECT_THAT(dst[0], Eq(0xff7f0080u));
+    EXPECT_THAT(dst[1], Eq(0xffff0000u));
+    EXPECT_THAT(dst[2], Eq(0xff00ff00u));
+}
+
+TEST_P(PixelOps, over_with_alpha_scales_source_first)
+{
+    std::uint32_t dst[] = {0xff000000};
+    std::uint32_t const src[] = {0xffffffff};
+
+    ops.over_with_alpha(dst, src, 1, 128);
+
+    EXPECT_THAT(dst[0], Eq(0xff808080u));
+}
+
+TEST_P(PixelOps, over_with_mask_scales_colour_by_coverage)
+{
+    std::uint32_t dst[] = {0xff000000, 0xff000000, 0xff000000};
+    std::uint8_t const mask[] = {0, 128, 255};
+
+    ops.over_with_mask(dst, mask, 0xffffffff, 3);
+
+    EXPECT_THAT(dst, ElementsAre(0xff000000u, 0xff808080u, 0xffffffffu));
+}
+
+TEST_P(PixelOps, swap_red_blue_swaps_only_those_channels)
+{
+    std::uint32_t dst[1];
+    std::uint32_t const src[] = {0x11223344};
+
+    ops.swap_red_blue(dst, src, 1);
+
+    EXPECT_THAT(dst[0], Eq(0x11443322u));
+}
+
+TEST_P(PixelOps, premultiply_scales_colour_channels_by_alpha)
+{
+    std::uint32_t dst[2];
+    std::uint32_t const src[] = {0x80ffffff, 0x00123456};
+
+    ops.premultiply(dst, src, 2);
+
+    EXPECT_THAT(dst, ElementsAre(0x80808080u, 0x00000000u));
+}
+
+TEST_P(PixelOps, rotate_left_turns_anticlockwise)
+{
+    std::vector<std::uint32_t> dst(6);
+
+    ops.rotate_left(dst.data(), 2, image.data(), 3, 3, 2);
+
+    EXPECT_THAT(dst, ElementsAre(
+        3, 6,
+        2, 5,
+        1, 4));
+}
+
+TEST_P(PixelOps, rotate_right_turns_clockwise)
+{
+    std::vector<std::uint32_t> dst(6);
+
+    ops.rotate_right(dst.data(), 2, image.data(), 3, 3, 2);
+
+    EXPECT_THAT(dst, ElementsAre(
+        4, 1,
+        5, 2,
+        6, 3));
+}
+
+TEST_P(PixelOps, agree_exactly_with_the_portable_operations)
+{
+    for (auto n : {1u, 3u, 4u, 7u, 8u, 15u, 16u, 33u, 257u})
+    {
+        auto const src = random_pixels(n);
+        auto const dst = random_pixels(n);
+        auto const mask = random_mask(n);
+        auto const colour = random_pixels(1).front();
+        std::uint8_t const alpha = random() % 256;
+
+        auto expected = dst;
+        auto actual = dst;
+        scalar.over(expected.data(), src.data(), n);
+        ops.over(actual.data(), src.data(), n);
+        EXPECT_THAT(actual, Eq(expected)) << "over of " << n;
+
+        expected = dst;
+        actual = dst;
+        scalar.over_with_alpha(expected.data(), src.data(), n, alpha);
+        ops.over_with_alpha(actual.data(), src.data(), n, alpha);
+        EXPECT_THAT(actual, Eq(expected)) << "over_with_alpha of " << n;
+
+        expected = dst;
+        actual = dst;
+        scalar.over_with_mask(expected.data(), mask.data(), colour, n);
+        ops.over_with_mask(actual.data(), mask.data(), colour, n);
+        EXPECT_THAT(actual, Eq(expected)) << "over_with_mask of " << n;
+
+        scalar.swap_red_blue(expected.data(), src.data(), n);
+        ops.swap_red_blue(actual.data(), src.data(), n);
+        EXPECT_THAT(actual, Eq(expected)) << "swap_red_blue of " << n;
+
+        scalar.reverse(expected.data(), src.data(), n);
+        ops.reverse(actual.data(), src.data(), n);
+        EXPECT_THAT(actual, Eq(expected)) << "reverse of " << n;
+
+        scalar.premultiply(expected.data(), src.data(), n);
+        ops.premultiply(actual.data(), src.data(), n);
+        EXPECT_THAT(actual, Eq(expected)) << "premultiply of " << n;
+
+        scalar.copy_opaque(expected.data(), src.data(), n);
+        ops.copy_opaque(actual.data(), src.data(), n);
+        EXPECT_THAT(actual, Eq(expected)) << "copy_opaque of " << n;
+
+        scalar.fill(expected.data(), 0x12345678, n);
+        ops.fill(actual.data(), 0x12345678, n);
+        EXPECT_THAT(actual, Eq(expected)) << "fill of " << n;
+    }
+}
+
+TEST_P(PixelOps, rotations_agree_exactly_with_the_portable_operations)
+{
+    for (auto size : {geom::Size{1, 1}, geom::Size{4, 4}, geom::Size{7, 5}, geom::Size{64, 64}, geom::Size{37, 70}})
+    {
+        auto const width = size.width.as_uint32_t();
+        auto const height = size.height.as_uint32_t();
+        // Rows padded, as buffers' often are
+        auto const src_stride = width + 3;
+        auto const dst_stride = height + 5;
+        auto const src = random_pixels(src_stride * height);
+
+        std::vector<std::uint32_t> expected(dst_stride * width);
+        std::vector<std::uint32_t> actual(dst_stride * width);
+        scalar.rotate_left(expected.data(), dst_stride, src.data(), src_stride, width, height);
+        ops.rotate_left(actual.data(), dst_stride, src.data(), src_stride, width, height);
+        EXPECT_THAT(actual, Eq(expected)) << "rotate_left of " << size;
+
+        scalar.rotate_right(expected.data(), dst_stride, src.data(), src_stride, width, height);
+        ops.rotate_right(actual.data(), dst_stride, src.data(), src_stride, width, height);
+        EXPECT_THAT(actual, Eq(expected)) << "rotate_right of " << size;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Supported,
+    PixelOps,
+    testing::ValuesIn(mg::supported_pixel_ops()),
+    name_of);
+
+TEST(PixelOpsImages, flip_vertically_reverses_rows)
+{
+    auto pixels = image;
+
+    mg::flip_vertically(
+        reinterpret_cast<unsigned char*>(pixels.data()), geom::Size{3, 2}, geom::Stride{12}, false);
+
+    EXPECT_THAT(pixels, ElementsAre(
+        4, 5, 6,
+        1, 2, 3));
+}
+
+TEST(PixelOpsImages, flip_vertically_can_swap_red_and_blue)
+{
+    std::vector<std::uint32_t> pixels{0x11223344, 0x55667788, 0x99aabbcc};
+
+    mg::flip_vertically(
+        reinterpret_cast<unsigned char*>(pixels.data()), geom::Size{1, 3}, geom::Stride{4}, true);
+
+    EXPECT_THAT(pixels, ElementsAre(0x99ccbbaau, 0x55887766u, 0x11443322u));
+}
+
+TEST(PixelOpsImages, rotate_turns_to_each_orientation)
+{
+    std::vector<std::uint32_t> dst(6);
+    auto const rotated = [&](MirOrientation orientation, int dst_width)
+        {
+            mg::rotate(
+                reinterpret_cast<unsigned char*>(dst.data()), geom::Stride{dst_width * 4},
+                reinterpret_cast<unsigned char const*>(image.data()), geom::Size{3, 2}, geom::Stride{12},
+                orientation);
+            return dst;
+        };
+
+    EXPECT_THAT(rotated(mir_orientation_normal, 3), ElementsAre(1, 2, 3, 4, 5, 6));
+    EXPECT_THAT(rotated(mir_orientation_inverted, 3), ElementsAre(6, 5, 4, 3, 2, 1));
+    EXPECT_THAT(rotated(mir_orientation_left, 2), ElementsAre(3, 6, 2, 5, 1, 4));
+    EXPECT_THAT(rotated(mir_orientation_right, 2), ElementsAre(4, 1, 5, 2, 6, 3));
+}
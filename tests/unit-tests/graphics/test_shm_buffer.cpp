@@ -32,6 +32,10 @@
 #include <endian.h>
 #include <boost/throw_exception.hpp>
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 namespace mg = mir::graphics;
 namespace mgc = mir::graphics::common;
 namespace mtd = mir::test::doubles;
@@ -362,3 +366,309 @@ TEST_F(ShmBufferTest, texture_is_destroyed_on_thread_with_current_context)
         eglMakeCurrent(dummy_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     }
 }
+
+namespace
+{
+struct StreamShmBuffer : mgc::ShmBuffer
+{
+    StreamShmBuffer(
+        geom::Size const& size,
+        std::shared_ptr<mgc::EGLContextExecutor> egl_delegate)
+        : ShmBuffer(size, mir_pixel_format_abgr_8888, std::move(egl_delegate)),
+          pixels(size.width.as_int() * size.height.as_int() * 4)
+    {
+    }
+
+    StreamShmBuffer(
+        geom::Size const& size,
+        StreamShmBuffer const& previous,
+        std::experimental::optional<geom::Rectangles> const& damage)
+        : ShmBuffer(size, mir_pixel_format_abgr_8888, previous, damage),
+          pixels(size.width.as_int() * size.height.as_int() * 4)
+    {
+    }
+
+    std::shared_ptr<mg::NativeBuffer> native_buffer_handle() const override
+    {
+        return nullptr;
+    }
+
+    void with_pixels(std::function<void(unsigned char const*, geom::Stride)> const& do_with_pixels) override
+    {
+        do_with_pixels(pixels.data(), stride());
+    }
+
+    geom::Stride stride() const
+    {
+        return geom::Stride{size().width.as_int() * 4};
+    }
+
+    std::vector<unsigned char> pixels;
+};
+
+struct ShmBufferStreamTest : ShmBufferTest
+{
+    geom::Size const stream_size{640, 480};
+    StreamShmBuffer first{stream_size, egl_delegate};
+};
+}
+
+TEST_F(ShmBufferStreamTest, buffers_of_a_stream_share_a_texture)
+{
+    EXPECT_CALL(mock_gl, glGenTextures(1, _))
+        .WillOnce(SetArgPointee<1>(0x8086));
+
+    StreamShmBuffer second{stream_size, first, geom::Rectangles{}};
+
+    first.bind();
+    second.bind();
+}
+
+TEST_F(ShmBufferStreamTest, replacement_buffer_uploads_only_damage)
+{
+    geom::Rectangle const damage{{10, 20}, {30, 40}};
+    StreamShmBuffer second{stream_size, first, geom::Rectangles{damage}};
+
+    first.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glPixelStorei(GL_UNPACK_ALIGNMENT, _)).Times(AnyNumber());
+    EXPECT_CALL(mock_gl, glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stream_size.width.as_int()));
+    EXPECT_CALL(mock_gl, glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0));
+    EXPECT_CALL(mock_gl, glTexSubImage2D(
+        GL_TEXTURE_2D, 0,
+        10, 20,
+        30, 40,
+        GL_RGBA, GL_UNSIGNED_BYTE,
+        second.pixels.data() + 20 * second.stride().as_int() + 10 * 4));
+
+    second.bind();
+}
+
+TEST_F(ShmBufferStreamTest, damage_accumulates_over_frames_the_texture_missed)
+{
+    geom::Rectangle const first_damage{{10, 20}, {30, 40}};
+    geom::Rectangle const second_damage{{100, 200}, {5, 5}};
+    StreamShmBuffer second{stream_size, first, geom::Rectangles{first_damage}};
+    StreamShmBuffer third{stream_size, second, geom::Rectangles{second_damage}};
+
+    first.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, 10, 20, 30, 40, _, _, _));
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, 100, 200, 5, 5, _, _, _));
+
+    third.bind();
+}
+
+TEST_F(ShmBufferStreamTest, replacement_buffer_with_unknown_damage_is_fully_uploaded)
+{
+    StreamShmBuffer second{stream_size, first, std::experimental::nullopt};
+
+    first.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glTexImage2D(
+        GL_TEXTURE_2D, 0, _,
+        stream_size.width.as_int(), stream_size.height.as_int(),
+        0, _, _,
+        second.pixels.data()));
+
+    second.bind();
+}
+
+TEST_F(ShmBufferStreamTest, resized_buffer_is_fully_uploaded)
+{
+    geom::Size const new_size{320, 200};
+    StreamShmBuffer second{new_size, first, geom::Rectangles{{{0, 0}, {1, 1}}}};
+
+    first.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glTexImage2D(
+        GL_TEXTURE_2D, 0, _,
+        new_size.width.as_int(), new_size.height.as_int(),
+        0, _, _,
+        second.pixels.data()));
+
+    second.bind();
+}
+
+TEST_F(ShmBufferStreamTest, rebinding_an_older_buffer_uploads_it_again)
+{
+    StreamShmBuffer second{stream_size, first, geom::Rectangles{}};
+
+    first.bind();
+    second.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(
+        GL_TEXTURE_2D, 0, _,
+        stream_size.width.as_int(), stream_size.height.as_int(),
+        0, _, _,
+        first.pixels.data()));
+
+    first.bind();
+}
+
+TEST_F(ShmBufferStreamTest, stream_is_drawn_from_textures_once_any_buffer_is_bound)
+{
+    StreamShmBuffer second{stream_size, first, geom::Rectangles{}};
+
+    EXPECT_FALSE(first.drawn_from_textures());
+    EXPECT_FALSE(second.drawn_from_textures());
+
+    first.bind();
+
+    EXPECT_TRUE(first.drawn_from_textures());
+    EXPECT_TRUE(second.drawn_from_textures());
+}
+
+TEST_F(ShmBufferStreamTest, background_upload_leaves_nothing_for_bind_to_do)
+{
+    auto const second = std::make_shared<StreamShmBuffer>(stream_size, first, geom::Rectangles{});
+
+    first.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    // The compositor is drawing first, so second goes to the other texture
+    EXPECT_CALL(mock_gl, glTexImage2D(
+        GL_TEXTURE_2D, 0, _,
+        stream_size.width.as_int(), stream_size.height.as_int(),
+        0, _, _,
+        second->pixels.data()));
+    EXPECT_CALL(mock_gl, glFinish());
+
+    mgc::ShmBuffer::upload_in_background(second);
+    wait_for_egl_thread(*egl_delegate);
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+
+    second->bind();
+}
+
+TEST_F(ShmBufferStreamTest, bind_draws_the_previous_frame_while_a_background_upload_completes)
+{
+    GLuint const first_texture{0x8086};
+    GLuint const second_texture{0x8087};
+    EXPECT_CALL(mock_gl, glGenTextures(1, _))
+        .WillOnce(SetArgPointee<1>(first_texture))
+        .WillOnce(SetArgPointee<1>(second_texture));
+
+    auto const second = std::make_shared<StreamShmBuffer>(stream_size, first, geom::Rectangles{});
+
+    first.bind();
+
+    std::promise<void> upload_started;
+    std::promise<void> compositor_done;
+    auto const compositor_done_future = compositor_done.get_future();
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, second->pixels.data()))
+        .WillOnce(InvokeWithoutArgs([&] { upload_started.set_value(); }));
+    EXPECT_CALL(mock_gl, glFinish())
+        .WillOnce(InvokeWithoutArgs([&] { compositor_done_future.wait_for(std::chrono::seconds{10}); }));
+
+    mgc::ShmBuffer::upload_in_background(second);
+    ASSERT_THAT(
+        upload_started.get_future().wait_for(std::chrono::seconds{10}),
+        Eq(std::future_status::ready));
+
+    // The compositor neither waits for the upload nor does it again itself
+    EXPECT_CALL(mock_gl, glBindTexture(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mock_gl, glBindTexture(GL_TEXTURE_2D, first_texture));
+    second->bind();
+
+    compositor_done.set_value();
+    wait_for_egl_thread(*egl_delegate);
+}
+
+TEST_F(ShmBufferStreamTest, bind_starts_uploading_a_buffer_not_yet_uploaded_in_the_background)
+{
+    auto const second = std::make_shared<StreamShmBuffer>(stream_size, first, geom::Rectangles{});
+
+    first.bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, second->pixels.data()));
+    EXPECT_CALL(mock_gl, glFinish());
+
+    second->bind();
+    wait_for_egl_thread(*egl_delegate);
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+
+    second->bind();
+}
+
+TEST_F(ShmBufferStreamTest, background_upload_leaves_textures_a_compositor_is_drawing_alone)
+{
+    auto const second = std::make_shared<StreamShmBuffer>(stream_size, first, geom::Rectangles{});
+    auto const third = std::make_shared<StreamShmBuffer>(
+        stream_size, *second, geom::Rectangles{{{10, 20}, {30, 40}}});
+
+    EXPECT_CALL(mock_gl, glGenTextures(1, _)).Times(3);
+
+    // Without fences nothing says when the GPU is done with first's texture
+    first.bind();
+    first.add_syncpoint();
+
+    mgc::ShmBuffer::upload_in_background(second);
+    wait_for_egl_thread(*egl_delegate);
+
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, third->pixels.data()));
+
+    mgc::ShmBuffer::upload_in_background(third);
+    wait_for_egl_thread(*egl_delegate);
+}
+
+TEST_F(ShmBufferStreamTest, background_upload_reuses_textures_once_the_compositor_is_fenced)
+{
+    auto const fence = reinterpret_cast<EGLSyncKHR>(0xfe);
+    ON_CALL(mock_egl, eglQueryString(_, EGL_EXTENSIONS))
+        .WillByDefault(Return("EGL_KHR_fence_sync"));
+    ON_CALL(mock_egl, eglCreateSyncKHR(_, EGL_SYNC_FENCE_KHR, _))
+        .WillByDefault(Return(fence));
+    ON_CALL(mock_egl, eglClientWaitSyncKHR(_, fence, _, _))
+        .WillByDefault(Return(EGL_CONDITION_SATISFIED_KHR));
+
+    auto const second = std::make_shared<StreamShmBuffer>(stream_size, first, geom::Rectangles{});
+    auto const third = std::make_shared<StreamShmBuffer>(
+        stream_size, *second, geom::Rectangles{{{10, 20}, {30, 40}}});
+
+    EXPECT_CALL(mock_gl, glGenTextures(1, _)).Times(2);
+
+    first.bind();
+    first.add_syncpoint();
+
+    mgc::ShmBuffer::upload_in_background(second);
+    wait_for_egl_thread(*egl_delegate);
+
+    // first's texture is only a frame behind, so third's damage is all it needs
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, third->pixels.data())).Times(0);
+    EXPECT_CALL(mock_gl, glTexSubImage2D(_, _, 10, 20, 30, 40, _, _, _));
+
+    mgc::ShmBuffer::upload_in_background(third);
+    wait_for_egl_thread(*egl_delegate);
+}
+
+TEST_F(ShmBufferStreamTest, background_upload_skips_buffers_already_superseded)
+{
+    auto const second = std::make_shared<StreamShmBuffer>(stream_size, first, geom::Rectangles{});
+    auto const third = std::make_shared<StreamShmBuffer>(stream_size, *second, geom::Rectangles{});
+
+    third->bind();
+    Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glTexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+
+    mgc::ShmBuffer::upload_in_background(second);
+    wait_for_egl_thread(*egl_delegate);
+}
@@ -110,6 +110,76 @@ TEST_F(LoggingCompositorReport, calculates_accurate_stats)
     EXPECT_FLOAT_EQ(10.0f, measured_frame_time);
 }
 
+TEST_F(LoggingCompositorReport, reports_average_state_changes)
+{
+    const void* const id = "My Screen";
+
+    report.started();
+
+    for (int f = 0; f < 3; ++f)
+    {
+        report.began_frame(id);
+        report.state_changes_in_frame(id, 40, 200);
+        report.rendered_frame(id);
+        report.finished_frame(id);
+        clock->advance_by(chrono::microseconds(1000000));
+    }
+    EXPECT_TRUE(recorder->last_message_contains("40 state changes/frame (200 skipped)"))
+        << recorder->last_message();
+
+    report.stopped();
+}
+
+TEST_F(LoggingCompositorReport, reports_texture_cache_use)
+{
+    const void* const id = "My Screen";
+
+    report.started();
+
+    for (int f = 0; f < 3; ++f)
+    {
+        report.began_frame(id);
+        report.texture_cache_in_frame(id, 10, 1, 2048 * 1024);
+        report.rendered_frame(id);
+        report.finished_frame(id);
+        clock->advance_by(chrono::microseconds(1000000));
+    }
+    EXPECT_TRUE(recorder->last_message_contains("texture cache 10 hits, 1 misses, 2048 KiB"))
+        << recorder->last_message();
+
+    report.stopped();
+}
+
+TEST_F(LoggingCompositorReport, reports_gpu_timings_when_there_are_any)
+{
+    const void* const id = "My Screen";
+
+    report.started();
+
+    for (int f = 0; f < 3; ++f)
+    {
+        report.began_frame(id);
+        report.rendered_frame(id);
+        report.finished_frame(id);
+        clock->advance_by(chrono::microseconds(1000000));
+    }
+    EXPECT_FALSE(recorder->last_message_contains("GPU")) << recorder->last_message();
+
+    for (int f = 0; f < 3; ++f)
+    {
+        report.began_frame(id);
+        report.rendered_frame(id);
+        report.gpu_rendered_frame(id, chrono::microseconds(4250));
+        report.gpu_idle(id, chrono::microseconds(1500));
+        report.finished_frame(id);
+        clock->advance_by(chrono::microseconds(1000000));
+    }
+    EXPECT_TRUE(recorder->last_message_contains("GPU 4.250 ms/frame, GPU idle 1.500 ms/frame"))
+        << recorder->last_message();
+
+    report.stopped();
+}
+
 TEST_F(LoggingCompositorReport, survives_pause_resume)
 {
     const void* const before = "before";
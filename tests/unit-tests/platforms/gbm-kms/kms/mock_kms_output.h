@@ -58,6 +58,8 @@ struct MockKMSOutput : public graphics::gbm::KMSOutput
     }
     MOCK_METHOD1(schedule_page_flip_thunk, bool(graphics::gbm::FBHandle const*));
     MOCK_METHOD0(wait_for_page_flip, void());
+    MOCK_METHOD1(on_page_flip_complete, void(std::function<void()> const&));
+    MOCK_METHOD1(set_overlays, bool(std::vector<graphics::gbm::OverlayLayer> const&));
 
     MOCK_CONST_METHOD0(last_frame, graphics::Frame());
 
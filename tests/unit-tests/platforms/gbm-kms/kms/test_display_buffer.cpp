@@ -246,6 +246,19 @@ TEST_F(MesaDisplayBufferTest, frames_requiring_gl_are_not_throttled)
     }
 }
 
+TEST_F(MesaDisplayBufferTest, predicts_a_conservative_render_time_until_frames_are_measured)
+{
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    EXPECT_THAT(db.predicted_render_time(), Eq(std::chrono::milliseconds{50}));
+}
+
 TEST_F(MesaDisplayBufferTest, bypass_buffer_only_referenced_once_by_db)
 {
     graphics::gbm::DisplayBuffer db(
@@ -421,12 +434,14 @@ TEST_F(MesaDisplayBufferTest, clone_mode_first_flip_flips_but_no_wait)
     db.post();
 }
 
-TEST_F(MesaDisplayBufferTest, single_mode_first_post_flips_with_wait)
+TEST_F(MesaDisplayBufferTest, single_mode_first_post_flips_without_waiting)
 {
     EXPECT_CALL(*mock_kms_output, schedule_page_flip_thunk(_))
         .Times(1);
-    EXPECT_CALL(*mock_kms_output, wait_for_page_flip())
+    EXPECT_CALL(*mock_kms_output, on_page_flip_complete(_))
         .Times(1);
+    EXPECT_CALL(*mock_kms_output, wait_for_page_flip())
+        .Times(0);
 
     graphics::gbm::DisplayBuffer db(
         graphics::gbm::BypassOption::allowed,
@@ -512,3 +527,187 @@ TEST_F(MesaDisplayBufferTest, skips_bypass_because_of_incompatible_bypass_buffer
 
     EXPECT_FALSE(db.overlay(list));
 }
+
+TEST_F(MesaDisplayBufferTest, assigns_unobscured_dmabuf_renderable_to_overlay_plane)
+{
+    auto window = std::make_shared<FakeRenderable>(geometry::Rectangle{{100, 100}, {200, 200}});
+    window->set_buffer(mock_bypassable_buffer);
+    graphics::RenderableList list{fake_software_renderable, window};
+
+    EXPECT_CALL(*mock_kms_output, set_overlays(SizeIs(1)))
+        .WillOnce(Return(true));
+
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    db.assign_planes(list);
+
+    EXPECT_THAT(list, ElementsAre(fake_software_renderable));
+}
+
+TEST_F(MesaDisplayBufferTest, renderable_beneath_composited_renderable_is_not_assigned_to_overlay_plane)
+{
+    auto window = std::make_shared<FakeRenderable>(geometry::Rectangle{{100, 100}, {200, 200}});
+    window->set_buffer(mock_bypassable_buffer);
+    auto menu = std::make_shared<FakeRenderable>(geometry::Rectangle{{150, 150}, {20, 20}});
+    graphics::RenderableList list{window, menu};
+
+    EXPECT_CALL(*mock_kms_output, set_overlays(Not(IsEmpty())))
+        .Times(0);
+
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    db.assign_planes(list);
+
+    EXPECT_THAT(list, ElementsAre(window, menu));
+}
+
+TEST_F(MesaDisplayBufferTest, renderable_rejected_by_hardware_is_composited)
+{
+    auto window = std::make_shared<FakeRenderable>(geometry::Rectangle{{100, 100}, {200, 200}});
+    window->set_buffer(mock_bypassable_buffer);
+    graphics::RenderableList list{fake_software_renderable, window};
+
+    ON_CALL(*mock_kms_output, set_overlays(_))
+        .WillByDefault(Return(false));
+
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    db.assign_planes(list);
+
+    EXPECT_THAT(list, ElementsAre(fake_software_renderable, window));
+}
+
+TEST_F(MesaDisplayBufferTest, page_flip_completion_releases_the_replaced_bypass_buffer)
+{
+    std::function<void()> flip_complete;
+    ON_CALL(*mock_kms_output, on_page_flip_complete(_))
+        .WillByDefault(SaveArg<0>(&flip_complete));
+
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    auto const original_count = mock_bypassable_buffer.use_count();
+
+    ASSERT_TRUE(db.overlay(bypassable_list));
+    db.post();
+    ASSERT_TRUE(flip_complete);
+    EXPECT_TRUE(db.frame_pending());
+
+    flip_complete();
+    EXPECT_FALSE(db.frame_pending());
+    EXPECT_EQ(original_count + 1, mock_bypassable_buffer.use_count());
+
+    // Back to compositing; once that's on screen the client buffer can go...
+    db.make_current();
+    db.swap_buffers();
+    db.post();
+    flip_complete();
+    EXPECT_EQ(original_count + 1, mock_bypassable_buffer.use_count());
+
+    // ...but only from the compositor's thread, not the one the flip completed on
+    db.swap_buffers();
+    db.post();
+    EXPECT_EQ(original_count, mock_bypassable_buffer.use_count());
+}
+
+TEST_F(MesaDisplayBufferTest, clone_mode_outputs_flip_independently)
+{
+    auto const other_output = std::make_shared<NiceMock<MockKMSOutput>>();
+    ON_CALL(*other_output, schedule_page_flip_thunk(_))
+        .WillByDefault(Return(true));
+    ON_CALL(*other_output, max_refresh_rate())
+        .WillByDefault(Return(mock_refresh_rate));
+
+    std::function<void()> flip_complete, other_flip_complete;
+    ON_CALL(*mock_kms_output, on_page_flip_complete(_))
+        .WillByDefault(SaveArg<0>(&flip_complete));
+    ON_CALL(*other_output, on_page_flip_complete(_))
+        .WillByDefault(SaveArg<0>(&other_flip_complete));
+
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output, other_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    db.swap_buffers();
+    db.post();
+    ASSERT_TRUE(flip_complete);
+    ASSERT_TRUE(other_flip_complete);
+
+    std::vector<int64_t> presented;
+    db.on_presented([&](graphics::Frame const& frame) { presented.push_back(frame.msc); });
+
+    flip_complete();
+    EXPECT_TRUE(db.frame_pending());
+    EXPECT_THAT(presented, IsEmpty());
+
+    // Only the output still flipping is waited for
+    EXPECT_CALL(*mock_kms_output, wait_for_page_flip())
+        .Times(0);
+    EXPECT_CALL(*other_output, wait_for_page_flip())
+        .Times(1);
+
+    db.swap_buffers();
+    db.post();
+    EXPECT_THAT(presented, SizeIs(1));
+}
+
+TEST_F(MesaDisplayBufferTest, presented_handlers_wait_for_the_flip)
+{
+    std::function<void()> flip_complete;
+    ON_CALL(*mock_kms_output, on_page_flip_complete(_))
+        .WillByDefault(SaveArg<0>(&flip_complete));
+    graphics::Frame flipped;
+    flipped.msc = 42;
+    ON_CALL(*mock_kms_output, last_frame())
+        .WillByDefault(Return(flipped));
+
+    graphics::gbm::DisplayBuffer db(
+        graphics::gbm::BypassOption::allowed,
+        null_display_report(),
+        {mock_kms_output},
+        make_output_surface(),
+        display_area,
+        identity);
+
+    ASSERT_TRUE(db.overlay(bypassable_list));
+    db.post();
+    ASSERT_TRUE(flip_complete);
+
+    std::vector<int64_t> presented;
+    db.on_presented([&](graphics::Frame const& frame) { presented.push_back(frame.msc); });
+    EXPECT_THAT(presented, IsEmpty());
+
+    flip_complete();
+    EXPECT_THAT(presented, ElementsAre(42));
+
+    // Once it's on screen there's nothing to wait for
+    db.on_presented([&](graphics::Frame const& frame) { presented.push_back(frame.msc); });
+    EXPECT_THAT(presented, ElementsAre(42, 42));
+}
@@ -28,6 +28,7 @@
 
 #include <stdexcept>
 #include <atomic>
+#include <future>
 #include <thread>
 #include <unordered_set>
 
@@ -128,6 +129,81 @@ TEST_F(KMSPageFlipperTest, wait_for_flip_handles_drm_event)
     page_flipper.wait_for_flip(crtc_id);
 }
 
+TEST_F(KMSPageFlipperTest, flip_completion_handler_runs_without_waiting_for_flip)
+{
+    using namespace testing;
+
+    uint32_t const crtc_id{10};
+    uint32_t const fb_id{101};
+    uint32_t const connector_id{345};
+    void* user_data{nullptr};
+
+    EXPECT_CALL(mock_drm, drmModePageFlip(drm_fd, crtc_id, fb_id, _, _))
+        .WillOnce(DoAll(SaveArg<4>(&user_data), Return(0)));
+    EXPECT_CALL(mock_drm, drmHandleEvent(drm_fd, _))
+        .WillOnce(DoAll(InvokePageFlipHandler(&user_data), Return(0)));
+
+    std::promise<std::thread::id> flipped;
+    page_flipper.schedule_flip(crtc_id, fb_id, connector_id);
+    page_flipper.on_flip_complete(
+        crtc_id,
+        [&flipped](mg::Frame const&) { flipped.set_value(std::this_thread::get_id()); });
+
+    /* Fake a DRM event */
+    mock_drm.generate_event_on(drm_device);
+
+    auto completion = flipped.get_future();
+    ASSERT_THAT(completion.wait_for(std::chrono::seconds{5}), Eq(std::future_status::ready));
+    EXPECT_THAT(completion.get(), Ne(std::this_thread::get_id()));
+
+    /* Nothing left to wait for */
+    page_flipper.wait_for_flip(crtc_id);
+}
+
+TEST_F(KMSPageFlipperTest, commit_scheduled_with_handler_is_seen_through_in_background)
+{
+    using namespace testing;
+
+    uint32_t const crtc_id{10};
+    uint32_t const connector_id{345};
+    void* user_data{nullptr};
+
+    EXPECT_CALL(mock_drm, drmHandleEvent(drm_fd, _))
+        .WillOnce(DoAll(InvokePageFlipHandler(&user_data), Return(0)));
+
+    std::promise<std::thread::id> flipped;
+    auto const scheduled = page_flipper.schedule_flip(
+        crtc_id,
+        connector_id,
+        [&user_data](void* event_data)
+        {
+            user_data = event_data;
+            return 0;
+        },
+        [&flipped](mg::Frame const&) { flipped.set_value(std::this_thread::get_id()); });
+    ASSERT_TRUE(scheduled);
+
+    /* Fake a DRM event */
+    mock_drm.generate_event_on(drm_device);
+
+    auto completion = flipped.get_future();
+    ASSERT_THAT(completion.wait_for(std::chrono::seconds{5}), Eq(std::future_status::ready));
+    EXPECT_THAT(completion.get(), Ne(std::this_thread::get_id()));
+
+    /* Nothing left to wait for */
+    page_flipper.wait_for_flip(crtc_id);
+}
+
+TEST_F(KMSPageFlipperTest, flip_completion_handler_runs_immediately_without_pending_flip)
+{
+    using namespace testing;
+
+    bool flipped{false};
+    page_flipper.on_flip_complete(10, [&flipped](mg::Frame const&) { flipped = true; });
+
+    EXPECT_TRUE(flipped);
+}
+
 TEST_F(KMSPageFlipperTest, wait_for_flip_reports_vsync)
 {
     using namespace testing;
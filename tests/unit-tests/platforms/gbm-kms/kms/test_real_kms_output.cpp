@@ -17,6 +17,7 @@
  */
 
 #include "src/platforms/gbm-kms/server/kms/real_kms_output.h"
+#include "src/platforms/gbm-kms/server/kms/atomic_kms_output.h"
 #include "src/platforms/gbm-kms/server/kms/page_flipper.h"
 #include "mir/fatal.h"
 
@@ -46,14 +47,38 @@ class NullPageFlipper : public mgg::PageFlipper
 {
 public:
     bool schedule_flip(uint32_t,uint32_t,uint32_t) override { return true; }
+    bool schedule_flip(uint32_t,uint32_t,std::function<int(void*)> const&) override { return true; }
+    bool schedule_flip(
+        uint32_t,uint32_t,std::function<int(void*)> const&,std::function<void(mg::Frame const&)> const&) override
+    {
+        return true;
+    }
     mg::Frame wait_for_flip(uint32_t) override { return {}; }
+    void on_flip_complete(uint32_t, std::function<void(mg::Frame const&)> const& handler) override
+    {
+        handler({});
+    }
 };
 
 class MockPageFlipper : public mgg::PageFlipper
 {
 public:
     MOCK_METHOD3(schedule_flip, bool(uint32_t,uint32_t,uint32_t));
+    bool schedule_flip(uint32_t crtc_id, uint32_t connector_id, std::function<int(void*)> const& commit) override
+    {
+        return schedule_commit(crtc_id, connector_id, commit);
+    }
+    bool schedule_flip(
+        uint32_t crtc_id,
+        uint32_t connector_id,
+        std::function<int(void*)> const& commit,
+        std::function<void(mg::Frame const&)> const&) override
+    {
+        return schedule_commit(crtc_id, connector_id, commit);
+    }
+    MOCK_METHOD3(schedule_commit, bool(uint32_t,uint32_t,std::function<int(void*)> const&));
     MOCK_METHOD1(wait_for_flip, mg::Frame(uint32_t));
+    MOCK_METHOD2(on_flip_complete, void(uint32_t, std::function<void(mg::Frame const&)> const&));
 };
 
 class RealKMSOutputTest : public ::testing::Test
@@ -218,6 +243,49 @@ TEST_F(RealKMSOutputTest, operations_use_existing_crtc)
     output.wait_for_page_flip();
 }
 
+TEST_F(RealKMSOutputTest, atomic_output_falls_back_to_legacy_api_without_planes)
+{
+    using namespace testing;
+
+    setup_outputs_connected_crtc();
+
+    uint32_t const fb_id{42};
+    append_fb_id(fb_id);
+
+    ON_CALL(mock_drm, drmModeGetPlaneResources(_))
+        .WillByDefault(Return(nullptr));
+
+    EXPECT_CALL(mock_page_flipper, schedule_commit(_, _, _))
+        .Times(0);
+
+    {
+        InSequence s;
+
+        EXPECT_CALL(mock_drm, drmModeSetCrtc(_, crtc_ids[0], fb_id, _, _,
+                                             Pointee(connector_ids[0]), _, _))
+            .Times(1);
+
+        EXPECT_CALL(mock_page_flipper, schedule_flip(crtc_ids[0], fb_id,
+                                                     connector_ids[0]))
+            .Times(1)
+            .WillOnce(Return(true));
+
+        EXPECT_CALL(mock_page_flipper, wait_for_flip(crtc_ids[0]))
+            .Times(1);
+    }
+
+    mgg::AtomicKMSOutput output{
+        drm_fd,
+        mg::kms::get_connector(drm_fd, connector_ids[0]),
+        mt::fake_shared(mock_page_flipper)};
+
+    auto fb = output.fb_for(fake_bo);
+
+    EXPECT_TRUE(output.set_crtc(*fb));
+    EXPECT_TRUE(output.schedule_page_flip(*fb));
+    output.wait_for_page_flip();
+}
+
 TEST_F(RealKMSOutputTest, operations_use_possible_crtc)
 {
     using namespace testing;
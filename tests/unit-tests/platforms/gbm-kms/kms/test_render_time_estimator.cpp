@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/gbm-kms/server/kms/render_time_estimator.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+namespace mgg = mir::graphics::gbm;
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+struct RenderTimeEstimatorTest : Test
+{
+    std::chrono::milliseconds const fallback{50ms};
+    mgg::RenderTimeEstimator estimator{fallback};
+};
+}
+
+TEST_F(RenderTimeEstimatorTest, predicts_fallback_before_any_frames)
+{
+    EXPECT_THAT(estimator.predicted_render_time(), Eq(fallback));
+}
+
+TEST_F(RenderTimeEstimatorTest, predicts_fallback_after_too_few_frames)
+{
+    estimator.record(2ms);
+    estimator.record(2ms);
+
+    EXPECT_THAT(estimator.predicted_render_time(), Eq(fallback));
+}
+
+TEST_F(RenderTimeEstimatorTest, prediction_follows_measured_render_times)
+{
+    for (int frame = 0; frame < 60; ++frame)
+        estimator.record(3ms);
+
+    EXPECT_THAT(estimator.predicted_render_time(), Gt(3ms));
+    EXPECT_THAT(estimator.predicted_render_time(), Lt(6ms));
+}
+
+TEST_F(RenderTimeEstimatorTest, prediction_rounds_partial_milliseconds_up)
+{
+    for (int frame = 0; frame < 60; ++frame)
+        estimator.record(3100us);
+
+    EXPECT_THAT(estimator.predicted_render_time(), Ge(4ms));
+}
+
+TEST_F(RenderTimeEstimatorTest, prediction_ignores_rare_slow_frames)
+{
+    for (int frame = 0; frame < 100; ++frame)
+        estimator.record(frame % 50 ? 2ms : 40ms);
+
+    EXPECT_THAT(estimator.predicted_render_time(), Lt(10ms));
+}
+
+TEST_F(RenderTimeEstimatorTest, prediction_covers_frequently_slow_frames)
+{
+    for (int frame = 0; frame < 100; ++frame)
+        estimator.record(frame % 4 ? 2ms : 12ms);
+
+    EXPECT_THAT(estimator.predicted_render_time(), Ge(12ms));
+}
+
+TEST_F(RenderTimeEstimatorTest, old_frames_are_forgotten)
+{
+    for (int frame = 0; frame < 200; ++frame)
+        estimator.record(20ms);
+    for (int frame = 0; frame < 200; ++frame)
+        estimator.record(2ms);
+
+    EXPECT_THAT(estimator.predicted_render_time(), Lt(5ms));
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/platforms/gbm-kms/server/kms/render_timer.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <future>
+#include <thread>
+
+namespace mgg = mir::graphics::gbm;
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+auto const fallback = 50ms;
+// Enough frames for the estimator to trust its measurements
+int const enough_frames = 20;
+
+/// Waits until \a predicted_render_time meets \a matcher, or gives up after a while
+template<typename Matcher>
+auto eventually(mgg::RenderTimer const& timer, Matcher const& matcher) -> std::chrono::milliseconds
+{
+    auto const give_up = std::chrono::steady_clock::now() + 10s;
+    auto predicted = timer.predicted_render_time();
+    while (!Matches(matcher)(predicted) && std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(1ms);
+        predicted = timer.predicted_render_time();
+    }
+    return predicted;
+}
+}
+
+TEST(RenderTimer, predicts_fallback_before_any_frames)
+{
+    mgg::RenderTimer timer{fallback};
+
+    EXPECT_THAT(timer.predicted_render_time(), Eq(fallback));
+}
+
+TEST(RenderTimer, measures_frames_from_start_to_fence)
+{
+    mgg::RenderTimer timer{fallback};
+
+    for (int frame = 0; frame != enough_frames; ++frame)
+    {
+        timer.time(std::chrono::steady_clock::now() - 3ms, [](auto) { return true; });
+    }
+
+    auto const predicted = eventually(timer, Lt(fallback));
+    EXPECT_THAT(predicted, Ge(3ms));
+    EXPECT_THAT(predicted, Lt(fallback));
+}
+
+TEST(RenderTimer, does_not_wait_for_the_gpu)
+{
+    mgg::RenderTimer timer{fallback};
+    std::promise<void> gpu_finished;
+    auto const finished = gpu_finished.get_future().share();
+
+    auto const before = std::chrono::steady_clock::now();
+    timer.time(
+        before,
+        [finished](std::chrono::nanoseconds timeout)
+        {
+            return finished.wait_for(timeout) == std::future_status::ready;
+        });
+
+    EXPECT_THAT(std::chrono::steady_clock::now() - before, Lt(50ms));
+    gpu_finished.set_value();
+}
+
+TEST(RenderTimer, frames_that_time_out_count_as_slow)
+{
+    mgg::RenderTimer timer{fallback};
+
+    // The fence never signals, however long it's given
+    for (int frame = 0; frame != enough_frames; ++frame)
+    {
+        timer.time(std::chrono::steady_clock::now(), [](auto) { return false; });
+    }
+
+    EXPECT_THAT(eventually(timer, Ne(fallback)), Ge(100ms));
+}
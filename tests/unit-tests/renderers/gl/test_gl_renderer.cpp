@@ -31,6 +31,8 @@
 #include <src/renderers/gl/renderer.h>
 #include <mir/test/doubles/stub_gl_display_buffer.h>
 #include <mir/test/doubles/mock_gl_display_buffer.h>
+#include <mir/test/doubles/stub_buffer.h>
+#include <mir/graphics/buffer_properties.h>
 
 using testing::SetArgPointee;
 using testing::InSequence;
@@ -40,6 +42,9 @@ using testing::Pointee;
 using testing::AnyNumber;
 using testing::AtLeast;
 using testing::DoAll;
+using testing::Eq;
+using testing::Gt;
+using testing::Lt;
 using testing::_;
 
 namespace mt=mir::test;
@@ -183,6 +188,18 @@ TEST_F(GLRenderer, enables_blending_for_rgba_surfaces)
     renderer.render(renderable_list);
 }
 
+TEST_F(GLRenderer, disables_blending_for_opaque_region_of_rgba_surfaces)
+{
+    EXPECT_CALL(*renderable, shaped()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*renderable, opaque_region())
+        .WillRepeatedly(Return(mir::geometry::Rectangles{{{1,3},{3,2}}}));
+    EXPECT_CALL(mock_gl, glDisable(GL_BLEND));
+    EXPECT_CALL(mock_gl, glEnable(GL_BLEND));
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderable_list);
+}
+
 TEST_F(GLRenderer, enables_blending_for_rgbx_translucent_surfaces)
 {
     EXPECT_CALL(*renderable, alpha()).WillRepeatedly(Return(0.5f));
@@ -466,3 +483,286 @@ TEST_F(GLRenderer, sets_viewport_downscaled_wide)
 
     mrg::Renderer renderer(mock_display_buffer);
 }
+
+TEST_F(GLRenderer, draws_only_visible_region_of_partly_hidden_surfaces)
+{
+    EXPECT_CALL(mock_gl, glEnable(GL_SCISSOR_TEST));
+    EXPECT_CALL(mock_gl, glScissor(_, _, 3, 1));
+    EXPECT_CALL(mock_gl, glDisable(GL_SCISSOR_TEST));
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.set_visible_regions({{&renderable, mir::geometry::Rectangles{{{1,2},{3,1}}}}});
+    renderer.render(renderable_list);
+}
+
+namespace
+{
+struct GLRendererBatching : GLRenderer
+{
+    auto add_renderable(mir::geometry::Rectangle const& position, bool shaped)
+    {
+        auto const r = std::make_shared<testing::NiceMock<mtd::MockRenderable>>();
+        ON_CALL(*r, id()).WillByDefault(Return(r.get()));
+        ON_CALL(*r, buffer()).WillByDefault(Return(mock_buffer));
+        ON_CALL(*r, shaped()).WillByDefault(Return(shaped));
+        ON_CALL(*r, alpha()).WillByDefault(Return(1.0f));
+        ON_CALL(*r, transformation()).WillByDefault(Return(trans));
+        ON_CALL(*r, screen_position()).WillByDefault(Return(position));
+        renderables.push_back(r);
+        return r;
+    }
+
+    mg::RenderableList renderables;
+};
+}
+
+TEST_F(GLRendererBatching, uploads_vertices_once_per_frame)
+{
+    add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{20, 0}, {10, 10}}, false);
+    add_renderable({{40, 0}, {10, 10}}, true);
+
+    EXPECT_CALL(mock_gl, glBufferData(GL_ARRAY_BUFFER, _, _, GL_STREAM_DRAW)).Times(1);
+    EXPECT_CALL(mock_gl, glDrawArrays(_, _, _)).Times(3);
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererBatching, groups_separate_renderables_by_blend_state)
+{
+    add_renderable({{0, 0}, {10, 10}}, true);
+    add_renderable({{20, 0}, {10, 10}}, false);
+    add_renderable({{40, 0}, {10, 10}}, true);
+
+    EXPECT_CALL(mock_gl, glEnable(GL_BLEND)).Times(1);
+    EXPECT_CALL(mock_gl, glDisable(GL_BLEND)).Times(1);
+    EXPECT_CALL(mock_gl, glBlendFuncSeparate(_, _, _, _)).Times(1);
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererBatching, keeps_overlapping_renderables_in_order)
+{
+    add_renderable({{0, 0}, {10, 10}}, true);
+    add_renderable({{5, 5}, {10, 10}}, false);
+    add_renderable({{10, 10}, {10, 10}}, true);
+
+    InSequence seq;
+    EXPECT_CALL(mock_gl, glEnable(GL_BLEND));
+    EXPECT_CALL(mock_gl, glDisable(GL_BLEND));
+    EXPECT_CALL(mock_gl, glEnable(GL_BLEND));
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererBatching, skips_redundant_state_changes_between_renderables)
+{
+    mir::geometry::Rectangle const clip{{0, 0}, {50, 10}};
+    for (auto const x : {0, 20})
+    {
+        auto const r = add_renderable({{x, 0}, {10, 10}}, false);
+        ON_CALL(*r, clip_area())
+            .WillByDefault(Return(std::experimental::optional<mir::geometry::Rectangle>{clip}));
+    }
+
+    EXPECT_CALL(mock_gl, glUseProgram(_)).Times(1);
+    EXPECT_CALL(mock_gl, glEnable(GL_SCISSOR_TEST)).Times(1);
+    EXPECT_CALL(mock_gl, glScissor(_, _, _, _)).Times(1);
+    EXPECT_CALL(mock_gl, glDisable(GL_SCISSOR_TEST)).Times(1);
+    EXPECT_CALL(mock_gl, glUniformMatrix4fv(transform_uniform_location, _, _, _)).Times(1);
+    EXPECT_CALL(mock_gl, glDrawArrays(_, _, _)).Times(2);
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererBatching, counts_state_changes_per_frame)
+{
+    add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{20, 0}, {10, 10}}, true);
+
+    mrg::Renderer renderer(display_buffer);
+
+    renderer.render(renderables);
+    auto const first = renderer.state_changes();
+    EXPECT_THAT(first.made, Gt(0u));
+    EXPECT_THAT(first.skipped, Gt(0u));
+
+    // Uniforms belong to the programs, so they're still set for the next frame
+    renderer.render(renderables);
+    auto const second = renderer.state_changes();
+    EXPECT_THAT(second.made, Lt(first.made));
+    EXPECT_THAT(second.made + second.skipped, Eq(first.made + first.skipped));
+}
+
+TEST_F(GLRendererBatching, draws_small_software_buffers_together_from_the_texture_atlas)
+{
+    ON_CALL(mock_gl, glGetIntegerv(GL_MAX_TEXTURE_SIZE, _))
+        .WillByDefault(SetArgPointee<1>(4096));
+    for (auto const x : {0, 20, 40})
+    {
+        auto const r = add_renderable({{x, 0}, {10, 10}}, false);
+        ON_CALL(*r, transformation()).WillByDefault(Return(glm::mat4(1)));
+        ON_CALL(*r, buffer()).WillByDefault(Return(std::make_shared<mtd::StubBuffer>(
+            mg::BufferProperties{{10, 10}, mir_pixel_format_abgr_8888, mg::BufferUsage::software})));
+    }
+
+    EXPECT_CALL(mock_gl, glTexSubImage2D(GL_TEXTURE_2D, 0, _, _, 10, 10, GL_RGBA, GL_UNSIGNED_BYTE, _)).Times(3);
+    EXPECT_CALL(mock_gl, glDrawArrays(GL_TRIANGLES, _, 18)).Times(1);
+    EXPECT_CALL(mock_gl, glDrawArrays(GL_TRIANGLE_STRIP, _, _)).Times(0);
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+namespace
+{
+struct GLRendererFrontToBack : GLRendererBatching
+{
+    GLRendererFrontToBack()
+    {
+        ON_CALL(mock_gl, glGetIntegerv(GL_STENCIL_BITS, _))
+            .WillByDefault(SetArgPointee<1>(8));
+        EXPECT_CALL(mock_gl, glEnable(GL_BLEND)).Times(AnyNumber());
+        EXPECT_CALL(mock_gl, glDisable(GL_BLEND)).Times(AnyNumber());
+    }
+};
+}
+
+TEST_F(GLRendererFrontToBack, draws_opaque_renderables_nearest_first)
+{
+    add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{5, 5}, {10, 10}}, false);
+
+    InSequence seq;
+    EXPECT_CALL(mock_gl, glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
+    EXPECT_CALL(mock_gl, glEnable(GL_STENCIL_TEST));
+    EXPECT_CALL(mock_gl, glStencilFunc(GL_GREATER, 2, _));
+    EXPECT_CALL(mock_gl, glStencilFunc(GL_GREATER, 1, _));
+    EXPECT_CALL(mock_gl, glDisable(GL_STENCIL_TEST));
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererFrontToBack, draws_translucent_renderables_after_opaque_ones)
+{
+    add_renderable({{0, 0}, {10, 10}}, true);
+    add_renderable({{5, 5}, {10, 10}}, false);
+
+    InSequence seq;
+    EXPECT_CALL(mock_gl, glStencilFunc(GL_GREATER, 2, _));
+    EXPECT_CALL(mock_gl, glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE));
+    EXPECT_CALL(mock_gl, glStencilFunc(GL_GREATER, 1, _));
+    EXPECT_CALL(mock_gl, glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP));
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererBatching, draws_back_to_front_without_a_stencil_buffer)
+{
+    add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{5, 5}, {10, 10}}, false);
+
+    EXPECT_CALL(mock_gl, glClear(GL_COLOR_BUFFER_BIT));
+    EXPECT_CALL(mock_gl, glEnable(GL_STENCIL_TEST)).Times(0);
+    EXPECT_CALL(mock_gl, glStencilFunc(_, _, _)).Times(0);
+
+    mrg::Renderer renderer(display_buffer);
+    renderer.render(renderables);
+}
+
+namespace
+{
+struct GLRendererRetainedLayer : GLRendererBatching
+{
+    GLRendererRetainedLayer()
+    {
+        // The layer is only used when the viewport maps 1:1 onto the buffer
+        auto const view_size = display_buffer.view_area().size;
+        ON_CALL(mock_egl, eglQuerySurface(_,_,EGL_WIDTH,_))
+            .WillByDefault(DoAll(SetArgPointee<3>(view_size.width.as_int()), Return(EGL_TRUE)));
+        ON_CALL(mock_egl, eglQuerySurface(_,_,EGL_HEIGHT,_))
+            .WillByDefault(DoAll(SetArgPointee<3>(view_size.height.as_int()), Return(EGL_TRUE)));
+        ON_CALL(mock_gl, glGenFramebuffers(1, _))
+            .WillByDefault(SetArgPointee<1>(layer_framebuffer));
+    }
+
+    // Render until anything unchanged so far would be retained
+    void render_unchanging_frames(mrg::Renderer& renderer)
+    {
+        for (auto i = 0u; i != mrg::RetainedLayer::frames_to_retain; ++i)
+            renderer.render(renderables);
+    }
+
+    GLuint const layer_framebuffer{7};
+};
+}
+
+TEST_F(GLRendererRetainedLayer, draws_unchanging_renderables_from_one_texture)
+{
+    add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{5, 5}, {10, 10}}, true);
+
+    mrg::Renderer renderer(display_buffer);
+    render_unchanging_frames(renderer);
+
+    EXPECT_CALL(mock_gl, glBindFramebuffer(GL_FRAMEBUFFER, layer_framebuffer)).Times(1);
+    renderer.render(renderables);
+    testing::Mock::VerifyAndClearExpectations(&mock_gl);
+
+    EXPECT_CALL(mock_gl, glBindFramebuffer(GL_FRAMEBUFFER, layer_framebuffer)).Times(0);
+    EXPECT_CALL(mock_gl, glDrawArrays(_, _, _)).Times(1);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererRetainedLayer, draws_changing_renderables_over_the_layer)
+{
+    add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{5, 5}, {10, 10}}, true);
+    auto const moving = add_renderable({{0, 0}, {2, 2}}, true);
+
+    mrg::Renderer renderer(display_buffer);
+    auto x = 0;
+    auto const move = [&]
+        {
+            ++x;
+            ON_CALL(*moving, screen_position())
+                .WillByDefault(Return(mir::geometry::Rectangle{{x, 0}, {2, 2}}));
+        };
+    for (auto i = 0u; i != mrg::RetainedLayer::frames_to_retain + 1; ++i)
+    {
+        move();
+        renderer.render(renderables);
+    }
+    testing::Mock::VerifyAndClearExpectations(&mock_gl);
+
+    move();
+    EXPECT_CALL(mock_gl, glBindFramebuffer(GL_FRAMEBUFFER, layer_framebuffer)).Times(0);
+    EXPECT_CALL(mock_gl, glDrawArrays(_, _, _)).Times(2);
+    renderer.render(renderables);
+}
+
+TEST_F(GLRendererRetainedLayer, stops_using_the_layer_when_a_member_changes)
+{
+    auto const bottom = add_renderable({{0, 0}, {10, 10}}, false);
+    add_renderable({{5, 5}, {10, 10}}, true);
+
+    mrg::Renderer renderer(display_buffer);
+    render_unchanging_frames(renderer);
+    renderer.render(renderables);
+    testing::Mock::VerifyAndClearExpectations(&mock_gl);
+
+    auto const new_buffer = std::make_shared<testing::NiceMock<mtd::MockGLBuffer>>();
+    ON_CALL(*new_buffer, id()).WillByDefault(Return(mir::graphics::BufferID(790)));
+    ON_CALL(*new_buffer, size()).WillByDefault(Return(mir::geometry::Size{10, 10}));
+    ON_CALL(*bottom, buffer()).WillByDefault(Return(new_buffer));
+
+    EXPECT_CALL(mock_gl, glBindFramebuffer(GL_FRAMEBUFFER, layer_framebuffer)).Times(0);
+    EXPECT_CALL(mock_gl, glDrawArrays(_, _, _)).Times(2);
+    renderer.render(renderables);
+}
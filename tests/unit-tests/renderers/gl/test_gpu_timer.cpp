@@ -0,0 +1,324 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <src/renderers/gl/gpu_timer.h>
+#include <mir/test/doubles/mock_gl.h>
+#include <mir/test/doubles/mock_egl.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono_literals;
+using testing::_;
+using testing::Eq;
+using testing::Return;
+using testing::SetArgPointee;
+using testing::StrEq;
+
+namespace mg = mir::graphics;
+namespace mtd = mir::test::doubles;
+namespace mrg = mir::renderer::gl;
+
+namespace
+{
+// The fake GPU: queries record its clock when they're issued
+GLuint64 gpu_clock{0};
+bool results_available{true};
+GLuint next_query{1};
+std::unordered_map<GLuint, GLuint64> timestamps;
+
+void fake_gen_queries(GLsizei n, GLuint* ids)
+{
+    for (auto i = 0; i != n; ++i)
+        ids[i] = next_query++;
+}
+
+void fake_delete_queries(GLsizei, GLuint const*)
+{
+}
+
+void fake_get_query(GLenum, GLenum pname, GLint* params)
+{
+    if (pname == GL_QUERY_COUNTER_BITS_EXT)
+        *params = 64;
+}
+
+void fake_query_counter(GLuint id, GLenum)
+{
+    timestamps[id] = gpu_clock;
+}
+
+void fake_get_query_object_int(GLuint, GLenum pname, GLint* params)
+{
+    if (pname == GL_QUERY_RESULT_AVAILABLE_EXT)
+        *params = results_available ? GL_TRUE : GL_FALSE;
+}
+
+void fake_get_query_object_uint64(GLuint id, GLenum, GLuint64* params)
+{
+    *params = timestamps[id];
+}
+
+template<typename Function>
+auto as_proc(Function function)
+{
+    return reinterpret_cast<mtd::MockEGL::generic_function_pointer_t>(function);
+}
+
+struct GPUTimer : testing::Test
+{
+    GPUTimer()
+    {
+        gpu_clock = 1000;
+        results_available = true;
+        timestamps.clear();
+
+        ON_CALL(mock_gl, glGetString(GL_EXTENSIONS))
+            .WillByDefault(Return(reinterpret_cast<GLubyte const*>("GL_EXT_disjoint_timer_query")));
+
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glGenQueriesEXT")))
+            .WillByDefault(Return(as_proc(&fake_gen_queries)));
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glDeleteQueriesEXT")))
+            .WillByDefault(Return(as_proc(&fake_delete_queries)));
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glGetQueryivEXT")))
+            .WillByDefault(Return(as_proc(&fake_get_query)));
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glQueryCounterEXT")))
+            .WillByDefault(Return(as_proc(&fake_query_counter)));
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glGetQueryObjectivEXT")))
+            .WillByDefault(Return(as_proc(&fake_get_query_object_int)));
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glGetQueryObjectui64vEXT")))
+            .WillByDefault(Return(as_proc(&fake_get_query_object_uint64)));
+    }
+
+    /// A frame that keeps the GPU busy for render_time
+    void render_frame(mrg::GPUTimer& timer, GLuint64 render_time)
+    {
+        timer.begin_frame();
+        gpu_clock += render_time;
+        timer.end_frame();
+    }
+
+    std::vector<mir::renderer::Renderer::GPUFrameTiming> collect(mrg::GPUTimer& timer)
+    {
+        std::vector<mir::renderer::Renderer::GPUFrameTiming> timings;
+        timer.collect(timings);
+        return timings;
+    }
+
+    /// Fences are waited for on another thread, so their results turn up in their own time
+    std::vector<mir::renderer::Renderer::GPUFrameTiming> collect_within(
+        mrg::GPUTimer& timer, std::chrono::seconds timeout)
+    {
+        auto const deadline = std::chrono::steady_clock::now() + timeout;
+        std::vector<mir::renderer::Renderer::GPUFrameTiming> timings;
+        while (timings.empty() && std::chrono::steady_clock::now() < deadline)
+        {
+            timer.collect(timings);
+            std::this_thread::sleep_for(1ms);
+        }
+        return timings;
+    }
+
+    void use_fences()
+    {
+        ON_CALL(mock_gl, glGetString(GL_EXTENSIONS))
+            .WillByDefault(Return(reinterpret_cast<GLubyte const*>("")));
+        ON_CALL(mock_egl, eglQueryString(_, EGL_EXTENSIONS))
+            .WillByDefault(Return("EGL_KHR_fence_sync"));
+    }
+
+    testing::NiceMock<mtd::MockGL> mock_gl;
+    testing::NiceMock<mtd::MockEGL> mock_egl;
+};
+}
+
+TEST_F(GPUTimer, reports_how_long_the_gpu_took_over_a_frame)
+{
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+    ASSERT_TRUE(timer.available());
+
+    render_frame(timer, 3000);
+
+    auto const timings = collect(timer);
+    ASSERT_THAT(timings.size(), Eq(1u));
+    EXPECT_THAT(timings[0].render_time, Eq(3000ns));
+    EXPECT_TRUE(timings[0].renderables.empty());
+}
+
+TEST_F(GPUTimer, reports_the_gap_between_consecutive_frames)
+{
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    render_frame(timer, 3000);
+    gpu_clock += 500;
+    render_frame(timer, 2000);
+
+    auto const timings = collect(timer);
+    ASSERT_THAT(timings.size(), Eq(2u));
+    EXPECT_FALSE(timings[0].idle_before);
+    ASSERT_TRUE(timings[1].idle_before);
+    EXPECT_THAT(timings[1].idle_before.value(), Eq(500ns));
+}
+
+TEST_F(GPUTimer, waits_for_the_gpu_to_finish_a_frame)
+{
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    results_available = false;
+    render_frame(timer, 3000);
+    EXPECT_TRUE(collect(timer).empty());
+
+    results_available = true;
+    EXPECT_THAT(collect(timer).size(), Eq(1u));
+}
+
+TEST_F(GPUTimer, doesnt_time_frames_while_too_many_are_awaited)
+{
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    results_available = false;
+    for (auto i = 0; i != 10; ++i)
+    {
+        collect(timer);
+        render_frame(timer, 1000);
+    }
+
+    results_available = true;
+    EXPECT_THAT(collect(timer).size(), testing::Lt(10u));
+}
+
+TEST_F(GPUTimer, discards_timestamps_after_a_disjoint_operation)
+{
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    render_frame(timer, 3000);
+
+    EXPECT_CALL(mock_gl, glGetIntegerv(GL_GPU_DISJOINT_EXT, _))
+        .WillOnce(SetArgPointee<1>(GL_TRUE));
+
+    EXPECT_TRUE(collect(timer).empty());
+}
+
+TEST_F(GPUTimer, times_renderables_in_sampled_frames)
+{
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::renderables};
+    int a, b;
+
+    for (auto frame = 1u; frame != mrg::GPUTimer::sample_interval; ++frame)
+    {
+        timer.begin_frame();
+        EXPECT_FALSE(timer.sampling());
+        timer.end_frame();
+    }
+    collect(timer);
+
+    timer.begin_frame();
+    ASSERT_TRUE(timer.sampling());
+    gpu_clock += 100;
+    timer.begin_renderables();
+    gpu_clock += 700;
+    timer.end_renderable(&a);
+    gpu_clock += 200;
+    timer.end_renderable(&b);
+    timer.end_frame();
+
+    auto const timings = collect(timer);
+    ASSERT_THAT(timings.size(), Eq(1u));
+    EXPECT_THAT(timings[0].render_time, Eq(1000ns));
+    ASSERT_THAT(timings[0].renderables.size(), Eq(2u));
+    EXPECT_THAT(timings[0].renderables[0].first, Eq(&a));
+    EXPECT_THAT(timings[0].renderables[0].second, Eq(700ns));
+    EXPECT_THAT(timings[0].renderables[1].first, Eq(&b));
+    EXPECT_THAT(timings[0].renderables[1].second, Eq(200ns));
+}
+
+TEST_F(GPUTimer, falls_back_to_fences_without_timer_queries)
+{
+    use_fences();
+
+    auto const fence = reinterpret_cast<EGLSyncKHR>(0x5);
+    EXPECT_CALL(mock_egl, eglCreateSyncKHR(_, EGL_SYNC_FENCE_KHR, _))
+        .WillOnce(Return(fence));
+    EXPECT_CALL(mock_egl, eglClientWaitSyncKHR(_, fence, _, _))
+        .WillOnce(Return(EGL_TIMEOUT_EXPIRED_KHR))
+        .WillOnce(Return(EGL_CONDITION_SATISFIED_KHR));
+    EXPECT_CALL(mock_egl, eglDestroySyncKHR(_, fence));
+
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::renderables};
+    ASSERT_TRUE(timer.available());
+
+    timer.begin_frame();
+    EXPECT_FALSE(timer.sampling());
+    timer.end_frame();
+
+    auto const timings = collect_within(timer, 10s);
+    ASSERT_THAT(timings.size(), Eq(1u));
+    EXPECT_FALSE(timings[0].idle_before);
+}
+
+TEST_F(GPUTimer, times_fences_when_they_signal_rather_than_when_collected)
+{
+    use_fences();
+
+    auto const fence = reinterpret_cast<EGLSyncKHR>(0x5);
+    ON_CALL(mock_egl, eglCreateSyncKHR(_, EGL_SYNC_FENCE_KHR, _))
+        .WillByDefault(Return(fence));
+    ON_CALL(mock_egl, eglClientWaitSyncKHR(_, fence, _, _))
+        .WillByDefault(Return(EGL_CONDITION_SATISFIED_KHR));
+
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    timer.begin_frame();
+    timer.end_frame();
+
+    auto const delay = 500ms;
+    std::this_thread::sleep_for(delay);
+
+    auto const timings = collect_within(timer, 10s);
+    ASSERT_THAT(timings.size(), Eq(1u));
+    EXPECT_THAT(timings[0].render_time, testing::Lt(delay));
+}
+
+TEST_F(GPUTimer, destroys_fences_still_awaited_when_destroyed)
+{
+    use_fences();
+
+    auto const fence = reinterpret_cast<EGLSyncKHR>(0x5);
+    ON_CALL(mock_egl, eglCreateSyncKHR(_, EGL_SYNC_FENCE_KHR, _))
+        .WillByDefault(Return(fence));
+    ON_CALL(mock_egl, eglClientWaitSyncKHR(_, fence, _, _))
+        .WillByDefault(Return(EGL_TIMEOUT_EXPIRED_KHR));
+    EXPECT_CALL(mock_egl, eglDestroySyncKHR(_, fence));
+
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    timer.begin_frame();
+    timer.end_frame();
+}
+
+TEST_F(GPUTimer, is_unavailable_without_timer_queries_or_fences)
+{
+    ON_CALL(mock_gl, glGetString(GL_EXTENSIONS))
+        .WillByDefault(Return(reinterpret_cast<GLubyte const*>("")));
+
+    mrg::GPUTimer timer{mrg::GPUTimer::Mode::frames};
+
+    EXPECT_FALSE(timer.available());
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <src/renderers/gl/program_binary_cache.h>
+#include <mir/test/doubles/mock_gl.h>
+#include <mir/test/doubles/mock_egl.h>
+
+#include <GLES2/gl2ext.h>
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using testing::_;
+using testing::Eq;
+using testing::Return;
+using testing::SetArgPointee;
+using testing::StrEq;
+
+namespace mtd = mir::test::doubles;
+namespace mrg = mir::renderer::gl;
+
+namespace
+{
+GLchar const* const vshader_src = "vertex shader";
+GLchar const* const fshader_src = "fragment shader";
+GLuint const linked_program = 3;
+GLuint const loaded_program = 4;
+GLenum const binary_format = 0x1234;
+std::string const binary_data{"program binary"};
+
+// What the fake entry points were last given
+std::vector<char> loaded_binary;
+GLenum loaded_format{GL_NONE};
+
+void fake_get_program_binary(
+    GLuint, GLsizei buf_size, GLsizei* length, GLenum* format, void* binary)
+{
+    auto const size = std::min<GLsizei>(buf_size, binary_data.size());
+    std::memcpy(binary, binary_data.data(), size);
+    *length = size;
+    *format = binary_format;
+}
+
+void fake_program_binary(GLuint, GLenum format, void const* binary, GLint length)
+{
+    auto const bytes = static_cast<char const*>(binary);
+    loaded_binary.assign(bytes, bytes + length);
+    loaded_format = format;
+}
+
+struct ProgramBinaryCache : testing::Test
+{
+    ProgramBinaryCache()
+    {
+        auto const name = (boost::filesystem::temp_directory_path() / "mir-program-binaries-XXXXXX").string();
+        std::vector<char> tmp_name(name.begin(), name.end());
+        tmp_name.push_back('\0');
+        if (mkdtemp(tmp_name.data()) == nullptr)
+            throw std::system_error{errno, std::system_category(), "Failed to create temporary directory"};
+        cache_dir = tmp_name.data();
+
+        loaded_binary.clear();
+        loaded_format = GL_NONE;
+
+        ON_CALL(mock_gl, glGetString(GL_EXTENSIONS))
+            .WillByDefault(Return(reinterpret_cast<GLubyte const*>("GL_OES_get_program_binary")));
+        ON_CALL(mock_gl, glGetString(GL_RENDERER))
+            .WillByDefault(Return(reinterpret_cast<GLubyte const*>("Stub renderer")));
+        ON_CALL(mock_gl, glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, _))
+            .WillByDefault(SetArgPointee<1>(1));
+        ON_CALL(mock_gl, glGetProgramiv(_, GL_PROGRAM_BINARY_LENGTH_OES, _))
+            .WillByDefault(SetArgPointee<2>(static_cast<GLint>(binary_data.size())));
+        ON_CALL(mock_gl, glGetProgramiv(_, GL_LINK_STATUS, _))
+            .WillByDefault(SetArgPointee<2>(GL_TRUE));
+        ON_CALL(mock_gl, glCreateProgram())
+            .WillByDefault(Return(loaded_program));
+
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glGetProgramBinaryOES")))
+            .WillByDefault(Return(reinterpret_cast<mtd::MockEGL::generic_function_pointer_t>(&fake_get_program_binary)));
+        ON_CALL(mock_egl, eglGetProcAddress(StrEq("glProgramBinaryOES")))
+            .WillByDefault(Return(reinterpret_cast<mtd::MockEGL::generic_function_pointer_t>(&fake_program_binary)));
+    }
+
+    ~ProgramBinaryCache()
+    {
+        boost::system::error_code ignored;
+        boost::filesystem::remove_all(cache_dir, ignored);
+    }
+
+    testing::NiceMock<mtd::MockGL> mock_gl;
+    testing::NiceMock<mtd::MockEGL> mock_egl;
+    std::string cache_dir;
+};
+}
+
+TEST_F(ProgramBinaryCache, misses_without_a_stored_binary)
+{
+    mrg::ProgramBinaryCache cache{cache_dir};
+
+    EXPECT_CALL(mock_gl, glCreateProgram()).Times(0);
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(0u));
+}
+
+TEST_F(ProgramBinaryCache, creates_programs_from_stored_binaries)
+{
+    mrg::ProgramBinaryCache cache{cache_dir};
+    cache.store(vshader_src, fshader_src, linked_program);
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(loaded_program));
+    EXPECT_THAT(std::string(loaded_binary.begin(), loaded_binary.end()), Eq(binary_data));
+    EXPECT_THAT(loaded_format, Eq(binary_format));
+}
+
+TEST_F(ProgramBinaryCache, reuses_binaries_stored_by_a_previous_cache)
+{
+    mrg::ProgramBinaryCache{cache_dir}.store(vshader_src, fshader_src, linked_program);
+
+    mrg::ProgramBinaryCache cache{cache_dir};
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(loaded_program));
+    EXPECT_THAT(std::string(loaded_binary.begin(), loaded_binary.end()), Eq(binary_data));
+}
+
+TEST_F(ProgramBinaryCache, misses_for_other_shader_sources)
+{
+    mrg::ProgramBinaryCache cache{cache_dir};
+    cache.store(vshader_src, fshader_src, linked_program);
+
+    EXPECT_THAT(cache.load(vshader_src, "another fragment shader"), Eq(0u));
+}
+
+TEST_F(ProgramBinaryCache, misses_for_binaries_stored_by_another_driver)
+{
+    mrg::ProgramBinaryCache{cache_dir}.store(vshader_src, fshader_src, linked_program);
+
+    ON_CALL(mock_gl, glGetString(GL_RENDERER))
+        .WillByDefault(Return(reinterpret_cast<GLubyte const*>("Another renderer")));
+    mrg::ProgramBinaryCache cache{cache_dir};
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(0u));
+}
+
+TEST_F(ProgramBinaryCache, misses_for_files_whose_binary_size_doesnt_match)
+{
+    mrg::ProgramBinaryCache{cache_dir}.store(vshader_src, fshader_src, linked_program);
+
+    for (auto const& entry : boost::filesystem::directory_iterator{cache_dir})
+        std::ofstream{entry.path().string(), std::ios::binary | std::ios::app} << "trailing junk";
+    mrg::ProgramBinaryCache cache{cache_dir};
+
+    EXPECT_CALL(mock_gl, glCreateProgram()).Times(0);
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(0u));
+}
+
+TEST_F(ProgramBinaryCache, leaves_no_temporary_files_behind)
+{
+    mrg::ProgramBinaryCache cache{cache_dir};
+    cache.store(vshader_src, fshader_src, linked_program);
+    cache.store(vshader_src, "another fragment shader", linked_program);
+
+    auto files = 0;
+    for (auto const& entry : boost::filesystem::directory_iterator{cache_dir})
+    {
+        EXPECT_THAT(entry.path().extension().string(), Eq(".bin"));
+        ++files;
+    }
+    EXPECT_THAT(files, Eq(2));
+}
+
+TEST_F(ProgramBinaryCache, discards_binaries_the_driver_rejects)
+{
+    mrg::ProgramBinaryCache cache{cache_dir};
+    cache.store(vshader_src, fshader_src, linked_program);
+
+    ON_CALL(mock_gl, glGetProgramiv(_, GL_LINK_STATUS, _))
+        .WillByDefault(SetArgPointee<2>(GL_FALSE));
+    EXPECT_CALL(mock_gl, glDeleteProgram(loaded_program));
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(0u));
+
+    ON_CALL(mock_gl, glGetProgramiv(_, GL_LINK_STATUS, _))
+        .WillByDefault(SetArgPointee<2>(GL_TRUE));
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(0u));
+    EXPECT_THAT(mrg::ProgramBinaryCache{cache_dir}.load(vshader_src, fshader_src), Eq(0u));
+}
+
+TEST_F(ProgramBinaryCache, does_nothing_without_program_binary_support)
+{
+    ON_CALL(mock_gl, glGetString(GL_EXTENSIONS))
+        .WillByDefault(Return(reinterpret_cast<GLubyte const*>("GL_OES_EGL_image")));
+    mrg::ProgramBinaryCache cache{cache_dir};
+
+    EXPECT_CALL(mock_gl, glGetProgramiv(_, GL_PROGRAM_BINARY_LENGTH_OES, _)).Times(0);
+    EXPECT_CALL(mock_gl, glCreateProgram()).Times(0);
+
+    cache.store(vshader_src, fshader_src, linked_program);
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(0u));
+}
+
+TEST_F(ProgramBinaryCache, keeps_binaries_in_memory_without_a_cache_dir)
+{
+    mrg::ProgramBinaryCache cache{""};
+    cache.store(vshader_src, fshader_src, linked_program);
+
+    EXPECT_THAT(cache.load(vshader_src, fshader_src), Eq(loaded_program));
+    EXPECT_TRUE(boost::filesystem::is_empty(cache_dir));
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2020 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <src/renderers/software/renderer.h>
+#include <mir/graphics/buffer_properties.h>
+#include <mir/test/doubles/mock_renderable.h>
+#include <mir/test/doubles/stub_buffer.h>
+#include <mir/test/doubles/stub_software_display_buffer.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <vector>
+
+using testing::Eq;
+using testing::Return;
+
+namespace mg = mir::graphics;
+namespace mrs = mir::renderer::software;
+namespace geom = mir::geometry;
+namespace mtd = mir::test::doubles;
+
+namespace
+{
+std::uint32_t const black{0xff000000};
+std::uint32_t const red{0xffff0000};
+std::uint32_t const green{0xff00ff00};
+std::uint32_t const blue{0xff0000ff};
+
+struct SoftwareRenderer : testing::Test
+{
+    std::shared_ptr<mg::Buffer> buffer_of(
+        geom::Size const& size,
+        std::vector<std::uint32_t> const& pixels,
+        MirPixelFormat format = mir_pixel_format_argb_8888)
+    {
+        auto const buffer = std::make_shared<mtd::StubBuffer>(
+            mg::BufferProperties{size, format, mg::BufferUsage::software});
+        buffer->write(reinterpret_cast<unsigned char const*>(pixels.data()), pixels.size() * 4);
+        return buffer;
+    }
+
+    std::shared_ptr<mtd::MockRenderable> renderable_of(
+        geom::Rectangle const& position,
+        std::shared_ptr<mg::Buffer> const& buffer,
+        bool shaped = false,
+        float alpha = 1.0f)
+    {
+        auto const r = std::make_shared<testing::NiceMock<mtd::MockRenderable>>();
+        ON_CALL(*r, id()).WillByDefault(Return(r.get()));
+        ON_CALL(*r, screen_position()).WillByDefault(Return(position));
+        ON_CALL(*r, buffer()).WillByDefault(Return(buffer));
+        ON_CALL(*r, shaped()).WillByDefault(Return(shaped));
+        ON_CALL(*r, alpha()).WillByDefault(Return(alpha));
+        ON_CALL(*r, transformation()).WillByDefault(Return(glm::mat4(1)));
+        return r;
+    }
+
+    std::vector<std::uint32_t> column(int x)
+    {
+        std::vector<std::uint32_t> result;
+        for (auto y = 0; y != display_buffer.size.height.as_int(); ++y)
+            result.push_back(display_buffer.pixel(x, y));
+        return result;
+    }
+
+    mtd::StubSoftwareDisplayBuffer display_buffer{{{0, 0}, {4, 4}}};
+};
+}
+
+TEST_F(SoftwareRenderer, draws_buffers_at_their_screen_position)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+
+    renderer.render({renderable_of({{1, 2}, {2, 1}}, buffer_of({2, 1}, {red, green}))});
+
+    EXPECT_THAT(display_buffer.pixel(1, 2), Eq(red));
+    EXPECT_THAT(display_buffer.pixel(2, 2), Eq(green));
+    EXPECT_THAT(display_buffer.pixel(0, 2), Eq(black));
+    EXPECT_THAT(display_buffer.pixel(1, 1), Eq(black));
+    EXPECT_THAT(display_buffer.swaps, Eq(1));
+}
+
+TEST_F(SoftwareRenderer, draws_in_the_viewport)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    renderer.set_viewport({{10, 10}, {4, 4}});
+
+    renderer.render({renderable_of({{11, 10}, {1, 1}}, buffer_of({1, 1}, {red}))});
+
+    EXPECT_THAT(display_buffer.pixel(1, 0), Eq(red));
+}
+
+TEST_F(SoftwareRenderer, converts_buffers_to_the_output_channel_order)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+
+    // ABGR red has red in the low byte
+    renderer.render({renderable_of({{0, 0}, {1, 1}}, buffer_of({1, 1}, {0xff0000ff}, mir_pixel_format_abgr_8888))});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(red));
+}
+
+TEST_F(SoftwareRenderer, treats_buffers_without_alpha_as_opaque)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+
+    renderer.render({renderable_of({{0, 0}, {1, 1}}, buffer_of({1, 1}, {0x00ff0000}, mir_pixel_format_xrgb_8888), true)});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(red));
+}
+
+TEST_F(SoftwareRenderer, blends_shaped_buffers_over_what_is_below)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+
+    renderer.render({
+        renderable_of({{0, 0}, {1, 1}}, buffer_of({1, 1}, {red})),
+        renderable_of({{0, 0}, {1, 1}}, buffer_of({1, 1}, {0x80000080}), true)});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(0xff7f0080u));
+}
+
+TEST_F(SoftwareRenderer, applies_renderable_alpha)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+
+    renderer.render({renderable_of({{0, 0}, {1, 1}}, buffer_of({1, 1}, {0xffffffff}), false, 0.5f)});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(0xff808080u));
+}
+
+TEST_F(SoftwareRenderer, draws_only_within_clip_area)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    auto const r = renderable_of({{0, 0}, {2, 1}}, buffer_of({2, 1}, {red, green}));
+    ON_CALL(*r, clip_area()).WillByDefault(Return(geom::Rectangle{{1, 0}, {3, 3}}));
+
+    renderer.render({r});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(black));
+    EXPECT_THAT(display_buffer.pixel(1, 0), Eq(green));
+}
+
+TEST_F(SoftwareRenderer, draws_only_visible_regions_of_partly_hidden_renderables)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    auto const r = renderable_of({{0, 0}, {2, 1}}, buffer_of({2, 1}, {red, green}));
+
+    renderer.set_visible_regions({{r->id(), geom::Rectangles{{{0, 0}, {1, 1}}}}});
+    renderer.render({r});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(red));
+    EXPECT_THAT(display_buffer.pixel(1, 0), Eq(black));
+}
+
+TEST_F(SoftwareRenderer, scales_buffers_to_their_screen_position)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+
+    renderer.render({renderable_of({{0, 0}, {4, 1}}, buffer_of({2, 1}, {red, green}))});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(red));
+    EXPECT_THAT(display_buffer.pixel(1, 0), Eq(red));
+    EXPECT_THAT(display_buffer.pixel(2, 0), Eq(green));
+    EXPECT_THAT(display_buffer.pixel(3, 0), Eq(green));
+}
+
+TEST_F(SoftwareRenderer, applies_renderable_transformation_about_its_centre)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    auto const r = renderable_of({{0, 0}, {4, 1}}, buffer_of({4, 1}, {red, green, green, blue}));
+    // Mirrored left to right
+    ON_CALL(*r, transformation()).WillByDefault(Return(glm::mat4(glm::mat2(-1, 0, 0, 1))));
+
+    renderer.render({r});
+
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(blue));
+    EXPECT_THAT(display_buffer.pixel(3, 0), Eq(red));
+}
+
+TEST_F(SoftwareRenderer, applies_output_transform)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    // A quarter turn anticlockwise
+    renderer.set_output_transform(glm::mat2(0, 1, -1, 0));
+
+    renderer.render({renderable_of({{0, 0}, {1, 1}}, buffer_of({1, 1}, {red}))});
+
+    EXPECT_THAT(display_buffer.pixel(0, 3), Eq(red));
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(black));
+}
+
+TEST_F(SoftwareRenderer, repaints_only_damage_when_the_back_buffer_is_recent)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    auto const r = renderable_of({{0, 0}, {4, 4}}, buffer_of({4, 4}, std::vector<std::uint32_t>(16, red)));
+    renderer.render({r});
+
+    std::fill(display_buffer.pixels.begin(), display_buffer.pixels.end(), blue);
+    display_buffer.age = 1;
+    renderer.set_damage(geom::Rectangles{{{1, 1}, {1, 1}}});
+    renderer.render({r});
+
+    EXPECT_THAT(display_buffer.pixel(1, 1), Eq(red));
+    EXPECT_THAT(display_buffer.pixel(0, 0), Eq(blue));
+    EXPECT_THAT(display_buffer.pixel(2, 2), Eq(blue));
+}
+
+TEST_F(SoftwareRenderer, repaints_everything_when_the_back_buffer_is_unknown)
+{
+    mrs::Renderer renderer{display_buffer, 1};
+    auto const r = renderable_of({{0, 0}, {4, 4}}, buffer_of({4, 4}, std::vector<std::uint32_t>(16, red)));
+    renderer.render({r});
+
+    std::fill(display_buffer.pixels.begin(), display_buffer.pixels.end(), blue);
+    renderer.set_damage(geom::Rectangles{{{1, 1}, {1, 1}}});
+    renderer.render({r});
+
+    EXPECT_THAT(display_buffer.pixels, Eq(std::vector<std::uint32_t>(16, red)));
+}
+
+TEST_F(SoftwareRenderer, draws_the_same_with_several_threads)
+{
+    geom::Rectangle const area{{0, 0}, {97, 203}};
+    mtd::StubSoftwareDisplayBuffer one_thread_buffer{area};
+    mtd::StubSoftwareDisplayBuffer threads_buffer{area};
+
+    std::vector<std::uint32_t> pixels(50 * 150);
+    for (auto i = 0u; i != pixels.size(); ++i)
+        pixels[i] = (i % 3 ? 0x80000000 : 0xff000000) | (i * 2654435761u & 0x007f7f7f);
+
+    mg::RenderableList const renderables{
+        renderable_of({{0, 0}, {97, 203}}, buffer_of({97, 203}, std::vector<std::uint32_t>(97 * 203, green))),
+        renderable_of({{10, 20}, {50, 150}}, buffer_of({50, 150}, pixels), true),
+        renderable_of({{40, 60}, {50, 150}}, buffer_of({50, 150}, pixels), true, 0.75f)};
+
+    mrs::Renderer{one_thread_buffer, 1}.render(renderables);
+    mrs::Renderer{threads_buffer, 4}.render(renderables);
+
+    EXPECT_THAT(threads_buffer.pixels, Eq(one_thread_buffer.pixels));
+}
@@ -39,6 +39,10 @@ struct MockBufferCallback
 {
     MOCK_METHOD1(invoke, void(int));
 };
+struct MockDamageCallback
+{
+    MOCK_METHOD2(invoke, void(int, mir::geometry::Rectangle const&));
+};
 
 struct LegacySceneChangeNotificationTest : public testing::Test
 {
@@ -49,8 +53,11 @@ struct LegacySceneChangeNotificationTest : public testing::Test
     }
     testing::NiceMock<MockSceneCallback> scene_callback;
     testing::NiceMock<MockBufferCallback> buffer_callback;
+    testing::NiceMock<MockDamageCallback> damage_callback;
     std::function<void(int)> buffer_change_callback{[this](int arg){buffer_callback.invoke(arg);}};
     std::function<void()> scene_change_callback{[this](){scene_callback.invoke();}};
+    std::function<void(int, mir::geometry::Rectangle const&)> damage_change_callback{
+        [this](int frames, mir::geometry::Rectangle const& damage){damage_callback.invoke(frames, damage);}};
     std::shared_ptr<testing::NiceMock<mtd::MockSurface>> surface;
 }; 
 }
@@ -144,3 +151,120 @@ TEST_F(LegacySceneChangeNotificationTest, ending_observation_unregisters_observe
     // Verify that its not simply the destruction removing the observer...
     ::testing::Mock::VerifyAndClearExpectations(&observer);
 }
+
+TEST_F(LegacySceneChangeNotificationTest, moving_surface_damages_where_it_was_and_where_it_is)
+{
+    using namespace ::testing;
+    using namespace mir::geometry;
+
+    std::shared_ptr<ms::SurfaceObserver> surface_observer;
+    EXPECT_CALL(*surface, add_observer(_)).Times(1)
+        .WillOnce(SaveArg<0>(&surface_observer));
+
+    surface->resize({100, 50});
+    surface->move_to({10, 20});
+
+    ms::LegacySceneChangeNotification observer(scene_change_callback, damage_change_callback);
+    observer.surface_added(surface);
+    Mock::VerifyAndClearExpectations(&damage_callback);
+
+    EXPECT_CALL(scene_callback, invoke()).Times(0);
+    EXPECT_CALL(damage_callback, invoke(1, Rectangle{{10, 20}, {100, 50}}));
+    EXPECT_CALL(damage_callback, invoke(1, Rectangle{{500, 20}, {100, 50}}));
+
+    surface->move_to({500, 20});
+    surface_observer->moved_to(surface.get(), {500, 20});
+}
+
+TEST_F(LegacySceneChangeNotificationTest, moving_surface_grown_by_a_posted_frame_damages_all_it_covered)
+{
+    using namespace ::testing;
+    using namespace mir::geometry;
+
+    std::shared_ptr<ms::SurfaceObserver> surface_observer;
+    EXPECT_CALL(*surface, add_observer(_)).Times(1)
+        .WillOnce(SaveArg<0>(&surface_observer));
+
+    surface->resize({100, 50});
+    surface->move_to({10, 20});
+
+    ms::LegacySceneChangeNotification observer(scene_change_callback, damage_change_callback);
+    observer.surface_added(surface);
+
+    // The client posts a bigger buffer, which is all that tells us the surface has grown
+    surface->resize({300, 200});
+    surface_observer->frame_posted(surface.get(), 1, {300, 200});
+    Mock::VerifyAndClearExpectations(&damage_callback);
+
+    EXPECT_CALL(damage_callback, invoke(1, Rectangle{{10, 20}, {300, 200}}));
+    EXPECT_CALL(damage_callback, invoke(1, Rectangle{{500, 20}, {300, 200}}));
+
+    surface->move_to({500, 20});
+    surface_observer->moved_to(surface.get(), {500, 20});
+}
+
+TEST_F(LegacySceneChangeNotificationTest, surface_changes_damage_only_the_surface)
+{
+    using namespace ::testing;
+    using namespace mir::geometry;
+
+    std::shared_ptr<ms::SurfaceObserver> surface_observer;
+    EXPECT_CALL(*surface, add_observer(_)).Times(1)
+        .WillOnce(SaveArg<0>(&surface_observer));
+
+    surface->resize({100, 50});
+    surface->move_to({10, 20});
+    Rectangle const surface_area{{10, 20}, {100, 50}};
+
+    ms::LegacySceneChangeNotification observer(scene_change_callback, damage_change_callback);
+    observer.surface_added(surface);
+
+    EXPECT_CALL(scene_callback, invoke()).Times(0);
+    EXPECT_CALL(damage_callback, invoke(1, surface_area)).Times(AtLeast(1));
+
+    surface_observer->alpha_set_to(surface.get(), 0.5f);
+    surface_observer->hidden_set_to(surface.get(), false);
+    surface_observer->renamed(surface.get(), "Something New");
+}
+
+TEST_F(LegacySceneChangeNotificationTest, adding_and_removing_surface_damages_its_area)
+{
+    using namespace ::testing;
+    using namespace mir::geometry;
+
+    surface->resize({100, 50});
+    surface->move_to({10, 20});
+    Rectangle const surface_area{{10, 20}, {100, 50}};
+
+    EXPECT_CALL(scene_callback, invoke()).Times(0);
+    EXPECT_CALL(damage_callback, invoke(1, surface_area)).Times(2);
+
+    ms::LegacySceneChangeNotification observer(scene_change_callback, damage_change_callback);
+    observer.surface_added(surface);
+    observer.surface_removed(surface);
+}
+
+TEST_F(LegacySceneChangeNotificationTest, raising_surface_damages_its_area)
+{
+    using namespace ::testing;
+    using namespace mir::geometry;
+
+    surface->resize({100, 50});
+    surface->move_to({10, 20});
+
+    ms::LegacySceneChangeNotification observer(scene_change_callback, damage_change_callback);
+
+    EXPECT_CALL(scene_callback, invoke()).Times(0);
+    EXPECT_CALL(damage_callback, invoke(1, Rectangle{{10, 20}, {100, 50}}));
+
+    observer.surfaces_reordered({surface});
+}
+
+TEST_F(LegacySceneChangeNotificationTest, reordering_unknown_surfaces_redraws_everything)
+{
+    EXPECT_CALL(scene_callback, invoke()).Times(1);
+    EXPECT_CALL(damage_callback, invoke(testing::_, testing::_)).Times(0);
+
+    ms::LegacySceneChangeNotification observer(scene_change_callback, damage_change_callback);
+    observer.surfaces_reordered({});
+}
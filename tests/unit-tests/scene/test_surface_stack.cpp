@@ -1261,3 +1261,40 @@ TEST_F(SurfaceStack, all_depth_layers_are_handled)
     }
 
 }
+
+TEST_F(SurfaceStack, publishes_a_new_snapshot_version_when_the_stack_changes)
+{
+    using namespace testing;
+
+    auto const initial = stack.snapshot();
+    stack.add_surface(stub_surface1, default_params.input_mode);
+    auto const added = stack.snapshot();
+    stack.add_surface(stub_surface2, default_params.input_mode);
+    stack.raise(stub_surface1);
+    auto const raised = stack.snapshot();
+
+    EXPECT_THAT(added->version, Gt(initial->version));
+    EXPECT_THAT(raised->version, Gt(added->version));
+    ASSERT_THAT(raised->surfaces.size(), Eq(2u));
+    EXPECT_THAT(raised->surfaces[0].surface, Eq(stub_surface2));
+    EXPECT_THAT(raised->surfaces[1].surface, Eq(stub_surface1));
+}
+
+TEST_F(SurfaceStack, held_snapshot_is_unaffected_by_later_changes)
+{
+    using namespace testing;
+
+    stack.add_surface(stub_surface1, default_params.input_mode);
+    auto const held = stack.snapshot();
+    auto const version = held->version;
+
+    stack.add_surface(stub_surface2, default_params.input_mode);
+    stack.remove_surface(stub_surface1);
+    stack.add_input_visualization(std::make_shared<mtd::StubRenderable>());
+
+    EXPECT_THAT(held->version, Eq(version));
+    ASSERT_THAT(held->surfaces.size(), Eq(1u));
+    EXPECT_THAT(held->surfaces[0].surface, Eq(stub_surface1));
+    EXPECT_THAT(held->overlays, IsEmpty());
+    EXPECT_THAT(stack.snapshot()->surfaces.size(), Eq(1u));
+}